@@ -0,0 +1,172 @@
+//
+//  bake.cpp
+//  cli
+//
+
+#include "bake.hpp"
+
+// C++
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+// Cubzh Core
+#include "color_atlas.h"
+#include "serialization.h"
+#include "shape.h"
+#include "stream.h"
+#include "thread_pool.h"
+#include "utils.h"
+
+namespace {
+
+struct BakeJob {
+    std::string inputPath;
+    std::string outputPath;
+    size_t nbChunks = 0;
+    double loadMs = 0.0;
+    double lightMs = 0.0;
+    double writeMs = 0.0;
+    std::string err;
+};
+
+double elapsed_ms(std::chrono::steady_clock::time_point start) {
+    const auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+/// "dir/user.item.3zh" -> "user.item"
+std::string item_fullname(const std::string& path) {
+    const size_t slash = path.find_last_of("/\\");
+    std::string name = slash == std::string::npos ? path : path.substr(slash + 1);
+    const size_t dot = name.rfind(".3zh");
+    if (dot != std::string::npos && dot + 4 == name.size()) {
+        name.resize(dot);
+    }
+    return name;
+}
+
+std::string directory(const std::string& path) {
+    const size_t slash = path.find_last_of("/\\");
+    return slash == std::string::npos ? std::string(".") : path.substr(0, slash);
+}
+
+void bake_job(void *userdata) {
+    BakeJob *job = static_cast<BakeJob *>(userdata);
+
+    // each job has its own atlas, color atlases aren't thread safe
+    ColorAtlas *atlas = color_atlas_new();
+
+    auto start = std::chrono::steady_clock::now();
+    Stream *stream = stream_new_mmap_read(job->inputPath.c_str());
+    Shape *s = nullptr;
+    if (stream != nullptr) {
+        LoadShapeSettings settings = {.lighting = false, .isMutable = false};
+        // `stream` is freed by `serialization_load_shape`
+        s = serialization_load_shape(stream,
+                                     item_fullname(job->inputPath).c_str(),
+                                     atlas,
+                                     &settings,
+                                     true);
+    }
+    job->loadMs = elapsed_ms(start);
+    if (s == nullptr) {
+        job->err = "can't load";
+        color_atlas_free(atlas);
+        return;
+    }
+    job->nbChunks = shape_get_nb_chunks(s);
+
+    // big shapes are lit w/ the same thread pool, waiting jobs run other jobs meanwhile
+    start = std::chrono::steady_clock::now();
+    shape_compute_baked_lighting(s);
+    job->lightMs = elapsed_ms(start);
+
+    start = std::chrono::steady_clock::now();
+    const uint64_t hash = shape_get_baked_lighting_hash(s);
+    char id[17];
+    snprintf(id, sizeof(id), "%016" PRIx64, hash);
+    char *bakedFullname = utils_get_baked_fullname(id, item_fullname(job->inputPath).c_str());
+    job->outputPath = job->outputPath + "/" + bakedFullname;
+    free(bakedFullname);
+
+    FILE *fd = fopen(job->outputPath.c_str(), "wb");
+    if (fd == nullptr) {
+        job->err = "can't open output file";
+    } else {
+        if (serialization_save_baked_file(s, hash, fd) == false) {
+            job->err = "can't write baked file";
+        }
+        fclose(fd);
+    }
+    job->writeMs = elapsed_ms(start);
+
+    shape_free(s);
+    color_atlas_free(atlas);
+}
+
+} // namespace
+
+bool command_bake(cxxopts::ParseResult parseResult, std::string& err) {
+    if (parseResult.count("input") <= 0) {
+        err.assign("no input files");
+        return false;
+    }
+    const std::vector<std::string> input_paths = parseResult["input"]
+                                                     .as<std::vector<std::string>>();
+    std::string output_dir;
+    if (parseResult.count("output") > 0) {
+        output_dir = parseResult["output"].as<std::string>();
+    }
+
+    std::vector<BakeJob> jobs(input_paths.size());
+    for (size_t i = 0; i < input_paths.size(); ++i) {
+        jobs[i].inputPath = input_paths[i];
+        jobs[i].outputPath = output_dir.empty() ? directory(input_paths[i]) : output_dir;
+    }
+
+    ThreadPool *pool = thread_pool_get_shared();
+    std::cout << "* Baking lighting of " << jobs.size() << " file(s), "
+              << thread_pool_get_nb_workers(pool) << " workers" << std::endl;
+
+    const auto start = std::chrono::steady_clock::now();
+    ThreadPoolBatch *batch = thread_pool_batch_new(pool);
+    for (BakeJob& job : jobs) {
+        thread_pool_batch_add_job(batch, bake_job, &job);
+    }
+    thread_pool_batch_wait_and_free(batch);
+    const double totalMs = elapsed_ms(start);
+
+    std::cout << std::left << std::setw(40) << "file" << std::right << std::setw(8) << "chunks"
+              << std::setw(10) << "load ms" << std::setw(10) << "light ms" << std::setw(10)
+              << "write ms" << std::endl;
+
+    double sumMs = 0.0;
+    size_t failures = 0;
+    for (const BakeJob& job : jobs) {
+        std::cout << std::left << std::setw(40) << job.inputPath << std::right << std::setw(8)
+                  << job.nbChunks << std::fixed << std::setprecision(1) << std::setw(10)
+                  << job.loadMs << std::setw(10) << job.lightMs << std::setw(10) << job.writeMs;
+        if (job.err.empty()) {
+            std::cout << "  -> " << job.outputPath << std::endl;
+        } else {
+            std::cout << "  ERROR: " << job.err << std::endl;
+            ++failures;
+        }
+        sumMs += job.loadMs + job.lightMs + job.writeMs;
+    }
+
+    std::cout << "* " << jobs.size() - failures << "/" << jobs.size() << " file(s) baked in "
+              << std::fixed << std::setprecision(1) << totalMs << " ms (" << sumMs
+              << " ms of work)" << std::endl;
+
+    if (failures > 0) {
+        err = std::to_string(failures) + " file(s) couldn't be baked";
+        return false;
+    }
+    return true;
+}
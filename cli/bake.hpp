@@ -0,0 +1,19 @@
+//
+//  bake.hpp
+//  cli
+//
+
+#pragma once
+
+// C++
+#include <string>
+
+// cxxopts
+#include <cxxopts.hpp>
+
+/// Computes baked lighting of input .3zh files, in parallel across files, and writes one baked
+/// file per input in output directory (input directory if not given). Baked files are named like
+/// the engine's (see utils_get_baked_fullname), w/ shape_get_baked_lighting_hash as hex id.
+/// Returns true on success, false otherwise.
+/// When an error occured, the `err` argument is filled with an error message.
+bool command_bake(cxxopts::ParseResult parseResult, std::string& err);
@@ -0,0 +1,130 @@
+//
+//  bench_boxcast.cpp
+//  cli
+//
+
+#include "bench_boxcast.hpp"
+#include "bench_utils.hpp"
+
+// C++
+#include <cmath>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+// Cubzh Core
+#include "color_atlas.h"
+#include "config.h"
+#include "rigidBody.h"
+#include "shape.h"
+
+// number of players walking over the terrain
+static const size_t playerCounts[] = {100, 1000, 5000};
+static const SHAPE_COORDS_INT_T mapSize = 256;
+static const size_t nbFrames = 120;
+static const float frameDt = 1.0f / 60.0f;
+static const float gravity = -30.0f;
+static const float walkSpeed = 6.0f;
+
+struct Player {
+    Box box;
+    float3 velocity;
+};
+
+/// Falls & walks, stopping along the axis of the first block hit, like a dynamic rigidbody
+static bool step(const Shape *s, Player& p, uint32_t& seed) {
+    p.velocity.y += gravity * frameDt;
+    if (next_random(seed) < 0.02f) {
+        const float angle = next_random(seed) * 2.0f * PI_F;
+        p.velocity.x = std::cos(angle) * walkSpeed;
+        p.velocity.z = std::sin(angle) * walkSpeed;
+    }
+
+    float3 dv = {p.velocity.x * frameDt, p.velocity.y * frameDt, p.velocity.z * frameDt};
+    float3 normal;
+    const float swept = shape_box_cast(s,
+                                       &p.box,
+                                       &dv,
+                                       &float3_epsilon_collision,
+                                       true,
+                                       &normal,
+                                       nullptr,
+                                       nullptr,
+                                       nullptr);
+    if (swept < 1.0f) {
+        float3_op_scale(&dv, swept);
+        if (normal.x != 0.0f) {
+            p.velocity.x = -p.velocity.x;
+        }
+        if (normal.y != 0.0f) {
+            p.velocity.y = 0.0f;
+        }
+        if (normal.z != 0.0f) {
+            p.velocity.z = -p.velocity.z;
+        }
+    }
+    float3_op_add(&p.box.min, &dv);
+    float3_op_add(&p.box.max, &dv);
+
+    // players leaving the terrain are dropped back above it
+    if (p.box.min.x < 0.0f || p.box.min.z < 0.0f || p.box.max.x > mapSize ||
+        p.box.max.z > mapSize || p.box.min.y < -10.0f) {
+        const float3 offset = {mapSize * 0.5f - p.box.min.x, 20.0f - p.box.min.y,
+                               mapSize * 0.5f - p.box.min.z};
+        float3_op_add(&p.box.min, &offset);
+        float3_op_add(&p.box.max, &offset);
+    }
+    return swept < 1.0f;
+}
+
+static void bench(const Shape *s, size_t nbPlayers) {
+    uint32_t seed = 42;
+    std::vector<Player> players(nbPlayers);
+    for (Player& p : players) {
+        const float x = 2.0f + next_random(seed) * (mapSize - 4);
+        const float y = 12.0f + next_random(seed) * 8.0f;
+        const float z = 2.0f + next_random(seed) * (mapSize - 4);
+        p.box = {{x, y, z}, {x + 0.8f, y + 1.8f, z + 0.8f}};
+        p.velocity = float3_zero;
+    }
+
+    size_t hits = 0;
+    const double ms = measure_ms([&] {
+        for (size_t f = 0; f < nbFrames; ++f) {
+            for (Player& p : players) {
+                hits += step(s, p, seed) ? 1 : 0;
+            }
+        }
+    });
+
+    // same moves give the same positions, to compare implementations
+    double checksum = 0.0;
+    for (const Player& p : players) {
+        checksum += static_cast<double>(p.box.min.x + p.box.min.y * 3.0f + p.box.min.z * 7.0f);
+    }
+
+    const double frames = static_cast<double>(nbFrames);
+    std::cout << std::setw(8) << nbPlayers << std::fixed << std::setprecision(3) << std::setw(12)
+              << ms / frames << std::setw(12) << ms * 1000.0 / (frames * nbPlayers)
+              << std::setw(12) << hits << std::setw(16) << checksum << std::endl;
+}
+
+bool command_bench_boxcast(cxxopts::ParseResult parseResult, std::string& err) {
+    ColorAtlas *atlas = color_atlas_new();
+    Shape *s = generate_terrain(atlas, mapSize);
+
+    std::cout << "* Players over a " << mapSize << "x" << mapSize << " terrain, " << nbFrames
+              << " frames, each player cast against terrain blocks" << std::endl;
+    std::cout << std::setw(8) << "players" << std::setw(12) << "ms/frame" << std::setw(12)
+              << "us/cast" << std::setw(12) << "hits" << std::setw(16) << "checksum"
+              << std::endl;
+
+    for (const size_t nbPlayers : playerCounts) {
+        bench(s, nbPlayers);
+    }
+
+    shape_free(s);
+    color_atlas_free(atlas);
+    return true;
+}
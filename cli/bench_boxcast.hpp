@@ -0,0 +1,18 @@
+//
+//  bench_boxcast.hpp
+//  cli
+//
+
+#pragma once
+
+// C++
+#include <string>
+
+// cxxopts
+#include <cxxopts.hpp>
+
+/// Measures frames of N players walking & falling over a generated terrain, each cast against the
+/// terrain blocks w/ shape_box_cast, like dynamic rigidbodies against a per-block map.
+/// Returns true on success, false otherwise.
+/// When an error occured, the `err` argument is filled with an error message.
+bool command_bench_boxcast(cxxopts::ParseResult parseResult, std::string& err);
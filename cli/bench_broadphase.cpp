@@ -0,0 +1,163 @@
+//
+//  bench_broadphase.cpp
+//  cli
+//
+
+#include "bench_broadphase.hpp"
+#include "bench_utils.hpp"
+
+// C++
+#include <cmath>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+// Cubzh Core
+#include "broadphase.h"
+#include "config.h"
+#include "rtree.h"
+
+// number of moving boxes, w/ as many static boxes
+static const size_t movingCounts[] = {500, 2000, 8000};
+static const size_t nbFrames = 120;
+static const float frameDt = 1.0f / 60.0f;
+
+struct Mover {
+    Box box;
+    float3 velocity;
+    RtreeNode *leaf;
+};
+
+/// Avatar-sized box, within a flat arena
+static Box random_box(uint32_t& seed, float arenaSize) {
+    const float x = next_random(seed) * arenaSize;
+    const float y = next_random(seed) * 32.0f;
+    const float z = next_random(seed) * arenaSize;
+    const float size = 2.0f + next_random(seed) * 8.0f;
+    return {{x, y, z}, {x + size, y + size, z + size}};
+}
+
+/// Moving boxes bounce on the arena bounds
+static void move(Mover& m, float arenaSize) {
+    const float3 dv = {m.velocity.x * frameDt, m.velocity.y * frameDt, m.velocity.z * frameDt};
+    float3_op_add(&m.box.min, &dv);
+    float3_op_add(&m.box.max, &dv);
+    if ((m.box.min.x < 0.0f && m.velocity.x < 0.0f) ||
+        (m.box.max.x > arenaSize && m.velocity.x > 0.0f)) {
+        m.velocity.x = -m.velocity.x;
+    }
+    if ((m.box.min.y < 0.0f && m.velocity.y < 0.0f) ||
+        (m.box.max.y > 32.0f && m.velocity.y > 0.0f)) {
+        m.velocity.y = -m.velocity.y;
+    }
+    if ((m.box.min.z < 0.0f && m.velocity.z < 0.0f) ||
+        (m.box.max.z > arenaSize && m.velocity.z > 0.0f)) {
+        m.velocity.z = -m.velocity.z;
+    }
+}
+
+/// Same scene & moves for each broadphase, static boxes are always in the r-tree
+static void bench(size_t nbMoving, BroadphaseType type, const char *name) {
+    const float arenaSize = 12.0f * std::sqrt(static_cast<float>(nbMoving));
+    uint32_t seed = 42;
+
+    Rtree *r = rtree_new(RTREE_NODE_MIN_CAPACITY, RTREE_NODE_MAX_CAPACITY);
+    Broadphase *b = type == BroadphaseType_Rtree ? nullptr : broadphase_new(type);
+
+    std::vector<RtreeNode *> statics(nbMoving);
+    for (size_t i = 0; i < nbMoving; ++i) {
+        Box box = random_box(seed, arenaSize);
+        statics[i] = rtree_create_leaf(r,
+                                       &box,
+                                       PHYSICS_GROUP_DEFAULT_MAP,
+                                       PHYSICS_GROUP_NONE,
+                                       reinterpret_cast<void *>(i + 1));
+    }
+    rtree_bulk_load(r, statics.data(), nbMoving);
+
+    std::vector<Mover> movers(nbMoving);
+    for (size_t i = 0; i < nbMoving; ++i) {
+        Mover& m = movers[i];
+        m.box = random_box(seed, arenaSize);
+        m.velocity = {(next_random(seed) - 0.5f) * 40.0f,
+                      (next_random(seed) - 0.5f) * 10.0f,
+                      (next_random(seed) - 0.5f) * 40.0f};
+        if (b != nullptr) {
+            m.leaf = rtree_create_leaf(r,
+                                       &m.box,
+                                       PHYSICS_GROUP_DEFAULT_PLAYER,
+                                       PHYSICS_GROUP_ALL_SYSTEM,
+                                       reinterpret_cast<void *>(nbMoving + i + 1));
+            broadphase_insert(b, m.leaf);
+        } else {
+            m.leaf = rtree_create_and_insert(r,
+                                             &m.box,
+                                             PHYSICS_GROUP_DEFAULT_PLAYER,
+                                             PHYSICS_GROUP_ALL_SYSTEM,
+                                             reinterpret_cast<void *>(nbMoving + i + 1));
+        }
+    }
+
+    FifoList *results = fifo_list_new();
+    size_t hits = 0;
+    double updateMs = 0.0, queryMs = 0.0;
+    for (size_t f = 0; f < nbFrames; ++f) {
+        updateMs += measure_ms([&] {
+            for (Mover& m : movers) {
+                move(m, arenaSize);
+                if (b != nullptr) {
+                    broadphase_update(b, m.leaf, &m.box);
+                } else {
+                    rtree_update(r, m.leaf, &m.box);
+                }
+            }
+        });
+        queryMs += measure_ms([&] {
+            for (const Mover& m : movers) {
+                hits += rtree_query_overlap_box(r,
+                                                &m.box,
+                                                PHYSICS_GROUP_DEFAULT_PLAYER,
+                                                PHYSICS_GROUP_ALL_SYSTEM,
+                                                nullptr,
+                                                results,
+                                                -EPSILON_COLLISION);
+                if (b != nullptr) {
+                    hits += broadphase_query_overlap_box(b,
+                                                         &m.box,
+                                                         PHYSICS_GROUP_DEFAULT_PLAYER,
+                                                         PHYSICS_GROUP_ALL_SYSTEM,
+                                                         nullptr,
+                                                         results,
+                                                         -EPSILON_COLLISION);
+                }
+                while (fifo_list_pop(results) != nullptr) {}
+            }
+        });
+    }
+    fifo_list_free(results, nullptr);
+
+    const double frames = static_cast<double>(nbFrames);
+    std::cout << std::setw(8) << nbMoving << std::setw(12) << name << std::fixed
+              << std::setprecision(3) << std::setw(12) << updateMs / frames << std::setw(12)
+              << queryMs / frames << std::setw(12) << (updateMs + queryMs) / frames
+              << std::setw(12) << hits << std::endl;
+
+    broadphase_free(b);
+    rtree_free(r);
+}
+
+bool command_bench_broadphase(cxxopts::ParseResult parseResult, std::string& err) {
+    std::cout << "* Moving boxes among as many static boxes, " << nbFrames
+              << " frames, each box moved then queried (ms per frame)" << std::endl;
+    std::cout << std::setw(8) << "moving" << std::setw(12) << "broadphase" << std::setw(12)
+              << "update" << std::setw(12) << "query" << std::setw(12) << "frame"
+              << std::setw(12) << "hits" << std::endl;
+
+    for (const size_t nbMoving : movingCounts) {
+        bench(nbMoving, BroadphaseType_Rtree, "r-tree");
+        bench(nbMoving, BroadphaseType_HashGrid, "hash grid");
+        bench(nbMoving, BroadphaseType_SweepAndPrune, "SAP");
+    }
+    return true;
+}
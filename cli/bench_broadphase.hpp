@@ -0,0 +1,18 @@
+//
+//  bench_broadphase.hpp
+//  cli
+//
+
+#pragma once
+
+// C++
+#include <string>
+
+// cxxopts
+#include <cxxopts.hpp>
+
+/// Measures frames of N moving boxes among static boxes, each moved then queried against the
+/// scene, w/ moving boxes in the r-tree, in a hash grid, & in a sweep-and-prune broadphase.
+/// Returns true on success, false otherwise.
+/// When an error occured, the `err` argument is filled with an error message.
+bool command_bench_broadphase(cxxopts::ParseResult parseResult, std::string& err);
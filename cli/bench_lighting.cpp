@@ -0,0 +1,124 @@
+//
+//  bench_lighting.cpp
+//  cli
+//
+
+#include "bench_lighting.hpp"
+#include "bench_utils.hpp"
+
+// C++
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+// Cubzh Core
+#include "asset_cache.h"
+#include "color_atlas.h"
+#include "shape.h"
+#include "stream.h"
+#include "thread_pool.h"
+
+// generated maps, same as unit tests
+#include "tests/lighting_map.h"
+
+// side of generated maps, in blocks
+static const SHAPE_COORDS_INT_T mapSizes[] = {64, 128, 256, 512};
+
+static Shape *load_map(ColorAtlas *atlas, const std::string& path) {
+    Stream *stream = stream_new_mmap_read(path.c_str());
+    if (stream == nullptr) {
+        return nullptr;
+    }
+    LoadShapeSettings settings = {.lighting = false, .isMutable = false};
+    // each input is loaded twice, second load is a copy of the cached shape
+    // `stream` is freed by `asset_cache_load_shape`
+    return asset_cache_load_shape(asset_cache_get_shared(), stream, "", atlas, &settings, true);
+}
+
+static bool same_lighting(const Shape *a, const Shape *b) {
+    SHAPE_COORDS_INT3_T min, max;
+    shape_get_model_aabb_2(a, &min, &max);
+    for (int x = min.x - 2; x <= max.x + 1; ++x) {
+        for (int y = min.y - 1; y <= max.y + 1; ++y) {
+            for (int z = min.z - 2; z <= max.z + 1; ++z) {
+                const VERTEX_LIGHT_STRUCT_T la = shape_get_light_or_default(
+                    a,
+                    static_cast<SHAPE_COORDS_INT_T>(x),
+                    static_cast<SHAPE_COORDS_INT_T>(y),
+                    static_cast<SHAPE_COORDS_INT_T>(z));
+                const VERTEX_LIGHT_STRUCT_T lb = shape_get_light_or_default(
+                    b,
+                    static_cast<SHAPE_COORDS_INT_T>(x),
+                    static_cast<SHAPE_COORDS_INT_T>(y),
+                    static_cast<SHAPE_COORDS_INT_T>(z));
+                if (memcmp(&la, &lb, sizeof(VERTEX_LIGHT_STRUCT_T)) != 0) {
+                    return false;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+/// Lights 2 copies of the same map, one w/ each path, returns false if results differ
+static bool bench(const std::string& name, Shape *serial, Shape *parallel, ThreadPool *pool) {
+    const double serialMs = measure_ms([&] { shape_compute_baked_lighting_serial(serial); });
+    const double parallelMs = measure_ms(
+        [&] { shape_compute_baked_lighting_parallel(parallel, pool); });
+    const bool same = same_lighting(serial, parallel);
+
+    std::cout << std::left << std::setw(24) << name << std::right << std::setw(10)
+              << shape_get_nb_chunks(serial) << std::fixed << std::setprecision(1)
+              << std::setw(12) << serialMs << std::setw(12) << parallelMs << std::setw(9)
+              << serialMs / parallelMs << "x" << (same ? "" : "  MISMATCH") << std::endl;
+    return same;
+}
+
+bool command_bench_lighting(cxxopts::ParseResult parseResult, std::string& err) {
+    std::vector<std::string> input_paths;
+    if (parseResult.count("input") > 0) {
+        input_paths = parseResult["input"].as<std::vector<std::string>>();
+    }
+
+    ColorAtlas *colorAtlas = color_atlas_new();
+    ThreadPool *pool = thread_pool_get_shared();
+    bool same = true;
+
+    std::cout << "* Baked lighting, " << thread_pool_get_nb_workers(pool) << " workers"
+              << std::endl;
+    std::cout << std::left << std::setw(24) << "map" << std::right << std::setw(10) << "chunks"
+              << std::setw(12) << "serial ms" << std::setw(12) << "parallel ms" << std::setw(10)
+              << "speedup" << std::endl;
+
+    for (const SHAPE_COORDS_INT_T size : mapSizes) {
+        Shape *serial = lighting_map_make(colorAtlas, size);
+        Shape *parallel = lighting_map_make(colorAtlas, size);
+        const std::string name = std::to_string(size) + "x" + std::to_string(size);
+        same = bench(name, serial, parallel, pool) && same;
+        shape_free(serial);
+        shape_free(parallel);
+    }
+
+    for (const std::string& input_path : input_paths) {
+        Shape *serial = load_map(colorAtlas, input_path);
+        Shape *parallel = load_map(colorAtlas, input_path);
+        if (serial == nullptr || parallel == nullptr) {
+            shape_free(serial);
+            shape_free(parallel);
+            err = std::string("can't load ") + input_path;
+            break;
+        }
+        same = bench(input_path, serial, parallel, pool) && same;
+        shape_free(serial);
+        shape_free(parallel);
+    }
+
+    asset_cache_flush(asset_cache_get_shared());
+    color_atlas_free(colorAtlas);
+
+    if (same == false && err.empty()) {
+        err.assign("parallel lighting differs from serial lighting");
+    }
+    return same && err.empty();
+}
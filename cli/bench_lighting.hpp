@@ -0,0 +1,18 @@
+//
+//  bench_lighting.hpp
+//  cli
+//
+
+#pragma once
+
+// C++
+#include <string>
+
+// cxxopts
+#include <cxxopts.hpp>
+
+/// Compares single-threaded & parallel baked lighting computation on generated maps of several
+/// sizes, and on input files if any. Fails if both paths don't give identical lighting.
+/// Returns true on success, false otherwise.
+/// When an error occured, the `err` argument is filled with an error message.
+bool command_bench_lighting(cxxopts::ParseResult parseResult, std::string& err);
@@ -0,0 +1,135 @@
+//
+//  bench_physics.cpp
+//  cli
+//
+
+#include "bench_physics.hpp"
+#include "bench_utils.hpp"
+
+// C++
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+// Cubzh Core
+#include "color_atlas.h"
+#include "config.h"
+#include "scene.h"
+#include "thread_pool.h"
+
+// number of dynamic rigidbodies walking over the terrain
+static const size_t bodyCounts[] = {1000, 4000};
+static const SHAPE_COORDS_INT_T mapSize = 256;
+static const size_t nbFrames = 120;
+static const double frameDt = 1.0 / 60.0;
+static const float gravity = -30.0f;
+static const float walkSpeed = 6.0f;
+
+/// Same scene & moves for each run, bodies are gathered in crowds where they push each other
+/// @returns physics steps duration
+static double bench(ColorAtlas *atlas, size_t nbBodies, ThreadPool *pool, double serialMs) {
+    Scene *sc = scene_new(nullptr);
+    scene_set_dynamic_broadphase(sc, BroadphaseType_SweepAndPrune);
+    scene_set_physics_thread_pool(sc, pool);
+    scene_set_constant_acceleration(sc, nullptr, &gravity, nullptr);
+
+    Shape *terrain = generate_terrain(atlas, mapSize);
+    RigidBody *rb;
+    shape_ensure_rigidbody(terrain, PHYSICS_GROUP_DEFAULT_MAP, PHYSICS_GROUP_NONE, &rb);
+    rigidbody_set_simulation_mode(rb, RigidbodyMode_StaticPerBlock);
+    shape_fit_collider_to_bounding_box(terrain);
+    transform_set_parent(shape_get_root_transform(terrain), scene_get_root(sc), false);
+
+    uint32_t seed = 42;
+    std::vector<Transform *> bodies(nbBodies);
+    const Box collider = {{-0.4f, 0.0f, -0.4f}, {0.4f, 1.8f, 0.4f}};
+    for (size_t i = 0; i < nbBodies; ++i) {
+        Transform *t = transform_make(PointTransform);
+        transform_ensure_rigidbody(t,
+                                   RigidbodyMode_Dynamic,
+                                   PHYSICS_GROUP_DEFAULT_PLAYER,
+                                   PHYSICS_GROUP_DEFAULT_MAP | PHYSICS_GROUP_DEFAULT_PLAYER,
+                                   &rb);
+        rigidbody_set_collider(rb, &collider, true);
+
+        // crowds of 16 bodies
+        uint32_t crowdSeed = static_cast<uint32_t>(i / 16) * 7919u + 1u;
+        const float x = 8.0f + next_random(crowdSeed) * (mapSize - 20) + next_random(seed) * 4.0f;
+        const float z = 8.0f + next_random(crowdSeed) * (mapSize - 20) + next_random(seed) * 4.0f;
+        transform_set_position(t, x, 14.0f + next_random(seed) * 6.0f, z);
+        transform_set_parent(t, scene_get_root(sc), false);
+        bodies[i] = t;
+    }
+
+    double ms = 0.0;
+    for (size_t f = 0; f < nbFrames; ++f) {
+        // bodies pick a new direction now & then
+        for (Transform *t : bodies) {
+            if (next_random(seed) < 0.02f) {
+                const float angle = next_random(seed) * 2.0f * PI_F;
+                const float3 motion = {std::cos(angle) * walkSpeed,
+                                       0.0f,
+                                       std::sin(angle) * walkSpeed};
+                rigidbody_set_motion(transform_get_rigidbody(t), &motion);
+            }
+        }
+        ms += measure_ms([&] { scene_refresh(sc, frameDt, nullptr); });
+        scene_end_of_frame_refresh(sc, nullptr);
+    }
+
+    // islands give the same results w/ any number of threads
+    double checksum = 0.0;
+    for (Transform *t : bodies) {
+        const float3 *pos = transform_get_position(t);
+        checksum += static_cast<double>(pos->x + pos->y * 3.0f + pos->z * 7.0f);
+    }
+
+    const double frames = static_cast<double>(nbFrames);
+    std::cout << std::setw(8) << nbBodies << std::setw(10);
+    if (pool != nullptr) {
+        std::cout << thread_pool_get_nb_workers(pool) + 1;
+    } else {
+        std::cout << "serial";
+    }
+    std::cout << std::fixed << std::setprecision(3) << std::setw(12) << ms / frames
+              << std::setw(10) << (serialMs > 0.0 ? serialMs / ms : 1.0) << std::setw(16)
+              << checksum << std::endl;
+
+    for (Transform *t : bodies) {
+        transform_release(t);
+    }
+    scene_free(sc);
+    shape_release(terrain);
+    return ms;
+}
+
+bool command_bench_physics(cxxopts::ParseResult parseResult, std::string& err) {
+    ColorAtlas *atlas = color_atlas_new();
+    // w/ at least 4 threads to see the overhead on machines w/ fewer cores
+    const uint32_t maxThreads = std::max(thread_pool_get_nb_cores(), 4u);
+
+    std::cout << "* Dynamic rigidbodies walking over a " << mapSize << "x" << mapSize
+              << " terrain, " << nbFrames << " frames, solved one by one then in islands"
+              << std::endl;
+    std::cout << std::setw(8) << "bodies" << std::setw(10) << "threads" << std::setw(12)
+              << "ms/frame" << std::setw(10) << "speedup" << std::setw(16) << "checksum"
+              << std::endl;
+
+    for (const size_t nbBodies : bodyCounts) {
+        const double serialMs = bench(atlas, nbBodies, nullptr, 0.0);
+        for (uint32_t threads = 2; threads <= maxThreads; threads *= 2) {
+            ThreadPool *pool = thread_pool_new(threads - 1);
+            bench(atlas, nbBodies, pool, serialMs);
+            thread_pool_free(pool);
+            if (threads < maxThreads && threads * 2 > maxThreads) {
+                threads = maxThreads / 2; // last run w/ all cores
+            }
+        }
+    }
+
+    color_atlas_free(atlas);
+    return true;
+}
@@ -0,0 +1,18 @@
+//
+//  bench_physics.hpp
+//  cli
+//
+
+#pragma once
+
+// C++
+#include <string>
+
+// cxxopts
+#include <cxxopts.hpp>
+
+/// Measures physics steps of N dynamic rigidbodies walking & pushing each other over a generated
+/// terrain, solved one by one, then in islands w/ an increasing number of threads.
+/// Returns true on success, false otherwise.
+/// When an error occured, the `err` argument is filled with an error message.
+bool command_bench_physics(cxxopts::ParseResult parseResult, std::string& err);
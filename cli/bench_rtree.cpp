@@ -0,0 +1,218 @@
+//
+//  bench_rtree.cpp
+//  cli
+//
+
+#include "bench_rtree.hpp"
+#include "bench_utils.hpp"
+
+// C++
+#include <cmath>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+// Cubzh Core
+#include "box_lanes.h"
+#include "config.h"
+#include "ray.h"
+#include "rtree.h"
+
+// number of leaves in generated scenes
+static const size_t leafCounts[] = {10000, 50000, 100000};
+// queries of each type per scene
+static const size_t nbQueries = 10000;
+// children boxes sets, & tests of each kind per set, for kernel benchmarks
+static const size_t nbKernelSets = 4096;
+static const size_t nbKernelTests = 256;
+
+/// Box of given size range, within a flat scene whose area grows w/ the number of leaves
+static Box random_box(uint32_t& seed, float sceneSize, float minSize, float maxSize) {
+    const float x = next_random(seed) * sceneSize;
+    const float y = next_random(seed) * 64.0f;
+    const float z = next_random(seed) * sceneSize;
+    const float sx = minSize + next_random(seed) * (maxSize - minSize);
+    const float sy = minSize + next_random(seed) * (maxSize - minSize);
+    const float sz = minSize + next_random(seed) * (maxSize - minSize);
+    return {{x, y, z}, {x + sx, y + sy, z + sz}};
+}
+
+/// Overlap & cast queries, the same ones for a given seed
+static void bench_queries(Rtree *r,
+                          const char *build,
+                          size_t nbLeaves,
+                          float sceneSize,
+                          double buildMs,
+                          uint32_t seed) {
+    // overlap queries
+    size_t overlapHits = 0;
+    FifoList *overlapResults = fifo_list_new();
+    const double overlapMs = measure_ms([&] {
+        for (size_t i = 0; i < nbQueries; ++i) {
+            const Box query = random_box(seed, sceneSize, 2.0f, 12.0f);
+            overlapHits += rtree_query_overlap_box(r,
+                                                   &query,
+                                                   PHYSICS_GROUP_ALL_SYSTEM,
+                                                   PHYSICS_GROUP_ALL_SYSTEM,
+                                                   nullptr,
+                                                   overlapResults,
+                                                   EPSILON_COLLISION);
+            while (fifo_list_pop(overlapResults) != nullptr) {}
+        }
+    });
+    fifo_list_free(overlapResults, nullptr);
+
+    // rays cast horizontally across the scene
+    size_t castHits = 0;
+    DoublyLinkedList *castResults = doubly_linked_list_new();
+    const double castMs = measure_ms([&] {
+        for (size_t i = 0; i < nbQueries; ++i) {
+            const float3 origin = {next_random(seed) * sceneSize,
+                                   next_random(seed) * 64.0f,
+                                   next_random(seed) * sceneSize};
+            const float angle = next_random(seed) * 6.2831853f;
+            const float3 dir = {std::cos(angle), 0.0f, std::sin(angle)};
+            Ray *ray = ray_new(&origin, &dir);
+            castHits += rtree_query_cast_all_ray(r,
+                                                 ray,
+                                                 PHYSICS_GROUP_ALL_SYSTEM,
+                                                 PHYSICS_GROUP_ALL_SYSTEM,
+                                                 nullptr,
+                                                 castResults);
+            doubly_linked_list_flush(castResults, free);
+            ray_free(ray);
+        }
+    });
+    doubly_linked_list_free(castResults);
+
+    std::cout << std::setw(8) << nbLeaves << std::setw(8) << build << std::setw(8)
+              << rtree_get_height(r) << std::fixed << std::setprecision(1) << std::setw(12)
+              << buildMs << std::setw(14) << overlapMs << std::setw(12) << overlapHits
+              << std::setw(12) << castMs << std::setw(12) << castHits << std::endl;
+}
+
+/// Same leaves & queries w/ successive inserts, then w/ bulk loading
+static void bench(size_t nbLeaves) {
+    const float sceneSize = 4.0f * std::sqrt(static_cast<float>(nbLeaves));
+    uint32_t seed = 42;
+
+    std::vector<Box> leaves(nbLeaves);
+    for (Box& b : leaves) {
+        b = random_box(seed, sceneSize, 0.5f, 4.0f);
+    }
+
+    Rtree *r = rtree_new(RTREE_NODE_MIN_CAPACITY, RTREE_NODE_MAX_CAPACITY);
+    const double insertMs = measure_ms([&] {
+        for (size_t i = 0; i < nbLeaves; ++i) {
+            rtree_create_and_insert(r,
+                                    &leaves[i],
+                                    PHYSICS_GROUP_DEFAULT_OBJECT,
+                                    PHYSICS_GROUP_ALL_SYSTEM,
+                                    reinterpret_cast<void *>(i + 1));
+        }
+    });
+    bench_queries(r, "insert", nbLeaves, sceneSize, insertMs, seed);
+    rtree_free(r);
+
+    r = rtree_new(RTREE_NODE_MIN_CAPACITY, RTREE_NODE_MAX_CAPACITY);
+    std::vector<RtreeNode *> bulk(nbLeaves);
+    const double bulkMs = measure_ms([&] {
+        for (size_t i = 0; i < nbLeaves; ++i) {
+            bulk[i] = rtree_create_leaf(r,
+                                        &leaves[i],
+                                        PHYSICS_GROUP_DEFAULT_OBJECT,
+                                        PHYSICS_GROUP_ALL_SYSTEM,
+                                        reinterpret_cast<void *>(i + 1));
+        }
+        rtree_bulk_load(r, bulk.data(), nbLeaves);
+    });
+    bench_queries(r, "STR", nbLeaves, sceneSize, bulkMs, seed);
+    rtree_free(r);
+}
+
+/// Box & ray tests against nodes of 4 children boxes, w/ the SIMD & scalar kernels
+static void bench_kernels() {
+    const uint8_t count = RTREE_NODE_MAX_CAPACITY;
+    uint32_t seed = 7;
+
+    std::vector<BoxLanes> sets(nbKernelSets);
+    for (BoxLanes& bl : sets) {
+        box_lanes_reset(&bl);
+        for (uint8_t i = 0; i < count; ++i) {
+            const Box b = random_box(seed, 64.0f, 1.0f, 16.0f);
+            box_lanes_set(&bl, i, &b);
+        }
+    }
+    std::vector<Box> boxes(nbKernelTests);
+    std::vector<Ray *> rays(nbKernelTests);
+    for (size_t i = 0; i < nbKernelTests; ++i) {
+        boxes[i] = random_box(seed, 64.0f, 1.0f, 16.0f);
+        const float3 origin = {next_random(seed) * 64.0f,
+                               next_random(seed) * 64.0f,
+                               next_random(seed) * 64.0f};
+        const float3 dir = {next_random(seed) - 0.5f,
+                            next_random(seed) - 0.5f,
+                            next_random(seed) - 0.5f};
+        rays[i] = ray_new(&origin, &dir);
+    }
+
+    // hits are accumulated so that tests can't be optimized out
+    size_t hits[4] = {0, 0, 0, 0};
+    float distances[BOX_LANES_COUNT];
+    const double boxMs = measure_ms([&] {
+        for (const BoxLanes& bl : sets) {
+            for (const Box& b : boxes) {
+                hits[0] += box_lanes_collide_epsilon(&bl, count, &b, EPSILON_COLLISION);
+            }
+        }
+    });
+    const double boxScalarMs = measure_ms([&] {
+        for (const BoxLanes& bl : sets) {
+            for (const Box& b : boxes) {
+                hits[1] += box_lanes_collide_epsilon_scalar(&bl, count, &b, EPSILON_COLLISION);
+            }
+        }
+    });
+    const double rayMs = measure_ms([&] {
+        for (const BoxLanes& bl : sets) {
+            for (const Ray *ray : rays) {
+                hits[2] += box_lanes_intersect_ray(&bl, count, ray, distances);
+            }
+        }
+    });
+    const double rayScalarMs = measure_ms([&] {
+        for (const BoxLanes& bl : sets) {
+            for (const Ray *ray : rays) {
+                hits[3] += box_lanes_intersect_ray_scalar(&bl, count, ray, distances);
+            }
+        }
+    });
+
+    for (Ray *ray : rays) {
+        ray_free(ray);
+    }
+
+    const double nsPerTest = 1e6 / static_cast<double>(nbKernelSets * nbKernelTests);
+    std::cout << "* Children boxes tests, " << static_cast<int>(count) << " boxes at once, "
+              << (BOX_LANES_SIMD ? "SIMD" : "scalar fallback") << " vs. scalar (ns per test)"
+              << std::endl;
+    std::cout << std::fixed << std::setprecision(2) << "  box: " << boxMs * nsPerTest << " vs. "
+              << boxScalarMs * nsPerTest << (hits[0] == hits[1] ? "" : " MISMATCH") << std::endl;
+    std::cout << "  ray: " << rayMs * nsPerTest << " vs. " << rayScalarMs * nsPerTest
+              << (hits[2] == hits[3] ? "" : " MISMATCH") << std::endl;
+}
+
+bool command_bench_rtree(cxxopts::ParseResult parseResult, std::string& err) {
+    bench_kernels();
+
+    std::cout << "* R-tree, " << nbQueries << " queries of each type" << std::endl;
+    std::cout << std::setw(8) << "leaves" << std::setw(8) << "build" << std::setw(8) << "height"
+              << std::setw(12) << "build ms" << std::setw(14) << "overlap ms" << std::setw(12)
+              << "hits" << std::setw(12) << "cast ms" << std::setw(12) << "hits" << std::endl;
+
+    for (const size_t nbLeaves : leafCounts) {
+        bench(nbLeaves);
+    }
+    return true;
+}
@@ -0,0 +1,18 @@
+//
+//  bench_rtree.hpp
+//  cli
+//
+
+#pragma once
+
+// C++
+#include <string>
+
+// cxxopts
+#include <cxxopts.hpp>
+
+/// Measures children boxes test kernels, then r-tree build, overlap & cast queries on generated
+/// scenes of 10k+ leaves, w/ successive inserts & w/ bulk loading.
+/// Returns true on success, false otherwise.
+/// When an error occured, the `err` argument is filled with an error message.
+bool command_bench_rtree(cxxopts::ParseResult parseResult, std::string& err);
@@ -0,0 +1,113 @@
+//
+//  bench_scene.cpp
+//  cli
+//
+
+#include "bench_scene.hpp"
+#include "bench_utils.hpp"
+
+// C++
+#include <cmath>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <vector>
+
+// Cubzh Core
+#include "config.h"
+#include "scene.h"
+
+// decorations are gathered in groups, like objects of a world
+static const size_t nbGroups = 200;
+static const size_t groupSize = 100;
+// per thousand of decorations moved every frame
+static const size_t activeRates[] = {0, 10, 100};
+static const size_t nbFrames = 120;
+static const double frameDt = 1.0 / 60.0;
+
+/// Same hierarchy for each run, active decorations are spread over all groups
+static void bench(size_t activeRate) {
+    Scene *sc = scene_new(nullptr);
+
+    std::vector<Transform *> groups(nbGroups);
+    std::vector<Transform *> decorations(nbGroups * groupSize);
+    std::vector<Transform *> active;
+    const Box collider = {{0.0f, 0.0f, 0.0f}, {1.0f, 2.0f, 1.0f}};
+    RigidBody *rb;
+    for (size_t g = 0; g < nbGroups; ++g) {
+        Transform *group = transform_make(PointTransform);
+        transform_set_position(group,
+                               static_cast<float>(g % 20) * 40.0f,
+                               0.0f,
+                               static_cast<float>(g / 20) * 40.0f);
+        transform_set_parent(group, scene_get_root(sc), false);
+        groups[g] = group;
+
+        for (size_t i = 0; i < groupSize; ++i) {
+            Transform *t = transform_make(PointTransform);
+            transform_ensure_rigidbody(t,
+                                       RigidbodyMode_Static,
+                                       PHYSICS_GROUP_DEFAULT_OBJECT,
+                                       PHYSICS_GROUP_NONE,
+                                       &rb);
+            rigidbody_set_collider(rb, &collider, true);
+            transform_set_local_position(t,
+                                         static_cast<float>(i % 10) * 4.0f,
+                                         0.0f,
+                                         static_cast<float>(i / 10) * 4.0f);
+            transform_set_parent(t, group, false);
+
+            const size_t idx = g * groupSize + i;
+            decorations[idx] = t;
+            if ((idx * 7919) % 1000 < activeRate) {
+                active.push_back(t);
+            }
+        }
+    }
+
+    // first frame partitions the scene
+    scene_refresh(sc, frameDt, nullptr);
+    scene_end_of_frame_refresh(sc, nullptr);
+
+    double refreshMs = 0.0, endOfFrameMs = 0.0;
+    for (size_t f = 0; f < nbFrames; ++f) {
+        // active decorations bob up & down
+        const float y = std::sin(static_cast<float>(f) * 0.2f);
+        for (Transform *t : active) {
+            const float3 *pos = transform_get_local_position(t);
+            transform_set_local_position(t, pos->x, y, pos->z);
+        }
+        refreshMs += measure_ms([&] { scene_refresh(sc, frameDt, nullptr); });
+        endOfFrameMs += measure_ms([&] { scene_end_of_frame_refresh(sc, nullptr); });
+    }
+
+    const double frames = static_cast<double>(nbFrames);
+    std::cout << std::setw(8) << active.size() << std::fixed << std::setprecision(3)
+              << std::setw(12) << refreshMs / frames << std::setw(14) << endOfFrameMs / frames
+              << std::setw(12)
+              << (active.empty() ? 0.0
+                                 : (refreshMs + endOfFrameMs) * 1000.0 /
+                                       (frames * static_cast<double>(active.size())))
+              << std::endl;
+
+    for (Transform *t : decorations) {
+        transform_release(t);
+    }
+    for (Transform *t : groups) {
+        transform_release(t);
+    }
+    scene_free(sc);
+}
+
+bool command_bench_scene(cxxopts::ParseResult parseResult, std::string& err) {
+    std::cout << "* " << nbGroups * groupSize << " static decorations in " << nbGroups
+              << " groups, " << nbFrames << " frames, moving a share of them every frame"
+              << std::endl;
+    std::cout << std::setw(8) << "active" << std::setw(12) << "refresh ms" << std::setw(14)
+              << "end-of-frame" << std::setw(12) << "us/active" << std::endl;
+
+    for (const size_t activeRate : activeRates) {
+        bench(activeRate);
+    }
+    return true;
+}
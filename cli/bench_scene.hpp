@@ -0,0 +1,18 @@
+//
+//  bench_scene.hpp
+//  cli
+//
+
+#pragma once
+
+// C++
+#include <string>
+
+// cxxopts
+#include <cxxopts.hpp>
+
+/// Measures scene refresh passes over a large hierarchy of static colliders, of which an
+/// increasing share is moved every frame, the rest being left untouched.
+/// Returns true on success, false otherwise.
+/// When an error occured, the `err` argument is filled with an error message.
+bool command_bench_scene(cxxopts::ParseResult parseResult, std::string& err);
@@ -0,0 +1,60 @@
+//
+//  bench_utils.hpp
+//  cli
+//
+
+#pragma once
+
+// C++
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+
+// Cubzh Core
+#include "color_atlas.h"
+#include "color_palette.h"
+#include "shape.h"
+
+// Helpers shared by bench commands
+
+/// Deterministic pseudo-random float in [0, 1[
+inline float next_random(uint32_t& seed) {
+    seed = seed * 1103515245 + 12345;
+    return static_cast<float>((seed >> 8) & 0xffff) / 65536.0f;
+}
+
+/// Wall-clock duration of `f`, in milliseconds
+template <typename F>
+inline double measure_ms(F f) {
+    const auto start = std::chrono::steady_clock::now();
+    f();
+    const auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+/// Hills w/ walls, border walls & pillars, same content for a given size (side, in blocks)
+inline Shape *generate_terrain(ColorAtlas *atlas, const SHAPE_COORDS_INT_T size) {
+    Shape *s = shape_make();
+    ColorPalette *p = color_palette_new(atlas);
+    shape_set_palette(s, p, false);
+
+    SHAPE_COLOR_INDEX_INT_T ground;
+    color_palette_check_and_add_color(p, {90, 140, 60, 255}, &ground, false);
+
+    for (SHAPE_COORDS_INT_T x = 0; x < size; ++x) {
+        for (SHAPE_COORDS_INT_T z = 0; z < size; ++z) {
+            int h = 4 + static_cast<int>(3.0f * std::sin(x * 0.1f) + 3.0f * std::cos(z * 0.13f));
+            if (x % 40 == 0 || x == size - 1 || z % 50 == 0 || z == size - 1) {
+                h += 6; // walls
+            }
+            if ((x * 31 + z * 17) % 113 == 0) {
+                h += 8; // pillars
+            }
+            for (int y = 0; y < h; ++y) {
+                shape_add_block(s, ground, x, static_cast<SHAPE_COORDS_INT_T>(y), z, false);
+            }
+        }
+    }
+    shape_set_pivot(s, 0.0f, 0.0f, 0.0f);
+    return s;
+}
@@ -36,14 +36,14 @@ bool count_blocks(cxxopts::ParseResult parseResult, std::string& err) {
 
     const std::string input_path = parseResult["input"].as<std::vector<std::string>>()[0];
     
-    FILE * const fd = fopen(input_path.c_str(), "rb");
-    if (fd == nullptr) {
+    // file is mapped in memory, Stream releases the mapping when freed
+    Stream * const stream = stream_new_mmap_read(input_path.c_str());
+    if (stream == nullptr) {
         err.assign("can't open input file: " + input_path);
         return false;
     }
 
     ColorAtlas * const colorAtlas = color_atlas_new();
-    Stream * const stream = stream_new_file_read(fd); // Stream is responsible for fclose-ing the file descriptor
 
     const LoadShapeSettings shapeSettings = {
         .lighting = false,
@@ -58,7 +58,6 @@ bool count_blocks(cxxopts::ParseResult parseResult, std::string& err) {
                                                          &shapeSettings,
                                                          allowLegacy);
     // `stream` is freed here (done by `serialization_load_assets`)
-    // `stream` took care of fclose-ing `fd`
     if (assets == NULL) {
         color_atlas_free(colorAtlas);
         err.assign("can't load assets");
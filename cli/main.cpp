@@ -12,6 +12,13 @@
 #include <cxxopts.hpp>
 
 // cli
+#include "bake.hpp"
+#include "bench_boxcast.hpp"
+#include "bench_broadphase.hpp"
+#include "bench_lighting.hpp"
+#include "bench_physics.hpp"
+#include "bench_rtree.hpp"
+#include "bench_scene.hpp"
 #include "blocks.hpp"
 #include "combine.hpp"
 #include "shape_point.hpp"
@@ -47,6 +54,20 @@ int main(int argc, const char * argv[]) {
         success = command_combine(result, err);
     } else if (command == "setpoint") {
         success = commandSetPoint(result, err);
+    } else if (command == "benchlighting") {
+        success = command_bench_lighting(result, err);
+    } else if (command == "benchboxcast") {
+        success = command_bench_boxcast(result, err);
+    } else if (command == "benchbroadphase") {
+        success = command_bench_broadphase(result, err);
+    } else if (command == "benchphysics") {
+        success = command_bench_physics(result, err);
+    } else if (command == "benchrtree") {
+        success = command_bench_rtree(result, err);
+    } else if (command == "benchscene") {
+        success = command_bench_scene(result, err);
+    } else if (command == "bake") {
+        success = command_bake(result, err);
     } else {
         err = "command not supported.";
     }
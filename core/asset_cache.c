@@ -0,0 +1,330 @@
+// -------------------------------------------------------------
+//  Cubzh Core
+//  asset_cache.c
+// -------------------------------------------------------------
+
+#include "asset_cache.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "cclog.h"
+#include "doubly_linked_list.h"
+#include "mutex.h"
+#include "serialization.h"
+#include "transform.h"
+#include "weakptr.h"
+#include "zlib.h"
+
+typedef struct {
+    Shape *templateShape;
+    Weakptr *atlas; // retained by entries, NULL if loaded w/o atlas
+    size_t memory;
+    uint32_t size;
+    uint32_t crc;
+    uint32_t adler;
+    LoadShapeSettings settings;
+    char pad[2];
+} _AssetCacheEntry;
+
+struct _AssetCache {
+    DoublyLinkedList *entries; // _AssetCacheEntry, most recently used first
+    Mutex *mutex;
+    AssetCacheStats stats;
+    size_t memoryBudget;
+};
+
+// MARK: - Private functions -
+
+static void _asset_cache_entry_free(void *ptr) {
+    _AssetCacheEntry *e = (_AssetCacheEntry *)ptr;
+    shape_release(e->templateShape);
+    if (e->atlas != NULL) {
+        weakptr_release(e->atlas);
+    }
+    free(e);
+}
+
+static bool _asset_cache_entry_matches(const _AssetCacheEntry *e, const _AssetCacheEntry *key) {
+    return e->size == key->size && e->crc == key->crc && e->adler == key->adler &&
+           e->atlas == key->atlas && e->settings.lighting == key->settings.lighting &&
+           e->settings.isMutable == key->settings.isMutable;
+}
+
+// lock must be held, also drops templates of freed atlases
+static DoublyLinkedListNode *_asset_cache_find(AssetCache *c, const _AssetCacheEntry *key) {
+    DoublyLinkedListNode *n = doubly_linked_list_first(c->entries);
+    while (n != NULL) {
+        _AssetCacheEntry *e = (_AssetCacheEntry *)doubly_linked_list_node_pointer(n);
+        DoublyLinkedListNode *next = doubly_linked_list_node_next(n);
+        if (e->atlas != NULL && weakptr_get(e->atlas) == NULL) {
+            doubly_linked_list_delete_node(c->entries, n);
+            c->stats.memory -= e->memory;
+            c->stats.nbEntries--;
+            c->stats.evictions++;
+            _asset_cache_entry_free(e);
+        } else if (_asset_cache_entry_matches(e, key)) {
+            return n;
+        }
+        n = next;
+    }
+    return NULL;
+}
+
+// lock must be held
+static void _asset_cache_evict(AssetCache *c) {
+    while (c->stats.memory > c->memoryBudget) {
+        _AssetCacheEntry *e = (_AssetCacheEntry *)doubly_linked_list_pop_last(c->entries);
+        if (e == NULL) {
+            break;
+        }
+        c->stats.memory -= e->memory;
+        c->stats.nbEntries--;
+        c->stats.evictions++;
+        _asset_cache_entry_free(e);
+    }
+}
+
+/// Blocks & baked lighting, for the shape & its descendants
+static size_t _asset_cache_estimate_memory(const Shape *s) {
+    size_t chunkSize = CHUNK_SIZE_CUBE * sizeof(Block);
+    if (shape_uses_baked_lighting(s)) {
+        chunkSize += CHUNK_SIZE_CUBE * sizeof(VERTEX_LIGHT_STRUCT_T);
+    }
+    size_t memory = sizeof(Shape *) + shape_get_nb_chunks(s) * chunkSize;
+
+    DoublyLinkedListNode *n = shape_get_transform_children_iterator(s);
+    while (n != NULL) {
+        Shape *child = transform_utils_get_shape((Transform *)doubly_linked_list_node_pointer(n));
+        if (child != NULL) {
+            memory += _asset_cache_estimate_memory(child);
+        }
+        n = doubly_linked_list_node_next(n);
+    }
+    return memory;
+}
+
+/// Copies descendants of templateShape under copy, descendants sharing the template root
+/// palette share the copy root palette
+static void _asset_cache_copy_children(Shape *templateShape,
+                                       Shape *copy,
+                                       const ColorPalette *templatePalette,
+                                       ColorPalette *copyPalette) {
+    DoublyLinkedListNode *n = shape_get_transform_children_iterator(templateShape);
+    while (n != NULL) {
+        Shape *child = transform_utils_get_shape((Transform *)doubly_linked_list_node_pointer(n));
+        if (child != NULL) {
+            Shape *childCopy = shape_make_copy(child);
+            if (shape_get_palette(child) == templatePalette) {
+                shape_set_palette(childCopy, copyPalette, true);
+            }
+            _asset_cache_copy_children(child, childCopy, templatePalette, copyPalette);
+            shape_set_parent(childCopy, shape_get_root_transform(copy), false);
+            shape_release(childCopy); // parent keeps a reference
+        }
+        n = doubly_linked_list_node_next(n);
+    }
+}
+
+/// Copies the shape & its descendants, same hierarchy & palette sharing as serialization_load_shape
+/// output
+static Shape *_asset_cache_copy(Shape *templateShape) {
+    Shape *copy = shape_make_copy(templateShape);
+    _asset_cache_copy_children(templateShape,
+                               copy,
+                               shape_get_palette(templateShape),
+                               shape_get_palette(copy));
+    return copy;
+}
+
+// lock must be held, returns false if template can't be cached
+static bool _asset_cache_insert(AssetCache *c,
+                                const _AssetCacheEntry *key,
+                                Shape *templateShape,
+                                size_t memory) {
+    // same content may have been cached by another thread meanwhile
+    if (_asset_cache_find(c, key) != NULL) {
+        return false;
+    }
+    // retaining atlas weakptr, for another atlas allocated at the same address not to match
+    if (key->atlas != NULL && weakptr_retain(key->atlas) == false) {
+        return false;
+    }
+    _AssetCacheEntry *e = (_AssetCacheEntry *)malloc(sizeof(_AssetCacheEntry));
+    if (e == NULL) {
+        if (key->atlas != NULL) {
+            weakptr_release(key->atlas);
+        }
+        return false;
+    }
+    *e = *key;
+    e->templateShape = templateShape;
+    e->memory = memory;
+    doubly_linked_list_push_first(c->entries, e);
+    c->stats.nbEntries++;
+    c->stats.memory += memory;
+    _asset_cache_evict(c);
+    return true;
+}
+
+// MARK: - Exposed functions -
+
+AssetCache *asset_cache_new(size_t memoryBudget) {
+    AssetCache *c = (AssetCache *)malloc(sizeof(AssetCache));
+    if (c == NULL) {
+        return NULL;
+    }
+    c->entries = doubly_linked_list_new();
+    c->mutex = mutex_new();
+    memset(&c->stats, 0, sizeof(AssetCacheStats));
+    c->memoryBudget = memoryBudget;
+    return c;
+}
+
+void asset_cache_free(AssetCache *c) {
+    if (c == NULL) {
+        return;
+    }
+    asset_cache_flush(c);
+    doubly_linked_list_free(c->entries);
+    mutex_free(c->mutex);
+    free(c);
+}
+
+#if defined(__VX_PLATFORM_WINDOWS)
+static INIT_ONCE _sharedCacheOnce = INIT_ONCE_STATIC_INIT;
+#else
+static pthread_once_t _sharedCacheOnce = PTHREAD_ONCE_INIT;
+#endif
+static AssetCache *_sharedCache = NULL;
+
+#if defined(__VX_PLATFORM_WINDOWS)
+static BOOL CALLBACK _asset_cache_create_shared(PINIT_ONCE once, PVOID param, PVOID *ctx) {
+    _sharedCache = asset_cache_new(ASSET_CACHE_DEFAULT_MEMORY_BUDGET);
+    return TRUE;
+}
+#else
+static void _asset_cache_create_shared(void) {
+    _sharedCache = asset_cache_new(ASSET_CACHE_DEFAULT_MEMORY_BUDGET);
+}
+#endif
+
+AssetCache *asset_cache_get_shared(void) {
+#if defined(__VX_PLATFORM_WINDOWS)
+    InitOnceExecuteOnce(&_sharedCacheOnce, _asset_cache_create_shared, NULL, NULL);
+#else
+    pthread_once(&_sharedCacheOnce, _asset_cache_create_shared);
+#endif
+    return _sharedCache;
+}
+
+void asset_cache_set_memory_budget(AssetCache *c, size_t memoryBudget) {
+    mutex_lock(c->mutex);
+    c->memoryBudget = memoryBudget;
+    _asset_cache_evict(c);
+    mutex_unlock(c->mutex);
+}
+
+Shape *asset_cache_load_shape(AssetCache *c,
+                              Stream *s,
+                              const char *fullname,
+                              ColorAtlas *colorAtlas,
+                              const LoadShapeSettings *shapeSettings,
+                              const bool allowLegacy) {
+
+    if (s == NULL) {
+        return NULL;
+    }
+
+    const size_t start = stream_get_cursor_position(s);
+    const size_t size = stream_get_size(s);
+    const void *bytes = stream_is_memory_backed(s) && size > start && size - start <= UINT32_MAX
+                            ? stream_borrow(s, size - start)
+                            : NULL;
+    if (bytes == NULL) {
+        mutex_lock(c->mutex);
+        c->stats.bypasses++;
+        mutex_unlock(c->mutex);
+        return serialization_load_shape(s,
+                                        fullname,
+                                        colorAtlas,
+                                        (LoadShapeSettings *)shapeSettings,
+                                        allowLegacy);
+    }
+    stream_set_cursor_position(s, start);
+
+    _AssetCacheEntry key;
+    key.templateShape = NULL;
+    key.atlas = colorAtlas != NULL ? color_atlas_get_weakptr(colorAtlas) : NULL;
+    key.memory = 0;
+    key.size = (uint32_t)(size - start);
+    key.crc = (uint32_t)crc32(crc32(0L, Z_NULL, 0), (const Bytef *)bytes, (uInt)key.size);
+    key.adler = (uint32_t)adler32(adler32(0L, Z_NULL, 0), (const Bytef *)bytes, (uInt)key.size);
+    key.settings = shapeSettings != NULL ? *shapeSettings
+                                         : (LoadShapeSettings){.lighting = false,
+                                                               .isMutable = false};
+
+    // hit
+    mutex_lock(c->mutex);
+    DoublyLinkedListNode *n = _asset_cache_find(c, &key);
+    if (n != NULL) {
+        _AssetCacheEntry *e = (_AssetCacheEntry *)doubly_linked_list_node_pointer(n);
+        doubly_linked_list_delete_node(c->entries, n);
+        doubly_linked_list_push_first(c->entries, e);
+        c->stats.hits++;
+        Shape *copy = _asset_cache_copy(e->templateShape);
+        mutex_unlock(c->mutex);
+        stream_free(s);
+        shape_set_fullname(copy, fullname);
+        return copy;
+    }
+    mutex_unlock(c->mutex);
+
+    // miss, decoding w/o holding the lock
+    Shape *templateShape = serialization_load_shape(s,
+                                                    fullname,
+                                                    colorAtlas,
+                                                    (LoadShapeSettings *)shapeSettings,
+                                                    allowLegacy);
+    if (templateShape == NULL) {
+        return NULL;
+    }
+
+    const size_t memory = _asset_cache_estimate_memory(templateShape);
+
+    mutex_lock(c->mutex);
+    if (memory > c->memoryBudget) {
+        c->stats.bypasses++;
+        mutex_unlock(c->mutex);
+        return templateShape;
+    }
+    c->stats.misses++;
+    mutex_unlock(c->mutex);
+
+    // template isn't shared yet, copied w/o holding the lock
+    Shape *copy = _asset_cache_copy(templateShape);
+    shape_set_fullname(copy, fullname);
+
+    mutex_lock(c->mutex);
+    const bool inserted = _asset_cache_insert(c, &key, templateShape, memory);
+    mutex_unlock(c->mutex);
+    if (inserted == false) {
+        shape_release(templateShape);
+    }
+    return copy;
+}
+
+void asset_cache_flush(AssetCache *c) {
+    mutex_lock(c->mutex);
+    doubly_linked_list_flush(c->entries, _asset_cache_entry_free);
+    c->stats.nbEntries = 0;
+    c->stats.memory = 0;
+    mutex_unlock(c->mutex);
+}
+
+AssetCacheStats asset_cache_get_stats(AssetCache *c) {
+    mutex_lock(c->mutex);
+    const AssetCacheStats stats = c->stats;
+    mutex_unlock(c->mutex);
+    return stats;
+}
@@ -0,0 +1,69 @@
+// -------------------------------------------------------------
+//  Cubzh Core
+//  asset_cache.h
+// -------------------------------------------------------------
+
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "color_atlas.h"
+#include "shape.h"
+#include "stream.h"
+
+// Cache of decoded shapes, keyed by file content hash & load settings (color atlas included).
+// The first load of an item decodes it into a template shape, kept in cache, subsequent loads
+// of the same content return copies of that template (no decompression or palette build).
+// Copies share the template's blocks until written (copy-on-write chunk octrees), and get the
+// fullname they've been loaded with: items w/ the same content share a template.
+// Least recently used templates are evicted when estimated memory exceeds the budget, templates
+// of a freed color atlas are dropped on next lookup, or when flushing the cache.
+//
+// Hashing & keeping templates only pays off when loading the same content repeatedly, the cache
+// is opt-in: serialization_load_shape doesn't use it, call sites that reload the same items do.
+
+#define ASSET_CACHE_DEFAULT_MEMORY_BUDGET 134217728 // 128MB
+
+typedef struct _AssetCache AssetCache;
+
+typedef struct {
+    uint32_t hits;      // loads served from cache
+    uint32_t misses;    // loads decoded & cached
+    uint32_t bypasses;  // loads not cached (not memory-backed Stream, or bigger than budget)
+    uint32_t evictions; // templates evicted to respect budget
+    size_t nbEntries;
+    size_t memory; // estimated memory used by templates
+} AssetCacheStats;
+
+AssetCache *asset_cache_new(size_t memoryBudget);
+void asset_cache_free(AssetCache *c);
+
+/// Process-wide cache, created on first call w/ default budget (thread safe)
+AssetCache *asset_cache_get_shared(void);
+
+/// Evicts templates if needed to fit new budget
+void asset_cache_set_memory_budget(AssetCache *c, size_t memoryBudget);
+
+/// Same as serialization_load_shape (Stream is freed), returns a shape owned by the caller.
+/// Only memory-backed streams (buffer & mmap reads) can be hashed, others bypass the cache.
+Shape *asset_cache_load_shape(AssetCache *c,
+                              Stream *s,
+                              const char *fullname,
+                              ColorAtlas *colorAtlas,
+                              const LoadShapeSettings *shapeSettings,
+                              const bool allowLegacy);
+
+/// Releases all templates
+void asset_cache_flush(AssetCache *c);
+
+AssetCacheStats asset_cache_get_stats(AssetCache *c);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
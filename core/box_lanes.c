@@ -0,0 +1,299 @@
+// -------------------------------------------------------------
+//  Cubzh Core
+//  box_lanes.c
+// -------------------------------------------------------------
+
+#include "box_lanes.h"
+
+#include <string.h>
+
+#include "utils.h"
+
+#if BOX_LANES_SIMD
+#if defined(__aarch64__) || defined(_M_ARM64)
+#include <arm_neon.h>
+#define BOX_LANES_NEON 1
+#elif defined(__AVX__)
+#include <immintrin.h>
+#define BOX_LANES_AVX 1
+#else
+#include <emmintrin.h>
+#endif
+#endif
+
+// mask of the first count boxes
+#define BOX_LANES_MASK(count) ((uint8_t)((1u << (count)) - 1u))
+
+// MARK: - Private functions -
+
+#if BOX_LANES_SIMD
+#if defined(BOX_LANES_NEON)
+
+static uint8_t _box_lanes_movemask(uint32x4_t m) {
+    static const uint32_t bits[4] = {1, 2, 4, 8};
+    return (uint8_t)vaddvq_u32(vandq_u32(m, vld1q_u32(bits)));
+}
+
+// same as min & max in ray.c, w/o FMIN/FMAX signed zeros ordering
+static float32x4_t _box_lanes_min(float32x4_t a, float32x4_t b) {
+    return vbslq_f32(vcltq_f32(a, b), a, b);
+}
+
+static float32x4_t _box_lanes_max(float32x4_t a, float32x4_t b) {
+    return vbslq_f32(vcgtq_f32(a, b), a, b);
+}
+
+static uint8_t _box_lanes_collide4(const BoxLanes *bl, uint8_t o, const Box *b, float epsilon) {
+    uint32x4_t hit = vcgtq_f32(vld1q_f32(bl->maxX + o), vdupq_n_f32(b->min.x - epsilon));
+    hit = vandq_u32(hit, vcltq_f32(vld1q_f32(bl->minX + o), vdupq_n_f32(b->max.x + epsilon)));
+    hit = vandq_u32(hit, vcgtq_f32(vld1q_f32(bl->maxY + o), vdupq_n_f32(b->min.y - epsilon)));
+    hit = vandq_u32(hit, vcltq_f32(vld1q_f32(bl->minY + o), vdupq_n_f32(b->max.y + epsilon)));
+    hit = vandq_u32(hit, vcgtq_f32(vld1q_f32(bl->maxZ + o), vdupq_n_f32(b->min.z - epsilon)));
+    hit = vandq_u32(hit, vcltq_f32(vld1q_f32(bl->minZ + o), vdupq_n_f32(b->max.z + epsilon)));
+    return _box_lanes_movemask(hit);
+}
+
+/// Distance along the ray to given bounds, 0 where bound & origin are equal (see float_isEqual)
+static float32x4_t _box_lanes_slab(const float *bounds, float origin, float invdir) {
+    const float32x4_t bound = vld1q_f32(bounds);
+    const float32x4_t o = vdupq_n_f32(origin);
+    const float32x4_t eps = vdupq_n_f32(EPSILON_ZERO);
+    const float32x4_t d = vsubq_f32(bound, o);
+    const float32x4_t diff = vabsq_f32(d);
+    const float32x4_t scale = vmulq_f32(vmaxq_f32(vabsq_f32(bound), vabsq_f32(o)), eps);
+    const uint32x4_t equal = vorrq_u32(vcltq_f32(diff, eps), vcltq_f32(diff, scale));
+    return vbslq_f32(equal, vdupq_n_f32(0.0f), vmulq_f32(d, vdupq_n_f32(invdir)));
+}
+
+static uint8_t _box_lanes_intersect_ray4(const BoxLanes *bl,
+                                         uint8_t o,
+                                         const Ray *ray,
+                                         float *distances) {
+    const float32x4_t t1 = _box_lanes_slab(bl->minX + o, ray->origin->x, ray->invdir->x);
+    const float32x4_t t2 = _box_lanes_slab(bl->maxX + o, ray->origin->x, ray->invdir->x);
+    const float32x4_t t3 = _box_lanes_slab(bl->minY + o, ray->origin->y, ray->invdir->y);
+    const float32x4_t t4 = _box_lanes_slab(bl->maxY + o, ray->origin->y, ray->invdir->y);
+    const float32x4_t t5 = _box_lanes_slab(bl->minZ + o, ray->origin->z, ray->invdir->z);
+    const float32x4_t t6 = _box_lanes_slab(bl->maxZ + o, ray->origin->z, ray->invdir->z);
+
+    const float32x4_t tmin = _box_lanes_max(_box_lanes_max(_box_lanes_min(t1, t2),
+                                                           _box_lanes_min(t3, t4)),
+                                            _box_lanes_min(t5, t6));
+    const float32x4_t tmax = _box_lanes_min(_box_lanes_min(_box_lanes_max(t1, t2),
+                                                           _box_lanes_max(t3, t4)),
+                                            _box_lanes_max(t5, t6));
+
+    vst1q_f32(distances + o, tmin);
+    const uint32x4_t miss = vorrq_u32(vcltq_f32(tmax, vdupq_n_f32(0.0f)), vcgtq_f32(tmin, tmax));
+    return (uint8_t)(~_box_lanes_movemask(miss) & 0x0f);
+}
+
+#elif defined(BOX_LANES_AVX)
+
+static uint8_t _box_lanes_collide8(const BoxLanes *bl, const Box *b, float epsilon) {
+    __m256 hit = _mm256_cmp_ps(_mm256_loadu_ps(bl->maxX),
+                               _mm256_set1_ps(b->min.x - epsilon),
+                               _CMP_GT_OQ);
+    hit = _mm256_and_ps(hit,
+                        _mm256_cmp_ps(_mm256_loadu_ps(bl->minX),
+                                      _mm256_set1_ps(b->max.x + epsilon),
+                                      _CMP_LT_OQ));
+    hit = _mm256_and_ps(hit,
+                        _mm256_cmp_ps(_mm256_loadu_ps(bl->maxY),
+                                      _mm256_set1_ps(b->min.y - epsilon),
+                                      _CMP_GT_OQ));
+    hit = _mm256_and_ps(hit,
+                        _mm256_cmp_ps(_mm256_loadu_ps(bl->minY),
+                                      _mm256_set1_ps(b->max.y + epsilon),
+                                      _CMP_LT_OQ));
+    hit = _mm256_and_ps(hit,
+                        _mm256_cmp_ps(_mm256_loadu_ps(bl->maxZ),
+                                      _mm256_set1_ps(b->min.z - epsilon),
+                                      _CMP_GT_OQ));
+    hit = _mm256_and_ps(hit,
+                        _mm256_cmp_ps(_mm256_loadu_ps(bl->minZ),
+                                      _mm256_set1_ps(b->max.z + epsilon),
+                                      _CMP_LT_OQ));
+    return (uint8_t)_mm256_movemask_ps(hit);
+}
+
+/// Distance along the ray to given bounds, 0 where bound & origin are equal (see float_isEqual)
+static __m256 _box_lanes_slab(const float *bounds, float origin, float invdir) {
+    const __m256 bound = _mm256_loadu_ps(bounds);
+    const __m256 o = _mm256_set1_ps(origin);
+    const __m256 eps = _mm256_set1_ps(EPSILON_ZERO);
+    const __m256 absMask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff));
+    const __m256 d = _mm256_sub_ps(bound, o);
+    const __m256 diff = _mm256_and_ps(d, absMask);
+    const __m256 scale = _mm256_mul_ps(
+        _mm256_max_ps(_mm256_and_ps(bound, absMask), _mm256_and_ps(o, absMask)),
+        eps);
+    const __m256 equal = _mm256_or_ps(_mm256_cmp_ps(diff, eps, _CMP_LT_OQ),
+                                      _mm256_cmp_ps(diff, scale, _CMP_LT_OQ));
+    return _mm256_andnot_ps(equal, _mm256_mul_ps(d, _mm256_set1_ps(invdir)));
+}
+
+static uint8_t _box_lanes_intersect_ray8(const BoxLanes *bl, const Ray *ray, float *distances) {
+    const __m256 t1 = _box_lanes_slab(bl->minX, ray->origin->x, ray->invdir->x);
+    const __m256 t2 = _box_lanes_slab(bl->maxX, ray->origin->x, ray->invdir->x);
+    const __m256 t3 = _box_lanes_slab(bl->minY, ray->origin->y, ray->invdir->y);
+    const __m256 t4 = _box_lanes_slab(bl->maxY, ray->origin->y, ray->invdir->y);
+    const __m256 t5 = _box_lanes_slab(bl->minZ, ray->origin->z, ray->invdir->z);
+    const __m256 t6 = _box_lanes_slab(bl->maxZ, ray->origin->z, ray->invdir->z);
+
+    // same operands order as min & max in ray.c
+    const __m256 tmin = _mm256_max_ps(_mm256_max_ps(_mm256_min_ps(t1, t2), _mm256_min_ps(t3, t4)),
+                                      _mm256_min_ps(t5, t6));
+    const __m256 tmax = _mm256_min_ps(_mm256_min_ps(_mm256_max_ps(t1, t2), _mm256_max_ps(t3, t4)),
+                                      _mm256_max_ps(t5, t6));
+
+    _mm256_storeu_ps(distances, tmin);
+    const __m256 miss = _mm256_or_ps(_mm256_cmp_ps(tmax, _mm256_setzero_ps(), _CMP_LT_OQ),
+                                     _mm256_cmp_ps(tmin, tmax, _CMP_GT_OQ));
+    return (uint8_t)~_mm256_movemask_ps(miss);
+}
+
+#else
+
+static uint8_t _box_lanes_collide4(const BoxLanes *bl, uint8_t o, const Box *b, float epsilon) {
+    __m128 hit = _mm_cmpgt_ps(_mm_loadu_ps(bl->maxX + o), _mm_set1_ps(b->min.x - epsilon));
+    hit = _mm_and_ps(hit,
+                     _mm_cmplt_ps(_mm_loadu_ps(bl->minX + o), _mm_set1_ps(b->max.x + epsilon)));
+    hit = _mm_and_ps(hit,
+                     _mm_cmpgt_ps(_mm_loadu_ps(bl->maxY + o), _mm_set1_ps(b->min.y - epsilon)));
+    hit = _mm_and_ps(hit,
+                     _mm_cmplt_ps(_mm_loadu_ps(bl->minY + o), _mm_set1_ps(b->max.y + epsilon)));
+    hit = _mm_and_ps(hit,
+                     _mm_cmpgt_ps(_mm_loadu_ps(bl->maxZ + o), _mm_set1_ps(b->min.z - epsilon)));
+    hit = _mm_and_ps(hit,
+                     _mm_cmplt_ps(_mm_loadu_ps(bl->minZ + o), _mm_set1_ps(b->max.z + epsilon)));
+    return (uint8_t)_mm_movemask_ps(hit);
+}
+
+/// Distance along the ray to given bounds, 0 where bound & origin are equal (see float_isEqual)
+static __m128 _box_lanes_slab(const float *bounds, float origin, float invdir) {
+    const __m128 bound = _mm_loadu_ps(bounds);
+    const __m128 o = _mm_set1_ps(origin);
+    const __m128 eps = _mm_set1_ps(EPSILON_ZERO);
+    const __m128 absMask = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+    const __m128 d = _mm_sub_ps(bound, o);
+    const __m128 diff = _mm_and_ps(d, absMask);
+    const __m128 scale = _mm_mul_ps(_mm_max_ps(_mm_and_ps(bound, absMask), _mm_and_ps(o, absMask)),
+                                    eps);
+    const __m128 equal = _mm_or_ps(_mm_cmplt_ps(diff, eps), _mm_cmplt_ps(diff, scale));
+    return _mm_andnot_ps(equal, _mm_mul_ps(d, _mm_set1_ps(invdir)));
+}
+
+static uint8_t _box_lanes_intersect_ray4(const BoxLanes *bl,
+                                         uint8_t o,
+                                         const Ray *ray,
+                                         float *distances) {
+    const __m128 t1 = _box_lanes_slab(bl->minX + o, ray->origin->x, ray->invdir->x);
+    const __m128 t2 = _box_lanes_slab(bl->maxX + o, ray->origin->x, ray->invdir->x);
+    const __m128 t3 = _box_lanes_slab(bl->minY + o, ray->origin->y, ray->invdir->y);
+    const __m128 t4 = _box_lanes_slab(bl->maxY + o, ray->origin->y, ray->invdir->y);
+    const __m128 t5 = _box_lanes_slab(bl->minZ + o, ray->origin->z, ray->invdir->z);
+    const __m128 t6 = _box_lanes_slab(bl->maxZ + o, ray->origin->z, ray->invdir->z);
+
+    // same operands order as min & max in ray.c
+    const __m128 tmin = _mm_max_ps(_mm_max_ps(_mm_min_ps(t1, t2), _mm_min_ps(t3, t4)),
+                                   _mm_min_ps(t5, t6));
+    const __m128 tmax = _mm_min_ps(_mm_min_ps(_mm_max_ps(t1, t2), _mm_max_ps(t3, t4)),
+                                   _mm_max_ps(t5, t6));
+
+    _mm_storeu_ps(distances + o, tmin);
+    const __m128 miss = _mm_or_ps(_mm_cmplt_ps(tmax, _mm_setzero_ps()), _mm_cmpgt_ps(tmin, tmax));
+    return (uint8_t)(~_mm_movemask_ps(miss) & 0x0f);
+}
+
+#endif
+#endif
+
+// MARK: - Exposed functions -
+
+void box_lanes_reset(BoxLanes *bl) {
+    memset(bl, 0, sizeof(BoxLanes));
+}
+
+void box_lanes_set(BoxLanes *bl, uint8_t i, const Box *b) {
+    bl->minX[i] = b->min.x;
+    bl->minY[i] = b->min.y;
+    bl->minZ[i] = b->min.z;
+    bl->maxX[i] = b->max.x;
+    bl->maxY[i] = b->max.y;
+    bl->maxZ[i] = b->max.z;
+}
+
+void box_lanes_get(const BoxLanes *bl, uint8_t i, Box *b) {
+    b->min.x = bl->minX[i];
+    b->min.y = bl->minY[i];
+    b->min.z = bl->minZ[i];
+    b->max.x = bl->maxX[i];
+    b->max.y = bl->maxY[i];
+    b->max.z = bl->maxZ[i];
+}
+
+uint8_t box_lanes_collide_epsilon(const BoxLanes *bl, uint8_t count, const Box *b, float epsilon) {
+#if BOX_LANES_SIMD
+#if defined(BOX_LANES_AVX)
+    const uint8_t mask = _box_lanes_collide8(bl, b, epsilon);
+#else
+    uint8_t mask = _box_lanes_collide4(bl, 0, b, epsilon);
+    if (count > 4) {
+        mask |= (uint8_t)(_box_lanes_collide4(bl, 4, b, epsilon) << 4);
+    }
+#endif
+    return mask & BOX_LANES_MASK(count);
+#else
+    return box_lanes_collide_epsilon_scalar(bl, count, b, epsilon);
+#endif
+}
+
+uint8_t box_lanes_intersect_ray(const BoxLanes *bl,
+                                uint8_t count,
+                                const Ray *ray,
+                                float *distances) {
+#if BOX_LANES_SIMD
+#if defined(BOX_LANES_AVX)
+    const uint8_t mask = _box_lanes_intersect_ray8(bl, ray, distances);
+#else
+    uint8_t mask = _box_lanes_intersect_ray4(bl, 0, ray, distances);
+    if (count > 4) {
+        mask |= (uint8_t)(_box_lanes_intersect_ray4(bl, 4, ray, distances) << 4);
+    }
+#endif
+    return mask & BOX_LANES_MASK(count);
+#else
+    return box_lanes_intersect_ray_scalar(bl, count, ray, distances);
+#endif
+}
+
+uint8_t box_lanes_collide_epsilon_scalar(const BoxLanes *bl,
+                                         uint8_t count,
+                                         const Box *b,
+                                         float epsilon) {
+    Box lane;
+    uint8_t mask = 0;
+    for (uint8_t i = 0; i < count; ++i) {
+        box_lanes_get(bl, i, &lane);
+        if (box_collide_epsilon(&lane, b, epsilon)) {
+            mask |= (uint8_t)(1u << i);
+        }
+    }
+    return mask;
+}
+
+uint8_t box_lanes_intersect_ray_scalar(const BoxLanes *bl,
+                                       uint8_t count,
+                                       const Ray *ray,
+                                       float *distances) {
+    Box lane;
+    uint8_t mask = 0;
+    for (uint8_t i = 0; i < count; ++i) {
+        box_lanes_get(bl, i, &lane);
+        if (ray_intersect_with_box(ray, &lane.min, &lane.max, &distances[i])) {
+            mask |= (uint8_t)(1u << i);
+        }
+    }
+    return mask;
+}
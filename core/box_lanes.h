@@ -0,0 +1,70 @@
+// -------------------------------------------------------------
+//  Cubzh Core
+//  box_lanes.h
+// -------------------------------------------------------------
+
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+#include "box.h"
+#include "ray.h"
+
+// Up to BOX_LANES_COUNT boxes stored one array per coordinate, so that a box or a ray can be
+// tested against all of them at once. Tests return a mask of hit boxes, bit i for box i.
+// Uses SSE2 or NEON 4 lanes at a time (AVX 8 lanes at a time if enabled), a scalar fallback on
+// other targets or if BOX_LANES_SCALAR is defined. Both give the same results.
+
+#define BOX_LANES_COUNT 8
+
+#if defined(BOX_LANES_SCALAR)
+#define BOX_LANES_SIMD 0
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define BOX_LANES_SIMD 1
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#define BOX_LANES_SIMD 1
+#else
+#define BOX_LANES_SIMD 0
+#endif
+
+typedef struct {
+    float minX[BOX_LANES_COUNT];
+    float minY[BOX_LANES_COUNT];
+    float minZ[BOX_LANES_COUNT];
+    float maxX[BOX_LANES_COUNT];
+    float maxY[BOX_LANES_COUNT];
+    float maxZ[BOX_LANES_COUNT];
+} BoxLanes;
+
+/// Sets all boxes to zero
+void box_lanes_reset(BoxLanes *bl);
+void box_lanes_set(BoxLanes *bl, uint8_t i, const Box *b);
+void box_lanes_get(const BoxLanes *bl, uint8_t i, Box *b);
+
+/// Same test as box_collide_epsilon(box i, b, epsilon), for the first count boxes
+uint8_t box_lanes_collide_epsilon(const BoxLanes *bl, uint8_t count, const Box *b, float epsilon);
+
+/// Same test as ray_intersect_with_box(ray, box i), for the first count boxes
+/// @param distances filled for hit boxes, BOX_LANES_COUNT floats
+uint8_t box_lanes_intersect_ray(const BoxLanes *bl,
+                                uint8_t count,
+                                const Ray *ray,
+                                float *distances);
+
+/// Scalar versions, exposed for tests & benchmarks
+uint8_t box_lanes_collide_epsilon_scalar(const BoxLanes *bl,
+                                         uint8_t count,
+                                         const Box *b,
+                                         float epsilon);
+uint8_t box_lanes_intersect_ray_scalar(const BoxLanes *bl,
+                                       uint8_t count,
+                                       const Ray *ray,
+                                       float *distances);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
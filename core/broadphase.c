@@ -0,0 +1,882 @@
+// -------------------------------------------------------------
+//  Cubzh Core
+//  broadphase.c
+// -------------------------------------------------------------
+
+#include "broadphase.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "config.h"
+#include "int3.h"
+#include "rigidBody.h"
+
+// cells coordinates are clamped to stay well within int32 range
+#define BROADPHASE_GRID_MAX_COORD 1073741824.0f
+#define BROADPHASE_GRID_INITIAL_CAPACITY 64
+#define BROADPHASE_LEAVES_INITIAL_CAPACITY 4
+
+typedef struct {
+    RtreeNode **leaves;
+    uint32_t count;
+    uint32_t capacity;
+} _BroadphaseLeaves;
+
+typedef struct {
+    _BroadphaseLeaves leaves;
+    int3 coords;
+    bool used;
+
+    char pad[3];
+} _BroadphaseCell;
+
+struct _Broadphase {
+    // hash grid: open addressing table of cells, w/ a power of two capacity
+    _BroadphaseCell *cells;
+    // hash grid: leaves overlapping too many cells
+    _BroadphaseLeaves large;
+    // sweep-and-prune: leaves sorted by aabb min x
+    _BroadphaseLeaves sorted;
+
+    size_t count;
+    uint32_t cellsCapacity;
+    uint32_t cellsCount;
+
+    // sweep-and-prune: largest leaf extent along x, bounds the leaves that may overlap a query
+    float maxExtent;
+    bool maxExtentDirty;
+
+    char pad[3];
+
+    BroadphaseType type;
+};
+
+/// Overlap results, pushed in list if any, or written in array up to capacity
+typedef struct {
+    FifoList *list;
+    RtreeNode **array;
+    size_t capacity;
+    size_t hits;
+} _BroadphaseOverlapResults;
+
+/// Cast results, pushed in list if any, or written in array up to capacity
+typedef struct {
+    DoublyLinkedList *list;
+    RtreeCastResult *array;
+    size_t capacity;
+    size_t hits;
+} _BroadphaseCastResults;
+
+// MARK: - Private functions -
+
+static bool _broadphase_leaves_push(_BroadphaseLeaves *l, RtreeNode *leaf) {
+    if (l->count == l->capacity) {
+        const uint32_t capacity = l->capacity == 0 ? BROADPHASE_LEAVES_INITIAL_CAPACITY
+                                                   : l->capacity * 2;
+        RtreeNode **leaves = (RtreeNode **)realloc(l->leaves, capacity * sizeof(RtreeNode *));
+        if (leaves == NULL) {
+            return false;
+        }
+        l->leaves = leaves;
+        l->capacity = capacity;
+    }
+    l->leaves[l->count++] = leaf;
+    return true;
+}
+
+/// Unordered removal
+static void _broadphase_leaves_remove(_BroadphaseLeaves *l, const RtreeNode *leaf) {
+    for (uint32_t i = 0; i < l->count; ++i) {
+        if (l->leaves[i] == leaf) {
+            l->leaves[i] = l->leaves[--l->count];
+            return;
+        }
+    }
+}
+
+static bool _broadphase_leaf_match(const RtreeNode *leaf,
+                                   uint16_t groups,
+                                   uint16_t collidesWith,
+                                   const DoublyLinkedList *excludeLeafPtrs) {
+    return rigidbody_collision_masks_reciprocal_match(rtree_node_get_groups(leaf),
+                                                      rtree_node_get_collides_with(leaf),
+                                                      groups,
+                                                      collidesWith) &&
+           (excludeLeafPtrs == NULL ||
+            doubly_linked_list_contains(excludeLeafPtrs, rtree_node_get_leaf_ptr(leaf)) == false);
+}
+
+static void _broadphase_overlap_leaf(RtreeNode *leaf,
+                                     const Box *aabb,
+                                     uint16_t groups,
+                                     uint16_t collidesWith,
+                                     const DoublyLinkedList *excludeLeafPtrs,
+                                     _BroadphaseOverlapResults *results,
+                                     float epsilon) {
+    if (box_collide_epsilon(rtree_node_get_aabb(leaf), aabb, epsilon) &&
+        _broadphase_leaf_match(leaf, groups, collidesWith, excludeLeafPtrs)) {
+        if (results->list != NULL) {
+            fifo_list_push(results->list, leaf);
+        } else if (results->hits < results->capacity) {
+            results->array[results->hits] = leaf;
+        }
+        results->hits++;
+    }
+}
+
+static void _broadphase_cast_ray_leaf(RtreeNode *leaf,
+                                      const Ray *ray,
+                                      uint16_t groups,
+                                      uint16_t collidesWith,
+                                      const DoublyLinkedList *excludeLeafPtrs,
+                                      _BroadphaseCastResults *results) {
+    const Box *aabb = rtree_node_get_aabb(leaf);
+    float distance;
+    if (ray_intersect_with_box(ray, &aabb->min, &aabb->max, &distance) &&
+        _broadphase_leaf_match(leaf, groups, collidesWith, excludeLeafPtrs)) {
+        if (results->list == NULL) {
+            if (results->hits < results->capacity) {
+                results->array[results->hits].rtreeLeaf = leaf;
+                results->array[results->hits].distance = distance;
+            }
+            results->hits++;
+        } else {
+            RtreeCastResult *result = malloc(sizeof(RtreeCastResult));
+            if (result != NULL) {
+                result->rtreeLeaf = leaf;
+                result->distance = distance;
+                doubly_linked_list_push_last(results->list, result);
+                results->hits++;
+            }
+        }
+    }
+}
+
+// MARK: Hash grid
+
+static int32_t _broadphase_grid_coord(float v) {
+    const float c = floorf(v / BROADPHASE_GRID_CELL_SIZE);
+    return (int32_t)CLAMP(c, -BROADPHASE_GRID_MAX_COORD, BROADPHASE_GRID_MAX_COORD);
+}
+
+static void _broadphase_grid_range(const Box *aabb, float margin, int3 *min, int3 *max) {
+    min->x = _broadphase_grid_coord(aabb->min.x - margin);
+    min->y = _broadphase_grid_coord(aabb->min.y - margin);
+    min->z = _broadphase_grid_coord(aabb->min.z - margin);
+    max->x = _broadphase_grid_coord(aabb->max.x + margin);
+    max->y = _broadphase_grid_coord(aabb->max.y + margin);
+    max->z = _broadphase_grid_coord(aabb->max.z + margin);
+}
+
+static double _broadphase_grid_range_cells(const int3 *min, const int3 *max) {
+    return ((double)max->x - (double)min->x + 1.0) * ((double)max->y - (double)min->y + 1.0) *
+           ((double)max->z - (double)min->z + 1.0);
+}
+
+static bool _broadphase_grid_is_large(const int3 *min, const int3 *max) {
+    return _broadphase_grid_range_cells(min, max) > BROADPHASE_GRID_MAX_LEAF_CELLS;
+}
+
+static uint32_t _broadphase_grid_hash(const int3 *c) {
+    return ((uint32_t)c->x * 73856093u) ^ ((uint32_t)c->y * 19349663u) ^
+           ((uint32_t)c->z * 83492791u);
+}
+
+static _BroadphaseCell *_broadphase_grid_find(const Broadphase *b, const int3 *c) {
+    if (b->cellsCount == 0) {
+        return NULL;
+    }
+    const uint32_t mask = b->cellsCapacity - 1;
+    uint32_t i = _broadphase_grid_hash(c) & mask;
+    while (b->cells[i].used) {
+        if (b->cells[i].coords.x == c->x && b->cells[i].coords.y == c->y &&
+            b->cells[i].coords.z == c->z) {
+            return &b->cells[i];
+        }
+        i = (i + 1) & mask;
+    }
+    return NULL;
+}
+
+/// @returns a free slot for given coordinates, table must not be full
+static _BroadphaseCell *_broadphase_grid_probe(_BroadphaseCell *cells,
+                                               uint32_t capacity,
+                                               const int3 *c) {
+    const uint32_t mask = capacity - 1;
+    uint32_t i = _broadphase_grid_hash(c) & mask;
+    while (cells[i].used) {
+        i = (i + 1) & mask;
+    }
+    return &cells[i];
+}
+
+static bool _broadphase_grid_grow(Broadphase *b) {
+    const uint32_t capacity = b->cellsCapacity == 0 ? BROADPHASE_GRID_INITIAL_CAPACITY
+                                                    : b->cellsCapacity * 2;
+    _BroadphaseCell *cells = (_BroadphaseCell *)calloc(capacity, sizeof(_BroadphaseCell));
+    if (cells == NULL) {
+        return false;
+    }
+    for (uint32_t i = 0; i < b->cellsCapacity; ++i) {
+        if (b->cells[i].used) {
+            *_broadphase_grid_probe(cells, capacity, &b->cells[i].coords) = b->cells[i];
+        }
+    }
+    free(b->cells);
+    b->cells = cells;
+    b->cellsCapacity = capacity;
+    return true;
+}
+
+static _BroadphaseCell *_broadphase_grid_find_or_add(Broadphase *b, const int3 *c) {
+    _BroadphaseCell *cell = _broadphase_grid_find(b, c);
+    if (cell != NULL) {
+        return cell;
+    }
+
+    // keep load factor under 1/2 for short probes
+    if ((b->cellsCount + 1) * 2 > b->cellsCapacity && _broadphase_grid_grow(b) == false) {
+        return NULL;
+    }
+    cell = _broadphase_grid_probe(b->cells, b->cellsCapacity, c);
+    cell->coords = *c;
+    cell->used = true;
+    b->cellsCount++;
+    return cell;
+}
+
+/// Removes an empty cell, following cells of the same probe sequence are shifted back in its place
+static void _broadphase_grid_delete(Broadphase *b, _BroadphaseCell *cell) {
+    free(cell->leaves.leaves);
+
+    const uint32_t mask = b->cellsCapacity - 1;
+    uint32_t i = (uint32_t)(cell - b->cells);
+    uint32_t j = i;
+    while (true) {
+        j = (j + 1) & mask;
+        if (b->cells[j].used == false) {
+            break;
+        }
+        // cell j can move to i if its ideal slot isn't cyclically within ]i, j]
+        const uint32_t ideal = _broadphase_grid_hash(&b->cells[j].coords) & mask;
+        const bool reachable = i <= j ? (ideal > i && ideal <= j) : (ideal > i || ideal <= j);
+        if (reachable == false) {
+            b->cells[i] = b->cells[j];
+            i = j;
+        }
+    }
+    memset(&b->cells[i], 0, sizeof(_BroadphaseCell));
+    b->cellsCount--;
+}
+
+static void _broadphase_grid_insert(Broadphase *b, RtreeNode *leaf) {
+    int3 min, max, c;
+    _broadphase_grid_range(rtree_node_get_aabb(leaf), 0.0f, &min, &max);
+
+    if (_broadphase_grid_is_large(&min, &max)) {
+        _broadphase_leaves_push(&b->large, leaf);
+        return;
+    }
+    for (c.z = min.z; c.z <= max.z; ++c.z) {
+        for (c.y = min.y; c.y <= max.y; ++c.y) {
+            for (c.x = min.x; c.x <= max.x; ++c.x) {
+                _BroadphaseCell *cell = _broadphase_grid_find_or_add(b, &c);
+                if (cell != NULL) {
+                    _broadphase_leaves_push(&cell->leaves, leaf);
+                }
+            }
+        }
+    }
+}
+
+static void _broadphase_grid_remove(Broadphase *b, RtreeNode *leaf) {
+    int3 min, max, c;
+    _broadphase_grid_range(rtree_node_get_aabb(leaf), 0.0f, &min, &max);
+
+    if (_broadphase_grid_is_large(&min, &max)) {
+        _broadphase_leaves_remove(&b->large, leaf);
+        return;
+    }
+    for (c.z = min.z; c.z <= max.z; ++c.z) {
+        for (c.y = min.y; c.y <= max.y; ++c.y) {
+            for (c.x = min.x; c.x <= max.x; ++c.x) {
+                _BroadphaseCell *cell = _broadphase_grid_find(b, &c);
+                if (cell != NULL) {
+                    _broadphase_leaves_remove(&cell->leaves, leaf);
+                    if (cell->leaves.count == 0) {
+                        _broadphase_grid_delete(b, cell);
+                    }
+                }
+            }
+        }
+    }
+}
+
+static void _broadphase_grid_update(Broadphase *b, RtreeNode *leaf, const Box *aabb) {
+    int3 min, max, newMin, newMax;
+    _broadphase_grid_range(rtree_node_get_aabb(leaf), 0.0f, &min, &max);
+    _broadphase_grid_range(aabb, 0.0f, &newMin, &newMax);
+
+    const bool large = _broadphase_grid_is_large(&min, &max);
+    const bool sameCells = large ? _broadphase_grid_is_large(&newMin, &newMax)
+                                 : min.x == newMin.x && min.y == newMin.y && min.z == newMin.z &&
+                                       max.x == newMax.x && max.y == newMax.y &&
+                                       max.z == newMax.z;
+
+    // leaf stays in the same cells most of the time
+    if (sameCells) {
+        *rtree_node_get_aabb(leaf) = *aabb;
+    } else {
+        _broadphase_grid_remove(b, leaf);
+        *rtree_node_get_aabb(leaf) = *aabb;
+        _broadphase_grid_insert(b, leaf);
+    }
+}
+
+/// A leaf overlapping several cells of the query is examined only in the first of these cells
+static void _broadphase_grid_overlap_cell(const _BroadphaseCell *cell,
+                                          const int3 *queryMin,
+                                          const Box *aabb,
+                                          uint16_t groups,
+                                          uint16_t collidesWith,
+                                          const DoublyLinkedList *excludeLeafPtrs,
+                                          _BroadphaseOverlapResults *results,
+                                          float epsilon) {
+    int3 min, max;
+    for (uint32_t i = 0; i < cell->leaves.count; ++i) {
+        RtreeNode *leaf = cell->leaves.leaves[i];
+        _broadphase_grid_range(rtree_node_get_aabb(leaf), 0.0f, &min, &max);
+        if (cell->coords.x == maximum(min.x, queryMin->x) &&
+            cell->coords.y == maximum(min.y, queryMin->y) &&
+            cell->coords.z == maximum(min.z, queryMin->z)) {
+            _broadphase_overlap_leaf(leaf,
+                                     aabb,
+                                     groups,
+                                     collidesWith,
+                                     excludeLeafPtrs,
+                                     results,
+                                     epsilon);
+        }
+    }
+}
+
+static void _broadphase_grid_query_overlap_box(Broadphase *b,
+                                               const Box *aabb,
+                                               uint16_t groups,
+                                               uint16_t collidesWith,
+                                               const DoublyLinkedList *excludeLeafPtrs,
+                                               _BroadphaseOverlapResults *results,
+                                               float epsilon) {
+    for (uint32_t i = 0; i < b->large.count; ++i) {
+        _broadphase_overlap_leaf(b->large.leaves[i],
+                                 aabb,
+                                 groups,
+                                 collidesWith,
+                                 excludeLeafPtrs,
+                                 results,
+                                 epsilon);
+    }
+
+    int3 min, max, c;
+    _broadphase_grid_range(aabb, maximum(epsilon, 0.0f), &min, &max);
+
+    // look up each cell of the query, or go through all cells if there are fewer
+    if (_broadphase_grid_range_cells(&min, &max) <= (double)b->cellsCount) {
+        for (c.z = min.z; c.z <= max.z; ++c.z) {
+            for (c.y = min.y; c.y <= max.y; ++c.y) {
+                for (c.x = min.x; c.x <= max.x; ++c.x) {
+                    const _BroadphaseCell *cell = _broadphase_grid_find(b, &c);
+                    if (cell != NULL) {
+                        _broadphase_grid_overlap_cell(cell,
+                                                      &min,
+                                                      aabb,
+                                                      groups,
+                                                      collidesWith,
+                                                      excludeLeafPtrs,
+                                                      results,
+                                                      epsilon);
+                    }
+                }
+            }
+        }
+    } else {
+        for (uint32_t i = 0; i < b->cellsCapacity; ++i) {
+            const _BroadphaseCell *cell = &b->cells[i];
+            if (cell->used && cell->coords.x >= min.x && cell->coords.x <= max.x &&
+                cell->coords.y >= min.y && cell->coords.y <= max.y && cell->coords.z >= min.z &&
+                cell->coords.z <= max.z) {
+                _broadphase_grid_overlap_cell(cell,
+                                              &min,
+                                              aabb,
+                                              groups,
+                                              collidesWith,
+                                              excludeLeafPtrs,
+                                              results,
+                                              epsilon);
+            }
+        }
+    }
+}
+
+/// Rays are unbounded, each leaf is tested once, in the cell of its aabb min
+static void _broadphase_grid_query_cast_all_ray(Broadphase *b,
+                                                const Ray *ray,
+                                                uint16_t groups,
+                                                uint16_t collidesWith,
+                                                const DoublyLinkedList *excludeLeafPtrs,
+                                                _BroadphaseCastResults *results) {
+    int3 min, max;
+    for (uint32_t i = 0; i < b->large.count; ++i) {
+        _broadphase_cast_ray_leaf(b->large.leaves[i],
+                                  ray,
+                                  groups,
+                                  collidesWith,
+                                  excludeLeafPtrs,
+                                  results);
+    }
+    for (uint32_t i = 0; i < b->cellsCapacity; ++i) {
+        const _BroadphaseCell *cell = &b->cells[i];
+        if (cell->used == false) {
+            continue;
+        }
+        for (uint32_t j = 0; j < cell->leaves.count; ++j) {
+            RtreeNode *leaf = cell->leaves.leaves[j];
+            _broadphase_grid_range(rtree_node_get_aabb(leaf), 0.0f, &min, &max);
+            if (cell->coords.x == min.x && cell->coords.y == min.y && cell->coords.z == min.z) {
+                _broadphase_cast_ray_leaf(leaf,
+                                          ray,
+                                          groups,
+                                          collidesWith,
+                                          excludeLeafPtrs,
+                                          results);
+            }
+        }
+    }
+}
+
+/// Pushes each leaf once, in the cell of its aabb min
+static void _broadphase_grid_list(const Broadphase *b, _BroadphaseLeaves *out) {
+    int3 min, max;
+    for (uint32_t i = 0; i < b->large.count; ++i) {
+        _broadphase_leaves_push(out, b->large.leaves[i]);
+    }
+    for (uint32_t i = 0; i < b->cellsCapacity; ++i) {
+        const _BroadphaseCell *cell = &b->cells[i];
+        if (cell->used == false) {
+            continue;
+        }
+        for (uint32_t j = 0; j < cell->leaves.count; ++j) {
+            _broadphase_grid_range(rtree_node_get_aabb(cell->leaves.leaves[j]), 0.0f, &min, &max);
+            if (cell->coords.x == min.x && cell->coords.y == min.y && cell->coords.z == min.z) {
+                _broadphase_leaves_push(out, cell->leaves.leaves[j]);
+            }
+        }
+    }
+}
+
+// MARK: Sweep-and-prune
+
+static float _broadphase_sap_min(const RtreeNode *leaf) {
+    return rtree_node_get_aabb(leaf)->min.x;
+}
+
+static float _broadphase_sap_extent(const RtreeNode *leaf) {
+    const Box *aabb = rtree_node_get_aabb(leaf);
+    return aabb->max.x - aabb->min.x;
+}
+
+/// @returns index of the first leaf whose min isn't lower than x
+static uint32_t _broadphase_sap_lower_bound(const Broadphase *b, float x) {
+    uint32_t lo = 0, hi = b->sorted.count;
+    while (lo < hi) {
+        const uint32_t mid = lo + (hi - lo) / 2;
+        if (_broadphase_sap_min(b->sorted.leaves[mid]) < x) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+/// @returns index of given leaf, or leaves count if it isn't found
+static uint32_t _broadphase_sap_find(const Broadphase *b, const RtreeNode *leaf) {
+    const float x = _broadphase_sap_min(leaf);
+    uint32_t i = _broadphase_sap_lower_bound(b, x);
+    while (i < b->sorted.count && b->sorted.leaves[i] != leaf &&
+           _broadphase_sap_min(b->sorted.leaves[i]) == x) {
+        ++i;
+    }
+    return i < b->sorted.count && b->sorted.leaves[i] == leaf ? i : b->sorted.count;
+}
+
+static void _broadphase_sap_insert(Broadphase *b, RtreeNode *leaf) {
+    const uint32_t i = _broadphase_sap_lower_bound(b, _broadphase_sap_min(leaf));
+    if (_broadphase_leaves_push(&b->sorted, leaf) == false) {
+        return;
+    }
+    memmove(&b->sorted.leaves[i + 1],
+            &b->sorted.leaves[i],
+            (b->sorted.count - 1 - i) * sizeof(RtreeNode *));
+    b->sorted.leaves[i] = leaf;
+
+    b->maxExtent = maximum(b->maxExtent, _broadphase_sap_extent(leaf));
+}
+
+static void _broadphase_sap_remove(Broadphase *b, RtreeNode *leaf) {
+    const uint32_t i = _broadphase_sap_find(b, leaf);
+    if (i == b->sorted.count) {
+        return;
+    }
+    memmove(&b->sorted.leaves[i],
+            &b->sorted.leaves[i + 1],
+            (b->sorted.count - 1 - i) * sizeof(RtreeNode *));
+    b->sorted.count--;
+
+    if (_broadphase_sap_extent(leaf) >= b->maxExtent) {
+        b->maxExtentDirty = true;
+    }
+}
+
+/// Leaf is shifted to its new place, usually close to the previous one
+static void _broadphase_sap_update(Broadphase *b, RtreeNode *leaf, const Box *aabb) {
+    uint32_t i = _broadphase_sap_find(b, leaf);
+    vx_assert(i < b->sorted.count);
+
+    const float extent = _broadphase_sap_extent(leaf);
+    *rtree_node_get_aabb(leaf) = *aabb;
+    if (i == b->sorted.count) {
+        return;
+    }
+
+    RtreeNode **leaves = b->sorted.leaves;
+    const float x = aabb->min.x;
+    while (i > 0 && _broadphase_sap_min(leaves[i - 1]) > x) {
+        leaves[i] = leaves[i - 1];
+        --i;
+    }
+    while (i + 1 < b->sorted.count && _broadphase_sap_min(leaves[i + 1]) < x) {
+        leaves[i] = leaves[i + 1];
+        ++i;
+    }
+    leaves[i] = leaf;
+
+    const float newExtent = _broadphase_sap_extent(leaf);
+    if (newExtent >= b->maxExtent) {
+        b->maxExtent = newExtent;
+    } else if (extent >= b->maxExtent) {
+        b->maxExtentDirty = true;
+    }
+}
+
+static void _broadphase_sap_refresh_max_extent(Broadphase *b) {
+    if (b->maxExtentDirty) {
+        b->maxExtent = 0.0f;
+        for (uint32_t i = 0; i < b->sorted.count; ++i) {
+            b->maxExtent = maximum(b->maxExtent, _broadphase_sap_extent(b->sorted.leaves[i]));
+        }
+        b->maxExtentDirty = false;
+    }
+}
+
+static void _broadphase_sap_query_overlap_box(Broadphase *b,
+                                              const Box *aabb,
+                                              uint16_t groups,
+                                              uint16_t collidesWith,
+                                              const DoublyLinkedList *excludeLeafPtrs,
+                                              _BroadphaseOverlapResults *results,
+                                              float epsilon) {
+    _broadphase_sap_refresh_max_extent(b);
+
+    // leaves starting before the query by more than the largest extent can't overlap it
+    const float margin = maximum(epsilon, 0.0f);
+    const float end = aabb->max.x + margin;
+    for (uint32_t i = _broadphase_sap_lower_bound(b, aabb->min.x - margin - b->maxExtent);
+         i < b->sorted.count && _broadphase_sap_min(b->sorted.leaves[i]) <= end;
+         ++i) {
+        _broadphase_overlap_leaf(b->sorted.leaves[i],
+                                 aabb,
+                                 groups,
+                                 collidesWith,
+                                 excludeLeafPtrs,
+                                 results,
+                                 epsilon);
+    }
+}
+
+static size_t _broadphase_query_overlap_box(Broadphase *b,
+                                            const Box *aabb,
+                                            uint16_t groups,
+                                            uint16_t collidesWith,
+                                            const DoublyLinkedList *excludeLeafPtrs,
+                                            _BroadphaseOverlapResults *results,
+                                            float epsilon) {
+    if (b->type == BroadphaseType_HashGrid) {
+        _broadphase_grid_query_overlap_box(b,
+                                           aabb,
+                                           groups,
+                                           collidesWith,
+                                           excludeLeafPtrs,
+                                           results,
+                                           epsilon);
+    } else {
+        _broadphase_sap_query_overlap_box(b,
+                                          aabb,
+                                          groups,
+                                          collidesWith,
+                                          excludeLeafPtrs,
+                                          results,
+                                          epsilon);
+    }
+    return results->hits;
+}
+
+static size_t _broadphase_query_cast_all_ray(Broadphase *b,
+                                             const Ray *worldRay,
+                                             uint16_t groups,
+                                             uint16_t collidesWith,
+                                             const DoublyLinkedList *excludeLeafPtrs,
+                                             _BroadphaseCastResults *results) {
+    if (b->type == BroadphaseType_HashGrid) {
+        _broadphase_grid_query_cast_all_ray(b,
+                                            worldRay,
+                                            groups,
+                                            collidesWith,
+                                            excludeLeafPtrs,
+                                            results);
+    } else {
+        for (uint32_t i = 0; i < b->sorted.count; ++i) {
+            _broadphase_cast_ray_leaf(b->sorted.leaves[i],
+                                      worldRay,
+                                      groups,
+                                      collidesWith,
+                                      excludeLeafPtrs,
+                                      results);
+        }
+    }
+    return results->hits;
+}
+
+// MARK: - Broadphase -
+
+Broadphase *broadphase_new(BroadphaseType type) {
+    vx_assert(type == BroadphaseType_HashGrid || type == BroadphaseType_SweepAndPrune);
+
+    Broadphase *b = (Broadphase *)malloc(sizeof(Broadphase));
+    if (b == NULL) {
+        return NULL;
+    }
+    b->cells = NULL;
+    b->large = (_BroadphaseLeaves){NULL, 0, 0};
+    b->sorted = (_BroadphaseLeaves){NULL, 0, 0};
+    b->count = 0;
+    b->cellsCapacity = 0;
+    b->cellsCount = 0;
+    b->maxExtent = 0.0f;
+    b->maxExtentDirty = false;
+    b->type = type;
+
+    return b;
+}
+
+void broadphase_free(Broadphase *b) {
+    if (b == NULL) {
+        return;
+    }
+    for (uint32_t i = 0; i < b->cellsCapacity; ++i) {
+        free(b->cells[i].leaves.leaves);
+    }
+    free(b->cells);
+    free(b->large.leaves);
+    free(b->sorted.leaves);
+    free(b);
+}
+
+BroadphaseType broadphase_get_type(const Broadphase *b) {
+    return b->type;
+}
+
+size_t broadphase_get_count(const Broadphase *b) {
+    return b->count;
+}
+
+// MARK: - Operations -
+
+void broadphase_insert(Broadphase *b, RtreeNode *leaf) {
+    if (b->type == BroadphaseType_HashGrid) {
+        _broadphase_grid_insert(b, leaf);
+    } else {
+        _broadphase_sap_insert(b, leaf);
+    }
+    b->count++;
+}
+
+void broadphase_remove(Broadphase *b, RtreeNode *leaf) {
+    if (b->type == BroadphaseType_HashGrid) {
+        _broadphase_grid_remove(b, leaf);
+    } else {
+        _broadphase_sap_remove(b, leaf);
+    }
+    b->count--;
+}
+
+void broadphase_update(Broadphase *b, RtreeNode *leaf, const Box *aabb) {
+    if (b->type == BroadphaseType_HashGrid) {
+        _broadphase_grid_update(b, leaf, aabb);
+    } else {
+        _broadphase_sap_update(b, leaf, aabb);
+    }
+}
+
+void broadphase_flush(Broadphase *b, FifoList *leaves) {
+    if (b->type == BroadphaseType_HashGrid) {
+        _BroadphaseLeaves all = {NULL, 0, 0};
+        _broadphase_grid_list(b, &all);
+        for (uint32_t i = 0; i < all.count; ++i) {
+            fifo_list_push(leaves, all.leaves[i]);
+        }
+        free(all.leaves);
+
+        for (uint32_t i = 0; i < b->cellsCapacity; ++i) {
+            free(b->cells[i].leaves.leaves);
+        }
+        memset(b->cells, 0, b->cellsCapacity * sizeof(_BroadphaseCell));
+        b->cellsCount = 0;
+        b->large.count = 0;
+    } else {
+        for (uint32_t i = 0; i < b->sorted.count; ++i) {
+            fifo_list_push(leaves, b->sorted.leaves[i]);
+        }
+        b->sorted.count = 0;
+        b->maxExtent = 0.0f;
+        b->maxExtentDirty = false;
+    }
+    b->count = 0;
+}
+
+void broadphase_refresh(Broadphase *b) {
+    if (b->type == BroadphaseType_SweepAndPrune) {
+        _broadphase_sap_refresh_max_extent(b);
+    }
+}
+
+// MARK: - Queries -
+
+size_t broadphase_query_overlap_box(Broadphase *b,
+                                    const Box *aabb,
+                                    uint16_t groups,
+                                    uint16_t collidesWith,
+                                    const DoublyLinkedList *excludeLeafPtrs,
+                                    FifoList *results,
+                                    float epsilon) {
+    _BroadphaseOverlapResults r = {results, NULL, 0, 0};
+    return _broadphase_query_overlap_box(b,
+                                         aabb,
+                                         groups,
+                                         collidesWith,
+                                         excludeLeafPtrs,
+                                         &r,
+                                         epsilon);
+}
+
+size_t broadphase_query_overlap_box_array(Broadphase *b,
+                                          const Box *aabb,
+                                          uint16_t groups,
+                                          uint16_t collidesWith,
+                                          const DoublyLinkedList *excludeLeafPtrs,
+                                          RtreeNode **results,
+                                          size_t capacity,
+                                          float epsilon) {
+    _BroadphaseOverlapResults r = {NULL, results, results != NULL ? capacity : 0, 0};
+    return _broadphase_query_overlap_box(b,
+                                         aabb,
+                                         groups,
+                                         collidesWith,
+                                         excludeLeafPtrs,
+                                         &r,
+                                         epsilon);
+}
+
+size_t broadphase_query_cast_all_ray(Broadphase *b,
+                                     const Ray *worldRay,
+                                     uint16_t groups,
+                                     uint16_t collidesWith,
+                                     const DoublyLinkedList *excludeLeafPtrs,
+                                     DoublyLinkedList *results) {
+    vx_assert(results != NULL);
+
+    _BroadphaseCastResults r = {results, NULL, 0, 0};
+    return _broadphase_query_cast_all_ray(b, worldRay, groups, collidesWith, excludeLeafPtrs, &r);
+}
+
+size_t broadphase_query_cast_all_ray_array(Broadphase *b,
+                                           const Ray *worldRay,
+                                           uint16_t groups,
+                                           uint16_t collidesWith,
+                                           const DoublyLinkedList *excludeLeafPtrs,
+                                           RtreeCastResult *results,
+                                           size_t capacity) {
+    _BroadphaseCastResults r = {NULL, results, results != NULL ? capacity : 0, 0};
+    return _broadphase_query_cast_all_ray(b, worldRay, groups, collidesWith, excludeLeafPtrs, &r);
+}
+
+size_t broadphase_query_cast_all_box(Broadphase *b,
+                                     const Box *aabb,
+                                     const float3 *unit,
+                                     float maxDist,
+                                     uint16_t groups,
+                                     uint16_t collidesWith,
+                                     const DoublyLinkedList *excludeLeafPtrs,
+                                     DoublyLinkedList *results) {
+    vx_assert(results != NULL);
+
+    FifoList *query = fifo_list_new();
+    Box broadPhaseBox, stepOriginBox = *aabb;
+    float d = 0.0f, step = 0.0f;
+    size_t hits = 0;
+
+    // same steps as r-tree cast queries, see rtree_utils_broadphase_steps
+    while (d < maxDist) {
+        d += step;
+        step = minimum(maxDist - d, RTREE_CAST_STEP_DISTANCE);
+
+        const float3 step3 = {unit->x * step, unit->y * step, unit->z * step};
+        box_set_broadphase_box(&stepOriginBox, &step3, &broadPhaseBox);
+
+        if (broadphase_query_overlap_box(b,
+                                         &broadPhaseBox,
+                                         groups,
+                                         collidesWith,
+                                         excludeLeafPtrs,
+                                         query,
+                                         -EPSILON_COLLISION) > 0) {
+            RtreeNode *hit = fifo_list_pop(query);
+            while (hit != NULL) {
+                const float swept = box_swept(&stepOriginBox,
+                                              &step3,
+                                              rtree_node_get_aabb(hit),
+                                              &float3_epsilon_collision,
+                                              false,
+                                              NULL,
+                                              NULL);
+
+                RtreeCastResult *result = malloc(sizeof(RtreeCastResult));
+                if (result != NULL) {
+                    result->rtreeLeaf = hit;
+                    result->distance = d + swept * float3_length(&step3);
+                    doubly_linked_list_push_last(results, result);
+                    hits++;
+                }
+                hit = fifo_list_pop(query);
+            }
+        }
+
+        float3_op_add(&stepOriginBox.min, &step3);
+        float3_op_add(&stepOriginBox.max, &step3);
+    }
+    fifo_list_free(query, NULL);
+
+    return hits;
+}
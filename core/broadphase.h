@@ -0,0 +1,101 @@
+// -------------------------------------------------------------
+//  Cubzh Core
+//  broadphase.h
+// -------------------------------------------------------------
+
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "box.h"
+#include "doubly_linked_list.h"
+#include "fifo_list.h"
+#include "ray.h"
+#include "rtree.h"
+
+// Broadphase for colliders moving every frame (dynamic rigidbodies), cheaper to update than the
+// r-tree which may remove & re-insert a leaf each time it moves,
+// - hash grid: leaves are registered in each fixed-size cell they overlap, cells are kept in a
+// hash table. Leaves overlapping too many cells are kept aside & tested by every query
+// - sweep-and-prune: leaves are kept sorted along x, a moving leaf is shifted in place. Queries
+// test the leaves whose x interval may overlap theirs
+//
+// Leaves are r-tree leaves created w/ rtree_create_leaf & never inserted in the r-tree, so that
+// queries results are the same as r-tree queries results, and can be merged w/ them.
+
+typedef enum {
+    /// no separate broadphase, dynamic colliders are in the r-tree w/ all other colliders
+    BroadphaseType_Rtree,
+    BroadphaseType_HashGrid,
+    BroadphaseType_SweepAndPrune
+} BroadphaseType;
+
+typedef struct _Broadphase Broadphase;
+
+/// @param type BroadphaseType_HashGrid or BroadphaseType_SweepAndPrune
+Broadphase *broadphase_new(BroadphaseType type);
+/// Leaves are not freed, see broadphase_flush
+void broadphase_free(Broadphase *b);
+
+BroadphaseType broadphase_get_type(const Broadphase *b);
+size_t broadphase_get_count(const Broadphase *b);
+
+/// MARK: - Operations -
+void broadphase_insert(Broadphase *b, RtreeNode *leaf);
+void broadphase_remove(Broadphase *b, RtreeNode *leaf);
+/// Sets leaf aabb, leaves must not be modified directly while in the broadphase
+void broadphase_update(Broadphase *b, RtreeNode *leaf, const Box *aabb);
+/// Removes all leaves, pushed in given list
+void broadphase_flush(Broadphase *b, FifoList *leaves);
+/// Refreshes what queries would compute on first use, so that queries may then run concurrently
+/// until next operation
+void broadphase_refresh(Broadphase *b);
+
+/// MARK: - Queries -
+/// Same parameters & results as r-tree queries, see rtree.h
+size_t broadphase_query_overlap_box(Broadphase *b,
+                                    const Box *aabb,
+                                    uint16_t groups,
+                                    uint16_t collidesWith,
+                                    const DoublyLinkedList *excludeLeafPtrs,
+                                    FifoList *results,
+                                    float epsilon);
+size_t broadphase_query_overlap_box_array(Broadphase *b,
+                                          const Box *aabb,
+                                          uint16_t groups,
+                                          uint16_t collidesWith,
+                                          const DoublyLinkedList *excludeLeafPtrs,
+                                          RtreeNode **results,
+                                          size_t capacity,
+                                          float epsilon);
+/// Rays are unbounded, all leaves are tested
+size_t broadphase_query_cast_all_ray(Broadphase *b,
+                                     const Ray *worldRay,
+                                     uint16_t groups,
+                                     uint16_t collidesWith,
+                                     const DoublyLinkedList *excludeLeafPtrs,
+                                     DoublyLinkedList *results);
+size_t broadphase_query_cast_all_ray_array(Broadphase *b,
+                                           const Ray *worldRay,
+                                           uint16_t groups,
+                                           uint16_t collidesWith,
+                                           const DoublyLinkedList *excludeLeafPtrs,
+                                           RtreeCastResult *results,
+                                           size_t capacity);
+size_t broadphase_query_cast_all_box(Broadphase *b,
+                                     const Box *aabb,
+                                     const float3 *unit,
+                                     float maxDist,
+                                     uint16_t groups,
+                                     uint16_t collidesWith,
+                                     const DoublyLinkedList *excludeLeafPtrs,
+                                     DoublyLinkedList *results);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
@@ -0,0 +1,143 @@
+// -------------------------------------------------------------
+//  Cubzh Core
+//  checksum.c
+// -------------------------------------------------------------
+
+#include "checksum.h"
+
+#include <string.h>
+
+#if defined(__ARM_FEATURE_CRC32)
+#include <arm_acle.h>
+#define CHECKSUM_CRC32_HARDWARE 1
+#else
+#define CHECKSUM_CRC32_HARDWARE 0
+#include "mutex.h" // pthread / windows.h
+#endif
+
+// reflected polynomial
+#define CHECKSUM_CRC32_POLY 0xedb88320
+
+#if CHECKSUM_CRC32_HARDWARE == 0
+
+// tables[0] is the usual byte-wise table, tables[k] advances a byte by k more bytes of zeros
+static uint32_t _crc32Tables[8][256];
+
+#if defined(__VX_PLATFORM_WINDOWS)
+static INIT_ONCE _crc32TablesOnce = INIT_ONCE_STATIC_INIT;
+#else
+static pthread_once_t _crc32TablesOnce = PTHREAD_ONCE_INIT;
+#endif
+
+static void _checksum_crc32_make_tables(void) {
+    for (uint32_t n = 0; n < 256; ++n) {
+        uint32_t c = n;
+        for (int k = 0; k < 8; ++k) {
+            c = c & 1 ? (c >> 1) ^ CHECKSUM_CRC32_POLY : c >> 1;
+        }
+        _crc32Tables[0][n] = c;
+    }
+    for (uint32_t n = 0; n < 256; ++n) {
+        for (int t = 1; t < 8; ++t) {
+            const uint32_t c = _crc32Tables[t - 1][n];
+            _crc32Tables[t][n] = (c >> 8) ^ _crc32Tables[0][c & 0xff];
+        }
+    }
+}
+
+#if defined(__VX_PLATFORM_WINDOWS)
+static BOOL CALLBACK _checksum_crc32_init(PINIT_ONCE once, PVOID param, PVOID *ctx) {
+    _checksum_crc32_make_tables();
+    return TRUE;
+}
+#endif
+
+#endif
+
+/// a * b modulo CRC-32 polynomial, reflected representation (x^0 is the highest bit)
+static uint32_t _checksum_crc32_multmodp(uint32_t a, uint32_t b) {
+    uint32_t m = (uint32_t)1 << 31;
+    uint32_t p = 0;
+    while (a != 0) {
+        if (a & m) {
+            p ^= b;
+            a ^= m;
+        }
+        m >>= 1;
+        b = b & 1 ? (b >> 1) ^ CHECKSUM_CRC32_POLY : b >> 1;
+    }
+    return p;
+}
+
+uint32_t checksum_crc32(uint32_t crc, const void *data, size_t size) {
+    const uint8_t *p = (const uint8_t *)data;
+    crc = ~crc;
+
+#if CHECKSUM_CRC32_HARDWARE
+    while (size > 0 && ((uintptr_t)p & 7) != 0) {
+        crc = __crc32b(crc, *p++);
+        --size;
+    }
+    uint64_t word;
+    while (size >= 8) {
+        memcpy(&word, p, 8);
+        crc = __crc32d(crc, word);
+        p += 8;
+        size -= 8;
+    }
+    while (size > 0) {
+        crc = __crc32b(crc, *p++);
+        --size;
+    }
+#else
+#if defined(__VX_PLATFORM_WINDOWS)
+    InitOnceExecuteOnce(&_crc32TablesOnce, _checksum_crc32_init, NULL, NULL);
+#else
+    pthread_once(&_crc32TablesOnce, _checksum_crc32_make_tables);
+#endif
+
+#if !defined(__BYTE_ORDER__) || __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    // 8 bytes at a time
+    uint32_t lo, hi;
+    while (size >= 8) {
+        memcpy(&lo, p, 4);
+        memcpy(&hi, p + 4, 4);
+        lo ^= crc;
+        crc = _crc32Tables[7][lo & 0xff] ^ _crc32Tables[6][(lo >> 8) & 0xff] ^
+              _crc32Tables[5][(lo >> 16) & 0xff] ^ _crc32Tables[4][lo >> 24] ^
+              _crc32Tables[3][hi & 0xff] ^ _crc32Tables[2][(hi >> 8) & 0xff] ^
+              _crc32Tables[1][(hi >> 16) & 0xff] ^ _crc32Tables[0][hi >> 24];
+        p += 8;
+        size -= 8;
+    }
+#endif
+    while (size > 0) {
+        crc = (crc >> 8) ^ _crc32Tables[0][(crc ^ *p++) & 0xff];
+        --size;
+    }
+#endif
+
+    return ~crc;
+}
+
+uint32_t checksum_crc32_combine(uint32_t crc1, uint32_t crc2, size_t size2) {
+    return checksum_crc32_combine_with_op(crc1, crc2, checksum_crc32_combine_op(size2));
+}
+
+uint32_t checksum_crc32_combine_op(size_t size2) {
+    // x^(8 * size2) modulo polynomial, squaring x^(2^k) from x^8
+    uint32_t op = (uint32_t)1 << 31;  // x^0
+    uint32_t x2k = (uint32_t)1 << 23; // x^8
+    while (size2 > 0) {
+        if (size2 & 1) {
+            op = _checksum_crc32_multmodp(x2k, op);
+        }
+        size2 >>= 1;
+        x2k = _checksum_crc32_multmodp(x2k, x2k);
+    }
+    return op;
+}
+
+uint32_t checksum_crc32_combine_with_op(uint32_t crc1, uint32_t crc2, uint32_t op) {
+    return _checksum_crc32_multmodp(op, crc1) ^ crc2;
+}
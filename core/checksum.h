@@ -0,0 +1,31 @@
+// -------------------------------------------------------------
+//  Cubzh Core
+//  checksum.h
+// -------------------------------------------------------------
+
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stddef.h>
+#include <stdint.h>
+
+// CRC-32 (IEEE 802.3), same values as zlib's crc32 & crc32_combine.
+// Uses CRC32 instructions on ARMv8 targets supporting them, slicing-by-8 tables otherwise.
+
+/// Updates running crc w/ given data, start w/ crc = 0
+uint32_t checksum_crc32(uint32_t crc, const void *data, size_t size);
+
+/// CRC-32 of two concatenated buffers, from the CRC-32 of each (first one may be a running crc)
+/// & the size of the second one, in O(log(size2))
+uint32_t checksum_crc32_combine(uint32_t crc1, uint32_t crc2, size_t size2);
+
+/// Same as checksum_crc32_combine, in constant time w/ an operator computed once for a given size2
+uint32_t checksum_crc32_combine_op(size_t size2);
+uint32_t checksum_crc32_combine_with_op(uint32_t crc1, uint32_t crc2, uint32_t op);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
@@ -10,13 +10,11 @@
 #include <string.h>
 
 #include "cclog.h"
+#include "checksum.h"
 #include "vertextbuffer.h"
-#include "zlib.h"
 
 #define CHUNK_NEIGHBORS_COUNT 26
 
-static VERTEX_LIGHT_STRUCT_T *defaultLight = NULL;
-
 // chunk structure definition
 struct _Chunk {
     // 26 possible chunk neighbors used for fast access
@@ -24,7 +22,7 @@ struct _Chunk {
     Chunk *neighbors[CHUNK_NEIGHBORS_COUNT]; /* 8 bytes */
     // octree partitioning this chunk's blocks
     Octree *octree; /* 8 bytes */
-    // NULL if chunk does not use lighting
+    // NULL if chunk does not use lighting, or if its lighting is uniform
     VERTEX_LIGHT_STRUCT_T *lightingData; /* 8 bytes */
     // reference to shape chunks rtree leaf node, used for removal
     void *rtreeLeaf; /* 8 bytes */
@@ -33,19 +31,29 @@ struct _Chunk {
     VertexBufferMemArea *vbma_transparent; /* 8 bytes */
     // number of blocks in that chunk
     int nbBlocks; /* 4 bytes */
+    // CRC-32 of octree elements & operator to append it to a running crc, computed on demand
+    uint32_t blocksCrc;   /* 4 bytes */
+    uint32_t blocksCrcOp; /* 4 bytes */
     // position of chunk in shape's model
     SHAPE_COORDS_INT3_T origin; /* 3 x 2 bytes */
     // model axis-aligned bounding box (bbMax - 1 is the max block)
     CHUNK_COORDS_INT3_T bbMin, bbMax; /* 6 x 1 byte */
+    // light value of all blocks, if lightingUniform
+    VERTEX_LIGHT_STRUCT_T uniformLight; /* 2 bytes */
+    bool lightingUniform;               /* 1 byte */
     // whether vertices need to be refreshed
     bool dirty; /* 1 byte */
+    // whether blocksCrc is up to date
+    bool blocksCrcValid; /* 1 byte */
 
-    char pad[7];
+    char pad[3];
 };
 
 // MARK: private functions prototypes
 
 Octree *_chunk_new_octree(void);
+/// copy-on-write, gives chunk its own octree if it's shared w/ chunk copies, before writing blocks
+bool _chunk_own_octree(Chunk *c);
 
 void _chunk_hello_neighbor(Chunk *newcomer,
                            Neighbor newcomerLocation,
@@ -70,6 +78,9 @@ void _vertex_light_smoothing(VERTEX_LIGHT_STRUCT_T *base,
                              VERTEX_LIGHT_STRUCT_T vlight2,
                              VERTEX_LIGHT_STRUCT_T vlight3);
 
+/// expands uniform lighting into a lighting data array, returns false if allocation failed
+bool _chunk_expand_lighting_data(Chunk *c);
+
 bool _chunk_is_bounding_box_empty(const Chunk *chunk);
 void _chunk_update_bounding_box(Chunk *chunk,
                                 const CHUNK_COORDS_INT3_T coords,
@@ -77,16 +88,6 @@ void _chunk_update_bounding_box(Chunk *chunk,
 
 // MARK: public functions
 
-void chunk_alloc_default_light(void) {
-    if (defaultLight == NULL) {
-        const size_t lightingSize = (size_t)CHUNK_SIZE_CUBE * (size_t)sizeof(VERTEX_LIGHT_STRUCT_T);
-        defaultLight = malloc(lightingSize);
-        for (size_t i = 0; i < CHUNK_SIZE_CUBE; ++i) {
-            DEFAULT_LIGHT(defaultLight[i])
-        }
-    }
-}
-
 Chunk *chunk_new(const SHAPE_COORDS_INT3_T origin) {
     Chunk *chunk = (Chunk *)malloc(sizeof(Chunk));
     if (chunk == NULL) {
@@ -94,8 +95,13 @@ Chunk *chunk_new(const SHAPE_COORDS_INT3_T origin) {
     }
     chunk->octree = _chunk_new_octree();
     chunk->lightingData = NULL;
+    ZERO_LIGHT(chunk->uniformLight)
+    chunk->lightingUniform = false;
     chunk->rtreeLeaf = NULL;
     chunk->dirty = false;
+    chunk->blocksCrc = 0;
+    chunk->blocksCrcOp = 0;
+    chunk->blocksCrcValid = false;
     chunk->origin = origin;
     chunk->bbMin = (CHUNK_COORDS_INT3_T){0, 0, 0};
     chunk->bbMax = (CHUNK_COORDS_INT3_T){0, 0, 0};
@@ -116,7 +122,8 @@ Chunk *chunk_new_copy(const Chunk *c) {
     if (copy == NULL) {
         return NULL;
     }
-    copy->octree = octree_new_copy(c->octree);
+    // blocks are shared until one of the chunks is written (see _chunk_own_octree)
+    copy->octree = octree_retain(c->octree);
     if (c->lightingData != NULL) {
         const size_t lightingSize = (size_t)CHUNK_SIZE_SQR * (size_t)CHUNK_SIZE *
                                     (size_t)sizeof(VERTEX_LIGHT_STRUCT_T);
@@ -125,8 +132,13 @@ Chunk *chunk_new_copy(const Chunk *c) {
     } else {
         copy->lightingData = NULL;
     }
+    copy->uniformLight = c->uniformLight;
+    copy->lightingUniform = c->lightingUniform;
     copy->rtreeLeaf = NULL;
     copy->dirty = false;
+    copy->blocksCrc = c->blocksCrc;
+    copy->blocksCrcOp = c->blocksCrcOp;
+    copy->blocksCrcValid = c->blocksCrcValid;
     copy->origin = c->origin;
     copy->bbMin = c->bbMin;
     copy->bbMax = c->bbMax;
@@ -197,11 +209,16 @@ void *chunk_get_rtree_leaf(const Chunk *c) {
     return c->rtreeLeaf;
 }
 
-uint64_t chunk_get_hash(const Chunk *c, uint64_t crc) {
-    const uint64_t originHash = crc32((uLong)crc,
-                                      (const Bytef *)&c->origin,
-                                      (uInt)sizeof(SHAPE_COORDS_INT3_T));
-    return octree_get_hash(c->octree, originHash);
+uint64_t chunk_get_hash(Chunk *c, uint64_t crc) {
+    const uint32_t originHash = checksum_crc32((uint32_t)crc,
+                                               &c->origin,
+                                               sizeof(SHAPE_COORDS_INT3_T));
+    if (c->blocksCrcValid == false) {
+        c->blocksCrc = (uint32_t)octree_get_hash(c->octree, 0);
+        c->blocksCrcOp = checksum_crc32_combine_op(octree_get_elements_size(c->octree));
+        c->blocksCrcValid = true;
+    }
+    return checksum_crc32_combine_with_op(originHash, c->blocksCrc, c->blocksCrcOp);
 }
 
 void chunk_set_light(Chunk *c,
@@ -215,17 +232,29 @@ void chunk_set_light(Chunk *c,
     }
 
     if (c->lightingData == NULL) {
-        chunk_reset_lighting_data(c, initEmpty);
+        if (c->lightingUniform == false) {
+            chunk_reset_lighting_data(c, initEmpty);
+        }
+        if (light.ambient == c->uniformLight.ambient && light.red == c->uniformLight.red &&
+            light.green == c->uniformLight.green && light.blue == c->uniformLight.blue) {
+            return;
+        }
+        // first non-uniform value
+        if (_chunk_expand_lighting_data(c) == false) {
+            return;
+        }
     }
 
     c->lightingData[coords.x * CHUNK_SIZE_SQR + coords.y * CHUNK_SIZE + coords.z] = light;
 }
 
 VERTEX_LIGHT_STRUCT_T chunk_get_light_without_checking(const Chunk *c, CHUNK_COORDS_INT3_T coords) {
-    if (c == NULL || c->lightingData == NULL) {
+    if (c == NULL || (c->lightingData == NULL && c->lightingUniform == false)) {
         VERTEX_LIGHT_STRUCT_T light;
         DEFAULT_LIGHT(light)
         return light;
+    } else if (c->lightingData == NULL) {
+        return c->uniformLight;
     } else {
         return c->lightingData[coords.x * CHUNK_SIZE_SQR + coords.y * CHUNK_SIZE + coords.z];
     }
@@ -249,19 +278,20 @@ void chunk_clear_lighting_data(Chunk *c) {
         free(c->lightingData);
         c->lightingData = NULL;
     }
+    c->lightingUniform = false;
 }
 
 void chunk_reset_lighting_data(Chunk *c, const bool emptyOrDefault) {
-    const size_t lightingSize = (size_t)CHUNK_SIZE_CUBE * (size_t)sizeof(VERTEX_LIGHT_STRUCT_T);
-    if (c->lightingData == NULL) {
-        c->lightingData = malloc(lightingSize);
+    if (c->lightingData != NULL) {
+        free(c->lightingData);
+        c->lightingData = NULL;
     }
     if (emptyOrDefault) {
-        memset(c->lightingData, 0, lightingSize);
+        ZERO_LIGHT(c->uniformLight)
     } else {
-        vx_assert(defaultLight != NULL);
-        memcpy(c->lightingData, defaultLight, lightingSize);
+        DEFAULT_LIGHT(c->uniformLight)
     }
+    c->lightingUniform = true;
 }
 
 void chunk_set_lighting_data(Chunk *c, VERTEX_LIGHT_STRUCT_T *data) {
@@ -269,12 +299,62 @@ void chunk_set_lighting_data(Chunk *c, VERTEX_LIGHT_STRUCT_T *data) {
         free(c->lightingData);
     }
     c->lightingData = data;
+    c->lightingUniform = false;
+    chunk_compact_lighting_data(c);
 }
 
 VERTEX_LIGHT_STRUCT_T *chunk_get_lighting_data(Chunk *c) {
     return c->lightingData;
 }
 
+bool chunk_get_uniform_light(const Chunk *c, VERTEX_LIGHT_STRUCT_T *light) {
+    if (c->lightingData != NULL || c->lightingUniform == false) {
+        return false;
+    }
+    if (light != NULL) {
+        *light = c->uniformLight;
+    }
+    return true;
+}
+
+void chunk_compact_lighting_data(Chunk *c) {
+    if (c->lightingData == NULL) {
+        return;
+    }
+    const VERTEX_LIGHT_STRUCT_T first = c->lightingData[0];
+    const VERTEX_LIGHT_STRUCT_T *cursor = c->lightingData + 1;
+    const VERTEX_LIGHT_STRUCT_T *end = c->lightingData + CHUNK_SIZE_CUBE;
+    while (cursor < end) {
+        if (cursor->ambient != first.ambient || cursor->red != first.red ||
+            cursor->green != first.green || cursor->blue != first.blue) {
+            return;
+        }
+        ++cursor;
+    }
+    free(c->lightingData);
+    c->lightingData = NULL;
+    c->uniformLight = first;
+    c->lightingUniform = true;
+}
+
+void chunk_write_lighting_data(const Chunk *c, VERTEX_LIGHT_STRUCT_T *out) {
+    if (c->lightingData != NULL) {
+        memcpy(out,
+               c->lightingData,
+               (size_t)CHUNK_SIZE_CUBE * (size_t)sizeof(VERTEX_LIGHT_STRUCT_T));
+        return;
+    }
+    VERTEX_LIGHT_STRUCT_T light;
+    if (c->lightingUniform) {
+        light = c->uniformLight;
+    } else {
+        DEFAULT_LIGHT(light)
+    }
+    for (size_t i = 0; i < CHUNK_SIZE_CUBE; ++i) {
+        out[i] = light;
+    }
+}
+
 bool chunk_add_block(Chunk *chunk,
                      const Block block,
                      const CHUNK_COORDS_INT_T x,
@@ -287,11 +367,12 @@ bool chunk_add_block(Chunk *chunk,
 
     Block *b = (Block *)
         octree_get_element_without_checking(chunk->octree, (size_t)x, (size_t)y, (size_t)z);
-    if (block_is_solid(b)) {
+    if (block_is_solid(b) || _chunk_own_octree(chunk) == false) {
         return false;
     } else {
         octree_set_element(chunk->octree, &block, (size_t)x, (size_t)y, (size_t)z);
         chunk->nbBlocks++;
+        chunk->blocksCrcValid = false;
         _chunk_update_bounding_box(chunk, (CHUNK_COORDS_INT3_T){x, y, z}, true);
         return true;
     }
@@ -305,13 +386,16 @@ bool chunk_remove_block(Chunk *chunk,
 
     Block *b = (Block *)
         octree_get_element_without_checking(chunk->octree, (size_t)x, (size_t)y, (size_t)z);
-    if (block_is_solid(b)) {
+    if (block_is_solid(b) && _chunk_own_octree(chunk)) {
+        b = (Block *)
+            octree_get_element_without_checking(chunk->octree, (size_t)x, (size_t)y, (size_t)z);
         if (prevColorIndex != NULL) {
             *prevColorIndex = block_get_color_index(b);
         }
         block_set_color_index(b, SHAPE_COLOR_INDEX_AIR_BLOCK);
         octree_remove_element(chunk->octree, (size_t)x, (size_t)y, (size_t)z, NULL);
         chunk->nbBlocks--;
+        chunk->blocksCrcValid = false;
         _chunk_update_bounding_box(chunk, (CHUNK_COORDS_INT3_T){x, y, z}, false);
         return true;
     } else {
@@ -328,11 +412,14 @@ bool chunk_paint_block(Chunk *chunk,
 
     Block *b = (Block *)
         octree_get_element_without_checking(chunk->octree, (size_t)x, (size_t)y, (size_t)z);
-    if (block_is_solid(b)) {
+    if (block_is_solid(b) && _chunk_own_octree(chunk)) {
+        b = (Block *)
+            octree_get_element_without_checking(chunk->octree, (size_t)x, (size_t)y, (size_t)z);
         if (prevColorIndex != NULL) {
             *prevColorIndex = block_get_color_index(b);
         }
         block_set_color_index(b, colorIndex);
+        chunk->blocksCrcValid = false;
         return true;
     } else {
         return false;
@@ -2497,6 +2584,31 @@ void _vertex_light_smoothing(VERTEX_LIGHT_STRUCT_T *base,
 #endif /* GLOBAL_LIGHTING_SMOOTHING_ENABLED */
 }
 
+bool _chunk_own_octree(Chunk *c) {
+    if (octree_is_shared(c->octree) == false) {
+        return true;
+    }
+    Octree *copy = octree_new_copy(c->octree);
+    if (copy == NULL) {
+        return false;
+    }
+    octree_free(c->octree);
+    c->octree = copy;
+    return true;
+}
+
+bool _chunk_expand_lighting_data(Chunk *c) {
+    VERTEX_LIGHT_STRUCT_T *data = (VERTEX_LIGHT_STRUCT_T *)malloc(
+        (size_t)CHUNK_SIZE_CUBE * (size_t)sizeof(VERTEX_LIGHT_STRUCT_T));
+    if (data == NULL) {
+        return false;
+    }
+    chunk_write_lighting_data(c, data);
+    c->lightingData = data;
+    c->lightingUniform = false;
+    return true;
+}
+
 bool _chunk_is_bounding_box_empty(const Chunk *chunk) {
     return chunk->bbMin.x == chunk->bbMax.x || chunk->bbMin.y == chunk->bbMax.y ||
            chunk->bbMin.z == chunk->bbMax.z;
@@ -55,8 +55,6 @@ typedef enum {
     NZ = 25
 } Neighbor;
 
-void chunk_alloc_default_light(void);
-
 Chunk *chunk_new(const SHAPE_COORDS_INT3_T origin);
 Chunk *chunk_new_copy(const Chunk *c);
 void chunk_free(Chunk *chunk, bool updateNeighbors);
@@ -68,7 +66,8 @@ int chunk_get_nb_blocks(const Chunk *chunk);
 Octree *chunk_get_octree(const Chunk *c);
 void chunk_set_rtree_leaf(Chunk *c, void *ptr);
 void *chunk_get_rtree_leaf(const Chunk *c);
-uint64_t chunk_get_hash(const Chunk *c, uint64_t crc);
+/// Running CRC-32 of chunk origin & blocks, blocks CRC is cached until blocks change
+uint64_t chunk_get_hash(Chunk *c, uint64_t crc);
 
 void chunk_set_light(Chunk *c,
                      const CHUNK_COORDS_INT3_T coords,
@@ -78,10 +77,20 @@ VERTEX_LIGHT_STRUCT_T chunk_get_light_without_checking(const Chunk *c, CHUNK_COO
 VERTEX_LIGHT_STRUCT_T chunk_get_light_or_default(Chunk *c,
                                                  CHUNK_COORDS_INT3_T coords,
                                                  bool isDefault);
+/// Lighting of a chunk w/ the same value for all its blocks is stored as that single value, it is
+/// expanded into an array of CHUNK_SIZE_CUBE values on first non-uniform write
 void chunk_clear_lighting_data(Chunk *c);
 void chunk_reset_lighting_data(Chunk *c, const bool emptyOrDefault);
+/// Takes ownership of data, an array of CHUNK_SIZE_CUBE values
 void chunk_set_lighting_data(Chunk *c, VERTEX_LIGHT_STRUCT_T *data);
+/// NULL if chunk lighting is uniform, see chunk_write_lighting_data
 VERTEX_LIGHT_STRUCT_T *chunk_get_lighting_data(Chunk *c);
+/// Returns true if chunk lighting is uniform, w/ its value
+bool chunk_get_uniform_light(const Chunk *c, VERTEX_LIGHT_STRUCT_T *light);
+/// Collapses lighting data into a single value, if uniform
+void chunk_compact_lighting_data(Chunk *c);
+/// Writes lighting of all blocks into an array of CHUNK_SIZE_CUBE values
+void chunk_write_lighting_data(const Chunk *c, VERTEX_LIGHT_STRUCT_T *out);
 
 bool chunk_add_block(Chunk *chunk,
                      const Block block,
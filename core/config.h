@@ -124,6 +124,12 @@ extern unsigned long upper_power_of_two(unsigned long v);
     64.0f // 1/4 of a large-sized map, or "10 frames" of max velocity (PHYSICS_MAX_VELOCITY * .016)
 /// When updating a leaf, stick to current node if volume expansion is below threshold
 #define RTREE_LEAF_UPDATE_THRESHOLD 25.0f
+/// Hash grid broadphase cell size, about the size of an avatar
+#define BROADPHASE_GRID_CELL_SIZE 16.0f
+/// Hash grid broadphase leaves overlapping more cells are kept aside, tested by every query
+#define BROADPHASE_GRID_MAX_LEAF_CELLS 64
+/// Scene queries results are kept on the stack up to this count, larger results are allocated
+#define PHYSICS_QUERY_STACK_RESULTS 64
 /// Maximum velocity magnitude in unit/sec for all objects
 #define PHYSICS_MAX_VELOCITY 400.0f
 #define PHYSICS_MAX_SQR_VELOCITY 160000.0f
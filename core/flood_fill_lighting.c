@@ -7,54 +7,61 @@
 #include "flood_fill_lighting.h"
 
 #include <stdlib.h>
+#include <string.h>
 
 #include "cclog.h"
-#include "chunk.h"
-#include "int3.h"
-
-struct _LightNode {
-    LightNode *next;
-    Chunk *chunk;
-    SHAPE_COORDS_INT3_T coords; /* 6 bytes */
-    char pad[2];
-};
+
+// must be a power of 2, capacity is doubled when full
+#define LIGHT_QUEUE_INITIAL_CAPACITY 64
 
 struct _LightNodeQueue {
-    LightNode *first;
+    LightNode *nodes;
+    uint32_t head;     // index of oldest node
+    uint32_t count;    // number of nodes in queue
+    uint32_t capacity; // power of 2
+    char pad[4];
 };
 
-LightNode *light_node_new(void) {
-    LightNode *ln = (LightNode *)malloc(sizeof(LightNode));
-    ln->next = NULL;
-    ln->chunk = NULL;
-    ln->coords = (SHAPE_COORDS_INT3_T){0, 0, 0};
-    return ln;
-}
-
-void light_node_free(LightNode *n) {
-    free(n);
-}
-
-void light_removal_node_free(LightRemovalNode *n) {
-    free(n);
-}
-
-SHAPE_COORDS_INT3_T light_node_get_coords(const LightNode *n) {
-    return n->coords;
-}
+struct _LightRemovalNodeQueue {
+    LightRemovalNode *nodes;
+    uint32_t head;
+    uint32_t count;
+    uint32_t capacity;
+    char pad[4];
+};
 
-Chunk *light_node_get_chunk(const LightNode *n) {
-    return n->chunk;
+/// Doubles ring buffer capacity (buffer allocated on first push), nodes that wrapped around are
+/// moved after previous end, so that they remain contiguous with the head
+static bool _light_queue_grow(void **nodes,
+                              const uint32_t head,
+                              const uint32_t count,
+                              uint32_t *capacity,
+                              const size_t nodeSize) {
+    const uint32_t newCapacity = *capacity == 0 ? LIGHT_QUEUE_INITIAL_CAPACITY : *capacity * 2;
+    char *newNodes = (char *)realloc(*nodes, newCapacity * nodeSize);
+    if (newNodes == NULL) {
+        return false;
+    }
+    if (head + count > *capacity) {
+        const uint32_t wrapped = head + count - *capacity;
+        memcpy(newNodes + *capacity * nodeSize, newNodes, wrapped * nodeSize);
+    }
+    *nodes = newNodes;
+    *capacity = newCapacity;
+    return true;
 }
 
-LightNodeQueue *light_node_recycle_pool(void) {
-    static LightNodeQueue p = {NULL};
-    return &p;
-}
+// MARK: - LightNodeQueue -
 
 LightNodeQueue *light_node_queue_new(void) {
     LightNodeQueue *q = (LightNodeQueue *)malloc(sizeof(LightNodeQueue));
-    q->first = NULL;
+    if (q == NULL) {
+        return NULL;
+    }
+    q->nodes = NULL;
+    q->head = 0;
+    q->count = 0;
+    q->capacity = 0;
     return q;
 }
 
@@ -62,133 +69,73 @@ void light_node_queue_free(LightNodeQueue *q) {
     if (q == NULL) {
         return;
     }
-    LightNode *n = NULL;
-    while (q->first != NULL) {
-        n = light_node_queue_pop(q);
-        if (n != NULL) {
-            light_node_queue_recycle(n);
-        }
-    }
+    free(q->nodes);
     free(q);
 }
 
-LightNode *light_node_queue_pop(LightNodeQueue *q) {
-    if (q->first == NULL)
-        return NULL;
-    LightNode *r = q->first;
-    q->first = r->next;
-    r->next = NULL;
-    return r;
+bool light_node_queue_pop(LightNodeQueue *q, LightNode *n) {
+    if (q->count == 0) {
+        return false;
+    }
+    *n = q->nodes[q->head];
+    q->head = (q->head + 1) & (q->capacity - 1);
+    q->count--;
+    return true;
 }
 
 void light_node_queue_push(LightNodeQueue *q, Chunk *chunk, const SHAPE_COORDS_INT3_T coords) {
-    // try to get new node from recycle pool first
-    LightNode *n = light_node_queue_pop(light_node_recycle_pool());
-
-    if (n == NULL) {
-        n = light_node_new();
-    }
-
-    if (n == NULL) {
+    if (q->count == q->capacity &&
+        _light_queue_grow((void **)&q->nodes, q->head, q->count, &q->capacity, sizeof(LightNode)) ==
+            false) {
         cclog_error("🔥 can't create light node");
         return;
     }
 
+    LightNode *n = &q->nodes[(q->head + q->count) & (q->capacity - 1)];
     n->chunk = chunk;
     n->coords = coords;
-    n->next = q->first;
-    q->first = n;
+    q->count++;
 }
 
-void light_node_queue_recycle(LightNode *n) {
-    LightNodeQueue *rp = light_node_recycle_pool();
-    n->next = rp->first;
-    rp->first = n;
+size_t light_node_queue_count(const LightNodeQueue *q) {
+    return q->count;
 }
 
-struct _LightRemovalNode {
-    LightRemovalNode *next;
-    Chunk *chunk;
-    SHAPE_COORDS_INT3_T coords;  /* 6 bytes */
-    VERTEX_LIGHT_STRUCT_T light; /* 2 bytes */
-    // 4 first bits used to flag in which channel [sunlight:R:G:B] removal should propagate
-    uint8_t srgb; /* 1 byte */
-    // this makes it possible to enqueue an emissive block as removal node
-    SHAPE_COLOR_INDEX_INT_T blockID; /* 1 byte */
-    char pad[6];
-};
+void light_node_queue_clear(LightNodeQueue *q) {
+    q->head = 0;
+    q->count = 0;
+}
 
-struct _LightRemovalNodeQueue {
-    LightRemovalNode *first;
-};
+// MARK: - LightRemovalNodeQueue -
 
-LightRemovalNode *light_removal_node_new(void) {
-    LightRemovalNode *ln = (LightRemovalNode *)malloc(sizeof(LightRemovalNode));
-    ln->next = NULL;
-    ln->chunk = NULL;
-    ln->coords = (SHAPE_COORDS_INT3_T){0, 0, 0};
-    ln->light.ambient = 0;
-    ln->light.red = 0;
-    ln->light.green = 0;
-    ln->light.blue = 0;
-    ln->srgb = 15;
-    ln->blockID = 255;
-    return ln;
+LightRemovalNodeQueue *light_removal_node_queue_new(void) {
+    LightRemovalNodeQueue *q = (LightRemovalNodeQueue *)malloc(sizeof(LightRemovalNodeQueue));
+    if (q == NULL) {
+        return NULL;
+    }
+    q->nodes = NULL;
+    q->head = 0;
+    q->count = 0;
+    q->capacity = 0;
+    return q;
 }
 
 void light_removal_node_queue_free(LightRemovalNodeQueue *q) {
     if (q == NULL) {
         return;
     }
-    LightRemovalNode *n = NULL;
-    while (q->first != NULL) {
-        n = light_removal_node_queue_pop(q);
-        if (n != NULL) {
-            light_removal_node_queue_recycle(n);
-        }
-    }
+    free(q->nodes);
     free(q);
 }
 
-SHAPE_COORDS_INT3_T light_removal_node_get_coords(const LightRemovalNode *n) {
-    return n->coords;
-}
-
-Chunk *light_removal_node_get_chunk(const LightRemovalNode *n) {
-    return n->chunk;
-}
-
-VERTEX_LIGHT_STRUCT_T light_removal_node_get_light(const LightRemovalNode *n) {
-    return n->light;
-}
-
-uint8_t light_removal_node_get_srgb(const LightRemovalNode *n) {
-    return n->srgb;
-}
-
-SHAPE_COLOR_INDEX_INT_T light_removal_node_get_block_id(const LightRemovalNode *n) {
-    return n->blockID;
-}
-
-LightRemovalNodeQueue *light_removal_node_recycle_pool(void) {
-    static LightRemovalNodeQueue p = {NULL};
-    return &p;
-}
-
-LightRemovalNodeQueue *light_removal_node_queue_new(void) {
-    LightRemovalNodeQueue *q = (LightRemovalNodeQueue *)malloc(sizeof(LightRemovalNodeQueue));
-    q->first = NULL;
-    return q;
-}
-
-LightRemovalNode *light_removal_node_queue_pop(LightRemovalNodeQueue *q) {
-    if (q->first == NULL) {
-        return NULL;
+bool light_removal_node_queue_pop(LightRemovalNodeQueue *q, LightRemovalNode *n) {
+    if (q->count == 0) {
+        return false;
     }
-    LightRemovalNode *r = q->first;
-    q->first = r->next;
-    r->next = NULL;
-    return r;
+    *n = q->nodes[q->head];
+    q->head = (q->head + 1) & (q->capacity - 1);
+    q->count--;
+    return true;
 }
 
 void light_removal_node_queue_push(LightRemovalNodeQueue *q,
@@ -197,34 +144,24 @@ void light_removal_node_queue_push(LightRemovalNodeQueue *q,
                                    VERTEX_LIGHT_STRUCT_T light,
                                    uint8_t srgb,
                                    SHAPE_COLOR_INDEX_INT_T blockID) {
-
-    // try to get new node from recycle pool first
-    LightRemovalNode *n = light_removal_node_queue_pop(light_removal_node_recycle_pool());
-
-    if (n == NULL) {
-        n = light_removal_node_new();
-    }
-
-    if (n == NULL) {
+    if (q->count == q->capacity && _light_queue_grow((void **)&q->nodes,
+                                                     q->head,
+                                                     q->count,
+                                                     &q->capacity,
+                                                     sizeof(LightRemovalNode)) == false) {
         cclog_error("🔥 can't create light node");
         return;
     }
 
+    LightRemovalNode *n = &q->nodes[(q->head + q->count) & (q->capacity - 1)];
     n->chunk = chunk;
     n->coords = coords;
-    n->light.ambient = light.ambient;
-    n->light.red = light.red;
-    n->light.green = light.green;
-    n->light.blue = light.blue;
+    n->light = light;
     n->srgb = srgb;
     n->blockID = blockID;
-
-    n->next = q->first;
-    q->first = n;
+    q->count++;
 }
 
-void light_removal_node_queue_recycle(LightRemovalNode *n) {
-    LightRemovalNodeQueue *rp = light_removal_node_recycle_pool();
-    n->next = rp->first;
-    rp->first = n;
+size_t light_removal_node_queue_count(const LightRemovalNodeQueue *q) {
+    return q->count;
 }
@@ -17,38 +17,50 @@ extern "C" {
 
 typedef struct _Chunk Chunk;
 
-typedef struct _LightNode LightNode;
-typedef struct _LightRemovalNode LightRemovalNode;
+// Light queues are growable ring buffers (FIFO) of light node records, push & pop don't
+// allocate once capacity is reached. Each queue is owned by the propagation call using it,
+// different queues can be used from different threads.
+
+typedef struct {
+    Chunk *chunk; // NULL for a virtual node outside of existing chunks
+    SHAPE_COORDS_INT3_T coords; /* 6 bytes */
+    char pad[2];
+} LightNode;
+
+typedef struct {
+    Chunk *chunk;
+    SHAPE_COORDS_INT3_T coords;  /* 6 bytes */
+    VERTEX_LIGHT_STRUCT_T light; /* 2 bytes */
+    // 4 first bits used to flag in which channel [sunlight:R:G:B] removal should propagate
+    uint8_t srgb; /* 1 byte */
+    // this makes it possible to enqueue an emissive block as removal node
+    SHAPE_COLOR_INDEX_INT_T blockID; /* 1 byte */
+    char pad[6];
+} LightRemovalNode;
+
 typedef struct _LightNodeQueue LightNodeQueue;
 typedef struct _LightRemovalNodeQueue LightRemovalNodeQueue;
 
-SHAPE_COORDS_INT3_T light_node_get_coords(const LightNode *n);
-Chunk *light_node_get_chunk(const LightNode *n);
-
 LightNodeQueue *light_node_queue_new(void);
-void light_node_free(LightNode *n);
-void light_removal_node_free(LightRemovalNode *n);
 void light_node_queue_free(LightNodeQueue *q);
-LightNode *light_node_queue_pop(LightNodeQueue *q);
+/// Copies oldest node into `n`, returns false if queue is empty
+bool light_node_queue_pop(LightNodeQueue *q, LightNode *n);
 void light_node_queue_push(LightNodeQueue *q, Chunk *chunk, const SHAPE_COORDS_INT3_T coords);
-void light_node_queue_recycle(LightNode *n);
-
-SHAPE_COORDS_INT3_T light_removal_node_get_coords(const LightRemovalNode *n);
-Chunk *light_removal_node_get_chunk(const LightRemovalNode *n);
-VERTEX_LIGHT_STRUCT_T light_removal_node_get_light(const LightRemovalNode *n);
-uint8_t light_removal_node_get_srgb(const LightRemovalNode *n);
-SHAPE_COLOR_INDEX_INT_T light_removal_node_get_block_id(const LightRemovalNode *n);
+size_t light_node_queue_count(const LightNodeQueue *q);
+/// Empties the queue, keeping its capacity
+void light_node_queue_clear(LightNodeQueue *q);
 
 LightRemovalNodeQueue *light_removal_node_queue_new(void);
 void light_removal_node_queue_free(LightRemovalNodeQueue *q);
-LightRemovalNode *light_removal_node_queue_pop(LightRemovalNodeQueue *q);
+/// Copies oldest node into `n`, returns false if queue is empty
+bool light_removal_node_queue_pop(LightRemovalNodeQueue *q, LightRemovalNode *n);
 void light_removal_node_queue_push(LightRemovalNodeQueue *q,
                                    Chunk *chunk,
                                    const SHAPE_COORDS_INT3_T coords,
                                    VERTEX_LIGHT_STRUCT_T light,
                                    uint8_t srgb,
                                    SHAPE_COLOR_INDEX_INT_T blockID);
-void light_removal_node_queue_recycle(LightRemovalNode *n);
+size_t light_removal_node_queue_count(const LightRemovalNodeQueue *q);
 
 #ifdef __cplusplus
 } // extern "C"
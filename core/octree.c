@@ -12,8 +12,15 @@
 #include <string.h>
 
 #include "cclog.h"
+#include "checksum.h"
 #include "config.h"
-#include "zlib.h"
+
+#if defined(__VX_PLATFORM_WINDOWS)
+#include <windows.h>
+typedef volatile LONG OctreeRefCount;
+#else
+typedef uint32_t OctreeRefCount;
+#endif
 
 // memory blocks are ordered this way:
 // 000, 001, 100, 101, 010, 011, 110, 111
@@ -43,8 +50,9 @@ struct _Octree {
     size_t width_height_depth;      // 4/8 bytes
     uint32_t nb_nodes;              // 4 bytes
     uint32_t nb_elements;           // 4 bytes
+    OctreeRefCount refCount;        // owners sharing this octree (atomic) // 4 bytes
     uint8_t levels;                 // 1 byte
-    char pad[7];
+    char pad[3];
 };
 
 ///
@@ -71,6 +79,16 @@ uint32_t nb_elements_for_levels(const size_t levels);
 size_t octree_element_index_1d(const Octree *octree, size_t x, size_t y, size_t z);
 void *_octree_set_element(const Octree *octree, const void *element, size_t x, size_t y, size_t z);
 static Octree *_octree_new(void);
+static uint8_t _octree_node_children_mask(const OctreeNode *node);
+static void _octree_foreach_in_range(const Octree *octree,
+                                     uint8_t level,
+                                     int node_index,
+                                     const uint16_t origin[3],
+                                     uint16_t size,
+                                     const uint16_t min[3],
+                                     const uint16_t max[3],
+                                     pointer_octree_range_func func,
+                                     void *ptr);
 
 Octree *octree_new_with_default_element(const OctreeLevelsForSize levels,
                                         const void *element,
@@ -143,8 +161,34 @@ void octree_flush(Octree *tree) {
     memset(tree->elements, 0, tree->nb_elements * tree->element_size);
 }
 
+Octree *octree_retain(Octree *octree) {
+#if defined(__VX_PLATFORM_WINDOWS)
+    InterlockedIncrement(&octree->refCount);
+#else
+    __atomic_add_fetch(&octree->refCount, 1, __ATOMIC_RELAXED);
+#endif
+    return octree;
+}
+
+bool octree_is_shared(const Octree *octree) {
+#if defined(__VX_PLATFORM_WINDOWS)
+    return InterlockedCompareExchange((OctreeRefCount *)&octree->refCount, 0, 0) > 1;
+#else
+    return __atomic_load_n(&octree->refCount, __ATOMIC_ACQUIRE) > 1;
+#endif
+}
+
 void octree_free(Octree *const tree) {
     if (tree != NULL) {
+#if defined(__VX_PLATFORM_WINDOWS)
+        if (InterlockedDecrement(&tree->refCount) > 0) {
+            return;
+        }
+#else
+        if (__atomic_sub_fetch(&tree->refCount, 1, __ATOMIC_ACQ_REL) > 0) {
+            return;
+        }
+#endif
         free(tree->nodes);
         tree->nodes = NULL;
         free(tree->elements);
@@ -456,6 +500,14 @@ bool octree_remove_element(const Octree *octree, size_t x, size_t y, size_t z, v
 
 // looks level per level to see if the element exists and returns it if it does, NULL otherwise.
 void *octree_get_element(const Octree *octree, const size_t x, const size_t y, const size_t z) {
+    return octree_get_element_or_empty_size(octree, x, y, z, NULL);
+}
+
+void *octree_get_element_or_empty_size(const Octree *octree,
+                                       const size_t x,
+                                       const size_t y,
+                                       const size_t z,
+                                       uint16_t *emptySize) {
 
     // check if element exists
     size_t _x = x;
@@ -478,13 +530,13 @@ void *octree_get_element(const Octree *octree, const size_t x, const size_t y, c
             if (_y >= half_size_at_level) {
                 if (_z >= half_size_at_level) {
                     if (node->n111 == 0) {
-                        return NULL;
+                        break; // empty child
                     }
                     index_in_branch = 6;
                     _z = _z ^ half_size_at_level; // diff
                 } else {
                     if (node->n110 == 0) {
-                        return NULL;
+                        break; // empty child
                     }
                     index_in_branch = 5;
                 }
@@ -492,13 +544,13 @@ void *octree_get_element(const Octree *octree, const size_t x, const size_t y, c
             } else {
                 if (_z >= half_size_at_level) {
                     if (node->n101 == 0) {
-                        return NULL;
+                        break; // empty child
                     }
                     index_in_branch = 2;
                     _z = _z ^ half_size_at_level; // diff
                 } else {
                     if (node->n100 == 0) {
-                        return NULL;
+                        break; // empty child
                     }
                     index_in_branch = 1;
                 }
@@ -508,13 +560,13 @@ void *octree_get_element(const Octree *octree, const size_t x, const size_t y, c
             if (_y >= half_size_at_level) {
                 if (_z >= half_size_at_level) {
                     if (node->n011 == 0) {
-                        return NULL;
+                        break; // empty child
                     }
                     index_in_branch = 7;
                     _z = _z ^ half_size_at_level; // diff
                 } else {
                     if (node->n010 == 0) {
-                        return NULL;
+                        break; // empty child
                     }
                     index_in_branch = 4;
                 }
@@ -522,14 +574,14 @@ void *octree_get_element(const Octree *octree, const size_t x, const size_t y, c
             } else {
                 if (_z >= half_size_at_level) {
                     if (node->n001 == 0) {
-                        return NULL;
+                        break; // empty child
                     }
                     index_in_branch = 3;
                     _z = _z ^ half_size_at_level; // diff
                 } else {
                     index_in_branch = 0;
                     if (node->n000 == 0) {
-                        return NULL;
+                        break; // empty child
                     }
                 }
             }
@@ -544,6 +596,13 @@ void *octree_get_element(const Octree *octree, const size_t x, const size_t y, c
         node = (OctreeNode *)(octree->nodes) + node_index;
     }
 
+    if (current_level < octree->levels) {
+        if (emptySize != NULL) {
+            *emptySize = half_size_at_level;
+        }
+        return NULL;
+    }
+
     return octree_get_element_without_checking(octree, x, y, z);
 }
 
@@ -831,6 +890,26 @@ void octree_non_recursive_iteration(const Octree *octree) {
     }
 }
 
+void octree_foreach_in_range(const Octree *octree,
+                             const uint16_t min[3],
+                             const uint16_t max[3],
+                             pointer_octree_range_func func,
+                             void *ptr) {
+    if (octree->levels == 0) {
+        return;
+    }
+    const uint16_t origin[3] = {0, 0, 0};
+    _octree_foreach_in_range(octree,
+                             0,
+                             0,
+                             origin,
+                             (uint16_t)octree->width_height_depth,
+                             min,
+                             max,
+                             func,
+                             ptr);
+}
+
 size_t octree_element_index_1d(const Octree *octree,
                                const size_t x,
                                const size_t y,
@@ -866,41 +945,21 @@ size_t octree_get_dimension(const Octree *octree) {
 }
 
 uint64_t octree_get_hash(const Octree *octree, uint64_t crc) {
-    return crc32((uLong)crc, octree->elements, (uInt)octree->elements_size_in_memory);
+    return checksum_crc32((uint32_t)crc, octree->elements, octree->elements_size_in_memory);
 }
 
 // MARK: Octree iterator
 
-struct _OctreeIterator {
-    const Octree *octree;
-    OctreeNode *current_nodes[11]; // there's only one node by level maximum at any time when
-                                   // exploring the tree
-    int node_index_in_level[11];   // index of node in its own level (global index minus start of
-                                   // level)
-    int branch_index[10]; // index of first child for node at given level (8 children for each node)
-
-    uint8_t child_index_processed[11]; // child index being processed for each level
-    char pad[1];
-
-    int current_level;          // level being processed
-    int current_level_plus_one; // level being processed
-
-    uint16_t current_node_x;
-    uint16_t current_node_y;
-    uint16_t current_node_z;
-    uint16_t current_node_size;
-
-    bool done;
-    bool foundLeaf;
-    char pad2[6];
-};
-
 OctreeIterator *octree_iterator_new(const Octree *octree) {
     OctreeIterator *oi = (OctreeIterator *)malloc(sizeof(OctreeIterator));
     if (oi == NULL) {
         return NULL;
     }
+    octree_iterator_init(oi, octree);
+    return oi;
+}
 
+void octree_iterator_init(OctreeIterator *oi, const Octree *octree) {
     oi->octree = octree;
 
     oi->current_level = 0;
@@ -920,8 +979,6 @@ OctreeIterator *octree_iterator_new(const Octree *octree) {
 
     oi->done = false;
     oi->foundLeaf = false;
-
-    return oi;
 }
 
 void octree_iterator_free(OctreeIterator *oi) {
@@ -1274,6 +1331,74 @@ static Octree *_octree_new(void) {
     o->width_height_depth = 0;
     o->nb_nodes = 0;
     o->nb_elements = 0;
+    o->refCount = 1;
     o->levels = 0;
     return o;
 }
+
+/// Children occupancy as a mask, bit i for child i in iterator order
+static uint8_t _octree_node_children_mask(const OctreeNode *node) {
+    return (uint8_t)(node->n000 | node->n100 << 1 | node->n101 << 2 | node->n001 << 3 |
+                     node->n010 << 4 | node->n110 << 5 | node->n111 << 6 | node->n011 << 7);
+}
+
+static void _octree_foreach_in_range(const Octree *octree,
+                                     uint8_t level,
+                                     int node_index,
+                                     const uint16_t origin[3],
+                                     uint16_t size,
+                                     const uint16_t min[3],
+                                     const uint16_t max[3],
+                                     pointer_octree_range_func func,
+                                     void *ptr) {
+
+    // children offsets, in iterator order
+    static const uint8_t offsets[8][3] = {{0, 0, 0},
+                                          {1, 0, 0},
+                                          {1, 0, 1},
+                                          {0, 0, 1},
+                                          {0, 1, 0},
+                                          {1, 1, 0},
+                                          {1, 1, 1},
+                                          {0, 1, 1}};
+
+    const uint8_t mask =
+        _octree_node_children_mask((const OctreeNode *)(octree->nodes) + node_index);
+    const uint16_t half_size = size >> 1;
+    uint16_t child[3];
+
+    for (int i = 0; i < 8; ++i) {
+        if ((mask & (1 << i)) == 0) {
+            continue;
+        }
+        bool inRange = true;
+        for (int a = 0; a < 3; ++a) {
+            child[a] = (uint16_t)(origin[a] + offsets[i][a] * half_size);
+            inRange = inRange && child[a] <= max[a] && child[a] + half_size > min[a];
+        }
+        if (inRange == false) {
+            continue;
+        }
+
+        if (level == octree->levels - 1) {
+            func((char *)octree->elements +
+                     octree->element_size *
+                         octree_element_index_1d(octree, child[0], child[1], child[2]),
+                 child[0],
+                 child[1],
+                 child[2],
+                 ptr);
+        } else {
+            _octree_foreach_in_range(octree,
+                                     (uint8_t)(level + 1),
+                                     startIndexForLevel[level + 1] +
+                                         8 * (node_index - startIndexForLevel[level]) + i,
+                                     child,
+                                     half_size,
+                                     min,
+                                     max,
+                                     func,
+                                     ptr);
+        }
+    }
+}
@@ -38,6 +38,10 @@ Octree *octree_new_with_default_element(const OctreeLevelsForSize levels,
                                         const void *element,
                                         const size_t elementSize);
 Octree *octree_new_copy(const Octree *octree);
+/// Adds an owner to the octree, released w/ octree_free (thread safe).
+/// Owners must not write a shared octree, but write to their own copy instead (copy-on-write).
+Octree *octree_retain(Octree *octree);
+bool octree_is_shared(const Octree *octree);
 void octree_free(Octree *const tree);
 void octree_flush(Octree *tree);
 
@@ -46,6 +50,14 @@ void octree_flush(Octree *tree);
 ///  octree_get_element_without_checking is always faster
 void *octree_get_element(const Octree *octree, const size_t x, const size_t y, const size_t z);
 
+/// Same as octree_get_element, also setting the size of the empty node containing given coordinates
+/// if there is no element, so that empty areas can be skipped
+void *octree_get_element_or_empty_size(const Octree *octree,
+                                       const size_t x,
+                                       const size_t y,
+                                       const size_t z,
+                                       uint16_t *emptySize);
+
 /// Always return the data at given coordinates (could be default value)
 void *octree_get_element_without_checking(const Octree *octree,
                                           const size_t x,
@@ -62,6 +74,21 @@ void octree_get_element_or_empty_value(const Octree *octree,
                                        void **element,
                                        void **empty);
 
+typedef void (*pointer_octree_range_func)(void *element,
+                                          uint16_t x,
+                                          uint16_t y,
+                                          uint16_t z,
+                                          void *ptr);
+
+/// Calls given function for each element within [min, max] coordinates (inclusive), in the same
+/// order as the iterator. Nodes bits are used as occupancy masks, empty nodes are skipped as a
+/// whole
+void octree_foreach_in_range(const Octree *octree,
+                             const uint16_t min[3],
+                             const uint16_t max[3],
+                             pointer_octree_range_func func,
+                             void *ptr);
+
 bool octree_set_element(const Octree *octree, const void *element, size_t x, size_t y, size_t z);
 
 bool octree_remove_element(const Octree *octree, size_t x, size_t y, size_t z, void *emptyElement);
@@ -82,8 +109,36 @@ uint64_t octree_get_hash(const Octree *octree, uint64_t crc);
 
 typedef struct _OctreeIterator OctreeIterator;
 
+// exposed so that an iterator can be used on the stack, see octree_iterator_init
+struct _OctreeIterator {
+    const Octree *octree;
+    OctreeNode *current_nodes[11]; // there's only one node by level maximum at any time when
+                                   // exploring the tree
+    int node_index_in_level[11];   // index of node in its own level (global index minus start of
+                                   // level)
+    int branch_index[10]; // index of first child for node at given level (8 children for each node)
+
+    uint8_t child_index_processed[11]; // child index being processed for each level
+    char pad[1];
+
+    int current_level;          // level being processed
+    int current_level_plus_one; // level being processed
+
+    uint16_t current_node_x;
+    uint16_t current_node_y;
+    uint16_t current_node_z;
+    uint16_t current_node_size;
+
+    bool done;
+    bool foundLeaf;
+    char pad2[6];
+};
+
 OctreeIterator *octree_iterator_new(const Octree *octree);
 
+/// Sets given iterator at the start of the octree, w/o allocation
+void octree_iterator_init(OctreeIterator *oi, const Octree *octree);
+
 void octree_iterator_free(OctreeIterator *oi);
 
 // useful to test collisions with node
@@ -454,3 +454,25 @@ Ray *ray_world_to_local(const Ray *ray, Transform *t) {
     float3_normalize(&dir);
     return ray_new(&origin, &dir);
 }
+
+void ray_init(Ray *ray, float3 *storage, const float3 *origin, const float3 *dir) {
+    ray->origin = &storage[0];
+    ray->dir = &storage[1];
+    ray->invdir = &storage[2];
+
+    *ray->origin = *origin;
+
+    // same as ray_new, direction vector may have been provided unnormalized
+    *ray->dir = *dir;
+    float3_normalize(ray->dir);
+
+    float3_set(ray->invdir, 1.0f / ray->dir->x, 1.0f / ray->dir->y, 1.0f / ray->dir->z);
+}
+
+void ray_init_world_to_local(Ray *local, float3 *storage, const Ray *ray, Transform *t) {
+    float3 origin, dir;
+    transform_utils_position_wtl(t, ray->origin, &origin);
+    transform_utils_vector_wtl(t, ray->dir, &dir);
+    float3_normalize(&dir);
+    ray_init(local, storage, &origin, &dir);
+}
@@ -48,6 +48,11 @@ FACE_INDEX_INT_T ray_impacted_block_face(const float3 *impact, const float3 *ldf
 
 Ray *ray_world_to_local(const Ray *ray, Transform *t);
 
+/// Sets a ray w/o allocation, eg. on the stack, pointing to given storage of 3 float3
+void ray_init(Ray *ray, float3 *storage, const float3 *origin, const float3 *dir);
+/// Same as ray_world_to_local, w/o allocation
+void ray_init_world_to_local(Ray *local, float3 *storage, const Ray *ray, Transform *t);
+
 #ifdef __cplusplus
 } // extern "C"
 #endif
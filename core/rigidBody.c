@@ -20,6 +20,8 @@
 #define SIMULATIONFLAG_END_CALLBACK_ENABLED 64
 #define SIMULATIONFLAG_COLLIDER_CUSTOM_SET 128
 
+#define RIGIDBODY_DEFERRED_INITIAL_CAPACITY 16
+
 #if DEBUG_RIGIDBODY
 static int debug_rigidbody_solver_iterations = 0;
 static int debug_rigidbody_replacements = 0;
@@ -47,6 +49,9 @@ struct _RigidBody {
     // last known valid position
     float3 *checkpoint;
 
+    // transform owning this rigidbody, its branch is flagged for the scene to refresh on changes
+    Transform *transform;
+
     // combined friction of 2 surfaces in contact represents how much force is absorbed,
     // it is a rate between 0 (full stop on contact) and 1 (full slide, no friction), or
     // below 0 (inverted movement) and above 1 (amplified movement)
@@ -81,6 +86,12 @@ struct _RigidBody {
 
 static pointer_rigidbody_collision_func rigidbody_collision_callback = NULL;
 
+static void _rigidbody_set_branch_dirty(RigidBody *rb) {
+    if (rb->transform != NULL) {
+        transform_set_branch_dirty(rb->transform);
+    }
+}
+
 void _rigidbody_set_simulation_flag(RigidBody *rb, uint8_t flag) {
     rb->simulationFlags |= flag;
 }
@@ -194,14 +205,75 @@ void _rigidbody_fire_reciprocal_callbacks(Scene *sc,
     }
 }
 
+static void _rigidbody_deferred_record(RigidbodyDeferred *d, const RigidbodyDeferredEvent *e) {
+    if (d->count == d->capacity) {
+        const size_t capacity = d->capacity > 0 ? d->capacity * 2
+                                                : RIGIDBODY_DEFERRED_INITIAL_CAPACITY;
+        RigidbodyDeferredEvent *events = (RigidbodyDeferredEvent *)
+            realloc(d->events, capacity * sizeof(RigidbodyDeferredEvent));
+        if (events == NULL) {
+            return;
+        }
+        d->events = events;
+        d->capacity = capacity;
+    }
+    d->events[d->count++] = *e;
+}
+
+static int _rigidbody_compare_address(const void *a, const void *b) {
+    const uintptr_t rb1 = (uintptr_t)(*(RigidBody *const *)a);
+    const uintptr_t rb2 = (uintptr_t)(*(RigidBody *const *)b);
+    return rb1 < rb2 ? -1 : (rb1 > rb2 ? 1 : 0);
+}
+
+/// Fires callbacks right away, or records them if tick is deferred
+static void _rigidbody_collision(Scene *sc,
+                                 RigidbodyDeferred *deferred,
+                                 RigidBody *selfRb,
+                                 Transform *selfTr,
+                                 RigidBody *otherRb,
+                                 Transform *otherTr,
+                                 float3 wNormal,
+                                 void *callbackData) {
+    if (deferred == NULL) {
+        _rigidbody_fire_reciprocal_callbacks(sc,
+                                             selfRb,
+                                             selfTr,
+                                             otherRb,
+                                             otherTr,
+                                             wNormal,
+                                             callbackData);
+    } else if (rigidbody_collision_callback != NULL &&
+               (rigidbody_has_callbacks(selfRb) || rigidbody_has_callbacks(otherRb))) {
+        const RigidbodyDeferredEvent e = {selfRb, selfTr, otherRb, otherTr, wNormal, {0}};
+        _rigidbody_deferred_record(deferred, &e);
+    }
+}
+
+/// Pushes right away, or records the push if tick is deferred & pushed rigidbody isn't pushable
+static void _rigidbody_push(RigidbodyDeferred *deferred, RigidBody *rb, const float3 *value) {
+    if (deferred == NULL || bsearch(&rb,
+                                    deferred->pushable,
+                                    deferred->pushableCount,
+                                    sizeof(RigidBody *),
+                                    _rigidbody_compare_address) != NULL) {
+        rigidbody_apply_push(rb, value);
+    } else {
+        const RigidbodyDeferredEvent e = {rb, NULL, NULL, NULL, *value, {0}};
+        _rigidbody_deferred_record(deferred, &e);
+    }
+}
+
+/// @param deferred if not NULL, final position is written in pos instead of being set, w/ pos
+/// holding current position, see rigidbody_tick_deferred
 bool _rigidbody_dynamic_tick(Scene *scene,
                              RigidBody *rb,
                              Transform *t,
                              Box *worldCollider,
-                             Rtree *r,
                              const TICK_DELTA_SEC_T dt,
-                             FifoList *sceneQuery,
-                             void *callbackData) {
+                             void *callbackData,
+                             RigidbodyDeferred *deferred,
+                             float3 *deferredPos) {
 
 #if DEBUG_RIGIDBODY_CALLS
 #define INC_REPLACEMENTS debug_rigidbody_replacements++;
@@ -301,10 +373,11 @@ bool _rigidbody_dynamic_tick(Scene *scene,
 
     float3 dv, normal, push3, modelDv, modelEpsilon, rtreeNormal;
     float minSwept, swept, rtreeSwept;
-    float3 pos = *transform_get_position(t);
+    float3 pos = deferred != NULL ? *deferredPos : *transform_get_position(t);
     const bool selfCallbacks = rigidbody_has_callbacks(rb);
     Box broadphase, modelBox, modelBroadphase;
     Shape *shape;
+    RtreeNode *stackHits[PHYSICS_QUERY_STACK_RESULTS], **hits;
 
     typedef struct {
         Transform *t;
@@ -344,27 +417,26 @@ bool _rigidbody_dynamic_tick(Scene *scene,
         // static scene. It isn't going to be accurate in case of concurring trajectories. We can
         // add a full broadphase if we see it's necessary
 
-        // previous query should be processed entirely
-        vx_assert(fifo_list_pop(sceneQuery) == NULL);
-
-        // run collision query in r-tree w/ default inner epsilon
-        if (rtree_query_overlap_box(r,
-                                    &broadphase,
-                                    rb->groups,
-                                    rb->collidesWith,
-                                    NULL,
-                                    sceneQuery,
-                                    -EPSILON_COLLISION) > 0) {
-            RtreeNode *hit = fifo_list_pop(sceneQuery);
+        // run collision query in scene w/ default inner epsilon
+        const size_t hitsCount = scene_query_overlap_box_buffer(scene,
+                                                                &broadphase,
+                                                                rb->groups,
+                                                                rb->collidesWith,
+                                                                NULL,
+                                                                stackHits,
+                                                                &hits,
+                                                                -EPSILON_COLLISION);
+        if (hitsCount > 0) {
+            RtreeNode *hit;
             Transform *hitLeaf;
             RigidBody *hitRb;
-            while (hit != NULL) {
+            for (size_t i = 0; i < hitsCount; ++i) {
+                hit = hits[i];
                 hitLeaf = (Transform *)rtree_node_get_leaf_ptr(hit);
                 vx_assert(rtree_node_is_leaf(hit));
 
                 // self isn't removed from r-tree before query
                 if (hitLeaf == t) {
-                    hit = fifo_list_pop(sceneQuery);
                     continue;
                 }
 
@@ -372,13 +444,11 @@ bool _rigidbody_dynamic_tick(Scene *scene,
                 vx_assert(hitRb != NULL);
 
                 if (rigidbody_collides_with_rigidbody(rb, hitRb) == false) {
-                    hit = fifo_list_pop(sceneQuery);
                     continue;
                 }
 
                 const RigidbodyMode mode = rigidbody_get_simulation_mode(hitRb);
                 if (mode == RigidbodyMode_Disabled) {
-                    hit = fifo_list_pop(sceneQuery);
                     continue;
                 }
 
@@ -387,7 +457,6 @@ bool _rigidbody_dynamic_tick(Scene *scene,
 
                 if (isTrigger && selfCallbacks == false &&
                     rigidbody_has_callbacks(hitRb) == false) {
-                    hit = fifo_list_pop(sceneQuery);
                     continue;
                 }
 
@@ -471,13 +540,14 @@ bool _rigidbody_dynamic_tick(Scene *scene,
                             wNormal = normal;
                         }
 
-                        _rigidbody_fire_reciprocal_callbacks(scene,
-                                                             rb,
-                                                             t,
-                                                             hitRb,
-                                                             hitLeaf,
-                                                             wNormal,
-                                                             callbackData);
+                        _rigidbody_collision(scene,
+                                             deferred,
+                                             rb,
+                                             t,
+                                             hitRb,
+                                             hitLeaf,
+                                             wNormal,
+                                             callbackData);
                     } else {
                         contact.t = hitLeaf;
                         contact.rb = hitRb;
@@ -486,10 +556,11 @@ bool _rigidbody_dynamic_tick(Scene *scene,
                         minSwept = swept;
                     }
                 }
-
-                hit = fifo_list_pop(sceneQuery);
             }
         }
+        if (hits != stackHits) {
+            free(hits);
+        }
 
         // ----------------------
         // STOP MOTION THRESHOLD
@@ -649,7 +720,7 @@ bool _rigidbody_dynamic_tick(Scene *scene,
                 push3.y *= push / dt_f;
                 push3.z *= push / dt_f;
 
-                rigidbody_apply_push(contact.rb, &push3);
+                _rigidbody_push(deferred, contact.rb, &push3);
 
                 // self is flagged as awake, since contact will move from push
                 rigidbody_set_awake(rb);
@@ -707,13 +778,14 @@ bool _rigidbody_dynamic_tick(Scene *scene,
             }
 
             // (5) fire reciprocal callbacks
-            _rigidbody_fire_reciprocal_callbacks(scene,
-                                                 rb,
-                                                 t,
-                                                 contact.rb,
-                                                 contact.t,
-                                                 wNormal,
-                                                 callbackData);
+            _rigidbody_collision(scene,
+                                 deferred,
+                                 rb,
+                                 t,
+                                 contact.rb,
+                                 contact.t,
+                                 wNormal,
+                                 callbackData);
 
             INC_COLLISIONS
         }
@@ -740,9 +812,14 @@ bool _rigidbody_dynamic_tick(Scene *scene,
     debug_rigidbody_solver_iterations += (int)solverCount;
 #endif
 
-    if (solverCount > 0 && float3_isEqual(&pos, transform_get_position(t), EPSILON_ZERO) == false) {
+    const float3 *current = deferred != NULL ? deferredPos : transform_get_position(t);
+    if (solverCount > 0 && float3_isEqual(&pos, current, EPSILON_ZERO) == false) {
         // apply final position to transform
-        transform_set_position(t, pos.x, pos.y, pos.z);
+        if (deferred != NULL) {
+            *deferredPos = pos;
+        } else {
+            transform_set_position(t, pos.x, pos.y, pos.z);
+        }
 
         if (rb->checkpoint == NULL) {
             rb->checkpoint = float3_new_copy(&pos);
@@ -760,27 +837,25 @@ void _rigidbody_trigger_tick(Scene *scene,
                              RigidBody *rb,
                              Transform *t,
                              Box *worldCollider,
-                             Rtree *r,
-                             FifoList *sceneQuery,
                              void *callbackData) {
 
     // ----------------------
     // SCENE OVERLAP
     // ----------------------
 
-    // previous query should be processed entirely
-    vx_assert(fifo_list_pop(sceneQuery) == NULL);
-
-    // run overlap query in r-tree
+    // run overlap query in scene
     // Note: w/ an outer epsilon to let trigger rigidbody callbacks be called before a potential
     // collision response from a dynamic rigidbody
-    if (rtree_query_overlap_box(r,
-                                worldCollider,
-                                rb->groups,
-                                rb->collidesWith,
-                                NULL,
-                                sceneQuery,
-                                EPSILON_COLLISION) > 0) {
+    RtreeNode *stackHits[PHYSICS_QUERY_STACK_RESULTS], **hits;
+    const size_t hitsCount = scene_query_overlap_box_buffer(scene,
+                                                            worldCollider,
+                                                            rb->groups,
+                                                            rb->collidesWith,
+                                                            NULL,
+                                                            stackHits,
+                                                            &hits,
+                                                            EPSILON_COLLISION);
+    if (hitsCount > 0) {
 
         const Shape *s = transform_utils_get_shape(t);
         const bool selfPerBlock = s != NULL && rigidbody_uses_per_block_collisions(rb);
@@ -791,17 +866,17 @@ void _rigidbody_trigger_tick(Scene *scene,
         const Matrix4x4 *selfModel = transform_get_ltw(selfModelTr);
         const Matrix4x4 *selfInvModel = transform_get_wtl(selfModelTr);
 
-        RtreeNode *hit = fifo_list_pop(sceneQuery);
+        RtreeNode *hit;
         Transform *hitLeaf;
         RigidBody *hitRb;
         Box box;
-        while (hit != NULL) {
+        for (size_t i = 0; i < hitsCount; ++i) {
+            hit = hits[i];
             hitLeaf = (Transform *)rtree_node_get_leaf_ptr(hit);
             vx_assert(rtree_node_is_leaf(hit));
 
             // self isn't removed from r-tree before query
             if (hitLeaf == t) {
-                hit = fifo_list_pop(sceneQuery);
                 continue;
             }
 
@@ -809,7 +884,6 @@ void _rigidbody_trigger_tick(Scene *scene,
             vx_assert(hitRb != NULL);
 
             if (rigidbody_collides_with_rigidbody(rb, hitRb) == false) {
-                hit = fifo_list_pop(sceneQuery);
                 continue;
             }
 
@@ -884,10 +958,11 @@ void _rigidbody_trigger_tick(Scene *scene,
                                                      wNormal,
                                                      callbackData);
             }
-
-            hit = fifo_list_pop(sceneQuery);
         }
     }
+    if (hits != stackHits) {
+        free(hits);
+    }
 }
 
 RigidBody *rigidbody_new(const uint8_t mode, const uint16_t groups, const uint16_t collidesWith) {
@@ -902,6 +977,7 @@ RigidBody *rigidbody_new(const uint8_t mode, const uint16_t groups, const uint16
     rb->velocity = float3_new_zero();
     rb->constantAcceleration = float3_new_zero();
     rb->checkpoint = NULL;
+    rb->transform = NULL;
     rb->mass = PHYSICS_MASS_DEFAULT;
     rb->contact = AxesMaskNone;
     rb->groups = groups;
@@ -943,6 +1019,7 @@ RigidBody *rigidbody_new_copy(const RigidBody *other) {
     rb->velocity = float3_new_zero();
     rb->constantAcceleration = float3_new_copy(other->constantAcceleration);
     rb->checkpoint = other->checkpoint != NULL ? float3_new_copy(other->checkpoint) : NULL;
+    rb->transform = NULL;
     rb->mass = other->mass;
     rb->contact = AxesMaskNone;
     rb->groups = other->groups;
@@ -1013,7 +1090,6 @@ bool rigidbody_tick(Scene *scene,
                     RigidBody *rb,
                     Transform *t,
                     Box *worldCollider,
-                    Rtree *r,
                     const TICK_DELTA_SEC_T dt,
                     void *callbackData) {
 
@@ -1021,11 +1097,6 @@ bool rigidbody_tick(Scene *scene,
         return false;
     }
 
-    static FifoList *sceneQuery = NULL;
-    if (sceneQuery == NULL) {
-        sceneQuery = fifo_list_new();
-    }
-
     // dynamic rigidbodies are fully simulated, their callbacks are evaluated in this loop
     // vs. other dynamic rigidbodies only
     if (rigidbody_is_dynamic(rb)) {
@@ -1033,19 +1104,51 @@ bool rigidbody_tick(Scene *scene,
                                        rb,
                                        t,
                                        worldCollider,
-                                       r,
                                        dt,
-                                       sceneQuery,
-                                       callbackData);
+                                       callbackData,
+                                       NULL,
+                                       NULL);
     }
     // check for overlaps to fire callbacks for trigger and static rigidbodies
     else if (rigidbody_is_active_trigger(rb)) {
-        _rigidbody_trigger_tick(scene, rb, t, worldCollider, r, sceneQuery, callbackData);
+        _rigidbody_trigger_tick(scene, rb, t, worldCollider, callbackData);
     }
 
     return false;
 }
 
+bool rigidbody_tick_deferred(Scene *scene,
+                             RigidBody *rb,
+                             Transform *t,
+                             Box *worldCollider,
+                             const TICK_DELTA_SEC_T dt,
+                             RigidbodyDeferred *deferred,
+                             float3 *pos) {
+
+    if (dt <= 0.0 || rigidbody_is_dynamic(rb) == false) {
+        return false;
+    }
+    return _rigidbody_dynamic_tick(scene, rb, t, worldCollider, dt, NULL, deferred, pos);
+}
+
+void rigidbody_deferred_apply(Scene *scene, RigidbodyDeferred *deferred, void *callbackData) {
+    for (size_t i = 0; i < deferred->count; ++i) {
+        const RigidbodyDeferredEvent *e = &deferred->events[i];
+        if (e->otherTr == NULL) {
+            rigidbody_apply_push(e->rb, &e->value);
+        } else {
+            _rigidbody_fire_reciprocal_callbacks(scene,
+                                                 e->rb,
+                                                 e->t,
+                                                 e->otherRb,
+                                                 e->otherTr,
+                                                 e->value,
+                                                 callbackData);
+        }
+    }
+    deferred->count = 0;
+}
+
 // MARK: - Accessors -
 
 const Box *rigidbody_get_collider(const RigidBody *rb) {
@@ -1054,6 +1157,7 @@ const Box *rigidbody_get_collider(const RigidBody *rb) {
 
 void rigidbody_set_collider(RigidBody *rb, const Box *value, const bool custom) {
     box_copy(rb->collider, value);
+    _rigidbody_set_branch_dirty(rb);
     if (_rigidbody_get_simulation_flag_value(rb, SIMULATIONFLAG_MODE) != RigidbodyMode_Disabled) {
         _rigidbody_set_simulation_flag(rb, SIMULATIONFLAG_COLLIDER_DIRTY);
     }
@@ -1070,6 +1174,15 @@ void rigidbody_set_rtree_leaf(RigidBody *rb, RtreeNode *leaf) {
     rb->rtreeLeaf = leaf;
 }
 
+Transform *rigidbody_get_transform(const RigidBody *rb) {
+    return rb->transform;
+}
+
+void rigidbody_set_transform(RigidBody *rb, Transform *t) {
+    rb->transform = t;
+    _rigidbody_set_branch_dirty(rb);
+}
+
 const float3 *rigidbody_get_motion(const RigidBody *rb) {
     return rb->motion;
 }
@@ -1128,6 +1241,7 @@ uint16_t rigidbody_get_groups(const RigidBody *rb) {
 
 void rigidbody_set_groups(RigidBody *rb, uint16_t value) {
     rb->groups = value;
+    _rigidbody_set_branch_dirty(rb);
 }
 
 uint16_t rigidbody_get_collides_with(const RigidBody *rb) {
@@ -1136,6 +1250,7 @@ uint16_t rigidbody_get_collides_with(const RigidBody *rb) {
 
 void rigidbody_set_collides_with(RigidBody *rb, uint16_t value) {
     rb->collidesWith = value;
+    _rigidbody_set_branch_dirty(rb);
 }
 
 uint8_t rigidbody_get_simulation_mode(const RigidBody *rb) {
@@ -1147,6 +1262,7 @@ void rigidbody_set_simulation_mode(RigidBody *rb, const uint8_t value) {
     const uint8_t mode = _rigidbody_get_simulation_flag_value(rb, SIMULATIONFLAG_MODE);
     if (mode != value) {
         _rigidbody_set_simulation_flag_value(rb, SIMULATIONFLAG_MODE, value);
+        _rigidbody_set_branch_dirty(rb);
 #if TRANSFORM_AABOX_STATIC_COLLIDER_MODE != TRANSFORM_AABOX_DYNAMIC_COLLIDER_MODE
         if (value != RigidbodyMode_Disabled) {
             _rigidbody_set_simulation_flag(rb, SIMULATIONFLAG_COLLIDER_DIRTY);
@@ -1326,6 +1442,7 @@ void rigidbody_toggle_groups(RigidBody *rb, uint16_t groups, bool toggle) {
     } else {
         rb->groups = rb->groups & ~groups;
     }
+    _rigidbody_set_branch_dirty(rb);
 }
 
 void rigidbody_toggle_collides_with(RigidBody *rb, uint16_t groups, bool toggle) {
@@ -1334,6 +1451,7 @@ void rigidbody_toggle_collides_with(RigidBody *rb, uint16_t groups, bool toggle)
     } else {
         rb->collidesWith = rb->collidesWith & ~groups;
     }
+    _rigidbody_set_branch_dirty(rb);
 }
 
 bool rigidbody_collision_mask_match(const uint16_t m1, const uint16_t m2) {
@@ -1455,6 +1573,8 @@ void rigidbody_fire_reciprocal_collision_end_callback(Transform *self,
 }
 
 void rigidbody_toggle_collision_callback(RigidBody *rb, CollisionCallbackType type, bool value) {
+    // may become an active trigger
+    _rigidbody_set_branch_dirty(rb);
     switch (type) {
         case CollisionCallbackType_Begin:
             if (value) {
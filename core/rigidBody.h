@@ -87,15 +87,58 @@ bool rigidbody_tick(Scene *scene,
                     RigidBody *rb,
                     Transform *t,
                     Box *worldCollider,
-                    Rtree *r,
                     const TICK_DELTA_SEC_T dt,
                     void *callbackData);
 
+/// MARK: - Deferred tick -
+/// Dynamic rigidbodies that can't touch each other during a tick may be ticked concurrently, w/o
+/// modifying the scene, their transforms or other rigidbodies. What is left is recorded, to be
+/// applied once all rigidbodies are solved
+
+typedef struct {
+    RigidBody *rb;
+    Transform *t;
+    RigidBody *otherRb;
+    Transform *otherTr;
+    // collision world normal, or push applied to rb if otherTr is NULL
+    float3 value;
+
+    char pad[4];
+} RigidbodyDeferredEvent;
+
+typedef struct {
+    /// rigidbodies that may be pushed right away, sorted by address, other pushes are recorded
+    RigidBody **pushable;
+    size_t pushableCount;
+    /// collision callbacks & pushes in order of occurrence, to be freed w/ free()
+    RigidbodyDeferredEvent *events;
+    size_t count;
+    size_t capacity;
+} RigidbodyDeferred;
+
+/// Same as rigidbody_tick for a dynamic rigidbody, its final position is given back instead of
+/// being set, and its callbacks & pushes to other rigidbodies are recorded
+/// @param pos current position of the transform, set to the final position
+/// @returns true if the rigidbody moved
+bool rigidbody_tick_deferred(Scene *scene,
+                             RigidBody *rb,
+                             Transform *t,
+                             Box *worldCollider,
+                             const TICK_DELTA_SEC_T dt,
+                             RigidbodyDeferred *deferred,
+                             float3 *pos);
+/// Applies recorded pushes & fires recorded collision callbacks in order, then clears them
+void rigidbody_deferred_apply(Scene *scene, RigidbodyDeferred *deferred, void *callbackData);
+
 /// MARK: - Accessors -
 const Box *rigidbody_get_collider(const RigidBody *rb);
 void rigidbody_set_collider(RigidBody *rb, const Box *value, const bool custom);
 RtreeNode *rigidbody_get_rtree_leaf(const RigidBody *rb);
 void rigidbody_set_rtree_leaf(RigidBody *rb, RtreeNode *leaf);
+Transform *rigidbody_get_transform(const RigidBody *rb);
+/// Set by transform_ensure_rigidbody, changes of simulation mode, collider, collision masks or
+/// callbacks then flag the transform branch, see transform_set_branch_dirty
+void rigidbody_set_transform(RigidBody *rb, Transform *t);
 const float3 *rigidbody_get_motion(const RigidBody *rb);
 void rigidbody_set_motion(RigidBody *rb, const float3 *value);
 const float3 *rigidbody_get_velocity(const RigidBody *rb);
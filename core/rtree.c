@@ -7,7 +7,10 @@
 #include "rtree.h"
 
 #include <float.h>
+#include <math.h>
+#include <string.h>
 
+#include "box_lanes.h"
 #include "cclog.h"
 #include "config.h"
 #include "shape.h"
@@ -21,10 +24,33 @@ static int debug_rtree_condense_calls = 0;
 static int debug_rtree_update_calls = 0;
 #endif
 
+// one extra slot for a node overflowing before it is split
+#define RTREE_NODE_SLOTS (RTREE_NODE_MAX_CAPACITY + 1)
+// nodes are allocated in pages of growing size, up to this many nodes
+#define RTREE_NODE_PAGE_MAX_SIZE 1024
+#define RTREE_NODE_PAGE_MIN_SIZE 8
+// queries examine nodes breadth-first w/ a queue on the stack, moved to the heap if it overflows
+#define RTREE_QUERY_STACK_SIZE 256
+
+#if RTREE_NODE_SLOTS > BOX_LANES_COUNT
+#error "r-tree node children boxes must fit in BoxLanes"
+#endif
+
+typedef struct _RtreeNodePage {
+    struct _RtreeNodePage *next;
+    RtreeNode *nodes;
+    uint32_t size;
+    uint32_t used;
+} RtreeNodePage;
+
 /// Ref: https://books.google.fr/books?id=1mu099DN9UwC&pg=PR5&redir_esc=y#v=onepage&q&f=false
 struct _Rtree {
     // root node may change dynamically as the tree is updated
     RtreeNode *root;
+    // nodes storage, most recent page first, nodes never move until the tree is freed
+    RtreeNodePage *pages;
+    // nodes available for reuse, chained through their parent pointer
+    RtreeNode *freeNodes;
     // height of the R-tree, it is dynamic
     uint16_t h;
     // minimum number of entries per node, under which a node has to be deleted
@@ -38,70 +64,143 @@ struct _Rtree {
 struct _RtreeNode {
     // parent is null for the root node
     RtreeNode *parent;
-    // children is empty for a leaf node
-    DoublyLinkedList *children;
-    // axis-aligned bounding box for this node
-    Box *aabb;
     // a leaf node carries a pointer to the corresponding object
     void *leaf;
+    // children, first count entries are used, none for a leaf node
+    RtreeNode *children[RTREE_NODE_SLOTS];
+    // copy of each child aabb, to test them all at once
+    BoxLanes childrenBoxes;
+    // axis-aligned bounding box for this node, unset for a root w/o children
+    Box aabb;
     // collision masks may be used to filter out queries,
     uint16_t groups;       // standalone queries may filter w/ groups only (cast functions)
     uint16_t collidesWith; // reciprocal queries may use both masks (collision checks)
     // children count
     uint8_t count;
-    // non-leaf node layers need to be refreshed
+    // index of this node in its parent children
+    uint8_t slot;
+    // non-leaf node layers need to be refreshed, set along ancestors
     bool layersDirty;
 
-    char pad[2];
+    char pad[1];
 };
 
+/// Nodes pending examination in a query, in the order they were found
+typedef struct {
+    RtreeNode **nodes; // points to stack until it overflows
+    size_t head;
+    size_t tail;
+    size_t capacity;
+    RtreeNode *stack[RTREE_QUERY_STACK_SIZE];
+} _RtreeQueryQueue;
+
 // MARK: - Private functions prototypes -
 
 void _rtree_node_assign(RtreeNode *parent, RtreeNode *child, bool merge);
-void _rtree_node_free(RtreeNode *rn);
+void _rtree_node_free(Rtree *r, RtreeNode *rn);
+static void _rtree_node_set_layers_dirty(RtreeNode *rn);
 
 // MARK: - Private functions -
 
-RtreeNode *_rtree_node_new_root(Rtree *r) {
-    RtreeNode *rn = (RtreeNode *)malloc(sizeof(RtreeNode));
-    if (rn == NULL) {
-        return NULL;
+RtreeNode *_rtree_node_alloc(Rtree *r) {
+    RtreeNode *rn = r->freeNodes;
+    if (rn != NULL) {
+        r->freeNodes = rn->parent;
+        return rn;
+    }
+
+    RtreeNodePage *page = r->pages;
+    if (page == NULL || page->used == page->size) {
+        const uint32_t size = page == NULL ? RTREE_NODE_PAGE_MIN_SIZE
+                                           : minimum(page->size * 2, RTREE_NODE_PAGE_MAX_SIZE);
+        page = (RtreeNodePage *)malloc(sizeof(RtreeNodePage));
+        if (page == NULL) {
+            return NULL;
+        }
+        page->nodes = (RtreeNode *)malloc(size * sizeof(RtreeNode));
+        if (page->nodes == NULL) {
+            free(page);
+            return NULL;
+        }
+        page->size = size;
+        page->used = 0;
+        page->next = r->pages;
+        r->pages = page;
     }
-    rn->parent = NULL;
-    rn->children = doubly_linked_list_new();
-    rn->aabb = NULL;
-    rn->leaf = NULL;
+    return &page->nodes[page->used++];
+}
+
+RtreeNode *_rtree_node_init(RtreeNode *rn, RtreeNode *parent, void *ptr) {
+    rn->parent = parent;
+    rn->leaf = ptr;
     rn->count = 0;
+    rn->slot = 0;
     rn->groups = PHYSICS_GROUP_ALL_SYSTEM;
     rn->collidesWith = PHYSICS_GROUP_ALL_SYSTEM;
     rn->layersDirty = false;
+    if (ptr == NULL) {
+        // unused lanes are masked out of tests, but are still loaded
+        box_lanes_reset(&rn->childrenBoxes);
+    }
+    return rn;
+}
 
-    if (r->root != NULL) {
-        rtree_recurse(r->root, _rtree_node_free);
+/// Copies node aabb in its parent children boxes
+void _rtree_node_sync_slot(RtreeNode *rn) {
+    RtreeNode *parent = rn->parent;
+    if (parent != NULL) {
+        BoxLanes *boxes = &parent->childrenBoxes;
+        boxes->minX[rn->slot] = rn->aabb.min.x;
+        boxes->minY[rn->slot] = rn->aabb.min.y;
+        boxes->minZ[rn->slot] = rn->aabb.min.z;
+        boxes->maxX[rn->slot] = rn->aabb.max.x;
+        boxes->maxY[rn->slot] = rn->aabb.max.y;
+        boxes->maxZ[rn->slot] = rn->aabb.max.z;
     }
+}
+
+/// Moves a child within its parent children array
+void _rtree_node_move_child(RtreeNode *parent, uint8_t from, uint8_t to) {
+    RtreeNode *child = parent->children[from];
+    BoxLanes *boxes = &parent->childrenBoxes;
+    parent->children[to] = child;
+    child->slot = to;
+    boxes->minX[to] = boxes->minX[from];
+    boxes->minY[to] = boxes->minY[from];
+    boxes->minZ[to] = boxes->minZ[from];
+    boxes->maxX[to] = boxes->maxX[from];
+    boxes->maxY[to] = boxes->maxY[from];
+    boxes->maxZ[to] = boxes->maxZ[from];
+}
+
+RtreeNode *_rtree_node_new_root(Rtree *r) {
+    RtreeNode *rn = _rtree_node_alloc(r);
+    if (rn == NULL) {
+        return NULL;
+    }
+    _rtree_node_init(rn, NULL, NULL);
+
+    // previous root, if any, is freed by the caller
     r->root = rn;
     r->h++;
 
     return rn;
 }
 
-RtreeNode *_rtree_node_new_leaf(RtreeNode *parent,
+RtreeNode *_rtree_node_new_leaf(Rtree *r,
+                                RtreeNode *parent,
                                 Box *aabb,
                                 uint16_t groups,
                                 uint16_t collidesWith,
                                 void *ptr) {
-    RtreeNode *rn = (RtreeNode *)malloc(sizeof(RtreeNode));
+    RtreeNode *rn = _rtree_node_alloc(r);
     if (rn == NULL) {
         return NULL;
     }
-    rn->parent = parent;
-    rn->children = doubly_linked_list_new();
-    rn->aabb = box_new_copy(aabb);
-    rn->leaf = ptr;
-    rn->count = 0;
+    _rtree_node_init(rn, parent, ptr);
+    rn->aabb = *aabb;
     rn->groups = groups;
     rn->collidesWith = collidesWith;
-    rn->layersDirty = false;
 
     if (parent != NULL) {
         _rtree_node_assign(parent, rn, true);
@@ -110,19 +209,13 @@ RtreeNode *_rtree_node_new_leaf(RtreeNode *parent,
     return rn;
 }
 
-RtreeNode *_rtree_node_new_branch(RtreeNode *parent, RtreeNode *child) {
-    RtreeNode *rn = (RtreeNode *)malloc(sizeof(RtreeNode));
+RtreeNode *_rtree_node_new_branch(Rtree *r, RtreeNode *parent, RtreeNode *child) {
+    RtreeNode *rn = _rtree_node_alloc(r);
     if (rn == NULL) {
         return NULL;
     }
-    rn->parent = parent;
-    rn->children = doubly_linked_list_new();
-    rn->aabb = NULL;
-    rn->leaf = NULL;
-    rn->count = 0;
-    rn->groups = PHYSICS_GROUP_ALL_SYSTEM;
-    rn->collidesWith = PHYSICS_GROUP_ALL_SYSTEM;
-    rn->layersDirty = false;
+    // parent is set on assign, not before: syncing aabb would otherwise write a foreign slot
+    _rtree_node_init(rn, NULL, NULL);
 
     if (child != NULL) {
         _rtree_node_assign(rn, child, true);
@@ -134,12 +227,9 @@ RtreeNode *_rtree_node_new_branch(RtreeNode *parent, RtreeNode *child) {
     return rn;
 }
 
-void _rtree_node_free(RtreeNode *rn) {
-    doubly_linked_list_free(rn->children);
-    if (rn->aabb != NULL) {
-        box_free(rn->aabb);
-    }
-    free(rn);
+void _rtree_node_free(Rtree *r, RtreeNode *rn) {
+    rn->parent = r->freeNodes;
+    r->freeNodes = rn;
 }
 
 /// @returns added volume to src box if it would merge w/ insert box
@@ -158,89 +248,86 @@ float _rtree_box_merge_dead_space(const Box *b1, const Box *b2, Box *result) {
 void _rtree_node_assign(RtreeNode *parent, RtreeNode *child, bool merge) {
     // leaves should always stay at height level
     vx_assert(parent->leaf == NULL);
+    vx_assert(parent->count < RTREE_NODE_SLOTS);
 
-    doubly_linked_list_push_first(parent->children, child);
+    // new child goes first
+    for (uint8_t i = parent->count; i > 0; --i) {
+        _rtree_node_move_child(parent, i - 1, i);
+    }
+    parent->children[0] = child;
     parent->count++;
     child->parent = parent;
+    child->slot = 0;
+    _rtree_node_sync_slot(child);
 
     if (merge) {
-        if (parent->aabb == NULL) {
+        if (parent->count == 1) {
             // this should happen on a previously empty node
-            vx_assert(parent->count == 1);
-
-            parent->aabb = box_new_copy(child->aabb);
+            parent->aabb = child->aabb;
         } else {
-            box_op_merge(parent->aabb, child->aabb, parent->aabb);
+            box_op_merge(&parent->aabb, &child->aabb, &parent->aabb);
         }
-        parent->layersDirty = true;
+        _rtree_node_sync_slot(parent);
+        _rtree_node_set_layers_dirty(parent);
     }
 }
 
 /// @returns whether or not child was found & removed, if so, ancestors aabb will need to be
 /// recomputed and the tree may need to be condensed
 bool _rtree_node_remove_child(RtreeNode *parent, RtreeNode *child) {
-    DoublyLinkedListNode *n;
-    RtreeNode *rn;
-
-    n = doubly_linked_list_first(parent->children);
-    while (n != NULL) {
-        rn = (RtreeNode *)doubly_linked_list_node_pointer(n);
-        if (rn == child) {
-            doubly_linked_list_delete_node(parent->children, n);
-            parent->count--;
-            child->parent = NULL;
-
-            return true;
-        }
-        n = doubly_linked_list_node_next(n);
+    if (child->parent != parent || child->slot >= parent->count ||
+        parent->children[child->slot] != child) {
+        return false;
     }
 
-    return false;
+    for (uint8_t i = child->slot + 1; i < parent->count; ++i) {
+        _rtree_node_move_child(parent, i, i - 1);
+    }
+    parent->count--;
+    child->parent = NULL;
+
+    return true;
 }
 
 void _rtree_node_reset_aabb(RtreeNode *rn) {
     // cannot reset the box of a leaf, it is a collider
     vx_assert(rn->leaf == NULL);
 
-    DoublyLinkedListNode *n = doubly_linked_list_first(rn->children);
-    if (n != NULL) {
+    if (rn->count > 0) {
         // aabb is set to match its first child aabb
-        RtreeNode *child = (RtreeNode *)doubly_linked_list_node_pointer(n);
-        box_copy(rn->aabb, child->aabb);
+        rn->aabb = rn->children[0]->aabb;
 
         // merge w/ other children aabb if any
-        n = doubly_linked_list_node_next(n);
-        while (n != NULL) {
-            child = (RtreeNode *)doubly_linked_list_node_pointer(n);
-            box_op_merge(rn->aabb, child->aabb, rn->aabb);
-            n = doubly_linked_list_node_next(n);
+        for (uint8_t i = 1; i < rn->count; ++i) {
+            box_op_merge(&rn->aabb, &rn->children[i]->aabb, &rn->aabb);
         }
+        _rtree_node_sync_slot(rn);
     } else {
         // only the tree root can remain w/o children
         vx_assert(rn->parent == NULL);
-
-        box_free(rn->aabb);
-        rn->aabb = NULL;
     }
 }
 
-void _rtree_node_reset_collision_masks(RtreeNode *rn) {
-    if (rn->layersDirty) {
-        rn->groups = PHYSICS_GROUP_NONE;
-        rn->collidesWith = PHYSICS_GROUP_NONE;
+/// Ancestors of a dirty node are dirty as well, so that refreshing layers only visits dirty nodes
+static void _rtree_node_set_layers_dirty(RtreeNode *rn) {
+    while (rn != NULL && rn->layersDirty == false) {
+        rn->layersDirty = true;
+        rn = rn->parent;
+    }
+}
 
-        DoublyLinkedListNode *n = doubly_linked_list_first(rn->children);
-        RtreeNode *child;
-        while (n != NULL) {
-            child = (RtreeNode *)doubly_linked_list_node_pointer(n);
-            rn->groups |= child->groups;
-            rn->collidesWith |= child->collidesWith;
-            n = doubly_linked_list_node_next(n);
-        }
+/// Refreshes layers of given dirty node (deep-first), from its children
+static void _rtree_node_refresh_collision_masks(RtreeNode *rn) {
+    rn->groups = PHYSICS_GROUP_NONE;
+    rn->collidesWith = PHYSICS_GROUP_NONE;
 
-        if (rn->parent != NULL) {
-            rn->parent->layersDirty = true;
+    for (uint8_t i = 0; i < rn->count; ++i) {
+        RtreeNode *child = rn->children[i];
+        if (child->layersDirty) {
+            _rtree_node_refresh_collision_masks(child);
         }
+        rn->groups |= child->groups;
+        rn->collidesWith |= child->collidesWith;
     }
     rn->layersDirty = false;
 }
@@ -254,14 +341,14 @@ void _rtree_insert_choose_node(Box *aabb,
                                float *selectedRnVol) {
 
     // choose the node w/ minimum volume enlargement
-    const float vol = _rtree_box_expand_volume(rn->aabb, aabb, tmpBox);
+    const float vol = _rtree_box_expand_volume(&rn->aabb, aabb, tmpBox);
     if (vol < *selectedRnVol) {
         *selectedRn = rn;
         *selectedRnVol = vol;
     } else if (float_isEqual(vol, *selectedRnVol, EPSILON_COLLISION)) {
         // tie: choose the node w/ the smallest existing box
-        const float boxVol = box_get_volume(rn->aabb);
-        const float selectedBoxVol = box_get_volume((*selectedRn)->aabb);
+        const float boxVol = box_get_volume(&rn->aabb);
+        const float selectedBoxVol = box_get_volume(&(*selectedRn)->aabb);
         if (boxVol < selectedBoxVol) {
             *selectedRn = rn;
             *selectedRnVol = vol;
@@ -279,7 +366,6 @@ void _rtree_insert_choose_node(Box *aabb,
 /// its ancestors aabb)
 /// @returns parent node which now has an additional child
 RtreeNode *_rtree_split_node_quadratic(Rtree *r, RtreeNode *toSplit) {
-    DoublyLinkedListNode *n1, *n2;
     RtreeNode *rn1, *rn2;
     RtreeNode *seed1 = NULL, *seed2 = NULL;
     float maxVol = -FLT_MAX;
@@ -300,23 +386,18 @@ RtreeNode *_rtree_split_node_quadratic(Rtree *r, RtreeNode *toSplit) {
 
     // quadratic split: we use as seeds the two aabb that if merged create as much dead space as
     // possible
-    n1 = doubly_linked_list_first(toSplit->children);
-    while (n1 != NULL) {
-        rn1 = (RtreeNode *)doubly_linked_list_node_pointer(n1);
-        n2 = doubly_linked_list_node_next(n1);
-        while (n2 != NULL) {
-            rn2 = (RtreeNode *)doubly_linked_list_node_pointer(n2);
-
-            const float vol = _rtree_box_merge_dead_space(rn1->aabb, rn2->aabb, &tmpBox);
+    for (uint8_t i = 0; i < toSplit->count; ++i) {
+        rn1 = toSplit->children[i];
+        for (uint8_t j = i + 1; j < toSplit->count; ++j) {
+            rn2 = toSplit->children[j];
+
+            const float vol = _rtree_box_merge_dead_space(&rn1->aabb, &rn2->aabb, &tmpBox);
             if (vol > maxVol) {
                 seed1 = rn1;
                 seed2 = rn2;
                 maxVol = vol;
             }
-
-            n2 = doubly_linked_list_node_next(n2);
         }
-        n1 = doubly_linked_list_node_next(n1);
     }
     vx_assert(seed1 != NULL && seed2 != NULL);
 
@@ -334,13 +415,13 @@ RtreeNode *_rtree_split_node_quadratic(Rtree *r, RtreeNode *toSplit) {
     }
 
     // create 2 branch nodes w/ each one a seed node
-    RtreeNode *rnSplit1 = _rtree_node_new_branch(rn1, seed1);
-    RtreeNode *rnSplit2 = _rtree_node_new_branch(rn1, seed2);
+    RtreeNode *rnSplit1 = _rtree_node_new_branch(r, rn1, seed1);
+    RtreeNode *rnSplit2 = _rtree_node_new_branch(r, rn1, seed2);
 
     // insert remaining nodes
     uint8_t toInsert = toSplit->count - 2;
-    while (doubly_linked_list_first(toSplit->children) != NULL) {
-        rn1 = (RtreeNode *)doubly_linked_list_pop_first(toSplit->children);
+    for (uint8_t i = 0; i < toSplit->count; ++i) {
+        rn1 = toSplit->children[i];
         if (rn1 != seed1 && rn1 != seed2) {
             // prioritize minimum node size over any other criteria
             if (rnSplit1->count == r->m - toInsert) {
@@ -350,8 +431,8 @@ RtreeNode *_rtree_split_node_quadratic(Rtree *r, RtreeNode *toSplit) {
             } else {
                 // choose optimal insertion node
                 rn2 = rnSplit1;
-                float vol = _rtree_box_expand_volume(rnSplit1->aabb, rn1->aabb, &tmpBox);
-                _rtree_insert_choose_node(rn1->aabb, &tmpBox, rnSplit2, &rn2, &vol);
+                float vol = _rtree_box_expand_volume(&rnSplit1->aabb, &rn1->aabb, &tmpBox);
+                _rtree_insert_choose_node(&rn1->aabb, &tmpBox, rnSplit2, &rn2, &vol);
             }
 
             // assign to chosen node
@@ -361,7 +442,7 @@ RtreeNode *_rtree_split_node_quadratic(Rtree *r, RtreeNode *toSplit) {
         }
     }
 
-    _rtree_node_free(toSplit);
+    _rtree_node_free(r, toSplit);
 
     // split should result in 2 new nodes within capacity
     vx_assert(rnSplit1->parent == rnSplit2->parent);
@@ -386,29 +467,26 @@ RtreeNode *_rtree_split_node_quadratic(Rtree *r, RtreeNode *toSplit) {
 
 RtreeNode *_rtree_find_leaf(RtreeNode *start, Box *aabb, void *ptr, bool check) {
     FifoList *toExamine = fifo_list_new();
-    DoublyLinkedListNode *n;
     RtreeNode *rn, *child;
 
     rn = start;
     while (rn != NULL) {
         if (rn->leaf != NULL) {
             if (rn->leaf == ptr) {
+                fifo_list_free(toExamine, NULL);
                 return rn;
             }
             rn = fifo_list_pop(toExamine);
             continue;
         }
 
-        n = doubly_linked_list_first(rn->children);
-        while (n != NULL) {
-            child = (RtreeNode *)doubly_linked_list_node_pointer(n);
+        for (uint8_t i = 0; i < rn->count; ++i) {
+            child = rn->children[i];
 
             // examine each potential node
-            if (check == false || box_collide(child->aabb, aabb)) {
+            if (check == false || box_collide(&child->aabb, aabb)) {
                 fifo_list_push(toExamine, child);
             }
-
-            n = doubly_linked_list_node_next(n);
         }
 
         rn = fifo_list_pop(toExamine);
@@ -421,7 +499,6 @@ RtreeNode *_rtree_find_leaf(RtreeNode *start, Box *aabb, void *ptr, bool check)
 
 void _rtree_condense(Rtree *r, RtreeNode *start) {
     FifoList *toRemove = fifo_list_new();
-    DoublyLinkedListNode *n;
     RtreeNode *rn1, *rn2;
 #if DEBUG_RTREE_EXTRA_LOGS
     uint16_t removalCount = 0, reinsertCount = 0;
@@ -459,9 +536,8 @@ void _rtree_condense(Rtree *r, RtreeNode *start) {
     // reinsert all the leaves amongst the children of nodes selected for removal
     rn1 = fifo_list_pop(toRemove);
     while (rn1 != NULL) {
-        n = doubly_linked_list_first(rn1->children);
-        while (n != NULL) {
-            rn2 = (RtreeNode *)doubly_linked_list_node_pointer(n);
+        for (uint8_t i = 0; i < rn1->count; ++i) {
+            rn2 = rn1->children[i];
 
             if (rn2->leaf != NULL) {
                 rtree_insert(r, rn2);
@@ -470,11 +546,9 @@ void _rtree_condense(Rtree *r, RtreeNode *start) {
                 fifo_list_push(toRemove, rn2);
                 INC_REMOVAL_COUNT
             }
-
-            n = doubly_linked_list_node_next(n);
         }
 
-        _rtree_node_free(rn1);
+        _rtree_node_free(r, rn1);
         rn1 = fifo_list_pop(toRemove);
     }
 
@@ -492,6 +566,117 @@ void _rtree_condense(Rtree *r, RtreeNode *start) {
 #endif
 }
 
+static int _rtree_compare_center_x(const void *a, const void *b) {
+    const Box *b1 = &(*(RtreeNode *const *)a)->aabb;
+    const Box *b2 = &(*(RtreeNode *const *)b)->aabb;
+    const float c1 = b1->min.x + b1->max.x, c2 = b2->min.x + b2->max.x;
+    return c1 < c2 ? -1 : (c1 > c2 ? 1 : 0);
+}
+
+static int _rtree_compare_center_y(const void *a, const void *b) {
+    const Box *b1 = &(*(RtreeNode *const *)a)->aabb;
+    const Box *b2 = &(*(RtreeNode *const *)b)->aabb;
+    const float c1 = b1->min.y + b1->max.y, c2 = b2->min.y + b2->max.y;
+    return c1 < c2 ? -1 : (c1 > c2 ? 1 : 0);
+}
+
+static int _rtree_compare_center_z(const void *a, const void *b) {
+    const Box *b1 = &(*(RtreeNode *const *)a)->aabb;
+    const Box *b2 = &(*(RtreeNode *const *)b)->aabb;
+    const float c1 = b1->min.z + b1->max.z, c2 = b2->min.z + b2->max.z;
+    return c1 < c2 ? -1 : (c1 > c2 ? 1 : 0);
+}
+
+/// Sort-Tile-Recursive order: nodes are sorted in slabs along X, each slab is sorted in runs
+/// along Y, each run is sorted along Z. Consecutive nodes are then packed in the same parent.
+/// Number of slices along each axis is proportional to the nodes extent on that axis, so that
+/// parents are close to cubes, eg. maps are usually much wider than they are tall
+static void _rtree_str_sort(RtreeNode **nodes, size_t n, size_t nbParents) {
+    Box centers = {{FLT_MAX, FLT_MAX, FLT_MAX}, {-FLT_MAX, -FLT_MAX, -FLT_MAX}};
+    for (size_t i = 0; i < n; ++i) {
+        const Box *b = &nodes[i]->aabb;
+        const float3 center = {b->min.x + b->max.x, b->min.y + b->max.y, b->min.z + b->max.z};
+        centers.min = float3_mmin2(&centers.min, &center);
+        centers.max = float3_mmax2(&centers.max, &center);
+    }
+    const float extents[3] = {centers.max.x - centers.min.x,
+                              centers.max.y - centers.min.y,
+                              centers.max.z - centers.min.z};
+    double volume = 1.0;
+    int dimensions = 0;
+    for (int a = 0; a < 3; ++a) {
+        if (extents[a] > 0.0f) {
+            volume *= (double)extents[a];
+            dimensions++;
+        }
+    }
+    size_t slices[3] = {1, 1, 1};
+    if (dimensions > 0) {
+        const double k = pow((double)nbParents / volume, 1.0 / dimensions);
+        for (int a = 0; a < 3; ++a) {
+            if (extents[a] > 0.0f) {
+                slices[a] = maximum((size_t)ceil((double)extents[a] * k), 1);
+            }
+        }
+    }
+
+    qsort(nodes, n, sizeof(RtreeNode *), _rtree_compare_center_x);
+
+    const size_t slabSize = (n + slices[0] - 1) / slices[0];
+    for (size_t slab = 0; slab < n; slab += slabSize) {
+        const size_t slabCount = minimum(slabSize, n - slab);
+        qsort(nodes + slab, slabCount, sizeof(RtreeNode *), _rtree_compare_center_y);
+
+        const size_t runSize = (slabCount + slices[1] - 1) / slices[1];
+        for (size_t run = 0; run < slabCount; run += runSize) {
+            qsort(nodes + slab + run,
+                  minimum(runSize, slabCount - run),
+                  sizeof(RtreeNode *),
+                  _rtree_compare_center_z);
+        }
+    }
+}
+
+static void _rtree_query_queue_init(_RtreeQueryQueue *q) {
+    q->nodes = q->stack;
+    q->head = 0;
+    q->tail = 0;
+    q->capacity = RTREE_QUERY_STACK_SIZE;
+}
+
+static void _rtree_query_queue_push(_RtreeQueryQueue *q, RtreeNode *rn) {
+    if (q->tail == q->capacity) {
+        if (q->head > 0) {
+            memmove(q->nodes, q->nodes + q->head, (q->tail - q->head) * sizeof(RtreeNode *));
+            q->tail -= q->head;
+            q->head = 0;
+        } else {
+            RtreeNode **nodes = (RtreeNode **)malloc(q->capacity * 2 * sizeof(RtreeNode *));
+            if (nodes == NULL) {
+                cclog_error("🔥 r-tree query queue can't grow, node skipped");
+                return;
+            }
+            memcpy(nodes, q->nodes, q->tail * sizeof(RtreeNode *));
+            if (q->nodes != q->stack) {
+                free(q->nodes);
+            }
+            q->nodes = nodes;
+            q->capacity *= 2;
+        }
+    }
+    q->nodes[q->tail++] = rn;
+}
+
+static RtreeNode *_rtree_query_queue_pop(_RtreeQueryQueue *q) {
+    return q->head < q->tail ? q->nodes[q->head++] : NULL;
+}
+
+static void _rtree_query_queue_release(_RtreeQueryQueue *q) {
+    if (q->nodes != q->stack) {
+        free(q->nodes);
+    }
+}
+
 // MARK: - Public functions -
 
 Rtree *rtree_new(uint8_t m, uint8_t M) {
@@ -500,17 +685,28 @@ Rtree *rtree_new(uint8_t m, uint8_t M) {
         return NULL;
     }
     r->root = NULL;
+    r->pages = NULL;
+    r->freeNodes = NULL;
     r->h = 0;
     r->m = m;
     r->M = M;
 
+    // nodes have room for up to RTREE_NODE_MAX_CAPACITY children
+    vx_assert(M <= RTREE_NODE_MAX_CAPACITY);
+
     _rtree_node_new_root(r);
 
     return r;
 }
 
 void rtree_free(Rtree *r) {
-    rtree_recurse(r->root, _rtree_node_free);
+    RtreeNodePage *page = r->pages;
+    while (page != NULL) {
+        RtreeNodePage *next = page->next;
+        free(page->nodes);
+        free(page);
+        page = next;
+    }
     free(r);
 }
 
@@ -525,15 +721,19 @@ RtreeNode *rtree_get_root(const Rtree *r) {
 // MARK: Nodes
 
 Box *rtree_node_get_aabb(const RtreeNode *rn) {
-    return rn->aabb;
+    return rn->leaf == NULL && rn->count == 0 ? NULL : (Box *)&rn->aabb;
 }
 
 uint8_t rtree_node_get_children_count(const RtreeNode *rn) {
     return rn->count;
 }
 
-DoublyLinkedListNode *rtree_node_get_children_iterator(const RtreeNode *rn) {
-    return doubly_linked_list_first(rn->children);
+RtreeNode *rtree_node_get_child(const RtreeNode *rn, uint8_t i) {
+    return i < rn->count ? rn->children[i] : NULL;
+}
+
+RtreeNode *rtree_node_get_parent(const RtreeNode *rn) {
+    return rn->parent;
 }
 
 void *rtree_node_get_leaf_ptr(const RtreeNode *rn) {
@@ -541,7 +741,7 @@ void *rtree_node_get_leaf_ptr(const RtreeNode *rn) {
 }
 
 bool rtree_node_is_leaf(const RtreeNode *rn) {
-    return rn != NULL && rn->parent != NULL && rn->leaf != NULL && rn->aabb != NULL;
+    return rn != NULL && rn->leaf != NULL;
 }
 
 uint16_t rtree_node_get_groups(const RtreeNode *rn) {
@@ -560,26 +760,21 @@ void rtree_node_set_collision_masks(RtreeNode *leaf,
 
     leaf->groups = groups;
     leaf->collidesWith = collidesWith;
-    leaf->parent->layersDirty = true;
+    _rtree_node_set_layers_dirty(leaf->parent);
 }
 
 /// MARK: Operations
 
 // NOTE: rtree_recurse is always "deep first"
 void rtree_recurse(RtreeNode *rn, pointer_rtree_recurse_func f) {
-    DoublyLinkedListNode *n = doubly_linked_list_first(rn->children);
-    RtreeNode *child = NULL;
-    while (n != NULL) {
-        child = (RtreeNode *)doubly_linked_list_node_pointer(n);
-        rtree_recurse(child, f);
-        n = doubly_linked_list_node_next(n);
+    for (uint8_t i = 0; i < rn->count; ++i) {
+        rtree_recurse(rn->children[i], f);
     }
-    f(rn); // free parent
+    f(rn);
 }
 
 void rtree_insert(Rtree *r, RtreeNode *leaf) {
     RtreeNode *rn, *selectedNode;
-    DoublyLinkedListNode *n;
     float selectedNodeVol;
     Box tmpBox;
     uint16_t level;
@@ -596,7 +791,7 @@ void rtree_insert(Rtree *r, RtreeNode *leaf) {
 #endif
 
     // we should only be inserting a leaf (no parent yet)
-    vx_assert(leaf->leaf != NULL && leaf->aabb != NULL);
+    vx_assert(leaf->leaf != NULL);
 
     selectedNode = r->root;
     level = 1;
@@ -609,13 +804,13 @@ void rtree_insert(Rtree *r, RtreeNode *leaf) {
 
         selectedNodeVol = FLT_MAX;
 
-        n = doubly_linked_list_first(selectedNode->children);
-        while (n != NULL) {
-            rn = (RtreeNode *)doubly_linked_list_node_pointer(n);
-
-            _rtree_insert_choose_node(leaf->aabb, &tmpBox, rn, &selectedNode, &selectedNodeVol);
-
-            n = doubly_linked_list_node_next(n);
+        rn = selectedNode;
+        for (uint8_t i = 0; i < rn->count; ++i) {
+            _rtree_insert_choose_node(&leaf->aabb,
+                                      &tmpBox,
+                                      rn->children[i],
+                                      &selectedNode,
+                                      &selectedNodeVol);
         }
 
         level++;
@@ -632,7 +827,8 @@ void rtree_insert(Rtree *r, RtreeNode *leaf) {
     if (selectedNode->count <= r->M) {
         rn = selectedNode->parent;
         while (rn != NULL) {
-            box_op_merge(rn->aabb, leaf->aabb, rn->aabb);
+            box_op_merge(&rn->aabb, &leaf->aabb, &rn->aabb);
+            _rtree_node_sync_slot(rn);
             rn = rn->parent;
             INC_BOX_MERGE_COUNT
         }
@@ -667,13 +863,77 @@ void rtree_insert(Rtree *r, RtreeNode *leaf) {
 #endif
 }
 
+RtreeNode *rtree_create_leaf(Rtree *r,
+                              Box *aabb,
+                              uint16_t groups,
+                              uint16_t collidesWith,
+                              void *ptr) {
+    return _rtree_node_new_leaf(r, NULL, aabb, groups, collidesWith, ptr);
+}
+
+void rtree_free_leaf(Rtree *r, RtreeNode *leaf) {
+    vx_assert(leaf->parent == NULL);
+    _rtree_node_free(r, leaf);
+}
+
+void rtree_bulk_load(Rtree *r, RtreeNode **leaves, size_t count) {
+    // a level of n nodes is packed in ceil(n / M) parents, each w/ at least m children if m <= M/2
+    vx_assert(r->m <= r->M / 2);
+
+    RtreeNode **parents = NULL;
+    if (r->root->count == 0 && count > r->M) {
+        parents = (RtreeNode **)malloc((count + r->M - 1) / r->M * sizeof(RtreeNode *));
+    }
+
+    // tree isn't empty or too few leaves: insert one by one
+    if (parents == NULL) {
+        for (size_t i = 0; i < count; ++i) {
+            rtree_insert(r, leaves[i]);
+        }
+        return;
+    }
+
+    // pack each level bottom-up, parents are written over the previous level once it is read
+    RtreeNode **level = leaves;
+    size_t n = count;
+    while (n > r->M) {
+        const size_t nbParents = (n + r->M - 1) / r->M;
+        _rtree_str_sort(level, n, nbParents);
+
+        size_t first = 0;
+        for (size_t i = 0; i < nbParents; ++i) {
+            const size_t nbChildren = n / nbParents + (i < n % nbParents ? 1 : 0);
+
+            RtreeNode *parent = _rtree_node_new_branch(r, NULL, NULL);
+            // children are assigned first, in reverse to keep them in sorted order
+            for (size_t j = nbChildren; j > 0; --j) {
+                _rtree_node_assign(parent, level[first + j - 1], true);
+            }
+            first += nbChildren;
+            parents[i] = parent;
+        }
+
+        level = parents;
+        n = nbParents;
+        r->h++;
+    }
+
+    for (size_t i = n; i > 0; --i) {
+        _rtree_node_assign(r->root, level[i - 1], true);
+    }
+
+    free(parents);
+}
+
 RtreeNode *rtree_create_and_insert(Rtree *r,
                                    Box *aabb,
                                    uint16_t groups,
                                    uint16_t collidesWith,
                                    void *ptr) {
-    RtreeNode *newLeaf = _rtree_node_new_leaf(NULL, aabb, groups, collidesWith, ptr);
-    rtree_insert(r, newLeaf);
+    RtreeNode *newLeaf = _rtree_node_new_leaf(r, NULL, aabb, groups, collidesWith, ptr);
+    if (newLeaf != NULL) {
+        rtree_insert(r, newLeaf);
+    }
     return newLeaf;
 }
 
@@ -692,15 +952,16 @@ void rtree_remove(Rtree *r, RtreeNode *leaf, bool freeLeaf) {
     RtreeNode *parent = leaf->parent;
     if (_rtree_node_remove_child(parent, leaf)) {
         if (freeLeaf) {
-            _rtree_node_free(leaf);
+            _rtree_node_free(r, leaf);
         }
         _rtree_condense(r, parent);
 
         // reduce height if root has only one non-leaf child
         if (r->root->count == 1 && r->h >= 2) {
-            r->root = (RtreeNode *)doubly_linked_list_pop_first(r->root->children);
-            _rtree_node_free(r->root->parent);
+            RtreeNode *oldRoot = r->root;
+            r->root = oldRoot->children[0];
             r->root->parent = NULL;
+            _rtree_node_free(r, oldRoot);
             r->h--;
             SET_HEIGHT_DECREASED
         }
@@ -733,25 +994,23 @@ void rtree_find_and_remove(Rtree *r, Box *aabb, void *ptr) {
 
 void rtree_update(Rtree *r, RtreeNode *leaf, Box *aabb) {
     Box tmpBox;
-    DoublyLinkedListNode *n;
-    RtreeNode *child;
+    RtreeNode *parent = leaf->parent;
 
     // simulate node volume w/ updated leaf aabb
     box_copy(&tmpBox, aabb);
-    n = doubly_linked_list_first(leaf->parent->children);
-    while (n != NULL) {
-        child = (RtreeNode *)doubly_linked_list_node_pointer(n);
-        if (child != leaf) {
-            box_op_merge(&tmpBox, child->aabb, &tmpBox);
+    for (uint8_t i = 0; i < parent->count; ++i) {
+        if (parent->children[i] != leaf) {
+            box_op_merge(&tmpBox, &parent->children[i]->aabb, &tmpBox);
         }
-        n = doubly_linked_list_node_next(n);
     }
     const float vol = box_get_volume(&tmpBox);
 
     // if volume difference is within threshold, keep leaf in place
-    if (fabsf(vol - box_get_volume(leaf->parent->aabb)) < RTREE_LEAF_UPDATE_THRESHOLD) {
-        box_copy(leaf->aabb, aabb);
-        box_copy(leaf->parent->aabb, &tmpBox);
+    if (fabsf(vol - box_get_volume(&parent->aabb)) < RTREE_LEAF_UPDATE_THRESHOLD) {
+        box_copy(&leaf->aabb, aabb);
+        _rtree_node_sync_slot(leaf);
+        box_copy(&parent->aabb, &tmpBox);
+        _rtree_node_sync_slot(parent);
 
         // propagate aabb update upwards
         RtreeNode *rn = leaf->parent->parent;
@@ -764,67 +1023,99 @@ void rtree_update(Rtree *r, RtreeNode *leaf, Box *aabb) {
 #endif
     } else {
         rtree_remove(r, leaf, false);
-        box_copy(leaf->aabb, aabb);
+        box_copy(&leaf->aabb, aabb);
         rtree_insert(r, leaf);
     }
 }
 
 void rtree_refresh_collision_masks(Rtree *r) {
-    rtree_recurse(r->root, _rtree_node_reset_collision_masks);
+    if (r->root->layersDirty) {
+        _rtree_node_refresh_collision_masks(r->root);
+    }
 }
 
 // MARK: Queries
 
-size_t rtree_query_overlap_func(Rtree *r,
-                                uint16_t groups,
-                                uint16_t collidesWith,
-                                pointer_rtree_query_overlap_func func,
-                                void *ptr,
-                                const DoublyLinkedList *excludeLeafPtrs,
-                                FifoList *results,
-                                float epsilon) {
-
-    FifoList *toExamine = fifo_list_new();
-    DoublyLinkedListNode *n;
+/// Overlap query w/ given function, or against given box w/ children boxes if func is NULL. Hits
+/// are pushed in results list if any, or written in results array up to capacity
+static size_t _rtree_query_overlap(Rtree *r,
+                                   uint16_t groups,
+                                   uint16_t collidesWith,
+                                   pointer_rtree_query_overlap_func func,
+                                   void *ptr,
+                                   const Box *aabb,
+                                   const DoublyLinkedList *excludeLeafPtrs,
+                                   FifoList *results,
+                                   RtreeNode **resultsArray,
+                                   size_t capacity,
+                                   float epsilon) {
+
+    _RtreeQueryQueue toExamine;
+    _rtree_query_queue_init(&toExamine);
     RtreeNode *rn, *child;
     size_t hits = 0;
 
     rn = r->root;
     while (rn != NULL) {
-        n = doubly_linked_list_first(rn->children);
-        while (n != NULL) {
-            child = (RtreeNode *)doubly_linked_list_node_pointer(n);
+        // test all children boxes at once
+        const uint8_t mask = func != NULL ? UINT8_MAX
+                                          : box_lanes_collide_epsilon(&rn->childrenBoxes,
+                                                                      rn->count,
+                                                                      aabb,
+                                                                      epsilon);
+        for (uint8_t i = 0; i < rn->count; ++i) {
+            if ((mask & (1u << i)) == 0) {
+                continue;
+            }
+            child = rn->children[i];
 
             if (rigidbody_collision_masks_reciprocal_match(child->groups,
                                                            child->collidesWith,
                                                            groups,
                                                            collidesWith) &&
-                func(child, ptr, epsilon)) {
+                (func == NULL || func(child, ptr, epsilon))) {
 
                 if (child->leaf == NULL) {
-                    fifo_list_push(toExamine, child);
+                    _rtree_query_queue_push(&toExamine, child);
                 } else if (excludeLeafPtrs == NULL ||
                            doubly_linked_list_contains(excludeLeafPtrs, child->leaf) == false) {
 
                     if (results != NULL) {
                         fifo_list_push(results, child);
+                    } else if (hits < capacity) {
+                        resultsArray[hits] = child;
                     }
                     hits++;
                 }
             }
-
-            n = doubly_linked_list_node_next(n);
         }
-        rn = (RtreeNode *)fifo_list_pop(toExamine);
+        rn = _rtree_query_queue_pop(&toExamine);
     }
-
-    fifo_list_free(toExamine, NULL);
+    _rtree_query_queue_release(&toExamine);
 
     return hits;
 }
 
-bool _rtree_query_overlap_box_func(RtreeNode *rn, void *ptr, float epsilon) {
-    return box_collide_epsilon(rn->aabb, (Box *)ptr, epsilon);
+size_t rtree_query_overlap_func(Rtree *r,
+                                uint16_t groups,
+                                uint16_t collidesWith,
+                                pointer_rtree_query_overlap_func func,
+                                void *ptr,
+                                const DoublyLinkedList *excludeLeafPtrs,
+                                FifoList *results,
+                                float epsilon) {
+
+    return _rtree_query_overlap(r,
+                                groups,
+                                collidesWith,
+                                func,
+                                ptr,
+                                NULL,
+                                excludeLeafPtrs,
+                                results,
+                                NULL,
+                                0,
+                                epsilon);
 }
 
 size_t rtree_query_overlap_box(Rtree *r,
@@ -835,71 +1126,130 @@ size_t rtree_query_overlap_box(Rtree *r,
                                FifoList *results,
                                float epsilon) {
 
-    return rtree_query_overlap_func(r,
-                                    groups,
-                                    collidesWith,
-                                    _rtree_query_overlap_box_func,
-                                    (void *)aabb,
-                                    excludeLeafPtrs,
-                                    results,
-                                    epsilon);
+    return _rtree_query_overlap(r,
+                                groups,
+                                collidesWith,
+                                NULL,
+                                NULL,
+                                aabb,
+                                excludeLeafPtrs,
+                                results,
+                                NULL,
+                                0,
+                                epsilon);
 }
 
-size_t rtree_query_cast_all_func(Rtree *r,
-                                 uint16_t groups,
-                                 uint16_t collidesWith,
-                                 pointer_rtree_query_cast_all_func func,
-                                 void *ptr,
-                                 const DoublyLinkedList *excludeLeafPtrs,
-                                 DoublyLinkedList *results) {
-    vx_assert(results != NULL);
+size_t rtree_query_overlap_box_array(Rtree *r,
+                                     const Box *aabb,
+                                     uint16_t groups,
+                                     uint16_t collidesWith,
+                                     const DoublyLinkedList *excludeLeafPtrs,
+                                     RtreeNode **results,
+                                     size_t capacity,
+                                     float epsilon) {
 
-    FifoList *toExamine = fifo_list_new();
-    DoublyLinkedListNode *n;
+    return _rtree_query_overlap(r,
+                                groups,
+                                collidesWith,
+                                NULL,
+                                NULL,
+                                aabb,
+                                excludeLeafPtrs,
+                                NULL,
+                                results,
+                                results != NULL ? capacity : 0,
+                                epsilon);
+}
+
+/// Cast all query w/ given function, or against given ray w/ children boxes if func is NULL. Hits
+/// are pushed in results list if any, or written in results array up to capacity
+static size_t _rtree_query_cast_all(Rtree *r,
+                                    uint16_t groups,
+                                    uint16_t collidesWith,
+                                    pointer_rtree_query_cast_all_func func,
+                                    void *ptr,
+                                    const Ray *ray,
+                                    const DoublyLinkedList *excludeLeafPtrs,
+                                    DoublyLinkedList *results,
+                                    RtreeCastResult *resultsArray,
+                                    size_t capacity) {
+
+    _RtreeQueryQueue toExamine;
+    _rtree_query_queue_init(&toExamine);
     RtreeNode *rn, *child;
     size_t hits = 0;
-    float dist;
+    float dist, distances[BOX_LANES_COUNT];
     RtreeCastResult *result;
 
     rn = r->root;
     while (rn != NULL) {
-        n = doubly_linked_list_first(rn->children);
-        while (n != NULL) {
-            child = (RtreeNode *)doubly_linked_list_node_pointer(n);
+        // test all children boxes at once
+        const uint8_t mask = func != NULL ? UINT8_MAX
+                                          : box_lanes_intersect_ray(&rn->childrenBoxes,
+                                                                    rn->count,
+                                                                    ray,
+                                                                    distances);
+        for (uint8_t i = 0; i < rn->count; ++i) {
+            if ((mask & (1u << i)) == 0) {
+                continue;
+            }
+            child = rn->children[i];
+            dist = func != NULL ? 0.0f : distances[i]; // func sets distance
 
             if (rigidbody_collision_masks_reciprocal_match(child->groups,
                                                            child->collidesWith,
                                                            groups,
                                                            collidesWith) &&
-                func(child, ptr, &dist)) {
+                (func == NULL || func(child, ptr, &dist))) {
 
                 if (child->leaf == NULL) {
-                    fifo_list_push(toExamine, child);
+                    _rtree_query_queue_push(&toExamine, child);
                 } else if (excludeLeafPtrs == NULL ||
                            doubly_linked_list_contains(excludeLeafPtrs, child->leaf) == false) {
 
-                    result = malloc(sizeof(RtreeCastResult));
-                    if (result != NULL) {
-                        result->rtreeLeaf = child;
-                        result->distance = dist;
-                        doubly_linked_list_push_last(results, result);
+                    if (results == NULL) {
+                        if (hits < capacity) {
+                            resultsArray[hits].rtreeLeaf = child;
+                            resultsArray[hits].distance = dist;
+                        }
                         hits++;
+                    } else {
+                        result = malloc(sizeof(RtreeCastResult));
+                        if (result != NULL) {
+                            result->rtreeLeaf = child;
+                            result->distance = dist;
+                            doubly_linked_list_push_last(results, result);
+                            hits++;
+                        }
                     }
                 }
             }
-
-            n = doubly_linked_list_node_next(n);
         }
-        rn = (RtreeNode *)fifo_list_pop(toExamine);
+        rn = _rtree_query_queue_pop(&toExamine);
     }
-
-    fifo_list_free(toExamine, NULL);
+    _rtree_query_queue_release(&toExamine);
 
     return hits;
 }
 
-bool _rtree_query_cast_ray_all_func(RtreeNode *rn, void *ptr, float *distance) {
-    return ray_intersect_with_box((Ray *)ptr, &rn->aabb->min, &rn->aabb->max, distance);
+size_t rtree_query_cast_all_func(Rtree *r,
+                                 uint16_t groups,
+                                 uint16_t collidesWith,
+                                 pointer_rtree_query_cast_all_func func,
+                                 void *ptr,
+                                 const DoublyLinkedList *excludeLeafPtrs,
+                                 DoublyLinkedList *results) {
+
+    return _rtree_query_cast_all(r,
+                                 groups,
+                                 collidesWith,
+                                 func,
+                                 ptr,
+                                 NULL,
+                                 excludeLeafPtrs,
+                                 results,
+                                 NULL,
+                                 0);
 }
 
 size_t rtree_query_cast_all_ray(Rtree *r,
@@ -909,13 +1259,36 @@ size_t rtree_query_cast_all_ray(Rtree *r,
                                 const DoublyLinkedList *excludeLeafPtrs,
                                 DoublyLinkedList *results) {
 
-    return rtree_query_cast_all_func(r,
-                                     groups,
-                                     collidesWith,
-                                     _rtree_query_cast_ray_all_func,
-                                     (void *)worldRay,
-                                     excludeLeafPtrs,
-                                     results);
+    return _rtree_query_cast_all(r,
+                                 groups,
+                                 collidesWith,
+                                 NULL,
+                                 NULL,
+                                 worldRay,
+                                 excludeLeafPtrs,
+                                 results,
+                                 NULL,
+                                 0);
+}
+
+size_t rtree_query_cast_all_ray_array(Rtree *r,
+                                      const Ray *worldRay,
+                                      uint16_t groups,
+                                      uint16_t collidesWith,
+                                      const DoublyLinkedList *excludeLeafPtrs,
+                                      RtreeCastResult *results,
+                                      size_t capacity) {
+
+    return _rtree_query_cast_all(r,
+                                 groups,
+                                 collidesWith,
+                                 NULL,
+                                 NULL,
+                                 worldRay,
+                                 excludeLeafPtrs,
+                                 NULL,
+                                 results,
+                                 results != NULL ? capacity : 0);
 }
 
 size_t rtree_query_cast_all_box_step_func(Rtree *r,
@@ -946,7 +1319,7 @@ size_t rtree_query_cast_all_box_step_func(Rtree *r,
         while (hit != NULL) {
             swept = box_swept(stepOriginBox,
                               step3,
-                              hit->aabb,
+                              &hit->aabb,
                               &float3_epsilon_collision,
                               false,
                               NULL,
@@ -1044,6 +1417,21 @@ bool rtree_utils_result_sort_func(DoublyLinkedListNode *n1, DoublyLinkedListNode
            ((RtreeCastResult *)doubly_linked_list_node_pointer(n2))->distance;
 }
 
+void rtree_utils_sort_results(RtreeCastResult *results, size_t count) {
+    // insertion sort, results arrays are short
+    RtreeCastResult tmp;
+    size_t j;
+    for (size_t i = 1; i < count; ++i) {
+        tmp = results[i];
+        j = i;
+        while (j > 0 && results[j - 1].distance > tmp.distance) {
+            results[j] = results[j - 1];
+            --j;
+        }
+        results[j] = tmp;
+    }
+}
+
 // MARK: - Debug functions -
 #if DEBUG_RTREE
 
@@ -1077,7 +1465,6 @@ void debug_rtree_reset_calls(void) {
 
 bool debug_rtree_integrity_check(Rtree *r) {
     DoublyLinkedList *toExamine = doubly_linked_list_new();
-    DoublyLinkedListNode *n;
     RtreeNode *rn, *child, *rbLeaf;
     Transform *t;
     Shape *s;
@@ -1103,8 +1490,8 @@ bool debug_rtree_integrity_check(Rtree *r) {
             if (rb != NULL) {
                 rbLeaf = rigidbody_get_rtree_leaf(rb);
                 if (rbLeaf != NULL) {
-                    if (float3_isEqual(&rn->aabb->min, &rbLeaf->aabb->min, EPSILON_ZERO) == false ||
-                        float3_isEqual(&rn->aabb->max, &rbLeaf->aabb->max, EPSILON_ZERO) == false) {
+                    if (float3_isEqual(&rn->aabb.min, &rbLeaf->aabb.min, EPSILON_ZERO) == false ||
+                        float3_isEqual(&rn->aabb.max, &rbLeaf->aabb.max, EPSILON_ZERO) == false) {
 
                         cclog_debug("⚠️⚠️⚠️debug_rtree_integrity_check: mismatched leaf");
                         success = false;
@@ -1127,26 +1514,28 @@ bool debug_rtree_integrity_check(Rtree *r) {
             }
         }
 
-        const size_t childrenCount = doubly_linked_list_node_count(rn->children);
-        if (rn->count != childrenCount) {
-            cclog_debug("⚠️⚠️⚠️debug_rtree_integrity_check: mismatched children count");
-            success = false;
-        }
-
-        n = doubly_linked_list_first(rn->children);
-        while (n != NULL) {
-            child = (RtreeNode *)doubly_linked_list_node_pointer(n);
+        for (uint8_t i = 0; i < rn->count; ++i) {
+            child = rn->children[i];
 
-            if (box_contains_epsilon(rn->aabb, &child->aabb->min, EPSILON_ZERO) == false ||
-                box_contains_epsilon(rn->aabb, &child->aabb->max, EPSILON_ZERO) == false) {
+            if (child->parent != rn || child->slot != i) {
+                cclog_debug("⚠️⚠️⚠️debug_rtree_integrity_check: mismatched child slot");
+                success = false;
+            }
+            if (box_contains_epsilon(&rn->aabb, &child->aabb.min, EPSILON_ZERO) == false ||
+                box_contains_epsilon(&rn->aabb, &child->aabb.max, EPSILON_ZERO) == false) {
 
                 cclog_debug("⚠️⚠️⚠️debug_rtree_integrity_check: parent aabb does not contain "
                             "child aabb");
                 success = false;
             }
-            doubly_linked_list_push_first(toExamine, child);
+            Box childBox;
+            box_lanes_get(&rn->childrenBoxes, i, &childBox);
+            if (memcmp(&childBox, &child->aabb, sizeof(Box)) != 0) {
 
-            n = doubly_linked_list_node_next(n);
+                cclog_debug("⚠️⚠️⚠️debug_rtree_integrity_check: stale child box");
+                success = false;
+            }
+            doubly_linked_list_push_first(toExamine, child);
         }
     }
 
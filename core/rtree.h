@@ -67,7 +67,10 @@ RtreeNode *rtree_get_root(const Rtree *r);
 /// MARK: - Nodes -
 Box *rtree_node_get_aabb(const RtreeNode *rn);
 uint8_t rtree_node_get_children_count(const RtreeNode *rn);
-DoublyLinkedListNode *rtree_node_get_children_iterator(const RtreeNode *rn);
+/// i-th child of a node, NULL if out of range
+RtreeNode *rtree_node_get_child(const RtreeNode *rn, uint8_t i);
+/// NULL for the root & for leaves outside of the tree
+RtreeNode *rtree_node_get_parent(const RtreeNode *rn);
 void *rtree_node_get_leaf_ptr(const RtreeNode *rn);
 bool rtree_node_is_leaf(const RtreeNode *rn);
 uint16_t rtree_node_get_groups(const RtreeNode *rn);
@@ -85,6 +88,18 @@ RtreeNode *rtree_create_and_insert(Rtree *r,
                                    uint16_t groups,
                                    uint16_t collidesWith,
                                    void *ptr);
+/// Creates a leaf w/o inserting it, see rtree_insert & rtree_bulk_load
+RtreeNode *rtree_create_leaf(Rtree *r,
+                             Box *aabb,
+                             uint16_t groups,
+                             uint16_t collidesWith,
+                             void *ptr);
+/// Inserts leaves all at once in an empty tree, packed w/ Sort-Tile-Recursive (STR) instead of
+/// successive splits, for a smaller tree w/ less overlap between nodes. Leaves are inserted one by
+/// one if the tree isn't empty. Given array is reordered.
+void rtree_bulk_load(Rtree *r, RtreeNode **leaves, size_t count);
+/// Frees a leaf outside of the tree, eg. created w/ rtree_create_leaf & never inserted
+void rtree_free_leaf(Rtree *r, RtreeNode *leaf);
 void rtree_remove(Rtree *r, RtreeNode *leaf, bool freeLeaf);
 void rtree_find_and_remove(Rtree *r, Box *aabb, void *ptr);
 void rtree_update(Rtree *r, RtreeNode *leaf, Box *aabb);
@@ -101,6 +116,9 @@ void rtree_refresh_collision_masks(Rtree *r);
 /// - CAST ALL: populates the 'results' parameter w/ RtreeCastResult structs, to be freed by caller
 /// - CAST: returns only 1 hit, but parameter 'excludeLeafPtrs' can be used to add a few exceptions
 ///
+/// Queries w/ an '_array' suffix write results in a caller-provided array instead, w/o any
+/// allocation. They return the total hits count, only the first 'capacity' hits are written
+///
 /// Two usages for collision masks in queries,
 /// - standalone queries like cast functions may filter w/ 'collidesWith' only (no groups)
 /// - reciprocal queries like collision checks may filter w/ both masks
@@ -119,6 +137,14 @@ size_t rtree_query_overlap_box(Rtree *r,
                                const DoublyLinkedList *excludeLeafPtrs,
                                FifoList *results,
                                float epsilon);
+size_t rtree_query_overlap_box_array(Rtree *r,
+                                     const Box *aabb,
+                                     uint16_t groups,
+                                     uint16_t collidesWith,
+                                     const DoublyLinkedList *excludeLeafPtrs,
+                                     RtreeNode **results,
+                                     size_t capacity,
+                                     float epsilon);
 size_t rtree_query_cast_all_func(Rtree *r,
                                  uint16_t groups,
                                  uint16_t collidesWith,
@@ -132,6 +158,13 @@ size_t rtree_query_cast_all_ray(Rtree *r,
                                 uint16_t collidesWith,
                                 const DoublyLinkedList *excludeLeafPtrs,
                                 DoublyLinkedList *results);
+size_t rtree_query_cast_all_ray_array(Rtree *r,
+                                      const Ray *worldRay,
+                                      uint16_t groups,
+                                      uint16_t collidesWith,
+                                      const DoublyLinkedList *excludeLeafPtrs,
+                                      RtreeCastResult *results,
+                                      size_t capacity);
 size_t rtree_query_cast_all_box_step_func(Rtree *r,
                                           const Box *stepOriginBox,
                                           float stepStartDistance,
@@ -163,6 +196,8 @@ size_t rtree_utils_broadphase_steps(Rtree *r,
                                     const DoublyLinkedList *excludeLeafPtrs,
                                     DoublyLinkedList *results);
 bool rtree_utils_result_sort_func(DoublyLinkedListNode *n1, DoublyLinkedListNode *n2);
+/// Sorts cast results by ascending distance
+void rtree_utils_sort_results(RtreeCastResult *results, size_t count);
 
 /// MARK: - Debug -
 #if DEBUG_RTREE
@@ -9,17 +9,116 @@
 #include <float.h>
 #include <stdlib.h>
 
+#include "thread_pool.h"
 #include "weakptr.h"
 
 #if DEBUG_SCENE
 static int debug_scene_awake_queries = 0;
 #endif
 
+// batched ray casts are split in jobs of this many rays, spread over worker threads if there are
+// at least two jobs
+#define SCENE_CAST_RAYS_JOB_SIZE 32
+
+#define SCENE_COUPLES_INITIAL_CAPACITY 32
+#define SCENE_COUPLE_NONE UINT32_MAX
+
+// islands are split in this many jobs per thread at most, to balance uneven islands
+#define SCENE_ISLANDS_JOBS_PER_THREAD 4
+#define SCENE_ISLANDS_INITIAL_CAPACITY 64
+
+typedef struct {
+    Weakptr *t1, *t2;
+    float3 wNormal;
+    // transforms IDs, lowest in high bits, IDs may be recycled so transforms are compared as well
+    uint32_t key;
+    // frame stamp of last registration
+    uint32_t frame;
+    // registered couples are chained from least to most recently registered, free couples are
+    // chained through next
+    uint32_t previous, next;
+
+    char pad[4];
+} _CollisionCouple;
+
+typedef struct {
+    // couples storage, indexes remain valid when growing
+    _CollisionCouple *pool;
+    // open addressing table of pool index + 1, 0 for empty slots, w/ a power of two capacity
+    uint32_t *table;
+    uint32_t poolCapacity;
+    uint32_t tableCapacity;
+    uint32_t count;
+    uint32_t free;
+    uint32_t first, last;
+    // stamped on couples registered during current frame
+    uint32_t frame;
+
+    char pad[4];
+} _CollisionCouples;
+
+typedef struct {
+    Transform *t;
+    RigidBody *rb;
+    // world collider at the start of the step, moved along w/ the rigidbody while it is solved
+    Box collider;
+    // space the rigidbody may go through during the step
+    Box reach;
+    // position at the start of the step, then once solved
+    float3 pos;
+    // union-find parent while grouping rigidbodies, then island index
+    uint32_t parent;
+    uint32_t island;
+    bool moved;
+
+    char pad[3];
+} _SceneBody;
+
+typedef struct {
+    float min;
+    uint32_t body;
+} _SceneSweepEntry;
+
+typedef struct {
+    Scene *sc;
+    // collision callbacks & pushes across islands, kept in islands order
+    RigidbodyDeferred deferred;
+    TICK_DELTA_SEC_T dt;
+    // range of islands solved by this job
+    uint32_t first, end;
+} _SceneIslandsJob;
+
+typedef struct {
+    // pool solving islands of dynamic rigidbodies, NULL to solve them one by one
+    ThreadPool *pool;
+    // dynamic rigidbodies in hierarchy order
+    _SceneBody *bodies;
+    _SceneSweepEntry *sweep;
+    // bodies indexes grouped by island, in hierarchy order within each island
+    uint32_t *order;
+    // rigidbodies of each island sorted by address, at the same indexes as in order
+    RigidBody **pushable;
+    // start of each island in order, followed by bodies count
+    uint32_t *islands;
+    _SceneIslandsJob *jobs;
+    uint32_t count;
+    uint32_t capacity;
+    uint32_t islandsCount;
+    uint32_t jobsCount;
+    uint32_t jobsCapacity;
+    // a rigidbody couldn't be gathered, all are then solved one by one
+    bool failed;
+
+    char pad[3];
+} _SceneIslands;
+
 struct _Scene {
     Transform *root;
     Transform *map;    // weak ref to Map transform (Shape retained by parent)
     Transform *system; // private hierarchy
     Rtree *rtree;
+    // dynamic rigidbodies leaves, NULL if they are in the r-tree w/ other leaves
+    Broadphase *broadphase;
     Weakptr *wptr;
 
     Weakptr *game; // weak ref used to resolve resources associated to transform IDs
@@ -29,26 +128,296 @@ struct _Scene {
     FifoList *removed;
 
     // rigidbody couples registered & waiting for a call to end-of-collision callback
-    DoublyLinkedList *collisions;
+    _CollisionCouples collisions;
+
+    // dynamic rigidbodies grouped in islands that can be solved in parallel
+    _SceneIslands islands;
 
     // awake volumes can be registered for end-of-frame awake phase
     DoublyLinkedList *awakeBoxes;
 
+    // new r-tree leaves collected during an end-of-frame refresh starting w/ an empty r-tree,
+    // partitioned all at once w/ a bulk load instead of one insertion each
+    FifoList *bulkLeaves;
+    bool bulkLoading;
+
     // constant acceleration for the whole Scene (gravity usually)
     float3 constantAcceleration;
 };
 
-typedef struct {
-    Weakptr *t1, *t2;
-    float3 wNormal;
-    bool flag;
-} _CollisionCouple;
+static void _scene_prepare_shape_rtree(RtreeNode *rn);
+
+// MARK: Collision couples
+
+static uint32_t _scene_couple_hash(uint32_t key) {
+    key = (key ^ (key >> 16)) * 0x45d9f3bu;
+    return key ^ (key >> 16);
+}
+
+static uint32_t _scene_couple_key(const Transform *t1, const Transform *t2) {
+    const uint32_t id1 = transform_get_id(t1);
+    const uint32_t id2 = transform_get_id(t2);
+    return id1 < id2 ? id1 << 16 | id2 : id2 << 16 | id1;
+}
+
+static void _scene_couples_init(_CollisionCouples *cs) {
+    cs->pool = NULL;
+    cs->table = NULL;
+    cs->poolCapacity = 0;
+    cs->tableCapacity = 0;
+    cs->count = 0;
+    cs->free = SCENE_COUPLE_NONE;
+    cs->first = SCENE_COUPLE_NONE;
+    cs->last = SCENE_COUPLE_NONE;
+    cs->frame = 0;
+}
+
+static void _scene_couples_free(_CollisionCouples *cs) {
+    uint32_t i = cs->first;
+    while (i != SCENE_COUPLE_NONE) {
+        weakptr_release(cs->pool[i].t1);
+        weakptr_release(cs->pool[i].t2);
+        i = cs->pool[i].next;
+    }
+    free(cs->pool);
+    free(cs->table);
+}
+
+/// @returns pool index of the couple of given transforms, in any order, or SCENE_COUPLE_NONE
+static uint32_t _scene_couples_find(const _CollisionCouples *cs,
+                                    uint32_t key,
+                                    const Transform *t1,
+                                    const Transform *t2) {
+    if (cs->count == 0) {
+        return SCENE_COUPLE_NONE;
+    }
+    const uint32_t mask = cs->tableCapacity - 1;
+    uint32_t i = _scene_couple_hash(key) & mask;
+    while (cs->table[i] != 0) {
+        const _CollisionCouple *cc = &cs->pool[cs->table[i] - 1];
+        if (cc->key == key) {
+            const Transform *cc1 = (Transform *)weakptr_get(cc->t1);
+            const Transform *cc2 = (Transform *)weakptr_get(cc->t2);
+            if ((cc1 == t1 && cc2 == t2) || (cc1 == t2 && cc2 == t1)) {
+                return cs->table[i] - 1;
+            }
+        }
+        i = (i + 1) & mask;
+    }
+    return SCENE_COUPLE_NONE;
+}
+
+/// @returns a free slot for given key, table must not be full
+static uint32_t *_scene_couples_probe(uint32_t *table, uint32_t capacity, uint32_t key) {
+    const uint32_t mask = capacity - 1;
+    uint32_t i = _scene_couple_hash(key) & mask;
+    while (table[i] != 0) {
+        i = (i + 1) & mask;
+    }
+    return &table[i];
+}
+
+static bool _scene_couples_grow(_CollisionCouples *cs) {
+    // keep table load factor under 1/2 for short probes
+    if ((cs->count + 1) * 2 > cs->tableCapacity) {
+        const uint32_t capacity = cs->tableCapacity == 0 ? SCENE_COUPLES_INITIAL_CAPACITY * 2
+                                                         : cs->tableCapacity * 2;
+        uint32_t *table = (uint32_t *)calloc(capacity, sizeof(uint32_t));
+        if (table == NULL) {
+            return false;
+        }
+        for (uint32_t i = 0; i < cs->tableCapacity; ++i) {
+            if (cs->table[i] != 0) {
+                *_scene_couples_probe(table, capacity, cs->pool[cs->table[i] - 1].key) =
+                    cs->table[i];
+            }
+        }
+        free(cs->table);
+        cs->table = table;
+        cs->tableCapacity = capacity;
+    }
+
+    if (cs->free == SCENE_COUPLE_NONE) {
+        const uint32_t capacity = cs->poolCapacity == 0 ? SCENE_COUPLES_INITIAL_CAPACITY
+                                                        : cs->poolCapacity * 2;
+        _CollisionCouple *pool = (_CollisionCouple *)realloc(cs->pool,
+                                                             capacity * sizeof(_CollisionCouple));
+        if (pool == NULL) {
+            return false;
+        }
+        for (uint32_t i = cs->poolCapacity; i < capacity; ++i) {
+            pool[i].next = i + 1 < capacity ? i + 1 : SCENE_COUPLE_NONE;
+        }
+        cs->pool = pool;
+        cs->free = cs->poolCapacity;
+        cs->poolCapacity = capacity;
+    }
+    return true;
+}
+
+static void _scene_couples_link_last(_CollisionCouples *cs, uint32_t idx) {
+    cs->pool[idx].previous = cs->last;
+    cs->pool[idx].next = SCENE_COUPLE_NONE;
+    if (cs->last != SCENE_COUPLE_NONE) {
+        cs->pool[cs->last].next = idx;
+    } else {
+        cs->first = idx;
+    }
+    cs->last = idx;
+}
+
+static void _scene_couples_unlink(_CollisionCouples *cs, uint32_t idx) {
+    const _CollisionCouple *cc = &cs->pool[idx];
+    if (cc->previous != SCENE_COUPLE_NONE) {
+        cs->pool[cc->previous].next = cc->next;
+    } else {
+        cs->first = cc->next;
+    }
+    if (cc->next != SCENE_COUPLE_NONE) {
+        cs->pool[cc->next].previous = cc->previous;
+    } else {
+        cs->last = cc->previous;
+    }
+}
+
+/// Removes couple from the table & the registration order, couple is put back in the free chain,
+/// its weak pointers are not released
+static void _scene_couples_remove(_CollisionCouples *cs, uint32_t idx) {
+    _scene_couples_unlink(cs, idx);
+
+    // following couples of the same probe sequence are shifted back in its place
+    const uint32_t mask = cs->tableCapacity - 1;
+    uint32_t i = _scene_couple_hash(cs->pool[idx].key) & mask;
+    while (cs->table[i] != idx + 1) {
+        i = (i + 1) & mask;
+    }
+    uint32_t j = i;
+    while (true) {
+        j = (j + 1) & mask;
+        if (cs->table[j] == 0) {
+            break;
+        }
+        // couple j can move to i if its ideal slot isn't cyclically within ]i, j]
+        const uint32_t ideal = _scene_couple_hash(cs->pool[cs->table[j] - 1].key) & mask;
+        const bool reachable = i <= j ? (ideal > i && ideal <= j) : (ideal > i || ideal <= j);
+        if (reachable == false) {
+            cs->table[i] = cs->table[j];
+            i = j;
+        }
+    }
+    cs->table[i] = 0;
+    cs->count--;
+
+    cs->pool[idx].next = cs->free;
+    cs->free = idx;
+}
+
+size_t _scene_query_cast_all_ray_array(Scene *sc,
+                                       const Ray *worldRay,
+                                       uint16_t groups,
+                                       uint16_t collidesWith,
+                                       const DoublyLinkedList *excludeLeafPtrs,
+                                       RtreeCastResult *results,
+                                       size_t capacity) {
+    size_t hits = rtree_query_cast_all_ray_array(sc->rtree,
+                                                 worldRay,
+                                                 groups,
+                                                 collidesWith,
+                                                 excludeLeafPtrs,
+                                                 results,
+                                                 capacity);
+    if (sc->broadphase != NULL) {
+        const size_t written = minimum(hits, capacity);
+        hits += broadphase_query_cast_all_ray_array(sc->broadphase,
+                                                    worldRay,
+                                                    groups,
+                                                    collidesWith,
+                                                    excludeLeafPtrs,
+                                                    results + written,
+                                                    capacity - written);
+    }
+    return hits;
+}
+
+/// Cast all query, results are written in given stack array if they fit, or in an array allocated
+/// for this query otherwise, to be freed by caller if it isn't the stack array
+size_t _scene_query_cast_all_ray(Scene *sc,
+                                 const Ray *worldRay,
+                                 uint16_t groups,
+                                 uint16_t collidesWith,
+                                 const DoublyLinkedList *excludeLeafPtrs,
+                                 RtreeCastResult *stackHits,
+                                 RtreeCastResult **hits) {
+    *hits = stackHits;
+    size_t count = _scene_query_cast_all_ray_array(sc,
+                                                   worldRay,
+                                                   groups,
+                                                   collidesWith,
+                                                   excludeLeafPtrs,
+                                                   stackHits,
+                                                   PHYSICS_QUERY_STACK_RESULTS);
+    if (count > PHYSICS_QUERY_STACK_RESULTS) {
+        *hits = (RtreeCastResult *)malloc(count * sizeof(RtreeCastResult));
+        if (*hits == NULL) {
+            *hits = stackHits;
+            return PHYSICS_QUERY_STACK_RESULTS;
+        }
+        count = _scene_query_cast_all_ray_array(sc,
+                                                worldRay,
+                                                groups,
+                                                collidesWith,
+                                                excludeLeafPtrs,
+                                                *hits,
+                                                count);
+    }
+    return count;
+}
+
+size_t _scene_query_cast_all_box(Scene *sc,
+                                 const Box *aabb,
+                                 const float3 *unit,
+                                 float maxDist,
+                                 uint16_t groups,
+                                 uint16_t collidesWith,
+                                 const DoublyLinkedList *excludeLeafPtrs,
+                                 DoublyLinkedList *results) {
+    size_t hits = rtree_query_cast_all_box(sc->rtree,
+                                           aabb,
+                                           unit,
+                                           maxDist,
+                                           groups,
+                                           collidesWith,
+                                           excludeLeafPtrs,
+                                           results);
+    if (sc->broadphase != NULL) {
+        hits += broadphase_query_cast_all_box(sc->broadphase,
+                                              aabb,
+                                              unit,
+                                              maxDist,
+                                              groups,
+                                              collidesWith,
+                                              excludeLeafPtrs,
+                                              results);
+    }
+    return hits;
+}
+
+bool _scene_uses_broadphase(const Scene *sc, const RigidBody *rb) {
+    return sc->broadphase != NULL && rigidbody_is_dynamic(rb);
+}
+
+/// Leaves outside of the r-tree are in the dynamic broadphase
+bool _scene_leaf_in_broadphase(const Scene *sc, const RtreeNode *leaf) {
+    return sc->broadphase != NULL && rtree_node_get_parent(leaf) == NULL;
+}
 
-void _scene_collision_couple_free_func(void *ptr) {
-    _CollisionCouple *cc = (_CollisionCouple *)ptr;
-    weakptr_release(cc->t1);
-    weakptr_release(cc->t2);
-    free(cc);
+void _scene_remove_leaf(Scene *sc, RtreeNode *leaf) {
+    if (_scene_leaf_in_broadphase(sc, leaf)) {
+        broadphase_remove(sc->broadphase, leaf);
+        rtree_free_leaf(sc->rtree, leaf);
+    } else {
+        rtree_remove(sc->rtree, leaf, true);
+    }
 }
 
 void _scene_update_rtree(Scene *sc, RigidBody *rb, Transform *t, Box *collider) {
@@ -56,27 +425,62 @@ void _scene_update_rtree(Scene *sc, RigidBody *rb, Transform *t, Box *collider)
     if (rigidbody_is_enabled(rb) && rigidbody_is_collider_valid(rb) &&
         box_is_valid(collider, EPSILON_COLLISION)) {
 
+        // simulation mode or scene broadphase changes may move the leaf to the other structure
+        if (rigidbody_get_rtree_leaf(rb) != NULL &&
+            _scene_leaf_in_broadphase(sc, rigidbody_get_rtree_leaf(rb)) !=
+                _scene_uses_broadphase(sc, rb)) {
+            scene_register_awake_rigidbody_contacts(sc, rb);
+            _scene_remove_leaf(sc, rigidbody_get_rtree_leaf(rb));
+            rigidbody_set_rtree_leaf(rb, NULL);
+        }
+
         // insert valid collider as a new leaf
         if (rigidbody_get_rtree_leaf(rb) == NULL) {
-            rigidbody_set_rtree_leaf(rb,
-                                     rtree_create_and_insert(sc->rtree,
-                                                             collider,
-                                                             rigidbody_get_groups(rb),
-                                                             rigidbody_get_collides_with(rb),
-                                                             t));
+            if (_scene_uses_broadphase(sc, rb)) {
+                RtreeNode *leaf = rtree_create_leaf(sc->rtree,
+                                                    collider,
+                                                    rigidbody_get_groups(rb),
+                                                    rigidbody_get_collides_with(rb),
+                                                    t);
+                if (leaf != NULL) {
+                    broadphase_insert(sc->broadphase, leaf);
+                }
+                rigidbody_set_rtree_leaf(rb, leaf);
+            } else if (sc->bulkLoading) {
+                RtreeNode *leaf = rtree_create_leaf(sc->rtree,
+                                                    collider,
+                                                    rigidbody_get_groups(rb),
+                                                    rigidbody_get_collides_with(rb),
+                                                    t);
+                rigidbody_set_rtree_leaf(rb, leaf);
+                if (leaf != NULL) {
+                    fifo_list_push(sc->bulkLeaves, leaf);
+                }
+            } else {
+                rigidbody_set_rtree_leaf(rb,
+                                         rtree_create_and_insert(sc->rtree,
+                                                                 collider,
+                                                                 rigidbody_get_groups(rb),
+                                                                 rigidbody_get_collides_with(rb),
+                                                                 t));
+            }
             scene_register_awake_rigidbody_contacts(sc, rb);
         }
         // update leaf due to collider or transformations change
         else if (rigidbody_get_collider_dirty(rb) || transform_is_physics_dirty(t)) {
             scene_register_awake_rigidbody_contacts(sc, rb);
-            rtree_update(sc->rtree, rigidbody_get_rtree_leaf(rb), collider);
+            if (_scene_leaf_in_broadphase(sc, rigidbody_get_rtree_leaf(rb))) {
+                broadphase_update(sc->broadphase, rigidbody_get_rtree_leaf(rb), collider);
+            } else {
+                rtree_update(sc->rtree, rigidbody_get_rtree_leaf(rb), collider);
+            }
             scene_register_awake_rigidbody_contacts(sc, rb);
         }
     }
     // remove disabled rigidbody or invalid collider from rtree
     else if (rigidbody_get_rtree_leaf(rb) != NULL) {
         scene_register_awake_rigidbody_contacts(sc, rb);
-        rtree_remove(sc->rtree, rigidbody_get_rtree_leaf(rb), true);
+        _scene_remove_leaf(sc, rigidbody_get_rtree_leaf(rb));
         rigidbody_set_rtree_leaf(rb, NULL);
     }
 
@@ -84,6 +488,27 @@ void _scene_update_rtree(Scene *sc, RigidBody *rb, Transform *t, Box *collider)
     transform_reset_physics_dirty(t);
 }
 
+void _scene_bulk_load_rtree(Scene *sc) {
+    const size_t count = fifo_list_get_size(sc->bulkLeaves);
+    RtreeNode **leaves = count > 0 ? (RtreeNode **)malloc(count * sizeof(RtreeNode *)) : NULL;
+
+    size_t i = 0;
+    RtreeNode *leaf = (RtreeNode *)fifo_list_pop(sc->bulkLeaves);
+    while (leaf != NULL) {
+        if (leaves != NULL) {
+            leaves[i++] = leaf;
+        } else {
+            rtree_insert(sc->rtree, leaf);
+        }
+        leaf = (RtreeNode *)fifo_list_pop(sc->bulkLeaves);
+    }
+
+    if (leaves != NULL) {
+        rtree_bulk_load(sc->rtree, leaves, count);
+        free(leaves);
+    }
+}
+
 void _scene_refresh_rtree_collision_masks(RigidBody *rb) {
     RtreeNode *rbLeaf = rigidbody_get_rtree_leaf(rb);
 
@@ -99,9 +524,31 @@ void _scene_refresh_rtree_collision_masks(RigidBody *rb) {
     }
 }
 
+/// Rigidbodies stepped every frame by _scene_refresh_recurse
+static bool _scene_is_active_rigidbody(const RigidBody *rb) {
+    return rb != NULL && (rigidbody_is_dynamic(rb) || rigidbody_is_active_trigger(rb));
+}
+
+/// Once a branch is visited, it stays flagged if the transform has work left or if any of its
+/// children is flagged, including changes made to the branch during the pass
+static void _scene_refresh_branch_dirty(Transform *t, bool endOfFrame, bool dirty) {
+    DoublyLinkedListNode *n = transform_get_children_iterator(t);
+    while (dirty == false && n != NULL) {
+        dirty = transform_is_branch_dirty((Transform *)doubly_linked_list_node_pointer(n),
+                                          endOfFrame);
+        n = doubly_linked_list_node_next(n);
+    }
+    transform_toggle_branch_dirty(t, endOfFrame, dirty);
+}
+
+/// Branches are visited if their transform hierarchy is dirty, or if they were flagged since their
+/// last visit, see transform_set_branch_dirty
+/// @param solved dynamic rigidbodies of this branch were solved in islands & are not ticked again,
+/// except those parented to another dynamic rigidbody
 void _scene_refresh_recurse(Scene *sc,
                             Transform *t,
                             bool hierarchyDirty,
+                            bool solved,
                             const TICK_DELTA_SEC_T dt,
                             void *callbackData) {
 
@@ -111,10 +558,11 @@ void _scene_refresh_recurse(Scene *sc,
     // Get rigidbody, compute world collider
     Box collider;
     RigidBody *rb = transform_get_or_compute_world_aligned_collider(t, &collider);
+    const bool isSolved = solved && rb != NULL && rigidbody_is_dynamic(rb);
 
     // Step physics (top-first), collider is kept up-to-date
-    if (rb != NULL) {
-        rigidbody_tick(sc, rb, t, &collider, sc->rtree, dt, callbackData);
+    if (rb != NULL && isSolved == false) {
+        rigidbody_tick(sc, rb, t, &collider, dt, callbackData);
     }
 
     // Refresh transform (top-first) after changes
@@ -126,23 +574,360 @@ void _scene_refresh_recurse(Scene *sc,
         _scene_update_rtree(sc, rb, t, &collider);
     }
 
-    // Recurse down the branch
+    // Recurse down the branch, skipping clean branches
     // ⬆ anything above recursion is executed TOP-FIRST
     DoublyLinkedListNode *n = transform_get_children_iterator(t);
     while (n != NULL) {
-        _scene_refresh_recurse(sc,
-                               (Transform *)doubly_linked_list_node_pointer(n),
-                               hierarchyDirty || transform_is_hierarchy_dirty(t),
-                               dt,
-                               callbackData);
+        Transform *child = (Transform *)doubly_linked_list_node_pointer(n);
+        const bool childHierarchyDirty = hierarchyDirty || transform_is_hierarchy_dirty(t);
+        if (childHierarchyDirty || transform_is_branch_dirty(child, false)) {
+            _scene_refresh_recurse(sc,
+                                   child,
+                                   childHierarchyDirty,
+                                   solved && isSolved == false,
+                                   dt,
+                                   callbackData);
+        }
         n = doubly_linked_list_node_next(n);
     }
     // ⬇ anything after recursion is executed DEEP-FIRST
 
+    // Keep branch flagged (deep-first) while simulated or triggering callbacks
+    _scene_refresh_branch_dirty(t, false, _scene_is_active_rigidbody(rb));
+
     // Clear intra-frame refresh flags (deep-first)
     transform_refresh_children_done(t);
 }
 
+// MARK: Islands
+
+static void _scene_islands_init(_SceneIslands *is) {
+    is->pool = NULL;
+    is->bodies = NULL;
+    is->sweep = NULL;
+    is->order = NULL;
+    is->pushable = NULL;
+    is->islands = NULL;
+    is->jobs = NULL;
+    is->count = 0;
+    is->capacity = 0;
+    is->islandsCount = 0;
+    is->jobsCount = 0;
+    is->jobsCapacity = 0;
+    is->failed = false;
+}
+
+static void _scene_islands_free(_SceneIslands *is) {
+    for (uint32_t i = 0; i < is->jobsCapacity; ++i) {
+        free(is->jobs[i].deferred.events);
+    }
+    free(is->bodies);
+    free(is->sweep);
+    free(is->order);
+    free(is->pushable);
+    free(is->islands);
+    free(is->jobs);
+}
+
+static bool _scene_islands_grow(_SceneIslands *is) {
+    const uint32_t capacity = is->capacity > 0 ? is->capacity * 2
+                                               : SCENE_ISLANDS_INITIAL_CAPACITY;
+
+    _SceneBody *bodies = (_SceneBody *)realloc(is->bodies, capacity * sizeof(_SceneBody));
+    if (bodies == NULL) {
+        return false;
+    }
+    is->bodies = bodies;
+
+    _SceneSweepEntry *sweep = (_SceneSweepEntry *)realloc(is->sweep,
+                                                          capacity * sizeof(_SceneSweepEntry));
+    if (sweep == NULL) {
+        return false;
+    }
+    is->sweep = sweep;
+
+    uint32_t *order = (uint32_t *)realloc(is->order, capacity * sizeof(uint32_t));
+    if (order == NULL) {
+        return false;
+    }
+    is->order = order;
+
+    RigidBody **pushable = (RigidBody **)realloc(is->pushable, capacity * sizeof(RigidBody *));
+    if (pushable == NULL) {
+        return false;
+    }
+    is->pushable = pushable;
+
+    uint32_t *islands = (uint32_t *)realloc(is->islands, (capacity + 1) * sizeof(uint32_t));
+    if (islands == NULL) {
+        return false;
+    }
+    is->islands = islands;
+
+    is->capacity = capacity;
+    return true;
+}
+
+/// Refreshes transforms & r-tree leaves, like _scene_refresh_recurse w/o stepping physics, and
+/// gathers dynamic rigidbodies. Their descendants are refreshed once they are solved
+static void _scene_islands_gather_recurse(Scene *sc, Transform *t, bool hierarchyDirty) {
+    transform_refresh(t, hierarchyDirty, false);
+
+    Box collider;
+    RigidBody *rb = transform_get_or_compute_world_aligned_collider(t, &collider);
+    if (rb != NULL) {
+        _scene_update_rtree(sc, rb, t, &collider);
+
+        if (rigidbody_is_dynamic(rb)) {
+            _SceneIslands *is = &sc->islands;
+            if (is->count == is->capacity && _scene_islands_grow(is) == false) {
+                is->failed = true;
+                return;
+            }
+            _SceneBody *b = &is->bodies[is->count++];
+            b->t = t;
+            b->rb = rb;
+            b->collider = collider;
+            b->pos = *transform_get_position(t);
+            b->moved = false;
+            return;
+        }
+    }
+
+    DoublyLinkedListNode *n = transform_get_children_iterator(t);
+    while (n != NULL) {
+        Transform *child = (Transform *)doubly_linked_list_node_pointer(n);
+        const bool childHierarchyDirty = hierarchyDirty || transform_is_hierarchy_dirty(t);
+        if (childHierarchyDirty || transform_is_branch_dirty(child, false)) {
+            _scene_islands_gather_recurse(sc, child, childHierarchyDirty);
+        }
+        n = doubly_linked_list_node_next(n);
+    }
+}
+
+static int _scene_islands_sweep_compare(const void *a, const void *b) {
+    const _SceneSweepEntry *e1 = (const _SceneSweepEntry *)a;
+    const _SceneSweepEntry *e2 = (const _SceneSweepEntry *)b;
+    if (e1->min != e2->min) {
+        return e1->min < e2->min ? -1 : 1;
+    }
+    return e1->body < e2->body ? -1 : (e1->body > e2->body ? 1 : 0);
+}
+
+static int _scene_islands_address_compare(const void *a, const void *b) {
+    const uintptr_t rb1 = (uintptr_t)(*(RigidBody *const *)a);
+    const uintptr_t rb2 = (uintptr_t)(*(RigidBody *const *)b);
+    return rb1 < rb2 ? -1 : (rb1 > rb2 ? 1 : 0);
+}
+
+static uint32_t _scene_islands_find(_SceneIslands *is, uint32_t i) {
+    while (is->bodies[i].parent != i) {
+        is->bodies[i].parent = is->bodies[is->bodies[i].parent].parent;
+        i = is->bodies[i].parent;
+    }
+    return i;
+}
+
+/// Islands roots are their first rigidbody in hierarchy order
+static void _scene_islands_union(_SceneIslands *is, uint32_t i, uint32_t j) {
+    const uint32_t root1 = _scene_islands_find(is, i);
+    const uint32_t root2 = _scene_islands_find(is, j);
+    if (root1 < root2) {
+        is->bodies[root2].parent = root1;
+    } else if (root2 < root1) {
+        is->bodies[root1].parent = root2;
+    }
+}
+
+/// Groups rigidbodies that may touch each other during the step, from the space they can reach
+/// at their current velocity, motion & acceleration. Rigidbodies may still touch another island
+/// after a push or a replacement, they only read its start-of-step r-tree leaves then
+static void _scene_islands_build(Scene *sc, const float dt) {
+    _SceneIslands *is = &sc->islands;
+    const float3 *g = &sc->constantAcceleration;
+
+    for (uint32_t i = 0; i < is->count; ++i) {
+        _SceneBody *b = &is->bodies[i];
+        const float3 *a = rigidbody_get_constant_acceleration(b->rb);
+        const float3 acceleration = {g->x + a->x, g->y + a->y, g->z + a->z};
+        const float speed = float3_length(rigidbody_get_velocity(b->rb)) +
+                            float3_length(&acceleration) * dt +
+                            float3_length(rigidbody_get_motion(b->rb));
+        const float margin = minimum(speed, PHYSICS_MAX_VELOCITY) * dt + EPSILON_COLLISION;
+
+        b->reach.min = (float3){b->collider.min.x - margin,
+                                b->collider.min.y - margin,
+                                b->collider.min.z - margin};
+        b->reach.max = (float3){b->collider.max.x + margin,
+                                b->collider.max.y + margin,
+                                b->collider.max.z + margin};
+        b->parent = i;
+        is->sweep[i].min = b->reach.min.x;
+        is->sweep[i].body = i;
+    }
+
+    // sweep along x, rigidbodies that can reach & collide w/ each other are in the same island
+    qsort(is->sweep, is->count, sizeof(_SceneSweepEntry), _scene_islands_sweep_compare);
+    for (uint32_t i = 0; i < is->count; ++i) {
+        const _SceneBody *b1 = &is->bodies[is->sweep[i].body];
+        for (uint32_t j = i + 1; j < is->count && is->sweep[j].min <= b1->reach.max.x; ++j) {
+            const _SceneBody *b2 = &is->bodies[is->sweep[j].body];
+            if (box_collide(&b1->reach, &b2->reach) &&
+                rigidbody_collides_with_rigidbody(b1->rb, b2->rb)) {
+                _scene_islands_union(is, is->sweep[i].body, is->sweep[j].body);
+            }
+        }
+    }
+
+    // number islands in order of their roots, & count their rigidbodies
+    is->islandsCount = 0;
+    for (uint32_t i = 0; i < is->count; ++i) {
+        const uint32_t root = _scene_islands_find(is, i);
+        if (root == i) {
+            is->bodies[i].island = is->islandsCount;
+            is->islands[is->islandsCount++] = 0;
+        } else {
+            is->bodies[i].island = is->bodies[root].island;
+        }
+        is->islands[is->bodies[i].island]++;
+    }
+
+    // group rigidbodies, each island start is its end while filling
+    uint32_t start = 0;
+    for (uint32_t k = 0; k < is->islandsCount; ++k) {
+        const uint32_t count = is->islands[k];
+        is->islands[k] = start;
+        start += count;
+    }
+    for (uint32_t i = 0; i < is->count; ++i) {
+        const uint32_t idx = is->islands[is->bodies[i].island]++;
+        is->order[idx] = i;
+        is->pushable[idx] = is->bodies[i].rb;
+    }
+    for (uint32_t k = is->islandsCount; k > 0; --k) {
+        is->islands[k] = is->islands[k - 1];
+    }
+    is->islands[0] = 0;
+}
+
+static void _scene_islands_job(void *userdata) {
+    _SceneIslandsJob *job = (_SceneIslandsJob *)userdata;
+    _SceneIslands *is = &job->sc->islands;
+
+    for (uint32_t k = job->first; k < job->end; ++k) {
+        const uint32_t start = is->islands[k];
+        const uint32_t count = is->islands[k + 1] - start;
+
+        // rigidbodies of the island are only modified by this job
+        qsort(is->pushable + start, count, sizeof(RigidBody *), _scene_islands_address_compare);
+        job->deferred.pushable = is->pushable + start;
+        job->deferred.pushableCount = count;
+
+        for (uint32_t i = start; i < start + count; ++i) {
+            _SceneBody *b = &is->bodies[is->order[i]];
+            b->moved = rigidbody_tick_deferred(job->sc,
+                                               b->rb,
+                                               b->t,
+                                               &b->collider,
+                                               job->dt,
+                                               &job->deferred,
+                                               &b->pos);
+        }
+    }
+}
+
+/// Islands are split in jobs of similar rigidbodies counts, each island is solved by one job in
+/// hierarchy order, results don't depend on the number of jobs or threads
+static void _scene_islands_solve(Scene *sc, const TICK_DELTA_SEC_T dt) {
+    _SceneIslands *is = &sc->islands;
+    is->jobsCount = 0;
+    if (is->islandsCount == 0) {
+        return;
+    }
+
+    const uint32_t workers = thread_pool_get_nb_workers(is->pool);
+    const uint32_t maxJobs = minimum(is->islandsCount,
+                                     (workers + 1) * SCENE_ISLANDS_JOBS_PER_THREAD);
+    if (maxJobs > is->jobsCapacity) {
+        _SceneIslandsJob *jobs = (_SceneIslandsJob *)realloc(is->jobs,
+                                                             maxJobs * sizeof(_SceneIslandsJob));
+        if (jobs == NULL) {
+            return;
+        }
+        for (uint32_t i = is->jobsCapacity; i < maxJobs; ++i) {
+            jobs[i].deferred.events = NULL;
+            jobs[i].deferred.count = 0;
+            jobs[i].deferred.capacity = 0;
+        }
+        is->jobs = jobs;
+        is->jobsCapacity = maxJobs;
+    }
+
+    // each job but the last one gets at least jobSize rigidbodies
+    const uint32_t jobSize = (is->count + maxJobs - 1) / maxJobs;
+    uint32_t k = 0;
+    while (k < is->islandsCount) {
+        _SceneIslandsJob *job = &is->jobs[is->jobsCount++];
+        const uint32_t end = is->islands[k] + jobSize;
+        job->sc = sc;
+        job->dt = dt;
+        job->first = k;
+        do {
+            ++k;
+        } while (k < is->islandsCount && is->islands[k] < end);
+        job->end = k;
+    }
+
+    ThreadPoolBatch *b = workers > 0 && is->jobsCount > 1 ? thread_pool_batch_new(is->pool)
+                                                          : NULL;
+    for (uint32_t i = 0; i < is->jobsCount; ++i) {
+        if (b != NULL) {
+            thread_pool_batch_add_job(b, _scene_islands_job, &is->jobs[i]);
+        } else {
+            _scene_islands_job(&is->jobs[i]);
+        }
+    }
+    thread_pool_batch_wait_and_free(b);
+}
+
+/// Physics step w/ dynamic rigidbodies solved in parallel, from their start-of-step r-tree
+/// leaves, then the hierarchy is refreshed w/ their final positions, before firing their
+/// collision callbacks
+static void _scene_refresh_islands(Scene *sc, const TICK_DELTA_SEC_T dt, void *callbackData) {
+    _SceneIslands *is = &sc->islands;
+    const bool hierarchyDirty = transform_is_hierarchy_dirty(sc->root);
+
+    is->count = 0;
+    is->failed = false;
+    _scene_islands_gather_recurse(sc, sc->root, hierarchyDirty);
+    if (is->failed) {
+        _scene_refresh_recurse(sc, sc->root, hierarchyDirty, false, dt, callbackData);
+        return;
+    }
+    _scene_islands_build(sc, (float)dt);
+
+    // queries only read the scene once shapes & broadphase are ready
+    rtree_recurse(rtree_get_root(sc->rtree), _scene_prepare_shape_rtree);
+    if (sc->broadphase != NULL) {
+        broadphase_refresh(sc->broadphase);
+    }
+    _scene_islands_solve(sc, dt);
+
+    for (uint32_t i = 0; i < is->count; ++i) {
+        const _SceneBody *b = &is->bodies[i];
+        if (b->moved) {
+            transform_set_position(b->t, b->pos.x, b->pos.y, b->pos.z);
+        }
+    }
+    _scene_refresh_recurse(sc, sc->root, hierarchyDirty, is->jobsCount > 0, dt, callbackData);
+
+    for (uint32_t i = 0; i < is->jobsCount; ++i) {
+        rigidbody_deferred_apply(sc, &is->jobs[i].deferred, callbackData);
+    }
+}
+
+/// Branches are visited if their transform hierarchy is dirty, or if they were flagged since their
+/// last end-of-frame visit, see transform_set_branch_dirty
 void _scene_end_of_frame_refresh_recurse(Scene *sc, Transform *t, bool hierarchyDirty) {
     // Transform ends the frame inside scene hierarchy
     transform_set_removed_from_scene(t, false);
@@ -163,13 +948,15 @@ void _scene_end_of_frame_refresh_recurse(Scene *sc, Transform *t, bool hierarchy
         _scene_refresh_rtree_collision_masks(rb);
     }
 
-    // Recurse down the branch
+    // Recurse down the branch, skipping clean branches
     // ⬆ anything above recursion is executed TOP-FIRST
     DoublyLinkedListNode *n = transform_get_children_iterator(t);
     while (n != NULL) {
-        _scene_end_of_frame_refresh_recurse(sc,
-                                            (Transform *)doubly_linked_list_node_pointer(n),
-                                            hierarchyDirty || transform_is_hierarchy_dirty(t));
+        Transform *child = (Transform *)doubly_linked_list_node_pointer(n);
+        const bool childHierarchyDirty = hierarchyDirty || transform_is_hierarchy_dirty(t);
+        if (childHierarchyDirty || transform_is_branch_dirty(child, true)) {
+            _scene_end_of_frame_refresh_recurse(sc, child, childHierarchyDirty);
+        }
         n = doubly_linked_list_node_next(n);
     }
     // ⬇ anything after recursion is executed DEEP-FIRST
@@ -177,12 +964,20 @@ void _scene_end_of_frame_refresh_recurse(Scene *sc, Transform *t, bool hierarchy
     // Clear intra-frame refresh flags (deep-first)
     transform_refresh_children_done(t);
 
-#ifndef P3S_CLIENT_HEADLESS
-    // Refresh shape buffers (deep-first)
+    bool pending = false;
     if (transform_get_type(t) == ShapeTransform) {
-        shape_refresh_vertices(transform_utils_get_shape(t));
-    }
+        Shape *s = transform_utils_get_shape(t);
+#ifndef P3S_CLIENT_HEADLESS
+        // Refresh shape buffers (deep-first)
+        shape_refresh_vertices(s);
+        pending = shape_has_pending_vertices(s);
 #endif
+        // transaction kept pending, or not applied while model is locked
+        pending = pending || shape_has_pending_transaction(s);
+    }
+
+    // Keep branch flagged (deep-first) while shape has work left
+    _scene_refresh_branch_dirty(t, true, pending);
 }
 
 bool _scene_shapes_iterator_func(Transform *t, void *ptr) {
@@ -218,11 +1013,15 @@ Scene *scene_new(Weakptr *g) {
         sc->system = transform_make(HierarchyTransform);
         sc->map = NULL;
         sc->rtree = rtree_new(RTREE_NODE_MIN_CAPACITY, RTREE_NODE_MAX_CAPACITY);
+        sc->broadphase = NULL;
         sc->wptr = NULL;
         sc->game = g;
         sc->removed = fifo_list_new();
-        sc->collisions = doubly_linked_list_new();
+        _scene_couples_init(&sc->collisions);
+        _scene_islands_init(&sc->islands);
         sc->awakeBoxes = doubly_linked_list_new();
+        sc->bulkLeaves = fifo_list_new();
+        sc->bulkLoading = false;
         float3_set(&sc->constantAcceleration, 0.0f, 0.0f, 0.0f);
 
         transform_set_parent(sc->system, sc->root, false);
@@ -243,11 +1042,13 @@ void scene_free(Scene *sc) {
 
     transform_release(sc->system);
     transform_release(sc->root); // triggers release cascade in the hierarchy
+    broadphase_free(sc->broadphase);
     rtree_free(sc->rtree);
     weakptr_invalidate(sc->wptr);
     fifo_list_free(sc->removed, NULL);
-    doubly_linked_list_flush(sc->collisions, _scene_collision_couple_free_func);
-    doubly_linked_list_free(sc->collisions);
+    fifo_list_free(sc->bulkLeaves, NULL);
+    _scene_couples_free(&sc->collisions);
+    _scene_islands_free(&sc->islands);
     doubly_linked_list_flush(sc->awakeBoxes, box_free_std);
     doubly_linked_list_free(sc->awakeBoxes);
 
@@ -284,6 +1085,133 @@ Rtree *scene_get_rtree(Scene *sc) {
     return sc->rtree;
 }
 
+void scene_set_dynamic_broadphase(Scene *sc, BroadphaseType type) {
+    if (scene_get_dynamic_broadphase(sc) == type) {
+        return;
+    }
+
+    // previous broadphase leaves are moved to the r-tree, dynamic rigidbodies leaves are then
+    // moved to the new broadphase on next refresh
+    if (sc->broadphase != NULL) {
+        FifoList *leaves = fifo_list_new();
+        broadphase_flush(sc->broadphase, leaves);
+        RtreeNode *leaf = (RtreeNode *)fifo_list_pop(leaves);
+        while (leaf != NULL) {
+            rtree_insert(sc->rtree, leaf);
+            leaf = (RtreeNode *)fifo_list_pop(leaves);
+        }
+        fifo_list_free(leaves, NULL);
+        broadphase_free(sc->broadphase);
+        sc->broadphase = NULL;
+    }
+    if (type != BroadphaseType_Rtree) {
+        sc->broadphase = broadphase_new(type);
+    }
+}
+
+BroadphaseType scene_get_dynamic_broadphase(const Scene *sc) {
+    return sc->broadphase != NULL ? broadphase_get_type(sc->broadphase) : BroadphaseType_Rtree;
+}
+
+void scene_set_physics_thread_pool(Scene *sc, ThreadPool *pool) {
+    sc->islands.pool = pool;
+}
+
+ThreadPool *scene_get_physics_thread_pool(const Scene *sc) {
+    return sc->islands.pool;
+}
+
+size_t scene_query_overlap_box(Scene *sc,
+                               const Box *aabb,
+                               uint16_t groups,
+                               uint16_t collidesWith,
+                               const DoublyLinkedList *excludeLeafPtrs,
+                               FifoList *results,
+                               float epsilon) {
+    size_t hits = rtree_query_overlap_box(sc->rtree,
+                                          aabb,
+                                          groups,
+                                          collidesWith,
+                                          excludeLeafPtrs,
+                                          results,
+                                          epsilon);
+    if (sc->broadphase != NULL) {
+        hits += broadphase_query_overlap_box(sc->broadphase,
+                                             aabb,
+                                             groups,
+                                             collidesWith,
+                                             excludeLeafPtrs,
+                                             results,
+                                             epsilon);
+    }
+    return hits;
+}
+
+size_t scene_query_overlap_box_array(Scene *sc,
+                                     const Box *aabb,
+                                     uint16_t groups,
+                                     uint16_t collidesWith,
+                                     const DoublyLinkedList *excludeLeafPtrs,
+                                     RtreeNode **results,
+                                     size_t capacity,
+                                     float epsilon) {
+    size_t hits = rtree_query_overlap_box_array(sc->rtree,
+                                                aabb,
+                                                groups,
+                                                collidesWith,
+                                                excludeLeafPtrs,
+                                                results,
+                                                capacity,
+                                                epsilon);
+    if (sc->broadphase != NULL) {
+        const size_t written = results != NULL ? minimum(hits, capacity) : 0;
+        hits += broadphase_query_overlap_box_array(sc->broadphase,
+                                                   aabb,
+                                                   groups,
+                                                   collidesWith,
+                                                   excludeLeafPtrs,
+                                                   results != NULL ? results + written : NULL,
+                                                   capacity - written,
+                                                   epsilon);
+    }
+    return hits;
+}
+
+size_t scene_query_overlap_box_buffer(Scene *sc,
+                                      const Box *aabb,
+                                      uint16_t groups,
+                                      uint16_t collidesWith,
+                                      const DoublyLinkedList *excludeLeafPtrs,
+                                      RtreeNode **stackHits,
+                                      RtreeNode ***hits,
+                                      float epsilon) {
+    *hits = stackHits;
+    size_t count = scene_query_overlap_box_array(sc,
+                                                 aabb,
+                                                 groups,
+                                                 collidesWith,
+                                                 excludeLeafPtrs,
+                                                 stackHits,
+                                                 PHYSICS_QUERY_STACK_RESULTS,
+                                                 epsilon);
+    if (count > PHYSICS_QUERY_STACK_RESULTS) {
+        *hits = (RtreeNode **)malloc(count * sizeof(RtreeNode *));
+        if (*hits == NULL) {
+            *hits = stackHits;
+            return PHYSICS_QUERY_STACK_RESULTS;
+        }
+        count = scene_query_overlap_box_array(sc,
+                                              aabb,
+                                              groups,
+                                              collidesWith,
+                                              excludeLeafPtrs,
+                                              *hits,
+                                              count,
+                                              epsilon);
+    }
+    return count;
+}
+
 void scene_refresh(Scene *sc, const TICK_DELTA_SEC_T dt, void *callbackData) {
     if (sc == NULL) {
         return;
@@ -291,7 +1219,16 @@ void scene_refresh(Scene *sc, const TICK_DELTA_SEC_T dt, void *callbackData) {
 #if DEBUG_RIGIDBODY_EXTRA_LOGS
     cclog_debug("🏞 physics step");
 #endif
-    _scene_refresh_recurse(sc, sc->root, transform_is_hierarchy_dirty(sc->root), dt, callbackData);
+    if (sc->islands.pool != NULL && dt > 0.0) {
+        _scene_refresh_islands(sc, dt, callbackData);
+    } else {
+        _scene_refresh_recurse(sc,
+                               sc->root,
+                               transform_is_hierarchy_dirty(sc->root),
+                               false,
+                               dt,
+                               callbackData);
+    }
 }
 
 void scene_end_of_frame_refresh(Scene *sc, void *callbackData) {
@@ -299,8 +1236,16 @@ void scene_end_of_frame_refresh(Scene *sc, void *callbackData) {
         return;
     }
 
+    // first partition of the scene is done in bulk, eg. after loading a world
+    sc->bulkLoading = rtree_node_get_children_count(rtree_get_root(sc->rtree)) == 0;
+
     _scene_end_of_frame_refresh_recurse(sc, sc->root, transform_is_hierarchy_dirty(sc->root));
 
+    if (sc->bulkLoading) {
+        _scene_bulk_load_rtree(sc);
+        sc->bulkLoading = false;
+    }
+
 #if DEBUG_RTREE_CHECK
     vx_assert(debug_rtree_integrity_check(sc->rtree));
 #endif
@@ -327,7 +1272,7 @@ void scene_end_of_frame_refresh(Scene *sc, void *callbackData) {
             // r-tree leaf removal
             rb = transform_get_rigidbody(t);
             if (rb != NULL && rigidbody_get_rtree_leaf(rb) != NULL) {
-                rtree_remove(sc->rtree, rigidbody_get_rtree_leaf(rb), true);
+                _scene_remove_leaf(sc, rigidbody_get_rtree_leaf(rb));
                 rigidbody_set_rtree_leaf(rb, NULL);
             }
         }
@@ -336,30 +1281,25 @@ void scene_end_of_frame_refresh(Scene *sc, void *callbackData) {
         t = (Transform *)fifo_list_pop(sc->removed);
     }
 
-    // process collision couples for end-of-contact callback
-    n = doubly_linked_list_first(sc->collisions);
-    _CollisionCouple *cc;
+    // end-of-contact for couples not registered during this frame, they come first in
+    // registration order. Couples of removed transforms end once they are no longer registered
+    _CollisionCouples *cs = &sc->collisions;
+    Weakptr *w1, *w2;
     Transform *t2;
-    while (n != NULL) {
-        cc = (_CollisionCouple *)doubly_linked_list_node_pointer(n);
-        t = weakptr_get(cc->t1);
-        t2 = weakptr_get(cc->t2);
-
-        if (t == NULL || t2 == NULL || cc->flag == false) {
-            if (t != NULL && t2 != NULL) {
-                rigidbody_fire_reciprocal_collision_end_callback(t, t2, callbackData);
-            }
-
-            _scene_collision_couple_free_func(cc);
-
-            DoublyLinkedListNode *next = doubly_linked_list_node_next(n);
-            doubly_linked_list_delete_node(sc->collisions, n);
-            n = next;
-        } else {
-            cc->flag = false;
-            n = doubly_linked_list_node_next(n);
+    while (cs->first != SCENE_COUPLE_NONE && cs->pool[cs->first].frame != cs->frame) {
+        w1 = cs->pool[cs->first].t1;
+        w2 = cs->pool[cs->first].t2;
+        _scene_couples_remove(cs, cs->first);
+
+        t = weakptr_get(w1);
+        t2 = weakptr_get(w2);
+        if (t != NULL && t2 != NULL) {
+            rigidbody_fire_reciprocal_collision_end_callback(t, t2, callbackData);
         }
+        weakptr_release(w1);
+        weakptr_release(w2);
     }
+    cs->frame++;
 
     // awake phase
     FifoList *awakeQuery = fifo_list_new();
@@ -370,7 +1310,7 @@ void scene_end_of_frame_refresh(Scene *sc, void *callbackData) {
         awakeBox = (Box *)doubly_linked_list_node_pointer(n);
 
         vx_assert(fifo_list_pop(awakeQuery) == NULL);
-        if (rtree_query_overlap_box(sc->rtree,
+        if (scene_query_overlap_box(sc,
                                     awakeBox,
                                     PHYSICS_GROUP_ALL_SYSTEM,
                                     PHYSICS_GROUP_ALL_SYSTEM,
@@ -460,15 +1400,6 @@ void scene_register_managed_transform(Scene *sc, Transform *t) {
     transform_set_managed_ptr(t, sc->game);
 }
 
-bool _scene_register_collision_couple_func(void *ptr, void *data) {
-    const _CollisionCouple *cc1 = (_CollisionCouple *)ptr;
-    const _CollisionCouple *cc2 = (_CollisionCouple *)data;
-    return (weakptr_get(cc1->t1) == weakptr_get(cc2->t1) &&
-            weakptr_get(cc1->t2) == weakptr_get(cc2->t2)) ||
-           (weakptr_get(cc1->t1) == weakptr_get(cc2->t2) &&
-            weakptr_get(cc1->t2) == weakptr_get(cc2->t1));
-}
-
 CollisionCoupleStatus scene_register_collision_couple(Scene *sc,
                                                       Transform *t1,
                                                       Transform *t2,
@@ -478,31 +1409,38 @@ CollisionCoupleStatus scene_register_collision_couple(Scene *sc,
     }
     vx_assert(wNormal != NULL);
 
-    _CollisionCouple *newCC = (_CollisionCouple *)malloc(sizeof(_CollisionCouple));
-    if (newCC == NULL) {
-        return CollisionCoupleStatus_Discard;
-    }
-    newCC->t1 = transform_get_and_retain_weakptr(t1);
-    newCC->t2 = transform_get_and_retain_weakptr(t2);
-    newCC->wNormal = *wNormal;
-    newCC->flag = true;
-
-    _CollisionCouple *existingCC;
-    if (doubly_linked_list_contains_func(sc->collisions,
-                                         _scene_register_collision_couple_func,
-                                         newCC,
-                                         (void **)&existingCC)) {
-        _scene_collision_couple_free_func(newCC);
-        *wNormal = existingCC->wNormal;
-        if (existingCC->flag) {
+    _CollisionCouples *cs = &sc->collisions;
+    const uint32_t key = _scene_couple_key(t1, t2);
+    uint32_t idx = _scene_couples_find(cs, key, t1, t2);
+    if (idx != SCENE_COUPLE_NONE) {
+        _CollisionCouple *cc = &cs->pool[idx];
+        *wNormal = cc->wNormal;
+        if (cc->frame == cs->frame) {
             return CollisionCoupleStatus_Discard;
-        } else {
-            existingCC->flag = true;
-            return CollisionCoupleStatus_Tick;
         }
+        // most recently registered
+        cc->frame = cs->frame;
+        if (idx != cs->last) {
+            _scene_couples_unlink(cs, idx);
+            _scene_couples_link_last(cs, idx);
+        }
+        return CollisionCoupleStatus_Tick;
     }
 
-    doubly_linked_list_push_last(sc->collisions, newCC);
+    if (_scene_couples_grow(cs) == false) {
+        return CollisionCoupleStatus_Discard;
+    }
+    idx = cs->free;
+    _CollisionCouple *cc = &cs->pool[idx];
+    cs->free = cc->next;
+    cc->t1 = transform_get_and_retain_weakptr(t1);
+    cc->t2 = transform_get_and_retain_weakptr(t2);
+    cc->wNormal = *wNormal;
+    cc->key = key;
+    cc->frame = cs->frame;
+    _scene_couples_link_last(cs, idx);
+    *_scene_couples_probe(cs->table, cs->tableCapacity, key) = idx + 1;
+    cs->count++;
 
     return CollisionCoupleStatus_Begin;
 }
@@ -608,24 +1546,27 @@ HitType scene_cast_ray(Scene *sc,
         return Hit_None;
     }
 
-    DoublyLinkedList *sceneQuery = doubly_linked_list_new();
-    if (rtree_query_cast_all_ray(sc->rtree,
-                                 worldRay,
-                                 PHYSICS_GROUP_NONE,
-                                 groups,
-                                 filterOutTransforms,
-                                 sceneQuery) > 0) {
+    RtreeCastResult stackHits[PHYSICS_QUERY_STACK_RESULTS], *hits;
+    const size_t hitsCount = _scene_query_cast_all_ray(sc,
+                                                       worldRay,
+                                                       PHYSICS_GROUP_NONE,
+                                                       groups,
+                                                       filterOutTransforms,
+                                                       stackHits,
+                                                       &hits);
+    if (hitsCount > 0) {
 
         // sort query results by distance
-        doubly_linked_list_sort_ascending(sceneQuery, rtree_utils_result_sort_func);
+        rtree_utils_sort_results(hits, hitsCount);
 
         // process query results in order, to return first hit block or collision box
-        DoublyLinkedListNode *n = doubly_linked_list_first(sceneQuery);
         RtreeCastResult *rtreeHit;
         Transform *hitTr;
         RigidBody *hitRb;
-        while (n != NULL) {
-            rtreeHit = (RtreeCastResult *)doubly_linked_list_node_pointer(n);
+        Ray modelRay;
+        float3 modelRayStorage[3];
+        for (size_t i = 0; i < hitsCount; ++i) {
+            rtreeHit = &hits[i];
             hitTr = (Transform *)rtree_node_get_leaf_ptr(rtreeHit->rtreeLeaf);
             hitRb = transform_get_rigidbody(hitTr);
 
@@ -658,13 +1599,13 @@ HitType scene_cast_ray(Scene *sc,
                                          ? shape_get_pivot_transform(
                                                transform_utils_get_shape(hitTr))
                                          : hitTr;
-                Ray *modelRay = ray_world_to_local(worldRay, modelTr);
+                ray_init_world_to_local(&modelRay, modelRayStorage, worldRay, modelTr);
 
                 float distance;
-                if (ray_intersect_with_box(modelRay, &collider->min, &collider->max, &distance)) {
-                    const float3 modelVector = {modelRay->dir->x * distance,
-                                                modelRay->dir->y * distance,
-                                                modelRay->dir->z * distance};
+                if (ray_intersect_with_box(&modelRay, &collider->min, &collider->max, &distance)) {
+                    const float3 modelVector = {modelRay.dir->x * distance,
+                                                modelRay.dir->y * distance,
+                                                modelRay.dir->z * distance};
                     float3 worldVector;
                     transform_utils_vector_ltw(modelTr, &modelVector, &worldVector);
 
@@ -675,15 +1616,12 @@ HitType scene_cast_ray(Scene *sc,
                         hit.type = Hit_CollisionBox;
                     }
                 }
-
-                ray_free(modelRay);
             }
-
-            n = doubly_linked_list_node_next(n);
         }
     }
-    doubly_linked_list_flush(sceneQuery, free);
-    doubly_linked_list_free(sceneQuery);
+    if (hits != stackHits) {
+        free(hits);
+    }
 
     if (result != NULL) {
         *result = hit;
@@ -702,23 +1640,26 @@ size_t scene_cast_all_ray(Scene *sc,
         return 0;
     }
 
-    DoublyLinkedList *sceneQuery = doubly_linked_list_new();
+    RtreeCastResult stackHits[PHYSICS_QUERY_STACK_RESULTS], *hits;
+    const size_t hitsCount = _scene_query_cast_all_ray(sc,
+                                                       worldRay,
+                                                       PHYSICS_GROUP_NONE,
+                                                       groups,
+                                                       filterOutTransforms,
+                                                       stackHits,
+                                                       &hits);
     size_t count = 0;
-    if (rtree_query_cast_all_ray(sc->rtree,
-                                 worldRay,
-                                 PHYSICS_GROUP_NONE,
-                                 groups,
-                                 filterOutTransforms,
-                                 sceneQuery) > 0) {
+    if (hitsCount > 0) {
 
         // process query results to confirm intersections w/ per-block and rotated colliders
-        DoublyLinkedListNode *n = doubly_linked_list_first(sceneQuery);
         RtreeCastResult *rtreeHit;
         Transform *hitTr;
         RigidBody *hitRb;
         CastResult *hit;
-        while (n != NULL) {
-            rtreeHit = (RtreeCastResult *)doubly_linked_list_node_pointer(n);
+        Ray modelRay;
+        float3 modelRayStorage[3];
+        for (size_t i = 0; i < hitsCount; ++i) {
+            rtreeHit = &hits[i];
             hitTr = (Transform *)rtree_node_get_leaf_ptr(rtreeHit->rtreeLeaf);
             hitRb = transform_get_rigidbody(hitTr);
             hit = NULL;
@@ -748,13 +1689,13 @@ size_t scene_cast_all_ray(Scene *sc,
                                          ? shape_get_pivot_transform(
                                                transform_utils_get_shape(hitTr))
                                          : hitTr;
-                Ray *modelRay = ray_world_to_local(worldRay, modelTr);
+                ray_init_world_to_local(&modelRay, modelRayStorage, worldRay, modelTr);
 
                 float distance;
-                if (ray_intersect_with_box(modelRay, &collider->min, &collider->max, &distance)) {
-                    const float3 modelVector = {modelRay->dir->x * distance,
-                                                modelRay->dir->y * distance,
-                                                modelRay->dir->z * distance};
+                if (ray_intersect_with_box(&modelRay, &collider->min, &collider->max, &distance)) {
+                    const float3 modelVector = {modelRay.dir->x * distance,
+                                                modelRay.dir->y * distance,
+                                                modelRay.dir->z * distance};
                     float3 worldVector;
                     transform_utils_vector_ltw(modelTr, &modelVector, &worldVector);
 
@@ -763,20 +1704,17 @@ size_t scene_cast_all_ray(Scene *sc,
                     hit->distance = float3_length(&worldVector);
                     hit->type = Hit_CollisionBox;
                 }
-
-                ray_free(modelRay);
             }
 
             if (hit != NULL) {
                 doubly_linked_list_push_last(results, hit);
                 ++count;
             }
-
-            n = doubly_linked_list_node_next(n);
         }
     }
-    doubly_linked_list_flush(sceneQuery, free);
-    doubly_linked_list_free(sceneQuery);
+    if (hits != stackHits) {
+        free(hits);
+    }
 
     // sort query results by distance
     doubly_linked_list_sort_ascending(results, rtree_utils_result_sort_func);
@@ -784,6 +1722,90 @@ size_t scene_cast_all_ray(Scene *sc,
     return count;
 }
 
+typedef struct {
+    Scene *sc;
+    const CastRayQuery *queries;
+    CastResult *results;
+    size_t count;
+    size_t hits;
+} _SceneCastRaysJob;
+
+static void _scene_cast_rays_job(void *userdata) {
+    _SceneCastRaysJob *job = (_SceneCastRaysJob *)userdata;
+    for (size_t i = 0; i < job->count; ++i) {
+        const CastRayQuery *q = &job->queries[i];
+        const HitType type = scene_cast_ray(job->sc,
+                                            q->worldRay,
+                                            q->groups,
+                                            q->filterOutTransforms,
+                                            &job->results[i]);
+        if (type != Hit_None) {
+            job->hits++;
+        }
+    }
+}
+
+/// Shapes chunks r-trees are partitioned on first query, this can't happen from several threads
+static void _scene_prepare_shape_rtree(RtreeNode *rn) {
+    if (rtree_node_is_leaf(rn) == false) {
+        return;
+    }
+    Transform *t = (Transform *)rtree_node_get_leaf_ptr(rn);
+    if (transform_get_type(t) == ShapeTransform &&
+        rigidbody_uses_per_block_collisions(transform_get_rigidbody(t))) {
+        shape_get_rtree(transform_utils_get_shape(t));
+    }
+}
+
+size_t scene_cast_rays(Scene *sc,
+                       const CastRayQuery *queries,
+                       size_t count,
+                       CastResult *results) {
+
+    if (queries == NULL || results == NULL || count == 0) {
+        return 0;
+    }
+
+    const size_t nbJobs = (count + SCENE_CAST_RAYS_JOB_SIZE - 1) / SCENE_CAST_RAYS_JOB_SIZE;
+    ThreadPool *pool = nbJobs > 1 ? thread_pool_get_shared() : NULL;
+    if (pool == NULL || thread_pool_get_nb_workers(pool) == 0) {
+        _SceneCastRaysJob job = {sc, queries, results, count, 0};
+        _scene_cast_rays_job(&job);
+        return job.hits;
+    }
+
+    // queries only read the scene once shapes are ready
+    rtree_recurse(rtree_get_root(sc->rtree), _scene_prepare_shape_rtree);
+
+    _SceneCastRaysJob *jobs = (_SceneCastRaysJob *)malloc(nbJobs * sizeof(_SceneCastRaysJob));
+    if (jobs == NULL) {
+        return 0;
+    }
+    ThreadPoolBatch *b = thread_pool_batch_new(pool);
+    for (size_t i = 0; i < nbJobs; ++i) {
+        const size_t start = i * SCENE_CAST_RAYS_JOB_SIZE;
+        jobs[i].sc = sc;
+        jobs[i].queries = queries + start;
+        jobs[i].results = results + start;
+        jobs[i].count = minimum(count - start, SCENE_CAST_RAYS_JOB_SIZE);
+        jobs[i].hits = 0;
+        if (b != NULL) {
+            thread_pool_batch_add_job(b, _scene_cast_rays_job, &jobs[i]);
+        } else {
+            _scene_cast_rays_job(&jobs[i]);
+        }
+    }
+    thread_pool_batch_wait_and_free(b);
+
+    size_t hits = 0;
+    for (size_t i = 0; i < nbJobs; ++i) {
+        hits += jobs[i].hits;
+    }
+    free(jobs);
+
+    return hits;
+}
+
 Block *scene_cast_ray_shape_only(Scene *sc,
                                  const Shape *sh,
                                  const Ray *worldRay,
@@ -836,14 +1858,14 @@ HitType scene_cast_box(Scene *sc,
     }
 
     DoublyLinkedList *sceneQuery = doubly_linked_list_new();
-    if (rtree_query_cast_all_box(sc->rtree,
-                                 aabb,
-                                 unit,
-                                 maxDist,
-                                 PHYSICS_GROUP_NONE,
-                                 groups,
-                                 filterOutTransforms,
-                                 sceneQuery)) {
+    if (_scene_query_cast_all_box(sc,
+                                  aabb,
+                                  unit,
+                                  maxDist,
+                                  PHYSICS_GROUP_NONE,
+                                  groups,
+                                  filterOutTransforms,
+                                  sceneQuery)) {
 
         // sort query results by distance
         doubly_linked_list_sort_ascending(sceneQuery, rtree_utils_result_sort_func);
@@ -982,14 +2004,14 @@ size_t scene_cast_all_box(Scene *sc,
 
     DoublyLinkedList *sceneQuery = doubly_linked_list_new();
     size_t count = 0;
-    if (rtree_query_cast_all_box(sc->rtree,
-                                 aabb,
-                                 unit,
-                                 maxDist,
-                                 PHYSICS_GROUP_NONE,
-                                 groups,
-                                 filterOutTransforms,
-                                 sceneQuery)) {
+    if (_scene_query_cast_all_box(sc,
+                                  aabb,
+                                  unit,
+                                  maxDist,
+                                  PHYSICS_GROUP_NONE,
+                                  groups,
+                                  filterOutTransforms,
+                                  sceneQuery)) {
 
         // process query results to confirm intersections w/ per-block and rotated colliders
         DoublyLinkedListNode *n = doubly_linked_list_first(sceneQuery);
@@ -1118,21 +2140,24 @@ bool scene_overlap_box(Scene *sc,
         return false;
     }
 
-    FifoList *sceneQuery = fifo_list_new();
+    RtreeNode *stackHits[PHYSICS_QUERY_STACK_RESULTS], **sceneHits;
+    const size_t sceneHitsCount = scene_query_overlap_box_buffer(sc,
+                                                                 aabb,
+                                                                 groups,
+                                                                 collidesWith,
+                                                                 filterOutTransforms,
+                                                                 stackHits,
+                                                                 &sceneHits,
+                                                                 EPSILON_COLLISION);
     size_t hits = 0;
-    if (rtree_query_overlap_box(sc->rtree,
-                                aabb,
-                                groups,
-                                collidesWith,
-                                filterOutTransforms,
-                                sceneQuery,
-                                EPSILON_COLLISION) > 0) {
-        RtreeNode *hit = fifo_list_pop(sceneQuery);
+    if (sceneHitsCount > 0) {
+        RtreeNode *hit;
         Transform *hitLeaf;
         RigidBody *hitRb;
         Shape *s;
         Box model;
-        while (hit != NULL) {
+        for (size_t i = 0; i < sceneHitsCount && (results != NULL || hits == 0); ++i) {
+            hit = sceneHits[i];
             hitLeaf = (Transform *)rtree_node_get_leaf_ptr(hit);
             vx_assert(rtree_node_is_leaf(hit));
 
@@ -1153,10 +2178,8 @@ bool scene_overlap_box(Scene *sc,
                         result->hitTr = hitLeaf;
                         result->type = Hit_Block;
                         fifo_list_push(results, result);
-                        ++hits;
-                    } else {
-                        return true;
                     }
+                    ++hits;
                 }
             } else {
                 if (results != NULL) {
@@ -1164,16 +2187,14 @@ bool scene_overlap_box(Scene *sc,
                     result->hitTr = hitLeaf;
                     result->type = Hit_CollisionBox;
                     fifo_list_push(results, result);
-                    ++hits;
-                } else {
-                    return true;
                 }
+                ++hits;
             }
-
-            hit = fifo_list_pop(sceneQuery);
         }
     }
-    fifo_list_free(sceneQuery, NULL);
+    if (sceneHits != stackHits) {
+        free(sceneHits);
+    }
 
     return hits > 0;
 }
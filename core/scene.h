@@ -10,10 +10,12 @@
 extern "C" {
 #endif
 
+#include "broadphase.h"
 #include "fifo_list.h"
 #include "rigidBody.h"
 #include "rtree.h"
 #include "shape.h"
+#include "thread_pool.h"
 #include "utils.h"
 
 #if DEBUG
@@ -46,6 +48,44 @@ Transform *scene_get_root(Scene *sc);
 Transform *scene_get_system_root(Scene *sc);
 Rtree *scene_get_rtree(Scene *sc);
 
+/// Broadphase used for dynamic rigidbodies, other colliders are always in the r-tree.
+/// Dynamic rigidbodies leaves are moved to the new broadphase on next refresh
+void scene_set_dynamic_broadphase(Scene *sc, BroadphaseType type);
+BroadphaseType scene_get_dynamic_broadphase(const Scene *sc);
+/// Physics steps solve dynamic rigidbodies in parallel on given pool if set, grouped in islands of
+/// rigidbodies that may touch each other, from start-of-step colliders. Results don't depend on the
+/// number of workers. Their pushes across islands & collision callbacks are applied at the end of
+/// the step. NULL (default) solves rigidbodies one by one during the hierarchy refresh
+void scene_set_physics_thread_pool(Scene *sc, ThreadPool *pool);
+ThreadPool *scene_get_physics_thread_pool(const Scene *sc);
+/// Overlap query against all scene colliders, same parameters as rtree_query_overlap_box
+size_t scene_query_overlap_box(Scene *sc,
+                               const Box *aabb,
+                               uint16_t groups,
+                               uint16_t collidesWith,
+                               const DoublyLinkedList *excludeLeafPtrs,
+                               FifoList *results,
+                               float epsilon);
+/// Same query w/o allocation, see rtree_query_overlap_box_array
+size_t scene_query_overlap_box_array(Scene *sc,
+                                     const Box *aabb,
+                                     uint16_t groups,
+                                     uint16_t collidesWith,
+                                     const DoublyLinkedList *excludeLeafPtrs,
+                                     RtreeNode **results,
+                                     size_t capacity,
+                                     float epsilon);
+/// Same query w/ results written in given stack array of PHYSICS_QUERY_STACK_RESULTS if they fit,
+/// or in an array allocated for this query otherwise, to be freed by caller if it isn't stackHits
+size_t scene_query_overlap_box_buffer(Scene *sc,
+                                      const Box *aabb,
+                                      uint16_t groups,
+                                      uint16_t collidesWith,
+                                      const DoublyLinkedList *excludeLeafPtrs,
+                                      RtreeNode **stackHits,
+                                      RtreeNode ***hits,
+                                      float epsilon);
+
 /// FRAME REFRESH ORDER:
 /// - physics and core tick+refresh (this function)
 /// - scripting tick
@@ -123,6 +163,14 @@ typedef struct {
 } CastResult;
 CastResult scene_cast_result_default(void);
 
+typedef struct {
+    const Ray *worldRay;
+    const DoublyLinkedList *filterOutTransforms;
+    uint16_t groups;
+
+    char pad[6];
+} CastRayQuery;
+
 typedef struct {
     Transform *hitTr;
     HitType type;
@@ -140,6 +188,14 @@ size_t scene_cast_all_ray(Scene *sc,
                           uint16_t groups,
                           const DoublyLinkedList *filterOutTransforms,
                           DoublyLinkedList *results);
+/// Batched ray casts, each query is cast like scene_cast_ray w/ its own groups & filter, results
+/// are written at the same index. Large batches are spread over worker threads, the scene must not
+/// be modified until it returns
+/// @returns number of rays hitting something
+size_t scene_cast_rays(Scene *sc,
+                       const CastRayQuery *queries,
+                       size_t count,
+                       CastResult *results);
 Block *scene_cast_ray_shape_only(Scene *sc,
                                  const Shape *sh,
                                  const Ray *worldRay,
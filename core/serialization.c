@@ -13,9 +13,15 @@
 #include "serialization_v5.h"
 #include "serialization_v6.h"
 #include "stream.h"
+#include "thread_pool.h"
 #include "transform.h"
 #include "zlib.h"
 
+// Sources bigger than this are compressed in several slices, in parallel
+#define SERIALIZATION_COMPRESSION_SLICE_SIZE 131072
+// Each slice is primed w/ the end of previous slice to keep compression ratio (deflate window)
+#define SERIALIZATION_COMPRESSION_DICT_SIZE 32768
+
 // Returns 0 on success, 1 otherwise.
 // This function doesn't close the file descriptor, you probably want to close
 // it in the calling context, when an error occurs.
@@ -217,6 +223,65 @@ bool serialization_save_shape(Shape *shape,
     return success;
 }
 
+typedef struct {
+    SerializationV6Snapshot *snapshot;
+    FILE *fd;
+    serialization_save_callback callback;
+    void *userdata;
+} _AsyncSave;
+
+static void _serialization_save_shape_async_job(void *ptr) {
+    _AsyncSave *save = (_AsyncSave *)ptr;
+
+    bool success = false;
+    if (fwrite(MAGIC_BYTES, sizeof(char), MAGIC_BYTES_SIZE, save->fd) != MAGIC_BYTES_SIZE) {
+        cclog_error("failed to write magic bytes");
+    } else {
+        success = serialization_v6_snapshot_write(save->snapshot, save->fd);
+    }
+    fclose(save->fd);
+    serialization_v6_snapshot_free(save->snapshot);
+
+    if (save->callback != NULL) {
+        save->callback(success, save->userdata);
+    }
+    free(save);
+}
+
+bool serialization_save_shape_async(Shape *shape,
+                                    const void *imageData,
+                                    const uint32_t imageDataSize,
+                                    FILE *fd,
+                                    serialization_save_callback callback,
+                                    void *userdata) {
+
+    if (fd == NULL) {
+        cclog_error("file descriptor is NULL");
+        return false;
+    }
+
+    _AsyncSave *save = (_AsyncSave *)malloc(sizeof(_AsyncSave));
+    if (save == NULL) {
+        fclose(fd);
+        return false;
+    }
+
+    // edits made after this point don't affect the file
+    save->snapshot = serialization_v6_snapshot_new(shape, imageData, imageDataSize);
+    if (save->snapshot == NULL) {
+        cclog_error("failed to snapshot shape");
+        free(save);
+        fclose(fd);
+        return false;
+    }
+    save->fd = fd;
+    save->callback = callback;
+    save->userdata = userdata;
+
+    thread_pool_add_job(thread_pool_get_shared(), _serialization_save_shape_async_job, save);
+    return true;
+}
+
 /// serialize a shape in a newly created memory buffer
 /// Arguments:
 /// - shape (mandatory)
@@ -332,6 +397,162 @@ void serialization_utils_writeUint32(void *dest, const uint32_t src, uint32_t *c
     }
 }
 
+// --------------------------------------------------
+// MARK: - Compression -
+// --------------------------------------------------
+
+typedef struct {
+    const uint8_t *src;
+    const uint8_t *dict;
+    uint8_t *dst;
+    uLong adler;
+    uint32_t srcSize;
+    uint32_t dictSize;
+    uint32_t dstSize;
+    bool last;
+    bool ok;
+    char pad[2];
+} _CompressionSlice;
+
+// Compresses one slice as raw deflate data. Non-final slices end on a byte boundary
+// (Z_SYNC_FLUSH), so that slices can simply be concatenated (same technique as pigz).
+static void _compression_slice_job(void *ptr) {
+    _CompressionSlice *slice = (_CompressionSlice *)ptr;
+    slice->ok = false;
+    slice->adler = adler32(adler32(0L, Z_NULL, 0), slice->src, slice->srcSize);
+
+    z_stream z;
+    memset(&z, 0, sizeof(z_stream));
+    // same parameters as zlib's `compress`, w/o zlib header & trailer (negative window bits)
+    if (deflateInit2(&z, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY) !=
+        Z_OK) {
+        return;
+    }
+    if (slice->dictSize > 0 &&
+        deflateSetDictionary(&z, slice->dict, (uInt)slice->dictSize) != Z_OK) {
+        deflateEnd(&z);
+        return;
+    }
+
+    // room for the sync flush marker
+    const uLong bound = deflateBound(&z, slice->srcSize) + 16;
+    slice->dst = (uint8_t *)malloc(bound);
+    if (slice->dst == NULL) {
+        deflateEnd(&z);
+        return;
+    }
+
+    z.next_in = (Bytef *)slice->src;
+    z.avail_in = (uInt)slice->srcSize;
+    z.next_out = slice->dst;
+    z.avail_out = (uInt)bound;
+
+    const int ret = deflate(&z, slice->last ? Z_FINISH : Z_SYNC_FLUSH);
+    slice->ok = slice->last ? ret == Z_STREAM_END : (ret == Z_OK && z.avail_in == 0);
+    slice->dstSize = (uint32_t)(bound - z.avail_out);
+    deflateEnd(&z);
+}
+
+bool serialization_utils_compress_parallel(SerializationCompressionTask *tasks, size_t count) {
+    if (tasks == NULL || count == 0) {
+        return true;
+    }
+
+    // split all tasks in slices
+    size_t nbSlices = 0;
+    for (size_t i = 0; i < count; ++i) {
+        tasks[i].dst = NULL;
+        tasks[i].dstSize = 0;
+        nbSlices += tasks[i].srcSize > 0
+                        ? (tasks[i].srcSize + SERIALIZATION_COMPRESSION_SLICE_SIZE - 1) /
+                              SERIALIZATION_COMPRESSION_SLICE_SIZE
+                        : 1;
+    }
+
+    _CompressionSlice *slices = (_CompressionSlice *)calloc(nbSlices, sizeof(_CompressionSlice));
+    if (slices == NULL) {
+        return false;
+    }
+
+    ThreadPoolBatch *batch = thread_pool_batch_new(thread_pool_get_shared());
+    if (batch == NULL) {
+        free(slices);
+        return false;
+    }
+
+    size_t sliceIdx = 0;
+    for (size_t i = 0; i < count; ++i) {
+        const uint8_t *src = (const uint8_t *)tasks[i].src;
+        uint32_t offset = 0;
+        do {
+            _CompressionSlice *slice = &slices[sliceIdx++];
+            slice->src = src + offset;
+            slice->srcSize = minimum(tasks[i].srcSize - offset,
+                                     (uint32_t)SERIALIZATION_COMPRESSION_SLICE_SIZE);
+            slice->dictSize = minimum(offset, (uint32_t)SERIALIZATION_COMPRESSION_DICT_SIZE);
+            slice->dict = slice->src - slice->dictSize;
+            offset += slice->srcSize;
+            slice->last = offset >= tasks[i].srcSize;
+            thread_pool_batch_add_job(batch, _compression_slice_job, slice);
+        } while (offset < tasks[i].srcSize);
+    }
+
+    thread_pool_batch_wait_and_free(batch);
+
+    // stitch slices: zlib header | slices | adler32 (big endian)
+    bool ok = true;
+    sliceIdx = 0;
+    for (size_t i = 0; i < count; ++i) {
+        const size_t firstSlice = sliceIdx;
+        uint32_t size = 2 + 4;
+        uLong adler = adler32(0L, Z_NULL, 0);
+        do {
+            ok = ok && slices[sliceIdx].ok;
+            size += slices[sliceIdx].dstSize;
+            adler = adler32_combine(adler, slices[sliceIdx].adler, (z_off_t)slices[sliceIdx].srcSize);
+        } while (slices[sliceIdx++].last == false);
+
+        if (ok == false) {
+            continue;
+        }
+
+        uint8_t *dst = (uint8_t *)malloc(size);
+        if (dst == NULL) {
+            ok = false;
+            continue;
+        }
+        uint8_t *cursor = dst;
+        *cursor++ = 0x78; // deflate, 32K window
+        *cursor++ = 0x9C; // default compression level, header checksum
+        for (size_t j = firstSlice; j < sliceIdx; ++j) {
+            memcpy(cursor, slices[j].dst, slices[j].dstSize);
+            cursor += slices[j].dstSize;
+        }
+        *cursor++ = (uint8_t)(adler >> 24);
+        *cursor++ = (uint8_t)(adler >> 16);
+        *cursor++ = (uint8_t)(adler >> 8);
+        *cursor++ = (uint8_t)adler;
+
+        tasks[i].dst = dst;
+        tasks[i].dstSize = size;
+    }
+
+    for (size_t i = 0; i < nbSlices; ++i) {
+        free(slices[i].dst);
+    }
+    free(slices);
+
+    if (ok == false) {
+        for (size_t i = 0; i < count; ++i) {
+            free(tasks[i].dst);
+            tasks[i].dst = NULL;
+            tasks[i].dstSize = 0;
+        }
+    }
+
+    return ok;
+}
+
 // MARK: - Baked files -
 
 bool serialization_save_baked_file(const Shape *s, uint64_t hash, FILE *fd) {
@@ -359,7 +580,8 @@ bool serialization_save_baked_file(const Shape *s, uint64_t hash, FILE *fd) {
         return false;
     }
 
-    // write chunks
+    // write chunks, uniform lighting is expanded (compresses to a few bytes)
+    VERTEX_LIGHT_STRUCT_T uniformData[CHUNK_SIZE_CUBE];
     Chunk *chunk;
     Index3DIterator *it = index3d_iterator_new(shape_get_chunks(s));
     while (index3d_iterator_pointer(it) != NULL) {
@@ -377,6 +599,10 @@ bool serialization_save_baked_file(const Shape *s, uint64_t hash, FILE *fd) {
         const size_t size = (size_t)CHUNK_SIZE_CUBE * (size_t)sizeof(VERTEX_LIGHT_STRUCT_T);
         uLong compressedSize = compressBound(size);
         const void *uncompressedData = chunk_get_lighting_data(chunk);
+        if (uncompressedData == NULL) {
+            chunk_write_lighting_data(chunk, uniformData);
+            uncompressedData = uniformData;
+        }
         void *compressedData = malloc(compressedSize);
         if (compress(compressedData, &compressedSize, uncompressedData, size) != Z_OK) {
             cclog_error("baked file: failed to compress lighting data");
@@ -117,6 +117,19 @@ bool serialization_save_shape(Shape *shape,
                               const uint32_t imageDataSize,
                               FILE *fd); // file opened with "wb" flag (closed within function)
 
+/// called once an asynchronous save is done, from a background thread
+typedef void (*serialization_save_callback)(bool success, void *userdata);
+
+/// Same as serialization_save_shape, but only snapshots the shape on the calling thread,
+/// compression & writing happen on the shared thread pool. Later edits don't affect the file.
+/// Returns false if the snapshot could not be taken (fd is then closed, callback not called).
+bool serialization_save_shape_async(Shape *shape,
+                                    const void *imageData,
+                                    const uint32_t imageDataSize,
+                                    FILE *fd, // opened with "wb" flag (closed when done)
+                                    serialization_save_callback callback,
+                                    void *userdata);
+
 /// serialize a shape in a newly created memory buffer
 bool serialization_save_shape_as_buffer(Shape *shape,
                                         ColorPalette *artistPalette,
@@ -160,6 +173,23 @@ void serialization_utils_writeUint16(void *dest, const uint16_t src, uint32_t *c
 ///
 void serialization_utils_writeUint32(void *dest, const uint32_t src, uint32_t *cursor);
 
+// --------------------------------------------------
+// MARK: - Compression -
+// --------------------------------------------------
+
+typedef struct {
+    const void *src;    // input
+    void *dst;          // output, allocated by the compression function, freed by caller
+    uint32_t srcSize;   // input
+    uint32_t dstSize;   // output
+} SerializationCompressionTask;
+
+/// Compresses each task's source as a zlib stream (same format as zlib's `compress`).
+/// Tasks are dispatched to the shared thread pool, large sources are split in slices
+/// compressed in parallel and stitched back into a single stream.
+/// Returns false if any task failed, outputs are then freed and set to NULL.
+bool serialization_utils_compress_parallel(SerializationCompressionTask *tasks, size_t count);
+
 // MARK: - Baked files -
 
 bool serialization_save_baked_file(const Shape *s, uint64_t hash, FILE *fd);   // does not close fd
@@ -0,0 +1,459 @@
+// -------------------------------------------------------------
+//  Cubzh Core
+//  serialization_journal.c
+// -------------------------------------------------------------
+
+#include "serialization_journal.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "cclog.h"
+#include "chunk.h"
+#include "index3d.h"
+#include "int3.h"
+#include "serialization.h"
+#include "stream.h"
+#include "zlib.h"
+
+#define JOURNAL_MAGIC_BYTES "CZHJNL"
+#define JOURNAL_MAGIC_BYTES_SIZE 6
+#define JOURNAL_VERSION 2
+#define JOURNAL_PALETTE_ENTRY_SIZE (sizeof(RGBAColor) + sizeof(uint8_t))
+#define JOURNAL_CHUNK_SIZE (3 * sizeof(int16_t) + CHUNK_SIZE_CUBE)
+#define JOURNAL_FILE_READ_BUFFER_SIZE 65536
+
+typedef struct {
+    uint32_t baseCRC;
+    uint32_t baseSize;
+} JournalHeader;
+
+// MARK: - Private functions -
+
+static char *_journal_path(const char *filepath) {
+    const size_t len = strlen(filepath);
+    const size_t extLen = strlen(SERIALIZATION_JOURNAL_EXTENSION);
+    char *path = (char *)malloc(len + extLen + 1);
+    if (path == NULL) {
+        return NULL;
+    }
+    memcpy(path, filepath, len);
+    memcpy(path + len, SERIALIZATION_JOURNAL_EXTENSION, extLen + 1);
+    return path;
+}
+
+static bool _journal_file_size(const char *filepath, uint32_t *size) {
+    FILE *fd = fopen(filepath, "rb");
+    if (fd == NULL) {
+        return false;
+    }
+    const bool ok = fseek(fd, 0, SEEK_END) == 0;
+    const long end = ftell(fd);
+    fclose(fd);
+    if (ok == false || end < 0) {
+        return false;
+    }
+    *size = (uint32_t)end;
+    return true;
+}
+
+static bool _journal_file_crc(const char *filepath, uint32_t *crc, uint32_t *size) {
+    FILE *fd = fopen(filepath, "rb");
+    if (fd == NULL) {
+        return false;
+    }
+    uint8_t *buffer = (uint8_t *)malloc(JOURNAL_FILE_READ_BUFFER_SIZE);
+    if (buffer == NULL) {
+        fclose(fd);
+        return false;
+    }
+
+    uLong _crc = crc32(0L, Z_NULL, 0);
+    uint32_t _size = 0;
+    size_t n = fread(buffer, 1, JOURNAL_FILE_READ_BUFFER_SIZE, fd);
+    while (n > 0) {
+        _crc = crc32(_crc, buffer, (uInt)n);
+        _size += (uint32_t)n;
+        n = fread(buffer, 1, JOURNAL_FILE_READ_BUFFER_SIZE, fd);
+    }
+    const bool ok = ferror(fd) == 0;
+
+    free(buffer);
+    fclose(fd);
+
+    *crc = (uint32_t)_crc;
+    *size = _size;
+    return ok;
+}
+
+static bool _journal_write_header(FILE *fd, const JournalHeader *header) {
+    const uint32_t version = JOURNAL_VERSION;
+    return fwrite(JOURNAL_MAGIC_BYTES, 1, JOURNAL_MAGIC_BYTES_SIZE, fd) ==
+               JOURNAL_MAGIC_BYTES_SIZE &&
+           fwrite(&version, sizeof(uint32_t), 1, fd) == 1 &&
+           fwrite(&header->baseCRC, sizeof(uint32_t), 1, fd) == 1 &&
+           fwrite(&header->baseSize, sizeof(uint32_t), 1, fd) == 1;
+}
+
+static bool _journal_read_header(FILE *fd, JournalHeader *header) {
+    char magic[JOURNAL_MAGIC_BYTES_SIZE];
+    uint32_t version;
+    if (fread(magic, 1, JOURNAL_MAGIC_BYTES_SIZE, fd) != JOURNAL_MAGIC_BYTES_SIZE ||
+        memcmp(magic, JOURNAL_MAGIC_BYTES, JOURNAL_MAGIC_BYTES_SIZE) != 0) {
+        return false;
+    }
+    if (fread(&version, sizeof(uint32_t), 1, fd) != 1 || version != JOURNAL_VERSION) {
+        return false;
+    }
+    return fread(&header->baseCRC, sizeof(uint32_t), 1, fd) == 1 &&
+           fread(&header->baseSize, sizeof(uint32_t), 1, fd) == 1;
+}
+
+/// Serializes edited chunks of the shape, in base coordinates
+static bool _journal_create_record(Shape *shape,
+                                   SHAPE_COORDS_INT3_T offset,
+                                   void **data,
+                                   uint32_t *size) {
+
+    Index3D *edited = shape_get_edited_chunks(shape);
+    const ColorPalette *palette = shape_get_palette(shape);
+    const uint8_t colorCount = palette != NULL ? color_palette_get_count(palette) : 0;
+
+    uint32_t chunkCount = 0;
+    Index3DIterator *it = index3d_iterator_new(edited);
+    while (index3d_iterator_pointer(it) != NULL) {
+        ++chunkCount;
+        index3d_iterator_next(it);
+    }
+
+    *size = (uint32_t)(sizeof(uint8_t) + colorCount * JOURNAL_PALETTE_ENTRY_SIZE +
+                       sizeof(uint32_t) + chunkCount * JOURNAL_CHUNK_SIZE);
+    uint8_t *buf = (uint8_t *)malloc(*size);
+    if (buf == NULL) {
+        index3d_iterator_free(it);
+        return false;
+    }
+    uint32_t cursor = 0;
+
+    // palette
+    serialization_utils_writeUint8(buf + cursor, colorCount, &cursor);
+    for (uint8_t i = 0; i < colorCount; ++i) {
+        const RGBAColor color = color_palette_get_color(palette, i);
+        memcpy(buf + cursor, &color, sizeof(RGBAColor));
+        cursor += sizeof(RGBAColor);
+        serialization_utils_writeUint8(buf + cursor,
+                                       color_palette_is_emissive(palette, i) ? 1 : 0,
+                                       &cursor);
+    }
+
+    // chunks
+    Index3D *chunks = shape_get_chunks(shape);
+    serialization_utils_writeUint32(buf + cursor, chunkCount, &cursor);
+    index3d_iterator_free(it);
+    it = index3d_iterator_new(edited);
+    while (index3d_iterator_pointer(it) != NULL) {
+        const int3 *coords = (const int3 *)index3d_iterator_pointer(it);
+        // NULL if chunk has been emptied & removed since then
+        const Chunk *chunk = (const Chunk *)index3d_get(chunks, coords->x, coords->y, coords->z);
+
+        const SHAPE_COORDS_INT3_T origin = {
+            (SHAPE_COORDS_INT_T)(coords->x * CHUNK_SIZE - offset.x),
+            (SHAPE_COORDS_INT_T)(coords->y * CHUNK_SIZE - offset.y),
+            (SHAPE_COORDS_INT_T)(coords->z * CHUNK_SIZE - offset.z)};
+        serialization_utils_writeUint16(buf + cursor, (uint16_t)origin.x, &cursor);
+        serialization_utils_writeUint16(buf + cursor, (uint16_t)origin.y, &cursor);
+        serialization_utils_writeUint16(buf + cursor, (uint16_t)origin.z, &cursor);
+
+        for (CHUNK_COORDS_INT_T x = 0; x < CHUNK_SIZE; ++x) {
+            for (CHUNK_COORDS_INT_T y = 0; y < CHUNK_SIZE; ++y) {
+                for (CHUNK_COORDS_INT_T z = 0; z < CHUNK_SIZE; ++z) {
+                    const Block *b = chunk != NULL ? chunk_get_block(chunk, x, y, z) : NULL;
+                    buf[cursor++] = block_is_solid(b) ? block_get_color_index(b)
+                                                      : SHAPE_COLOR_INDEX_AIR_BLOCK;
+                }
+            }
+        }
+        index3d_iterator_next(it);
+    }
+    index3d_iterator_free(it);
+
+    vx_assert(cursor == *size);
+    *data = buf;
+    return true;
+}
+
+/// Applies a record payload on the shape, returns false if payload is malformed.
+/// The whole payload is checked first, a malformed record leaves the shape untouched.
+static bool _journal_apply_record(Shape *shape, const uint8_t *data, uint32_t size) {
+    ColorPalette *palette = shape_get_palette(shape);
+    if (palette == NULL || size < sizeof(uint8_t)) {
+        return false;
+    }
+
+    uint32_t cursor = 0;
+    const uint8_t colorCount = data[cursor++];
+    if (size < cursor + colorCount * JOURNAL_PALETTE_ENTRY_SIZE + sizeof(uint32_t)) {
+        return false;
+    }
+
+    // record palette entries to shape palette entries, colors added on demand
+    SHAPE_COLOR_INDEX_INT_T remap[SHAPE_COLOR_INDEX_MAX_COUNT];
+    bool remapped[SHAPE_COLOR_INDEX_MAX_COUNT];
+    memset(remapped, 0, sizeof(remapped));
+    const uint8_t *colors = data + cursor;
+    cursor += colorCount * (uint32_t)JOURNAL_PALETTE_ENTRY_SIZE;
+
+    uint32_t chunkCount;
+    memcpy(&chunkCount, data + cursor, sizeof(uint32_t));
+    cursor += sizeof(uint32_t);
+    if ((uint64_t)(size - cursor) != (uint64_t)chunkCount * JOURNAL_CHUNK_SIZE) {
+        return false;
+    }
+    for (uint32_t c = 0; c < chunkCount; ++c) {
+        const uint8_t *entries = data + cursor + c * JOURNAL_CHUNK_SIZE + 3 * sizeof(int16_t);
+        for (uint32_t i = 0; i < CHUNK_SIZE_CUBE; ++i) {
+            if (entries[i] != SHAPE_COLOR_INDEX_AIR_BLOCK && entries[i] >= colorCount) {
+                return false;
+            }
+        }
+    }
+
+    for (uint32_t c = 0; c < chunkCount; ++c) {
+        int16_t origin[3];
+        memcpy(origin, data + cursor, sizeof(origin));
+        cursor += sizeof(origin);
+
+        for (int x = 0; x < CHUNK_SIZE; ++x) {
+            for (int y = 0; y < CHUNK_SIZE; ++y) {
+                for (int z = 0; z < CHUNK_SIZE; ++z) {
+                    const uint8_t entry = data[cursor++];
+                    const SHAPE_COORDS_INT_T bx = (SHAPE_COORDS_INT_T)(origin[0] + x);
+                    const SHAPE_COORDS_INT_T by = (SHAPE_COORDS_INT_T)(origin[1] + y);
+                    const SHAPE_COORDS_INT_T bz = (SHAPE_COORDS_INT_T)(origin[2] + z);
+                    const Block *b = shape_get_block(shape, bx, by, bz);
+
+                    if (entry == SHAPE_COLOR_INDEX_AIR_BLOCK) {
+                        if (block_is_solid(b)) {
+                            shape_remove_block(shape, bx, by, bz);
+                        }
+                        continue;
+                    }
+
+                    if (remapped[entry] == false) {
+                        RGBAColor color;
+                        memcpy(&color, colors + entry * JOURNAL_PALETTE_ENTRY_SIZE, sizeof(RGBAColor));
+                        const bool emissive = colors[entry * JOURNAL_PALETTE_ENTRY_SIZE +
+                                                     sizeof(RGBAColor)] != 0;
+                        if (color_palette_check_and_add_color(palette,
+                                                              color,
+                                                              &remap[entry],
+                                                              false) == false) {
+                            cclog_warning("journal: palette is full, color can't be restored");
+                            remap[entry] = 0;
+                        } else if (color_palette_is_emissive(palette, remap[entry]) != emissive) {
+                            color_palette_set_emissive(palette, remap[entry], emissive);
+                        }
+                        remapped[entry] = true;
+                    }
+
+                    if (block_is_solid(b) == false) {
+                        shape_add_block(shape, remap[entry], bx, by, bz, false);
+                    } else if (block_get_color_index(b) != remap[entry]) {
+                        shape_paint_block(shape, remap[entry], bx, by, bz);
+                    }
+                }
+            }
+        }
+    }
+    return true;
+}
+
+// MARK: - Exposed functions -
+
+bool serialization_journal_save_full(Shape *shape,
+                                     const void *imageData,
+                                     uint32_t imageDataSize,
+                                     const char *filepath) {
+
+    if (shape == NULL || filepath == NULL) {
+        return false;
+    }
+
+    char *journalPath = _journal_path(filepath);
+    if (journalPath == NULL) {
+        return false;
+    }
+
+    // base file is written w/ model AABB min at origin
+    SHAPE_COORDS_INT3_T bbMin, bbMax;
+    shape_get_model_aabb_2(shape, &bbMin, &bbMax);
+
+    FILE *fd = fopen(filepath, "wb");
+    if (fd == NULL || serialization_save_shape(shape, imageData, imageDataSize, fd) == false) {
+        cclog_error("journal: failed to write base file");
+        free(journalPath);
+        return false;
+    }
+
+    JournalHeader header;
+    if (_journal_file_crc(filepath, &header.baseCRC, &header.baseSize) == false) {
+        free(journalPath);
+        return false;
+    }
+
+    fd = fopen(journalPath, "wb");
+    free(journalPath);
+    if (fd == NULL) {
+        return false;
+    }
+    const bool ok = _journal_write_header(fd, &header);
+    fclose(fd);
+
+    if (ok) {
+        shape_enable_edit_tracking(shape, true);
+        shape_clear_edited_chunks(shape);
+        shape_set_edits_offset(shape, bbMin);
+    }
+    return ok;
+}
+
+bool serialization_journal_save(Shape *shape,
+                                const void *imageData,
+                                uint32_t imageDataSize,
+                                const char *filepath) {
+
+    if (shape == NULL || filepath == NULL) {
+        return false;
+    }
+    if (shape_get_edited_chunks(shape) == NULL) {
+        return serialization_journal_save_full(shape, imageData, imageDataSize, filepath);
+    }
+    if (index3d_is_empty(shape_get_edited_chunks(shape))) {
+        return true;
+    }
+
+    char *journalPath = _journal_path(filepath);
+    if (journalPath == NULL) {
+        return false;
+    }
+
+    // journal must exist & match base file, checking size only to keep save cost independent of
+    // base size, CRC is checked on load
+    JournalHeader header;
+    uint32_t baseSize = 0;
+    FILE *fd = fopen(journalPath, "r+b");
+    free(journalPath);
+    if (fd == NULL || _journal_read_header(fd, &header) == false ||
+        _journal_file_size(filepath, &baseSize) == false || baseSize != header.baseSize) {
+        if (fd != NULL) {
+            fclose(fd);
+        }
+        return serialization_journal_save_full(shape, imageData, imageDataSize, filepath);
+    }
+
+    SerializationCompressionTask task = {NULL, NULL, 0, 0};
+    void *record = NULL;
+    const SHAPE_COORDS_INT3_T offset = shape_get_edits_offset(shape);
+    if (_journal_create_record(shape, offset, &record, &task.srcSize) == false) {
+        fclose(fd);
+        return false;
+    }
+    task.src = record;
+    const bool compressed = serialization_utils_compress_parallel(&task, 1);
+    free(record);
+    if (compressed == false) {
+        fclose(fd);
+        return false;
+    }
+
+    bool ok = fseek(fd, 0, SEEK_END) == 0 &&
+         fwrite(&task.dstSize, sizeof(uint32_t), 1, fd) == 1 &&
+         fwrite(&task.srcSize, sizeof(uint32_t), 1, fd) == 1 &&
+         fwrite(task.dst, task.dstSize, 1, fd) == 1;
+    const long journalSize = ftell(fd);
+    ok = fclose(fd) == 0 && ok;
+    free(task.dst);
+
+    if (ok == false) {
+        cclog_error("journal: failed to append record");
+        return false;
+    }
+    shape_clear_edited_chunks(shape);
+
+    // compaction
+    if (journalSize > (long)header.baseSize) {
+        return serialization_journal_save_full(shape, imageData, imageDataSize, filepath);
+    }
+    return true;
+}
+
+Shape *serialization_journal_load_shape(const char *filepath,
+                                        ColorAtlas *colorAtlas,
+                                        LoadShapeSettings *shapeSettings) {
+
+    if (filepath == NULL) {
+        return NULL;
+    }
+
+    Stream *s = stream_new_mmap_read(filepath);
+    if (s == NULL) {
+        return NULL;
+    }
+    Shape *shape = serialization_load_shape(s, filepath, colorAtlas, shapeSettings, false);
+    if (shape == NULL) {
+        return NULL;
+    }
+    shape_enable_edit_tracking(shape, true);
+
+    char *journalPath = _journal_path(filepath);
+    if (journalPath == NULL) {
+        return shape;
+    }
+    FILE *fd = fopen(journalPath, "rb");
+    free(journalPath);
+    if (fd == NULL) {
+        // no journal, next save will be a full one
+        shape_enable_edit_tracking(shape, false);
+        return shape;
+    }
+
+    JournalHeader header;
+    uint32_t baseCRC, baseSize;
+    if (_journal_read_header(fd, &header) == false ||
+        _journal_file_crc(filepath, &baseCRC, &baseSize) == false ||
+        baseCRC != header.baseCRC || baseSize != header.baseSize) {
+        cclog_warning("journal: doesn't match base file, ignored");
+        fclose(fd);
+        shape_enable_edit_tracking(shape, false);
+        return shape;
+    }
+
+    uint32_t recordSizes[2];
+    while (fread(recordSizes, sizeof(uint32_t), 2, fd) == 2) {
+        void *compressed = malloc(recordSizes[0]);
+        uint8_t *record = (uint8_t *)malloc(recordSizes[1]);
+        uLong recordSize = recordSizes[1];
+        const bool ok = compressed != NULL && record != NULL &&
+                        fread(compressed, recordSizes[0], 1, fd) == 1 &&
+                        uncompress(record, &recordSize, compressed, recordSizes[0]) == Z_OK &&
+                        recordSize == recordSizes[1] &&
+                        _journal_apply_record(shape, record, recordSizes[1]);
+        free(compressed);
+        free(record);
+        if (ok == false) {
+            // e.g. interrupted while appending a record, next save will be a full one
+            cclog_warning("journal: invalid record, ignoring the rest of the journal");
+            fclose(fd);
+            shape_enable_edit_tracking(shape, false);
+            return shape;
+        }
+    }
+
+    fclose(fd);
+
+    // loaded shape is in base coordinates
+    shape_clear_edited_chunks(shape);
+    shape_set_edits_offset(shape, coords3_zero);
+    return shape;
+}
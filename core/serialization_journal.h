@@ -0,0 +1,76 @@
+// -------------------------------------------------------------
+//  Cubzh Core
+//  serialization_journal.h
+// -------------------------------------------------------------
+
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// C
+#include <stdbool.h>
+#include <stdint.h>
+
+// Cubzh Core
+#include "color_atlas.h"
+#include "shape.h"
+
+// =============================================================================
+// Edit journal (.3zh.journal)
+// =============================================================================
+//
+// Incremental saves of a shape's blocks, next to its full .3zh file (the "base").
+// Each save appends one record w/ the chunks edited since previous save, so save cost is
+// proportional to the edit. On load, records are replayed on top of the base file.
+// The journal is compacted (full save, empty journal) when it grows bigger than its base.
+//
+// Only block changes of the root shape are journaled, other changes (palette colors, POIs,
+// children...) require a full save.
+//
+// Header:
+//  6 bytes |  char[6] | journal magic bytes
+//  4 bytes |   uint32 | journal format version
+//  4 bytes |   uint32 | base file CRC32
+//  4 bytes |   uint32 | base file size
+//
+// Records (zlib compressed payload):
+//  4 bytes |   uint32 | compressed size
+//  4 bytes |   uint32 | uncompressed size
+//  n bytes |  char[n] | payload
+//
+// Record payload:
+//  1 byte  |    uint8 | palette color count
+//  n bytes |  char[n] | palette colors (RGBA + emissive flag)
+//  4 bytes |   uint32 | chunk count
+//  for each chunk:
+//  6 bytes | int16[3] | chunk origin (base coordinates, records are converted when appended)
+//  n bytes | uint8[n] | blocks palette indexes, air included (CHUNK_SIZE_CUBE, x, y, z order)
+
+#define SERIALIZATION_JOURNAL_EXTENSION ".journal"
+
+/// Full save of the shape at given path, starting an empty journal.
+/// Enables edit tracking on the shape.
+bool serialization_journal_save_full(Shape *shape,
+                                     const void *imageData,
+                                     uint32_t imageDataSize,
+                                     const char *filepath);
+
+/// Appends chunks edited since last save to the journal of given base file.
+/// Falls back on a full save if the shape isn't tracking edits, if the journal doesn't match the
+/// base file, or when the journal needs compaction.
+bool serialization_journal_save(Shape *shape,
+                                const void *imageData,
+                                uint32_t imageDataSize,
+                                const char *filepath);
+
+/// Loads base file & replays its journal, if any. Files are only read.
+/// Returned shape tracks edits in base coordinates, ready for incremental saves.
+Shape *serialization_journal_load_shape(const char *filepath,
+                                        ColorAtlas *colorAtlas,
+                                        LoadShapeSettings *shapeSettings);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
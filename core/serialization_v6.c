@@ -67,26 +67,12 @@ bool chunk_v6_shape_create_and_write_uncompressed_buffer(const Shape *shape,
                                                          uint32_t *uncompressedSize,
                                                          void **uncompressedData);
 
-bool chunk_v6_shape_create_and_write_compressed_buffer(const Shape *shape,
-                                                       uint16_t shapeId,
-                                                       uint16_t shapeParentId,
-                                                       const ColorPalette *sharedPalette,
-                                                       uint32_t *uncompressedSize,
-                                                       uint32_t *compressedSize,
-                                                       void **compressedData);
-
 void _chunk_v6_palette_create_and_write_uncompressed_buffer(
     const ColorPalette *palette,
     uint32_t *uncompressedSize,
     void **uncompressedData,
     SHAPE_COLOR_INDEX_INT_T **paletteMapping);
 
-bool _chunk_v6_palette_create_and_write_compressed_buffer(const ColorPalette *palette,
-                                                          uint32_t *uncompressedSize,
-                                                          uint32_t *compressedSize,
-                                                          void **compressedData,
-                                                          SHAPE_COLOR_INDEX_INT_T **paletteMapping);
-
 /// Writes chunk header and data
 static bool write_chunk_in_buffer(void *destBuffer,
                                   uint8_t chunkID,
@@ -105,15 +91,14 @@ static bool write_preview_chunk_in_buffer(void *destBuffer,
 // MARK: Write as file -
 
 bool v6_write_size_at(long position, uint32_t size, FILE *fd);
-// Writes full chunk (header + data) to file, compress the data if required, function will free data
-// when done
-bool chunk_v6_write_file(uint8_t chunkID, uint32_t size, void *data, uint8_t doCompress, FILE *fd);
-bool chunk_v6_write_shape(FILE *fd,
-                          Shape *shape,
-                          uint16_t *shapeId,
-                          uint16_t shapeParentId,
-                          const ColorPalette *sharedPalette,
-                          bool doCompress);
+// Writes full chunk (header + data) to file, data is expected to be compressed already if
+// isCompressed is true (dataSize then being the compressed size)
+bool chunk_v6_write_file(uint8_t chunkID,
+                         const void *data,
+                         uint32_t dataSize,
+                         uint32_t uncompressedSize,
+                         uint8_t isCompressed,
+                         FILE *fd);
 bool chunk_v6_write_preview_image(FILE *fd, const void *imageData, uint32_t imageDataSize);
 
 // MARK: Read -
@@ -121,9 +106,14 @@ bool chunk_v6_write_preview_image(FILE *fd, const void *imageData, uint32_t imag
 // all read functions return number of bytes read or 0 if the file can't be read
 uint8_t chunk_v6_read_identifier(Stream *s);
 uint32_t chunk_v6_read_size(Stream *s);
-// Reads full chunk, uncompressing it if necessary,
-// function allocates data that must be freed by caller
-bool chunk_v6_read(void **chunkData, uint32_t *chunkSize, uint32_t *uncompressedSize, Stream *s);
+// Reads full chunk, uncompressing it if necessary.
+// Uncompressed chunks read from a memory-backed Stream are not copied: chunkData then points
+// to Stream memory and *isOwned is false. Otherwise, chunkData must be freed by caller.
+bool chunk_v6_read(void **chunkData,
+                   bool *isOwned,
+                   uint32_t *chunkSize,
+                   uint32_t *uncompressedSize,
+                   Stream *s);
 
 // TODO: unify headers, currently only chunks writing with the function chunk_v6_write_file use v6
 // header ie. Shape & Palette skips a chunk with v5 header (only chunkSize as uint32_t)
@@ -139,14 +129,60 @@ uint32_t chunk_v6_read_palette(Stream *s,
 
 uint32_t chunk_v6_read_palette_id(Stream *s, uint8_t *paletteID);
 
+// MARK: Incremental read -
+
+// Size of the windows used to read chunk payloads incrementally
+#define CHUNK_V6_READ_WINDOW_SIZE 4096
+
+typedef enum {
+    ChunkV6ReaderSource_Stream,  // uncompressed payload, read from Stream
+    ChunkV6ReaderSource_Inflate, // compressed payload, inflated from Stream
+    ChunkV6ReaderSource_Memory,  // uncompressed payload, read from memory
+} ChunkV6ReaderSource;
+
+// Reads a chunk payload incrementally, inflating it on the fly if compressed.
+// Only fixed-size windows are used, payload is never entirely loaded in memory.
+typedef struct {
+    Stream *s;
+    const uint8_t *memory;
+    z_stream z;
+    uint32_t compressedLeft;   // compressed bytes still in Stream (not fed to zlib)
+    uint32_t uncompressedLeft; // payload bytes not read yet
+    ChunkV6ReaderSource source;
+    uint8_t window[CHUNK_V6_READ_WINDOW_SIZE]; // zlib input, if Stream isn't memory-backed
+} ChunkV6Reader;
+
+// Reads v6 chunk header (chunk ID should be read already at this point) and prepares reader
+static bool chunk_v6_reader_open(ChunkV6Reader *r,
+                                 Stream *s,
+                                 uint32_t *chunkSize,
+                                 uint32_t *uncompressedSize);
+static void chunk_v6_reader_open_memory(ChunkV6Reader *r, const void *data, uint32_t size);
+static bool chunk_v6_reader_read(ChunkV6Reader *r, void *dst, uint32_t size);
+static bool chunk_v6_reader_skip(ChunkV6Reader *r, uint32_t size);
+// Returns a pointer to the next bytes of an uncompressed payload read from memory, w/o copying
+// them, returns NULL & reads nothing otherwise
+static const void *chunk_v6_reader_borrow(ChunkV6Reader *r, uint32_t size);
+// Releases reader resources and moves Stream cursor to the end of the chunk
+static void chunk_v6_reader_close(ChunkV6Reader *r);
+
 // @param shrinkPalette used as reference to build a shrinked palette w/ only used colors
-uint32_t chunk_v6_read_shape_process_blocks(void *cursor,
-                                            Shape *shape,
-                                            uint16_t w,
-                                            uint16_t h,
-                                            uint16_t d,
-                                            uint8_t paletteID,
-                                            ColorPalette *shrinkPalette);
+static bool chunk_v6_read_shape_process_blocks(ChunkV6Reader *r,
+                                               Shape *shape,
+                                               uint16_t w,
+                                               uint16_t h,
+                                               uint16_t d,
+                                               uint8_t paletteID,
+                                               ColorPalette *shrinkPalette);
+
+// Sets shape palette following file compatibility mode, must be done before adding blocks
+static void chunk_v6_read_shape_set_palette(Shape *shape,
+                                            ColorAtlas *colorAtlas,
+                                            ColorPalette *shapePalette,
+                                            ColorPalette *rootShapePalette,
+                                            ColorPalette *filePalette,
+                                            uint8_t *paletteID,
+                                            bool *shrinkPalette);
 
 // chunk_v6_read_shape allocates a new Shape if shape != NULL
 uint32_t chunk_v6_read_shape(Stream *s,
@@ -167,25 +203,99 @@ static uint32_t compute_preview_chunk_size(const uint32_t previewBytesCount);
 static uint32_t compute_shape_chunk_size(uint32_t shapeBufferDataSize);
 
 typedef struct _ShapeBuffers {
+    void *shapeUncompressedData; // freed once compressed
+    void *shapeCompressedData;
     uint32_t shapeUncompressedDataSize;
     uint32_t shapeCompressedDataSize;
-    void *shapeCompressedData;
 } ShapeBuffers;
 
+/// Serializes shape & children (depth-first), pushing one uncompressed buffer per shape
 static bool create_shape_buffers(DoublyLinkedList *shapeBuffers,
                                  Shape const *shape,
                                  uint16_t *shapeId,
                                  uint16_t shapeParentId,
-                                 const ColorPalette *sharedPalette,
-                                 uint32_t *size);
+                                 const ColorPalette *sharedPalette);
+
+/// Compresses all shape buffers in parallel, along with optional extra task.
+/// Adds written shape chunks size to *size.
+static bool compress_shape_buffers(DoublyLinkedList *shapeBuffers,
+                                   SerializationCompressionTask *extra,
+                                   uint32_t *size);
+
+static void free_shape_buffers(DoublyLinkedList *shapeBuffers);
 
 // MARK: - Exposed functions -
 
+struct _SerializationV6Snapshot {
+    DoublyLinkedList *shapesBuffers; // ShapeBuffers, uncompressed
+    void *imageData;                 // copy of preview bytes (optional)
+    uint32_t imageDataSize;
+    char pad[4];
+};
+
 bool serialization_v6_save_shape(Shape *shape,
                                  const void *imageData,
                                  uint32_t imageDataSize,
                                  FILE *fd) {
 
+    SerializationV6Snapshot *snapshot = serialization_v6_snapshot_new(shape,
+                                                                      imageData,
+                                                                      imageDataSize);
+    if (snapshot == NULL) {
+        return false;
+    }
+    const bool success = serialization_v6_snapshot_write(snapshot, fd);
+    serialization_v6_snapshot_free(snapshot);
+    return success;
+}
+
+SerializationV6Snapshot *serialization_v6_snapshot_new(const Shape *shape,
+                                                       const void *imageData,
+                                                       uint32_t imageDataSize) {
+    if (shape == NULL) {
+        return NULL;
+    }
+
+    SerializationV6Snapshot *snapshot = (SerializationV6Snapshot *)malloc(
+        sizeof(SerializationV6Snapshot));
+    if (snapshot == NULL) {
+        return NULL;
+    }
+    snapshot->imageData = NULL;
+    snapshot->imageDataSize = 0;
+    snapshot->shapesBuffers = doubly_linked_list_new();
+    if (snapshot->shapesBuffers == NULL) {
+        free(snapshot);
+        return NULL;
+    }
+
+    if (imageData != NULL && imageDataSize > 0) {
+        snapshot->imageData = malloc(imageDataSize);
+        if (snapshot->imageData == NULL) {
+            serialization_v6_snapshot_free(snapshot);
+            return NULL;
+        }
+        memcpy(snapshot->imageData, imageData, imageDataSize);
+        snapshot->imageDataSize = imageDataSize;
+    }
+
+    // serialized shape chunks hold a copy of all shapes state
+    uint16_t shapeId = 1;
+    if (create_shape_buffers(snapshot->shapesBuffers,
+                             shape,
+                             &shapeId,
+                             0,
+                             shape_get_palette(shape)) == false) {
+        cclog_error("failed to create shape chunks");
+        serialization_v6_snapshot_free(snapshot);
+        return NULL;
+    }
+
+    return snapshot;
+}
+
+bool serialization_v6_snapshot_write(SerializationV6Snapshot *snapshot, FILE *fd) {
+
     // -------------------
     // HEADER
     // -------------------
@@ -219,10 +329,28 @@ bool serialization_v6_save_shape(Shape *shape,
     // CHUNKS
     // -------------------
 
-    chunk_v6_write_preview_image(fd, imageData, imageDataSize);
+    chunk_v6_write_preview_image(fd, snapshot->imageData, snapshot->imageDataSize);
 
-    uint16_t shapeId = 1;
-    chunk_v6_write_shape(fd, shape, &shapeId, 0, shape_get_palette(shape), true);
+    uint32_t shapesSize = 0;
+    if (compress_shape_buffers(snapshot->shapesBuffers, NULL, &shapesSize) == false) {
+        cclog_error("failed to compress shape chunks");
+        return false;
+    }
+
+    DoublyLinkedListNode *n = doubly_linked_list_first(snapshot->shapesBuffers);
+    while (n != NULL) {
+        const ShapeBuffers *buffers = (const ShapeBuffers *)doubly_linked_list_node_pointer(n);
+        if (chunk_v6_write_file(P3S_CHUNK_ID_SHAPE,
+                                buffers->shapeCompressedData,
+                                buffers->shapeCompressedDataSize,
+                                buffers->shapeUncompressedDataSize,
+                                true,
+                                fd) == false) {
+            cclog_error("failed to write shape chunk");
+            return false;
+        }
+        n = doubly_linked_list_node_next(n);
+    }
 
     // -------------------
     // END OF FILE
@@ -239,6 +367,15 @@ bool serialization_v6_save_shape(Shape *shape,
     return true;
 }
 
+void serialization_v6_snapshot_free(SerializationV6Snapshot *snapshot) {
+    if (snapshot == NULL) {
+        return;
+    }
+    free_shape_buffers(snapshot->shapesBuffers);
+    free(snapshot->imageData);
+    free(snapshot);
+}
+
 /// serialize a shape in a newly created memory buffer
 /// Arguments:
 /// - shape (mandatory)
@@ -277,34 +414,48 @@ bool serialization_v6_save_shape_as_buffer(const Shape *const shape,
     }
 
     uint16_t shapeId = 1;
-    if (create_shape_buffers(shapesBuffers, shape, &shapeId, 0, shape_get_palette(shape), &size) ==
+    if (create_shape_buffers(shapesBuffers, shape, &shapeId, 0, shape_get_palette(shape)) ==
         false) {
-        doubly_linked_list_free(shapesBuffers);
+        free_shape_buffers(shapesBuffers);
         return false;
     }
 
-    bool hasArtistPalette = false;
-    uint32_t paletteUncompressedDataSize = 0;
-    uint32_t paletteCompressedDataSize = 0;
-    void *paletteCompressedData = NULL;
-    if (artistPalette != NULL) {
-        SHAPE_COLOR_INDEX_INT_T *fakePaletteMapping;
-        if (_chunk_v6_palette_create_and_write_compressed_buffer(artistPalette,
-                                                                 &paletteUncompressedDataSize,
-                                                                 &paletteCompressedDataSize,
-                                                                 &paletteCompressedData,
-                                                                 &fakePaletteMapping) == false) {
+    // artist palette is compressed along with shapes
+    const bool hasArtistPalette = artistPalette != NULL;
+    SerializationCompressionTask paletteTask = {NULL, NULL, 0, 0};
+    void *paletteUncompressedData = NULL;
+    if (hasArtistPalette) {
+        SHAPE_COLOR_INDEX_INT_T *paletteMapping = NULL;
+        _chunk_v6_palette_create_and_write_uncompressed_buffer(artistPalette,
+                                                               &paletteTask.srcSize,
+                                                               &paletteUncompressedData,
+                                                               &paletteMapping);
+        free(paletteMapping);
+        if (paletteUncompressedData == NULL) {
+            free_shape_buffers(shapesBuffers);
             return false;
         }
-        size += getChunkHeaderSize(P3S_CHUNK_ID_PALETTE) + paletteCompressedDataSize;
-        hasArtistPalette = true;
+        paletteTask.src = paletteUncompressedData;
+    }
+
+    const bool compressed = compress_shape_buffers(shapesBuffers,
+                                                   hasArtistPalette ? &paletteTask : NULL,
+                                                   &size);
+    free(paletteUncompressedData);
+    if (compressed == false) {
+        free_shape_buffers(shapesBuffers);
+        return false;
+    }
+
+    if (hasArtistPalette) {
+        size += getChunkHeaderSize(P3S_CHUNK_ID_PALETTE) + paletteTask.dstSize;
     }
 
     // allocate buffer
     uint8_t *buf = (uint8_t *)malloc(sizeof(uint8_t) * size);
     if (buf == NULL) {
-        free(paletteCompressedData);
-        doubly_linked_list_free(shapesBuffers);
+        free(paletteTask.dst);
+        free_shape_buffers(shapesBuffers);
         return false;
     }
 
@@ -336,7 +487,8 @@ bool serialization_v6_save_shape_as_buffer(const Shape *const shape,
         ok = write_preview_chunk_in_buffer(buf + cursor, previewData, previewDataSize, &cursor);
         if (ok == false) {
             free(buf);
-            doubly_linked_list_free(shapesBuffers);
+            free(paletteTask.dst);
+            free_shape_buffers(shapesBuffers);
             return false;
         }
     }
@@ -346,14 +498,14 @@ bool serialization_v6_save_shape_as_buffer(const Shape *const shape,
         ok = write_chunk_in_buffer(buf + cursor,
                                    P3S_CHUNK_ID_PALETTE,
                                    true,
-                                   paletteCompressedData,
-                                   paletteCompressedDataSize,
-                                   paletteUncompressedDataSize,
+                                   paletteTask.dst,
+                                   paletteTask.dstSize,
+                                   paletteTask.srcSize,
                                    &cursor);
-        free(paletteCompressedData);
+        free(paletteTask.dst);
         if (ok == false) {
             free(buf);
-            doubly_linked_list_free(shapesBuffers);
+            free_shape_buffers(shapesBuffers);
             return false;
         }
     }
@@ -372,15 +524,14 @@ bool serialization_v6_save_shape_as_buffer(const Shape *const shape,
                                    &cursor);
         if (ok == false) {
             free(buf);
-            doubly_linked_list_free(shapesBuffers);
+            free_shape_buffers(shapesBuffers);
             return false;
         }
 
-        free(shapeBuffersCursor);
         n = doubly_linked_list_node_next(n);
     }
 
-    doubly_linked_list_free(shapesBuffers);
+    free_shape_buffers(shapesBuffers);
 
     // update total size
     totalSize = cursor - positionBeforeChunks;
@@ -470,106 +621,29 @@ bool v6_write_size_at(long position, uint32_t size, FILE *fd) {
     return true;
 }
 
-bool chunk_v6_write_file(uint8_t chunkID, uint32_t size, void *data, uint8_t doCompress, FILE *fd) {
-    uint32_t chunkSize = size;
-    const uint32_t uncompressedSize = size;
-
-    // compress data if required by this chunk
-    if (doCompress != 0) {
-        uLong compressedSize = compressBound(size);
-        void *compressedData = malloc(compressedSize);
-        if (compress(compressedData, &compressedSize, data, size) != Z_OK) {
-            // failed to compress data, let's free the destination buffer
-            free(compressedData);
-            free(data);
-            return false;
-        }
-        free(data);
-        chunkSize = (uint32_t)compressedSize;
-        data = compressedData;
-    }
-
+bool chunk_v6_write_file(uint8_t chunkID,
+                         const void *data,
+                         uint32_t dataSize,
+                         uint32_t uncompressedSize,
+                         uint8_t isCompressed,
+                         FILE *fd) {
     // write header
     if (fwrite(&chunkID, sizeof(uint8_t), 1, fd) != 1) {
-        free(data);
         return false;
     }
-    if (fwrite(&chunkSize, sizeof(uint32_t), 1, fd) != 1) {
-        free(data);
+    if (fwrite(&dataSize, sizeof(uint32_t), 1, fd) != 1) {
         return false;
     }
-    if (fwrite(&doCompress, sizeof(uint8_t), 1, fd) != 1) {
-        free(data);
+    if (fwrite(&isCompressed, sizeof(uint8_t), 1, fd) != 1) {
         return false;
     }
     if (fwrite(&uncompressedSize, sizeof(uint32_t), 1, fd) != 1) {
-        free(data);
         return false;
     }
     // write data
-    if (fwrite(data, chunkSize, 1, fd) != 1) {
-        free(data);
-        return false;
-    }
-
-    free(data);
-    return true;
-}
-
-bool chunk_v6_write_shape(FILE *fd,
-                          Shape *shape,
-                          uint16_t *shapeId,
-                          uint16_t shapeParentId,
-                          const ColorPalette *sharedPalette,
-                          bool doCompress) {
-
-    if (fd == NULL) {
-        return false;
-    }
-    if (shape == NULL) {
+    if (fwrite(data, dataSize, 1, fd) != 1) {
         return false;
     }
-
-    uint32_t uncompressedSize = 0;
-    void *uncompressedData = NULL;
-
-    if (chunk_v6_shape_create_and_write_uncompressed_buffer(shape,
-                                                            *shapeId,
-                                                            shapeParentId,
-                                                            sharedPalette,
-                                                            &uncompressedSize,
-                                                            &uncompressedData) == false) {
-        cclog_error("chunk_v6_shape_create_and_write_uncompressed_buffer failed");
-        return false;
-    }
-
-    /// write file
-    // uncompressedData freed within chunk_v6_write_file
-    if (chunk_v6_write_file(P3S_CHUNK_ID_SHAPE,
-                            uncompressedSize,
-                            uncompressedData,
-                            doCompress,
-                            fd) == false) {
-        cclog_error("failed to write shape chunk");
-        return false;
-    }
-
-    shapeParentId = *shapeId;
-    (*shapeId)++;
-
-    DoublyLinkedListNode *n = transform_get_children_iterator(shape_get_root_transform(shape));
-    Transform *child = NULL;
-
-    while (n != NULL) {
-        child = (Transform *)(doubly_linked_list_node_pointer(n));
-        // hide transforms reserved for engine
-        Shape *childShape = transform_utils_get_shape(child);
-        if (childShape != NULL) {
-            chunk_v6_write_shape(fd, childShape, shapeId, shapeParentId, sharedPalette, true);
-        }
-        n = doubly_linked_list_node_next(n);
-    }
-
     return true;
 }
 
@@ -622,7 +696,11 @@ uint32_t chunk_v6_read_size(Stream *s) {
     return i;
 }
 
-bool chunk_v6_read(void **chunkData, uint32_t *chunkSize, uint32_t *uncompressedSize, Stream *s) {
+bool chunk_v6_read(void **chunkData,
+                   bool *isOwned,
+                   uint32_t *chunkSize,
+                   uint32_t *uncompressedSize,
+                   Stream *s) {
 
     uint32_t _chunkSize = 0;
     uint8_t _isCompressed = 0;
@@ -643,27 +721,50 @@ bool chunk_v6_read(void **chunkData, uint32_t *chunkSize, uint32_t *uncompressed
         return false;
     }
 
-    // read chunk data
-    void *_chunkData = malloc(_chunkSize);
-    if (stream_read(s, _chunkData, _chunkSize, 1) == false) {
-        free(_chunkData);
-        return false;
+    // read chunk data, directly from Stream memory when possible
+    const void *_chunkData = NULL;
+    void *_chunkDataCopy = NULL;
+    if (stream_is_memory_backed(s)) {
+        _chunkData = stream_borrow(s, _chunkSize);
+        if (_chunkData == NULL) {
+            return false;
+        }
+    } else {
+        _chunkDataCopy = malloc(_chunkSize);
+        if (_chunkDataCopy == NULL) {
+            return false;
+        }
+        if (stream_read(s, _chunkDataCopy, _chunkSize, 1) == false) {
+            free(_chunkDataCopy);
+            return false;
+        }
+        _chunkData = _chunkDataCopy;
     }
 
     // uncompress if required by this chunk
     if (_isCompressed != 0) {
         uLong resultSize = _uncompressedSize;
         void *uncompressedData = malloc(_uncompressedSize);
+        if (uncompressedData == NULL) {
+            free(_chunkDataCopy);
+            return false;
+        }
         if (uncompress(uncompressedData, &resultSize, _chunkData, _chunkSize) != Z_OK) {
             free(uncompressedData);
-            free(_chunkData);
+            free(_chunkDataCopy);
             return false;
         }
-        free(_chunkData);
+        free(_chunkDataCopy);
 
         *chunkData = uncompressedData;
+        *isOwned = true;
+    } else if (_chunkDataCopy != NULL) {
+        *chunkData = _chunkDataCopy;
+        *isOwned = true;
     } else {
-        *chunkData = _chunkData;
+        // decoded in place, Stream keeps ownership
+        *chunkData = (void *)_chunkData;
+        *isOwned = false;
     }
     *chunkSize = _chunkSize;
     *uncompressedSize = _uncompressedSize;
@@ -736,15 +837,18 @@ uint32_t chunk_v6_read_palette(Stream *s,
 
     /// read file
     void *chunkData = NULL;
+    bool chunkDataOwned = false;
     uint32_t chunkSize = 0;
     uint32_t uncompressedSize = 0;
-    if (chunk_v6_read(&chunkData, &chunkSize, &uncompressedSize, s) == false) {
+    if (chunk_v6_read(&chunkData, &chunkDataOwned, &chunkSize, &uncompressedSize, s) == false) {
         cclog_error("failed to read palette");
         return 0;
     }
 
     *palette = chunk_v6_read_palette_data(chunkData, colorAtlas, isLegacy);
-    free(chunkData);
+    if (chunkDataOwned) {
+        free(chunkData);
+    }
 
     return CHUNK_V6_HEADER_NO_ID_SIZE + chunkSize;
 }
@@ -752,36 +856,251 @@ uint32_t chunk_v6_read_palette(Stream *s,
 uint32_t chunk_v6_read_palette_id(Stream *s, uint8_t *paletteID) {
     /// read file to get size, but this chunk is now unused
     void *chunkData = NULL;
+    bool chunkDataOwned = false;
     uint32_t chunkSize = 0;
     uint32_t uncompressedSize = 0;
-    if (chunk_v6_read(&chunkData, &chunkSize, &uncompressedSize, s) == false) {
+    if (chunk_v6_read(&chunkData, &chunkDataOwned, &chunkSize, &uncompressedSize, s) == false) {
         return 0;
     }
 
     *paletteID = *((uint8_t *)chunkData);
 
-    free(chunkData);
+    if (chunkDataOwned) {
+        free(chunkData);
+    }
 
     return CHUNK_V6_HEADER_NO_ID_SIZE + chunkSize;
 }
 
-uint32_t chunk_v6_read_shape_process_blocks(void *cursor,
-                                            Shape *shape,
-                                            uint16_t w,
-                                            uint16_t h,
-                                            uint16_t d,
-                                            uint8_t paletteID,
-                                            ColorPalette *shrinkPalette) {
+bool chunk_v6_reader_open(ChunkV6Reader *r,
+                          Stream *s,
+                          uint32_t *chunkSize,
+                          uint32_t *uncompressedSize) {
+
+    uint32_t _chunkSize = 0;
+    uint8_t _isCompressed = 0;
+    uint32_t _uncompressedSize = 0;
+
+    if (stream_read_uint32(s, &_chunkSize) == false) {
+        return false;
+    }
+    if (stream_read_uint8(s, &_isCompressed) == false) {
+        return false;
+    }
+    if (stream_read_uint32(s, &_uncompressedSize) == false) {
+        return false;
+    }
+
+    if (_chunkSize == 0 || _uncompressedSize == 0) {
+        return false;
+    }
+
+    r->s = s;
+    r->memory = NULL;
+    r->uncompressedLeft = _uncompressedSize;
+
+    if (_isCompressed != 0) {
+        memset(&r->z, 0, sizeof(z_stream));
+        r->source = ChunkV6ReaderSource_Inflate;
+        r->compressedLeft = _chunkSize;
+
+        // no input window needed if compressed bytes can be borrowed
+        if (stream_is_memory_backed(s)) {
+            const void *compressed = stream_borrow(s, _chunkSize);
+            if (compressed == NULL) {
+                return false;
+            }
+            r->z.next_in = (Bytef *)compressed;
+            r->z.avail_in = _chunkSize;
+            r->compressedLeft = 0;
+        }
+
+        if (inflateInit(&r->z) != Z_OK) {
+            return false;
+        }
+    } else {
+        r->source = ChunkV6ReaderSource_Stream;
+        r->compressedLeft = 0;
+    }
+
+    *chunkSize = _chunkSize;
+    *uncompressedSize = _uncompressedSize;
+    return true;
+}
+
+void chunk_v6_reader_open_memory(ChunkV6Reader *r, const void *data, uint32_t size) {
+    r->s = NULL;
+    r->memory = (const uint8_t *)data;
+    r->compressedLeft = 0;
+    r->uncompressedLeft = size;
+    r->source = ChunkV6ReaderSource_Memory;
+}
+
+bool chunk_v6_reader_read(ChunkV6Reader *r, void *dst, uint32_t size) {
+    if (size > r->uncompressedLeft) {
+        return false;
+    }
+
+    switch (r->source) {
+        case ChunkV6ReaderSource_Stream: {
+            if (stream_read(r->s, dst, size, 1) == false) {
+                return false;
+            }
+            break;
+        }
+        case ChunkV6ReaderSource_Memory: {
+            memcpy(dst, r->memory, size);
+            r->memory += size;
+            break;
+        }
+        case ChunkV6ReaderSource_Inflate: {
+            r->z.next_out = (Bytef *)dst;
+            r->z.avail_out = size;
+            while (r->z.avail_out > 0) {
+                // refill input window
+                if (r->z.avail_in == 0) {
+                    if (r->compressedLeft == 0) {
+                        return false;
+                    }
+                    const uint32_t toRead = minimum(r->compressedLeft,
+                                                    (uint32_t)CHUNK_V6_READ_WINDOW_SIZE);
+                    if (stream_read(r->s, r->window, toRead, 1) == false) {
+                        return false;
+                    }
+                    r->compressedLeft -= toRead;
+                    r->z.next_in = r->window;
+                    r->z.avail_in = toRead;
+                }
+                const int ret = inflate(&r->z, Z_NO_FLUSH);
+                if (ret == Z_STREAM_END) {
+                    if (r->z.avail_out > 0) {
+                        return false; // payload shorter than announced
+                    }
+                    break;
+                }
+                if (ret != Z_OK) {
+                    return false;
+                }
+            }
+            break;
+        }
+    }
+
+    r->uncompressedLeft -= size;
+    return true;
+}
+
+bool chunk_v6_reader_skip(ChunkV6Reader *r, uint32_t size) {
+    if (size > r->uncompressedLeft) {
+        return false;
+    }
+
+    switch (r->source) {
+        case ChunkV6ReaderSource_Stream: {
+            if (stream_skip(r->s, size) == false) {
+                return false;
+            }
+            r->uncompressedLeft -= size;
+            return true;
+        }
+        case ChunkV6ReaderSource_Memory: {
+            r->memory += size;
+            r->uncompressedLeft -= size;
+            return true;
+        }
+        case ChunkV6ReaderSource_Inflate: {
+            // compressed data has to be inflated anyway
+            uint8_t scratch[1024];
+            while (size > 0) {
+                const uint32_t toSkip = minimum(size, (uint32_t)sizeof(scratch));
+                if (chunk_v6_reader_read(r, scratch, toSkip) == false) {
+                    return false;
+                }
+                size -= toSkip;
+            }
+            return true;
+        }
+    }
+    return false;
+}
+
+const void *chunk_v6_reader_borrow(ChunkV6Reader *r, uint32_t size) {
+    if (size > r->uncompressedLeft) {
+        return NULL;
+    }
+
+    const void *data = NULL;
+    switch (r->source) {
+        case ChunkV6ReaderSource_Stream: {
+            if (stream_is_memory_backed(r->s)) {
+                data = stream_borrow(r->s, size);
+            }
+            break;
+        }
+        case ChunkV6ReaderSource_Memory: {
+            data = r->memory;
+            r->memory += size;
+            break;
+        }
+        case ChunkV6ReaderSource_Inflate: {
+            break;
+        }
+    }
+
+    if (data != NULL) {
+        r->uncompressedLeft -= size;
+    }
+    return data;
+}
+
+void chunk_v6_reader_close(ChunkV6Reader *r) {
+    switch (r->source) {
+        case ChunkV6ReaderSource_Stream: {
+            stream_skip(r->s, r->uncompressedLeft);
+            break;
+        }
+        case ChunkV6ReaderSource_Memory: {
+            break;
+        }
+        case ChunkV6ReaderSource_Inflate: {
+            inflateEnd(&r->z);
+            stream_skip(r->s, r->compressedLeft);
+            r->compressedLeft = 0;
+            break;
+        }
+    }
+    r->uncompressedLeft = 0;
+}
+
+bool chunk_v6_read_shape_process_blocks(ChunkV6Reader *r,
+                                        Shape *shape,
+                                        uint16_t w,
+                                        uint16_t h,
+                                        uint16_t d,
+                                        uint8_t paletteID,
+                                        ColorPalette *shrinkPalette) {
+
+    // blocks are decoded as they are read, one window at a time
+    uint8_t window[CHUNK_V6_READ_WINDOW_SIZE];
+    uint32_t windowSize = 0;
+    uint32_t windowCursor = 0;
+    uint32_t blocksLeft = (uint32_t)w * (uint32_t)h * (uint32_t)d;
 
-    uint32_t size = *((uint32_t *)cursor); // shape blocks chunk size
-    cursor = (void *)((uint32_t *)cursor + 1);
     SHAPE_COLOR_INDEX_INT_T colorIndex;
     ColorPalette *palette = shape_get_palette(shape);
     for (SHAPE_COORDS_INT_T x = 0; x < w; x++) { // shape blocks
         for (SHAPE_COORDS_INT_T y = 0; y < h; y++) {
             for (SHAPE_COORDS_INT_T z = 0; z < d; z++) {
-                colorIndex = *((SHAPE_COLOR_INDEX_INT_T *)cursor);
-                cursor = (void *)((SHAPE_COLOR_INDEX_INT_T *)cursor + 1);
+                if (windowCursor == windowSize) {
+                    windowSize = minimum(blocksLeft, (uint32_t)CHUNK_V6_READ_WINDOW_SIZE);
+                    if (chunk_v6_reader_read(r, window, windowSize) == false) {
+                        return false;
+                    }
+                    blocksLeft -= windowSize;
+                    windowCursor = 0;
+                }
+                colorIndex = (SHAPE_COLOR_INDEX_INT_T)window[windowCursor];
+                windowCursor++;
 
                 if (colorIndex == SHAPE_COLOR_INDEX_AIR_BLOCK) { // no cube
                     continue;
@@ -814,7 +1133,40 @@ uint32_t chunk_v6_read_shape_process_blocks(void *cursor,
     }
     color_palette_clear_lighting_dirty(palette);
 
-    return size + sizeof(uint32_t);
+    return true;
+}
+
+void chunk_v6_read_shape_set_palette(Shape *shape,
+                                     ColorAtlas *colorAtlas,
+                                     ColorPalette *shapePalette,
+                                     ColorPalette *rootShapePalette,
+                                     ColorPalette *filePalette,
+                                     uint8_t *paletteID,
+                                     bool *shrinkPalette) {
+
+    // Compatibility modes (see comment in serialization_load_assets_v6):
+    // [MULTI] Use sub-chunk palette if it exists, else use shared palette, ignore file palette
+    // [SINGLE] If file palette exists, use it as shape palette (optionally shrinked)
+    // [LEGACY] No file palette, legacy palette ID will be used (shrinked)
+    *shrinkPalette = false;
+    if (rootShapePalette != NULL || shapePalette != NULL) { // [MULTI]
+        if (shapePalette != NULL) {                         // individual palette
+            shape_set_palette(shape, shapePalette, false);
+        } else { // shared palette
+            shape_set_palette(shape, rootShapePalette, true);
+        }
+        *paletteID = PALETTE_ID_CUSTOM;
+    } else if (filePalette != NULL) { // [SINGLE]
+        *shrinkPalette = color_palette_get_count(filePalette) >= SHAPE_COLOR_INDEX_MAX_COUNT;
+        shape_set_palette(shape,
+                          *shrinkPalette ? color_palette_new(colorAtlas)
+                                         : color_palette_new_copy(filePalette),
+                          false);
+        *paletteID = PALETTE_ID_CUSTOM;
+    } else { // [LEGACY]
+        shape_set_palette(shape, color_palette_new(colorAtlas), false);
+        vx_assert(*paletteID != PALETTE_ID_CUSTOM); // from caller, reading legacy chunks at root
+    }
 }
 
 uint32_t chunk_v6_read_shape(Stream *s,
@@ -830,11 +1182,11 @@ uint32_t chunk_v6_read_shape(Stream *s,
         return 0;
     }
 
-    /// read file
-    void *chunkData = NULL;
+    /// read file, shape data is inflated & decoded incrementally
+    ChunkV6Reader reader;
     uint32_t chunkSize = 0;
     uint32_t uncompressedSize = 0;
-    if (chunk_v6_read(&chunkData, &chunkSize, &uncompressedSize, s) == false) {
+    if (chunk_v6_reader_open(&reader, s, &chunkSize, &uncompressedSize) == false) {
         cclog_error("failed to read shape");
         return 0;
     }
@@ -842,7 +1194,7 @@ uint32_t chunk_v6_read_shape(Stream *s,
     // no need to read if shape return parameter is NULL
     if (shape == NULL) {
         cclog_error("shape pointer is null");
-        free(chunkData);
+        chunk_v6_reader_close(&reader);
         return CHUNK_V6_HEADER_NO_ID_SIZE + chunkSize;
     }
 
@@ -852,8 +1204,15 @@ uint32_t chunk_v6_read_shape(Stream *s,
     }
 
     /// get shape data
-    void *cursor = chunkData;
-    void *shapeBlocksCursor = NULL;
+    // blocks are streamed into the shape when its size & palette are known, as written by
+    // chunk_v6_shape_create_and_write_uncompressed_buffer. Otherwise palette sub-chunk may come
+    // after them, blocks are then decoded once the whole shape chunk is read, borrowed from Stream
+    // memory if possible or buffered
+    bool paletteSet = false;
+    const void *shapeBlocks = NULL;
+    void *shapeBlocksData = NULL;
+    uint32_t shapeBlocksDataSize = 0;
+    bool ok = true;
 
     uint32_t totalSizeRead = 0;
     uint32_t sizeRead = 0;
@@ -864,6 +1223,7 @@ uint32_t chunk_v6_read_shape(Stream *s,
     MapStringFloat3 *pois_rotation = map_string_float3_new();
     VERTEX_LIGHT_STRUCT_T *lightingData = NULL;
     ColorPalette *palette = NULL;
+    bool shrinkPalette = false;
 
     uint16_t width = 0;
     uint16_t height = 0;
@@ -886,50 +1246,56 @@ uint32_t chunk_v6_read_shape(Stream *s,
     float3 pivot = {0.0f, 0.0f, 0.0f};
     bool hasPivot = false;
 
-    while (totalSizeRead < uncompressedSize) {
-        chunkID = *((uint8_t *)cursor);
-        cursor = (void *)((uint8_t *)cursor + 1);
+    while (ok && totalSizeRead < uncompressedSize) {
+        if (chunk_v6_reader_read(&reader, &chunkID, sizeof(uint8_t)) == false) {
+            ok = false;
+            break;
+        }
         totalSizeRead += 1; // size of chunk id
         switch (chunkID) {
             case P3S_CHUNK_ID_SHAPE_ID: {
-                memcpy(&sizeRead, cursor, sizeof(uint32_t)); // shape id chunk size
-                cursor = (void *)((uint32_t *)cursor + 1);
-                memcpy(&shapeId, cursor, sizeof(uint16_t));
-                cursor = (void *)((uint16_t *)cursor + 1);
+                ok = chunk_v6_reader_read(&reader, &sizeRead, sizeof(uint32_t)) && // chunk size
+                     chunk_v6_reader_read(&reader, &shapeId, sizeof(uint16_t));
                 totalSizeRead += sizeRead + (uint32_t)sizeof(uint32_t);
                 break;
             }
             case P3S_CHUNK_ID_SHAPE_PARENT_ID: {
-                memcpy(&sizeRead, cursor, sizeof(uint32_t)); // shape id chunk size
-                cursor = (void *)((uint32_t *)cursor + 1);
-                memcpy(&shapeParentId, cursor, sizeof(uint16_t));
-                cursor = (void *)((uint16_t *)cursor + 1);
+                ok = chunk_v6_reader_read(&reader, &sizeRead, sizeof(uint32_t)) && // chunk size
+                     chunk_v6_reader_read(&reader, &shapeParentId, sizeof(uint16_t));
                 totalSizeRead += sizeRead + (uint32_t)sizeof(uint32_t);
                 break;
             }
             case P3S_CHUNK_ID_SHAPE_TRANSFORM: {
-                memcpy(&sizeRead, cursor, sizeof(uint32_t)); // shape id chunk size
-                cursor = (void *)((uint32_t *)cursor + 1);
-                memcpy(&localTransform, cursor, sizeof(LocalTransform));
-                cursor = (void *)((LocalTransform *)cursor + 1);
+                ok = chunk_v6_reader_read(&reader, &sizeRead, sizeof(uint32_t)) && // chunk size
+                     chunk_v6_reader_read(&reader, &localTransform, sizeof(LocalTransform));
                 totalSizeRead += sizeRead + (uint32_t)sizeof(uint32_t);
                 break;
             }
             case P3S_CHUNK_ID_SHAPE_PIVOT: {
-                memcpy(&sizeRead, cursor, sizeof(uint32_t)); // shape id chunk size
-                cursor = (void *)((uint32_t *)cursor + 1);
-                memcpy(&pivot, cursor, sizeof(float3));
-                cursor = (void *)((float3 *)cursor + 1);
+                ok = chunk_v6_reader_read(&reader, &sizeRead, sizeof(uint32_t)) && // chunk size
+                     chunk_v6_reader_read(&reader, &pivot, sizeof(float3));
                 totalSizeRead += sizeRead + (uint32_t)sizeof(uint32_t);
                 hasPivot = true;
                 break;
             }
             case P3S_CHUNK_ID_SHAPE_PALETTE: {
-                memcpy(&sizeRead, cursor, sizeof(uint32_t)); // shape palette chunk size
-                cursor = (void *)((uint32_t *)cursor + 1);
+                // shape palette chunk size
+                ok = chunk_v6_reader_read(&reader, &sizeRead, sizeof(uint32_t));
+                if (ok == false) {
+                    break;
+                }
 
-                palette = chunk_v6_read_palette_data(cursor, colorAtlas, false);
-                cursor = (void *)((uint8_t *)cursor + sizeRead);
+                // palette sub-chunk is small, read it entirely
+                void *paletteData = malloc(sizeRead);
+                if (paletteData == NULL) {
+                    ok = false;
+                    break;
+                }
+                ok = chunk_v6_reader_read(&reader, paletteData, sizeRead);
+                if (ok) {
+                    palette = chunk_v6_read_palette_data(paletteData, colorAtlas, false);
+                }
+                free(paletteData);
 
                 paletteID = PALETTE_ID_CUSTOM;
 
@@ -942,142 +1308,141 @@ uint32_t chunk_v6_read_shape(Stream *s,
                 break;
             }
             case P3S_CHUNK_ID_OBJECT_COLLISION_BOX: {
-                memcpy(&sizeRead, cursor, sizeof(uint32_t)); // shape id chunk size
-                cursor = (void *)((uint32_t *)cursor + 1);
-                memcpy(&collisionBoxMin, cursor, sizeof(float3));
-                cursor = (void *)((float3 *)cursor + 1);
-                memcpy(&collisionBoxMax, cursor, sizeof(float3));
-                cursor = (void *)((float3 *)cursor + 1);
+                ok = chunk_v6_reader_read(&reader, &sizeRead, sizeof(uint32_t)) && // chunk size
+                     chunk_v6_reader_read(&reader, &collisionBoxMin, sizeof(float3)) &&
+                     chunk_v6_reader_read(&reader, &collisionBoxMax, sizeof(float3));
                 totalSizeRead += sizeRead + (uint32_t)sizeof(uint32_t);
                 hasCustomCollisionBox = true;
                 break;
             }
             case P3S_CHUNK_ID_OBJECT_IS_HIDDEN: {
-                memcpy(&sizeRead, cursor, sizeof(uint32_t)); // object is hidden chunk size
-                cursor = (void *)((uint32_t *)cursor + 1);
-                memcpy(&isHiddenSelf, cursor, sizeof(uint8_t));
-                cursor = (void *)((uint8_t *)cursor + 1);
+                ok = chunk_v6_reader_read(&reader, &sizeRead, sizeof(uint32_t)) && // chunk size
+                     chunk_v6_reader_read(&reader, &isHiddenSelf, sizeof(uint8_t));
                 totalSizeRead += sizeRead + (uint32_t)sizeof(uint32_t);
                 break;
             }
             case P3S_CHUNK_ID_SHAPE_NAME: {
                 uint8_t nameLen;
-                memcpy(&nameLen, cursor, sizeof(uint8_t));
-                cursor = (void *)((uint8_t *)cursor + 1);
+                ok = chunk_v6_reader_read(&reader, &nameLen, sizeof(uint8_t));
+                if (ok == false) {
+                    break;
+                }
                 if (name != NULL) { // shouldn't happen
                     free(name);
                 }
                 name = malloc(nameLen + 1);
                 if (name == NULL) {
                     cclog_error("malloc failed");
+                    ok = chunk_v6_reader_skip(&reader, nameLen);
                 } else {
-                    memcpy(name, cursor, sizeof(char) * nameLen);
+                    ok = chunk_v6_reader_read(&reader, name, sizeof(char) * nameLen);
                     name[nameLen] = 0;
                 }
-                cursor = (void *)((uint8_t *)cursor + nameLen);
                 totalSizeRead += (uint32_t)(sizeof(uint8_t) + sizeof(char) * nameLen);
                 break;
             }
             case P3S_CHUNK_ID_SHAPE_SIZE: {
-                memcpy(&sizeRead, cursor, sizeof(uint32_t)); // shape size chunk size
-                cursor = (void *)((uint32_t *)cursor + 1);
-                memcpy(&width, cursor, sizeof(uint16_t)); // shape size X
-                cursor = (void *)((uint16_t *)cursor + 1);
-                memcpy(&height, cursor, sizeof(uint16_t)); // shape size Y
-                cursor = (void *)((uint16_t *)cursor + 1);
-                memcpy(&depth, cursor, sizeof(uint16_t)); // shape size Y
-                cursor = (void *)((uint16_t *)cursor + 1);
+                ok = chunk_v6_reader_read(&reader, &sizeRead, sizeof(uint32_t)) && // chunk size
+                     chunk_v6_reader_read(&reader, &width, sizeof(uint16_t)) &&    // size X
+                     chunk_v6_reader_read(&reader, &height, sizeof(uint16_t)) &&   // size Y
+                     chunk_v6_reader_read(&reader, &depth, sizeof(uint16_t));      // size Z
 
                 totalSizeRead += sizeRead + (uint32_t)sizeof(uint32_t);
 
                 // size is known, now is a good time to create the shape
-                *shape = shape_make_2(shapeSettings->isMutable);
+                if (ok && *shape == NULL) {
+                    *shape = shape_make_2(shapeSettings->isMutable);
+                }
                 break;
             }
             case P3S_CHUNK_ID_SHAPE_BLOCKS: {
-                // Palette and size are required to read blocks, storing blocks position to process
-                // them later
-                shapeBlocksCursor = cursor;
-
                 // shape blocks chunk size
-                sizeRead = *((uint32_t *)cursor);
-                cursor = (void *)((uint32_t *)cursor + 1);
-
-                // skip chunk for now
-                cursor = (void *)((uint8_t *)cursor + sizeRead);
+                ok = chunk_v6_reader_read(&reader, &sizeRead, sizeof(uint32_t));
+                if (ok == false) {
+                    break;
+                }
                 totalSizeRead += sizeRead + (uint32_t)sizeof(uint32_t);
-                break;
-            }
-            case P3S_CHUNK_ID_SHAPE_POINT: {
-                uint8_t nameLen = 0;
-                char *nameStr = NULL;
-                float3 *poi = float3_new(0, 0, 0);
-
-                memcpy(&sizeRead, cursor, sizeof(uint32_t)); // shape POI chunk size
-                cursor = (void *)((uint32_t *)cursor + 1);
-
-                memcpy(&nameLen, cursor, sizeof(uint8_t)); // shape POI name length
-                cursor = (void *)((uint8_t *)cursor + 1);
 
-                nameStr = (char *)malloc(nameLen + 1); // +1 for null terminator
-                if (nameStr == NULL) {
-                    cclog_error("malloc failed");
-                } else {
-                    memcpy(nameStr, cursor, nameLen); // shape POI name
-                    nameStr[nameLen] = 0;             // add null terminator
+                // [MULTI] blocks use shape palette indexes as is, a palette sub-chunk following
+                // them (legacy) can still replace the shape palette
+                if (*shape != NULL && paletteSet == false &&
+                    (palette != NULL || *rootShapePalette != NULL)) {
+                    chunk_v6_read_shape_set_palette(*shape,
+                                                    colorAtlas,
+                                                    palette,
+                                                    *rootShapePalette,
+                                                    filePalette,
+                                                    &paletteID,
+                                                    &shrinkPalette);
+                    paletteSet = true;
                 }
-                cursor = (void *)((char *)cursor + nameLen);
-
-                memcpy(&(poi->x), cursor, sizeof(float)); // shape POI X
-                cursor = (void *)((float *)cursor + 1);
-
-                memcpy(&(poi->y), cursor, sizeof(float)); // shape POI Y
-                cursor = (void *)((float *)cursor + 1);
-
-                memcpy(&(poi->z), cursor, sizeof(float)); // shape POI Z
-                cursor = (void *)((float *)cursor + 1);
-
-                if (nameStr != NULL) {
-                    map_string_float3_set_key_value(pois, nameStr, poi);
-                    free(nameStr);
+                if (paletteSet) {
+                    const uint32_t blockCount = (uint32_t)width * (uint32_t)height *
+                                                (uint32_t)depth;
+                    ok = sizeRead >= blockCount &&
+                         chunk_v6_read_shape_process_blocks(&reader,
+                                                            *shape,
+                                                            width,
+                                                            height,
+                                                            depth,
+                                                            paletteID,
+                                                            NULL) &&
+                         chunk_v6_reader_skip(&reader, sizeRead - blockCount);
+                    break;
                 }
 
-                totalSizeRead += sizeRead + (uint32_t)sizeof(uint32_t);
+                free(shapeBlocksData); // shouldn't happen
+                shapeBlocksData = NULL;
+                shapeBlocks = chunk_v6_reader_borrow(&reader, sizeRead);
+                if (shapeBlocks == NULL) {
+                    shapeBlocksData = malloc(sizeRead);
+                    if (shapeBlocksData == NULL) {
+                        ok = false;
+                        break;
+                    }
+                    ok = chunk_v6_reader_read(&reader, shapeBlocksData, sizeRead);
+                    shapeBlocks = shapeBlocksData;
+                }
+                shapeBlocksDataSize = sizeRead;
                 break;
             }
+            case P3S_CHUNK_ID_SHAPE_POINT:
             case P3S_CHUNK_ID_SHAPE_POINT_ROTATION: {
                 uint8_t nameLen = 0;
                 char *nameStr = NULL;
                 float3 *poi = float3_new(0, 0, 0);
 
-                memcpy(&sizeRead, cursor, sizeof(uint32_t)); // shape POI chunk size
-                cursor = (void *)((uint32_t *)cursor + 1);
-
-                memcpy(&nameLen, cursor, sizeof(uint8_t)); // shape POI name length
-                cursor = (void *)((uint8_t *)cursor + 1);
+                // shape POI chunk size & name length
+                ok = chunk_v6_reader_read(&reader, &sizeRead, sizeof(uint32_t)) &&
+                     chunk_v6_reader_read(&reader, &nameLen, sizeof(uint8_t));
+                if (ok == false) {
+                    float3_free(poi);
+                    break;
+                }
 
                 nameStr = (char *)malloc(nameLen + 1); // +1 for null terminator
                 if (nameStr == NULL) {
                     cclog_error("malloc failed");
+                    ok = chunk_v6_reader_skip(&reader, nameLen);
                 } else {
-                    memcpy(nameStr, cursor, nameLen); // shape POI name
-                    nameStr[nameLen] = 0;             // add null terminator
+                    ok = chunk_v6_reader_read(&reader, nameStr, nameLen); // shape POI name
+                    nameStr[nameLen] = 0;                                  // null terminator
                 }
-                cursor = (void *)((char *)cursor + nameLen);
 
-                memcpy(&(poi->x), cursor, sizeof(float)); // shape POI X
-                cursor = (void *)((float *)cursor + 1);
+                ok = ok && chunk_v6_reader_read(&reader, &(poi->x), sizeof(float)) && // POI X
+                     chunk_v6_reader_read(&reader, &(poi->y), sizeof(float)) &&       // POI Y
+                     chunk_v6_reader_read(&reader, &(poi->z), sizeof(float));         // POI Z
 
-                memcpy(&(poi->y), cursor, sizeof(float)); // shape POI Y
-                cursor = (void *)((float *)cursor + 1);
-
-                memcpy(&(poi->z), cursor, sizeof(float)); // shape POI Z
-                cursor = (void *)((float *)cursor + 1);
-
-                if (nameStr != NULL) {
-                    map_string_float3_set_key_value(pois_rotation, nameStr, poi);
-                    free(nameStr);
+                if (ok && nameStr != NULL) {
+                    map_string_float3_set_key_value(chunkID == P3S_CHUNK_ID_SHAPE_POINT
+                                                        ? pois
+                                                        : pois_rotation,
+                                                    nameStr,
+                                                    poi);
+                } else {
+                    float3_free(poi);
                 }
+                free(nameStr);
 
                 totalSizeRead += sizeRead + (uint32_t)sizeof(uint32_t);
                 break;
@@ -1085,8 +1450,10 @@ uint32_t chunk_v6_read_shape(Stream *s,
 #if GLOBAL_LIGHTING_BAKE_READ_ENABLED
             case P3S_CHUNK_ID_SHAPE_BAKED_LIGHTING: {
                 // shape baked lighting chunk size
-                memcpy(&lightingDataSizeRead, cursor, sizeof(uint32_t));
-                cursor = (void *)((uint32_t *)cursor + 1);
+                ok = chunk_v6_reader_read(&reader, &lightingDataSizeRead, sizeof(uint32_t));
+                if (ok == false) {
+                    break;
+                }
 
                 totalSizeRead += lightingDataSizeRead + (uint32_t)sizeof(uint32_t);
 
@@ -1096,12 +1463,15 @@ uint32_t chunk_v6_read_shape(Stream *s,
                     }
                     lightingData = (VERTEX_LIGHT_STRUCT_T *)malloc(lightingDataSizeRead);
                     if (lightingData == NULL) {
+                        ok = chunk_v6_reader_skip(&reader, lightingDataSizeRead);
                         break;
                     }
 
-                    memcpy(lightingData, cursor, lightingDataSizeRead);
-                    cursor = (void *)((char *)cursor + lightingDataSizeRead);
+                    ok = chunk_v6_reader_read(&reader, lightingData, lightingDataSizeRead);
+                } else {
+                    ok = chunk_v6_reader_skip(&reader, lightingDataSizeRead);
                 }
+                break;
             }
 #endif
             default: // shape sub chunks we don't need to read
@@ -1115,13 +1485,18 @@ uint32_t chunk_v6_read_shape(Stream *s,
                  #define P3S_CHUNK_ID_GENERAL_RENDERING_OPTIONS 14
                  */
                 // sub chunk header size + sub chunk data size
+                uint32_t subChunkSize = 0;
                 if (uncompressedSize >= totalSizeRead &&
-                    uncompressedSize - totalSizeRead >= sizeof(uint32_t)) {
-                    sizeRead = CHUNK_V6_HEADER_NO_ID_SIZE + *((uint32_t *)cursor);
-                    // advance cursor
-                    cursor = (void *)((char *)cursor + sizeRead);
-
-                    totalSizeRead += sizeRead;
+                    uncompressedSize - totalSizeRead >= sizeof(uint32_t) &&
+                    chunk_v6_reader_read(&reader, &subChunkSize, sizeof(uint32_t))) {
+                    sizeRead = CHUNK_V6_HEADER_NO_ID_SIZE + subChunkSize;
+
+                    if (sizeRead <= uncompressedSize - totalSizeRead) {
+                        ok = chunk_v6_reader_skip(&reader, sizeRead - (uint32_t)sizeof(uint32_t));
+                        totalSizeRead += sizeRead;
+                    } else {
+                        totalSizeRead = uncompressedSize; // end it
+                    }
                 } else {
                     totalSizeRead = uncompressedSize; // end it
                 }
@@ -1130,54 +1505,53 @@ uint32_t chunk_v6_read_shape(Stream *s,
         }
     }
 
-    if (*shape == NULL) {
+    // moves Stream cursor to the end of the chunk
+    chunk_v6_reader_close(&reader);
+
+    if (*shape == NULL || ok == false) {
+        if (*shape != NULL) {
+            if (shape_get_palette(*shape) == palette) {
+                palette = NULL; // released w/ shape
+            }
+            shape_release(*shape);
+            *shape = NULL;
+        }
+        free(shapeBlocksData);
         free(lightingData);
         free(name);
         free(palette);
         map_string_float3_free(pois);
         map_string_float3_free(pois_rotation);
-        free(chunkData);
         cclog_error("error while reading shape : no shape were created");
         return 0;
     }
 
-    // Compatibility modes (see comment in serialization_load_assets_v6):
-    // [MULTI] Use sub-chunk palette if it exists, else use shared palette, ignore file palette
-    // [SINGLE] If file palette exists, use it as shape palette (optionally shrinked)
-    // [LEGACY] No file palette, legacy palette ID will be used (shrinked)
-    bool shrinkPalette = false;
-    if (*rootShapePalette != NULL || palette != NULL) { // [MULTI]
-        if (palette != NULL) {                          // individual palette
-            shape_set_palette(*shape, palette, false);
-        } else { // shared palette
-            shape_set_palette(*shape, *rootShapePalette, true);
-        }
-        paletteID = PALETTE_ID_CUSTOM;
-    } else if (filePalette != NULL) { // [SINGLE]
-        shrinkPalette = color_palette_get_count(filePalette) >= SHAPE_COLOR_INDEX_MAX_COUNT;
-        shape_set_palette(*shape,
-                          shrinkPalette ? color_palette_new(colorAtlas)
-                                        : color_palette_new_copy(filePalette),
-                          false);
-        paletteID = PALETTE_ID_CUSTOM;
-    } else { // [LEGACY]
-        shape_set_palette(*shape, color_palette_new(colorAtlas), false);
-        vx_assert(paletteID != PALETTE_ID_CUSTOM); // from caller, reading legacy chunks at the root
+    if (paletteSet == false) {
+        chunk_v6_read_shape_set_palette(*shape,
+                                        colorAtlas,
+                                        palette,
+                                        *rootShapePalette,
+                                        filePalette,
+                                        &paletteID,
+                                        &shrinkPalette);
+    } else if (palette != NULL && shape_get_palette(*shape) != palette) {
+        shape_set_palette(*shape, palette, false); // blocks count is transferred
     }
 
-    // process blocks now
-    if (shapeBlocksCursor != NULL) {
-        chunk_v6_read_shape_process_blocks(shapeBlocksCursor,
+    // process blocks now that palette is known
+    if (shapeBlocks != NULL) {
+        ChunkV6Reader blocksReader;
+        chunk_v6_reader_open_memory(&blocksReader, shapeBlocks, shapeBlocksDataSize);
+        chunk_v6_read_shape_process_blocks(&blocksReader,
                                            *shape,
                                            width,
                                            height,
                                            depth,
                                            paletteID,
                                            shrinkPalette ? filePalette : NULL);
+        free(shapeBlocksData);
     }
 
-    free(chunkData);
-
     float3 f3;
 
     // set shape POIs
@@ -1787,77 +2161,6 @@ bool chunk_v6_shape_create_and_write_uncompressed_buffer(const Shape *shape,
     return true;
 }
 
-bool chunk_v6_shape_create_and_write_compressed_buffer(const Shape *shape,
-                                                       uint16_t shapeId,
-                                                       uint16_t shapeParentId,
-                                                       const ColorPalette *sharedPalette,
-                                                       uint32_t *uncompressedSize,
-                                                       uint32_t *compressedSize,
-                                                       void **compressedData) {
-
-    if (uncompressedSize == NULL) {
-        return false;
-    }
-    if (compressedSize == NULL) {
-        return false;
-    }
-    if (compressedData == NULL) {
-        return false;
-    }
-
-    if (*compressedData != NULL) {
-        free(*compressedData);
-        *compressedData = NULL;
-    }
-
-    *uncompressedSize = 0;
-    *compressedSize = 0;
-
-    // first, get uncompressed data
-
-    void *uncompressedData = NULL;
-
-    if (chunk_v6_shape_create_and_write_uncompressed_buffer(shape,
-                                                            shapeId,
-                                                            shapeParentId,
-                                                            sharedPalette,
-                                                            uncompressedSize,
-                                                            &uncompressedData) == false) {
-        cclog_error("chunk_v6_shape_create_and_write_uncompressed_buffer failed");
-        return false;
-    }
-
-    // compress it
-
-    // compressBound is a zlib function making sure the buffer for compression will be large enough
-    // _compressedSize here is not final, it will be known after compression.
-    uLong _compressedSize = compressBound(*uncompressedSize);
-    void *_compressedData = malloc(_compressedSize);
-    if (_compressedData == NULL) {
-        return false; // malloc failed
-    }
-
-    if (compress(_compressedData, &_compressedSize, uncompressedData, *uncompressedSize) != Z_OK) {
-        free(_compressedData);
-        return false;
-    }
-
-    free(uncompressedData);
-
-    // now we have the final compressed size and data, we can pass it to our outputs.
-    *compressedSize = (uint32_t)_compressedSize;
-    *compressedData = malloc(*compressedSize);
-    if (*compressedData == NULL) {
-        free(_compressedData);
-        return false;
-    }
-    memcpy(*compressedData, _compressedData, *compressedSize);
-
-    free(_compressedData);
-
-    return true;
-}
-
 void _chunk_v6_palette_create_and_write_uncompressed_buffer(
     const ColorPalette *palette,
     uint32_t *uncompressedSize,
@@ -1891,50 +2194,6 @@ void _chunk_v6_palette_create_and_write_uncompressed_buffer(
     free(emissive);
 }
 
-bool _chunk_v6_palette_create_and_write_compressed_buffer(
-    const ColorPalette *palette,
-    uint32_t *uncompressedSize,
-    uint32_t *compressedSize,
-    void **compressedData,
-    SHAPE_COLOR_INDEX_INT_T **paletteMapping) {
-    void *uncompressedData = NULL;
-    if (paletteMapping != NULL) {
-        *paletteMapping = NULL;
-    }
-    _chunk_v6_palette_create_and_write_uncompressed_buffer(palette,
-                                                           uncompressedSize,
-                                                           &uncompressedData,
-                                                           paletteMapping);
-
-    // zlib: compressBound estimates size so we can allocate
-    uLong _compressedSize = compressBound(*uncompressedSize);
-    void *_compressedData = malloc(_compressedSize);
-    if (_compressedData == NULL) { // malloc failed
-        free(uncompressedData);
-        return false;
-    }
-
-    if (compress(_compressedData, &_compressedSize, uncompressedData, *uncompressedSize) != Z_OK) {
-        free(uncompressedData);
-        free(_compressedData);
-        return false;
-    }
-    free(uncompressedData);
-
-    // now we have the final compressed size and data
-    *compressedSize = (uint32_t)_compressedSize;
-    *compressedData = malloc(*compressedSize);
-    if (compressedData == NULL) { // mem alloc failed
-        free(_compressedData);
-        return false;
-    }
-    memcpy(*compressedData, _compressedData, *compressedSize);
-
-    free(_compressedData);
-
-    return true;
-}
-
 uint32_t getChunkHeaderSize(const uint8_t chunkID) {
     uint32_t result = 0;
     switch (chunkID) {
@@ -1974,8 +2233,7 @@ bool create_shape_buffers(DoublyLinkedList *shapesBuffers,
                           Shape const *shape,
                           uint16_t *shapeId,
                           uint16_t shapeParentId,
-                          const ColorPalette *sharedPalette,
-                          uint32_t *size) {
+                          const ColorPalette *sharedPalette) {
 
     ShapeBuffers *currentBuffer = calloc(1, sizeof(ShapeBuffers));
     if (currentBuffer == NULL) {
@@ -1983,17 +2241,16 @@ bool create_shape_buffers(DoublyLinkedList *shapesBuffers,
     }
     doubly_linked_list_push_last(shapesBuffers, currentBuffer);
 
-    if (chunk_v6_shape_create_and_write_compressed_buffer(shape,
-                                                          *shapeId,
-                                                          shapeParentId,
-                                                          sharedPalette,
-                                                          &currentBuffer->shapeUncompressedDataSize,
-                                                          &currentBuffer->shapeCompressedDataSize,
-                                                          &currentBuffer->shapeCompressedData) ==
+    if (chunk_v6_shape_create_and_write_uncompressed_buffer(shape,
+                                                            *shapeId,
+                                                            shapeParentId,
+                                                            sharedPalette,
+                                                            &currentBuffer->shapeUncompressedDataSize,
+                                                            &currentBuffer->shapeUncompressedData) ==
         false) {
+        cclog_error("chunk_v6_shape_create_and_write_uncompressed_buffer failed");
         return false;
     }
-    *size += compute_shape_chunk_size(currentBuffer->shapeCompressedDataSize);
 
     shapeParentId = *shapeId;
     (*shapeId)++;
@@ -2008,8 +2265,7 @@ bool create_shape_buffers(DoublyLinkedList *shapesBuffers,
                                      childShape,
                                      shapeId,
                                      shapeParentId,
-                                     sharedPalette,
-                                     size) == false) {
+                                     sharedPalette) == false) {
                 return false;
             }
         }
@@ -2018,6 +2274,66 @@ bool create_shape_buffers(DoublyLinkedList *shapesBuffers,
     return true;
 }
 
+bool compress_shape_buffers(DoublyLinkedList *shapesBuffers,
+                            SerializationCompressionTask *extra,
+                            uint32_t *size) {
+
+    size_t count = doubly_linked_list_node_count(shapesBuffers);
+    SerializationCompressionTask *tasks = (SerializationCompressionTask *)malloc(
+        sizeof(SerializationCompressionTask) * (count + 1));
+    if (tasks == NULL) {
+        return false;
+    }
+
+    size_t i = 0;
+    DoublyLinkedListNode *n = doubly_linked_list_first(shapesBuffers);
+    while (n != NULL) {
+        const ShapeBuffers *buffers = (const ShapeBuffers *)doubly_linked_list_node_pointer(n);
+        tasks[i].src = buffers->shapeUncompressedData;
+        tasks[i].srcSize = buffers->shapeUncompressedDataSize;
+        ++i;
+        n = doubly_linked_list_node_next(n);
+    }
+    if (extra != NULL) {
+        tasks[count++] = *extra;
+    }
+
+    if (serialization_utils_compress_parallel(tasks, count) == false) {
+        free(tasks);
+        return false;
+    }
+
+    i = 0;
+    n = doubly_linked_list_first(shapesBuffers);
+    while (n != NULL) {
+        ShapeBuffers *buffers = (ShapeBuffers *)doubly_linked_list_node_pointer(n);
+        free(buffers->shapeUncompressedData);
+        buffers->shapeUncompressedData = NULL;
+        buffers->shapeCompressedData = tasks[i].dst;
+        buffers->shapeCompressedDataSize = tasks[i].dstSize;
+        *size += compute_shape_chunk_size(buffers->shapeCompressedDataSize);
+        ++i;
+        n = doubly_linked_list_node_next(n);
+    }
+    if (extra != NULL) {
+        *extra = tasks[i];
+    }
+
+    free(tasks);
+    return true;
+}
+
+void free_shape_buffers(DoublyLinkedList *shapesBuffers) {
+    ShapeBuffers *buffers = (ShapeBuffers *)doubly_linked_list_pop_first(shapesBuffers);
+    while (buffers != NULL) {
+        free(buffers->shapeUncompressedData);
+        free(buffers->shapeCompressedData);
+        free(buffers);
+        buffers = (ShapeBuffers *)doubly_linked_list_pop_first(shapesBuffers);
+    }
+    doubly_linked_list_free(shapesBuffers);
+}
+
 DoublyLinkedList *serialization_load_assets_v6(Stream *s,
                                                ColorAtlas *colorAtlas,
                                                const AssetType filterMask,
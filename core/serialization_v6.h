@@ -42,6 +42,20 @@ bool serialization_v6_save_shape(Shape *shape,
                                  uint32_t imageDataSize,
                                  FILE *fd);
 
+/// Everything needed to save a shape & its children, copied at creation time.
+/// Once created, a snapshot doesn't depend on shapes anymore and can be written from any thread.
+typedef struct _SerializationV6Snapshot SerializationV6Snapshot;
+
+/// Serializes shapes (uncompressed) & copies preview, to be called on the thread owning the shape
+SerializationV6Snapshot *serialization_v6_snapshot_new(const Shape *shape,
+                                                       const void *imageData,
+                                                       uint32_t imageDataSize);
+
+/// Compresses & writes snapshot in file (everything after magic bytes), from any thread
+bool serialization_v6_snapshot_write(SerializationV6Snapshot *snapshot, FILE *fd);
+
+void serialization_v6_snapshot_free(SerializationV6Snapshot *snapshot);
+
 /// Serialize a shape in a newly created memory buffer
 bool serialization_v6_save_shape_as_buffer(const Shape *const shape,
                                            const ColorPalette *const artistPalette,
@@ -17,6 +17,7 @@
 #include "history.h"
 #include "rigidBody.h"
 #include "scene.h"
+#include "thread_pool.h"
 #include "transaction.h"
 #include "utils.h"
 
@@ -27,6 +28,11 @@
 // takes the 4 low bits of a and casts into uint8_t
 #define TO_UINT4(a) (uint8_t)((a) & 0x0F)
 
+// parallel baked lighting: size of a region along x & z (in chunks), and minimum number of chunks
+// for shape_compute_baked_lighting to use it
+#define LIGHT_REGION_SIZE 2
+#define LIGHT_PARALLEL_MIN_CHUNKS 64
+
 #define SHAPE_RENDERING_FLAG_NONE 0
 // whether or not to draw transparent inner faces between 2 blocks of a different color
 #define SHAPE_RENDERING_FLAG_INNER_TRANSPARENT_FACES 1
@@ -42,6 +48,35 @@
 #define SHAPE_LUA_FLAG_HISTORY 2
 #define SHAPE_LUA_FLAG_HISTORY_KEEP_PENDING 4
 
+// lighting batch: how a block changed between batch start & end
+#define LIGHTING_BATCH_CHANGE_NONE 0
+#define LIGHTING_BATCH_CHANGE_ADDED 1
+#define LIGHTING_BATCH_CHANGE_REMOVED 2
+#define LIGHTING_BATCH_CHANGE_REPLACED 3
+#define LIGHTING_BATCH_CHANGE_ADDED_AND_REMOVED 4
+
+typedef struct {
+    SHAPE_COORDS_INT3_T coords;     /* 6 bytes */
+    SHAPE_COLOR_INDEX_INT_T before; // block at batch start, air if none
+    uint8_t kind;                   // set when batch ends
+} _LightingBatchChange;
+
+// deferred lighting: stage of the batch being applied
+#define LIGHTING_WORK_IDLE 0
+#define LIGHTING_WORK_REMOVAL 1
+#define LIGHTING_WORK_PROPAGATION 2
+
+typedef struct {
+    Index3D *changes; // batch being applied, NULL when idle
+    LightNodeQueue *lightQueue;
+    LightRemovalNodeQueue *lightRemovalQueue;
+    SHAPE_COORDS_INT3_T min, max; // changed values bounding box
+    uint32_t budget;              // light nodes processed per frame
+    uint8_t stage;
+    bool ownsBatch; // false while lighting batch is the one opened by shape_begin_lighting_batch
+    char pad[2];
+} _LightingWork;
+
 struct _Shape {
     Weakptr *wptr;
 
@@ -69,6 +104,15 @@ struct _Shape {
     FifoList *dirtyChunks;
     Rtree *rtree;
 
+    // chunk coordinates (int3) of chunks w/ block changes since last clear, NULL if not tracked
+    Index3D *editedChunks;
+
+    // blocks changed since lighting batch start (_LightingBatchChange), NULL if not batching
+    Index3D *lightingBatch;
+
+    // pending lighting work, NULL if lighting isn't deferred
+    _LightingWork *lightingWork;
+
     // fragmented vertex buffers
     DoublyLinkedList *fragmentedVBs;
 
@@ -93,6 +137,9 @@ struct _Shape {
     uint8_t vbAllocationFlag_opaque;      // 1 byte
     uint8_t vbAllocationFlag_transparent; // 1 byte
 
+    // offset from shape coordinates to the coordinates its edits are saved in
+    SHAPE_COORDS_INT3_T editsOffset; /* 3 x 2 bytes */
+
     ShapeDrawMode drawMode; // 1 byte
 
     uint8_t renderingFlags; // 1 byte
@@ -109,6 +156,19 @@ static void _shape_toggle_lua_flag(Shape *s, const uint8_t flag, const bool togg
 static bool _shape_get_lua_flag(const Shape *s, const uint8_t flag);
 
 void _shape_chunk_enqueue_refresh(Shape *shape, Chunk *c);
+static void _shape_chunk_mark_edited(Shape *shape, const Chunk *c);
+static void _shape_lighting_batch_record(Shape *shape,
+                                         SHAPE_COORDS_INT3_T coords,
+                                         SHAPE_COLOR_INDEX_INT_T before);
+/// advances deferred lighting work, starting on pending changes if `nextBatch`, returns true if
+/// there is no work left
+static bool _shape_lighting_work_process(Shape *s, uint32_t budget, bool nextBatch);
+/// completes the batch being applied, block changes must not happen while it is in progress
+static void _shape_lighting_work_settle(Shape *s);
+static void _shape_lighting_work_reset(Shape *s);
+static void _shape_lighting_work_free(Shape *s);
+/// full single-threaded bake, sunlightColumns false to seed all sunlight from the plane above
+static void _shape_compute_baked_lighting_serial(Shape *s, const bool sunlightColumns);
 void _shape_chunk_check_neighbors_dirty(Shape *shape,
                                         const Chunk *chunk,
                                         CHUNK_COORDS_INT3_T block_pos);
@@ -124,6 +184,11 @@ static bool _shape_add_block_in_chunks(Shape *shape,
 
 void _set_vb_allocation_flag_one_frame(Shape *s);
 
+/// chunk r-tree box, in model space
+static void _shape_chunk_rtree_box(const Chunk *c, Box *box);
+/// chunks are partitioned in bulk when the r-tree is first needed, one by one afterwards
+static void _shape_bulk_load_rtree(const Shape *s);
+
 /// internal functions used to flag the relevant data when lighting has changed
 void _lighting_set_dirty(SHAPE_COORDS_INT3_T *bbMin,
                          SHAPE_COORDS_INT3_T *bbMax,
@@ -157,6 +222,20 @@ void _light_enqueue_ambient_and_block_sources(Shape *s,
                                               SHAPE_COORDS_INT3_T min,
                                               SHAPE_COORDS_INT3_T max,
                                               bool enqueueAir);
+void _light_enqueue_block_sources(Shape *s,
+                                  LightNodeQueue *q,
+                                  SHAPE_COORDS_INT3_T min,
+                                  SHAPE_COORDS_INT3_T max,
+                                  bool enqueueAir);
+/// light a non-opaque neighbor receives from current block's light (transparency & step applied)
+VERTEX_LIGHT_STRUCT_T _light_get_propagated(const Shape *s,
+                                            VERTEX_LIGHT_STRUCT_T current,
+                                            const Block *neighbor,
+                                            bool transparent,
+                                            uint8_t stepS,
+                                            uint8_t stepRGB);
+/// raises each light value individually to source's if lower, returns true if any was raised
+bool _light_raise(VERTEX_LIGHT_STRUCT_T *light, VERTEX_LIGHT_STRUCT_T source);
 /// propagate light values at a given block
 void _light_block_propagate(Shape *s,
                             Chunk *c,
@@ -181,13 +260,84 @@ void _light_propagate(Shape *s,
                       SHAPE_COORDS_INT_T srcY,
                       SHAPE_COORDS_INT_T srcZ,
                       bool initWithEmptyLight);
+/// processes at most maxNodes nodes of the light propagation queue, extending given bounding box
+/// w/ changed values, returns the number of nodes processed
+uint32_t _light_propagate_budgeted(Shape *s,
+                                   SHAPE_COORDS_INT3_T *bbMin,
+                                   SHAPE_COORDS_INT3_T *bbMax,
+                                   LightNodeQueue *lightQueue,
+                                   bool initWithEmptyLight,
+                                   uint32_t maxNodes);
 /// light removal also enqueues back any light source that needs recomputing
 void _light_removal(Shape *s,
                     SHAPE_COORDS_INT3_T *bbMin,
                     SHAPE_COORDS_INT3_T *bbMax,
                     LightRemovalNodeQueue *lightRemovalQueue,
                     LightNodeQueue *lightQueue);
+/// processes at most maxNodes nodes of the light removal queue, returns the number processed
+uint32_t _light_removal_budgeted(Shape *s,
+                                 SHAPE_COORDS_INT3_T *bbMin,
+                                 SHAPE_COORDS_INT3_T *bbMax,
+                                 LightRemovalNodeQueue *lightRemovalQueue,
+                                 LightNodeQueue *lightQueue,
+                                 uint32_t maxNodes);
 void _light_removal_all(Shape *s, SHAPE_COORDS_INT3_T *min, SHAPE_COORDS_INT3_T *max);
+/// collapses lighting data of uniformly lit chunks (e.g. open sky, or fully dark)
+void _light_compact_all(Shape *s);
+/// index of a (x, z) column of [min.x - 1, max.x] x [min.z - 1, max.z] in a sun floors array
+size_t _light_sun_floor_index(SHAPE_COORDS_INT3_T min,
+                              SHAPE_COORDS_INT3_T max,
+                              SHAPE_COORDS_INT_T x,
+                              SHAPE_COORDS_INT_T z);
+/// lights air blocks directly under the sky in one column of chunks, & stores the lowest sunlit y
+/// of each of its (x, z) columns within bounds in sunFloors (max.y if none)
+void _light_sunlight_chunk_column(Shape *s,
+                                  SHAPE_COORDS_INT3_T min,
+                                  SHAPE_COORDS_INT3_T max,
+                                  SHAPE_COORDS_INT_T chunkX,
+                                  SHAPE_COORDS_INT_T chunkZ,
+                                  SHAPE_COORDS_INT_T *sunFloors);
+/// highest block of a sunlit column that can still light a neighbor column
+SHAPE_COORDS_INT_T _light_sunlight_seed_top(SHAPE_COORDS_INT3_T min,
+                                            SHAPE_COORDS_INT3_T max,
+                                            const SHAPE_COORDS_INT_T *sunFloors,
+                                            SHAPE_COORDS_INT_T x,
+                                            SHAPE_COORDS_INT_T z);
+/// whether sunlight enters a column through a transparent block at the top of the bounds
+bool _light_sunlight_through_top(Shape *s,
+                                 SHAPE_COORDS_INT3_T max,
+                                 SHAPE_COORDS_INT_T x,
+                                 SHAPE_COORDS_INT_T z);
+/// enqueues sunlit blocks next to unlit ones, once all sunlight columns are computed
+void _light_enqueue_sunlight_borders(Shape *s,
+                                     LightNodeQueue *q,
+                                     SHAPE_COORDS_INT3_T min,
+                                     SHAPE_COORDS_INT3_T max,
+                                     const SHAPE_COORDS_INT_T *sunFloors);
+/// sunlight columns of the whole shape, replaces ambient sources for a full propagation, returns
+/// false if it couldn't be allocated
+bool _light_sunlight_columns(Shape *s,
+                             LightNodeQueue *q,
+                             SHAPE_COORDS_INT3_T min,
+                             SHAPE_COORDS_INT3_T max);
+/// same as the per-block update functions, for all changes of a lighting batch at once
+void _light_apply_batch(Shape *s, Index3D *changes);
+/// seeds light removal from the changes of a lighting batch & sets the bounding box of changed
+/// values, returns false if no block lighting changed
+bool _light_batch_seed_removal(Shape *s,
+                               Index3D *changes,
+                               LightRemovalNodeQueue *lightRemovalQueue,
+                               LightNodeQueue *lightQueue,
+                               SHAPE_COORDS_INT3_T *bbMin,
+                               SHAPE_COORDS_INT3_T *bbMax);
+/// seeds light propagation from the changes of a lighting batch, after light removal
+void _light_batch_seed_propagation(Shape *s, Index3D *changes, LightNodeQueue *lightQueue);
+/// light propagation from all sources of the shape, using given thread pool, returns false if
+/// regions couldn't be allocated
+bool _light_propagate_parallel(Shape *s,
+                               ThreadPool *pool,
+                               SHAPE_COORDS_INT3_T min,
+                               SHAPE_COORDS_INT3_T max);
 void _shape_check_all_vb_fragmented(Shape *s, VertexBuffer *first);
 void _shape_flush_all_vb(Shape *s);
 void _shape_fill_draw_slices(VertexBuffer *vb);
@@ -236,6 +386,10 @@ Shape *shape_make(void) {
     s->chunks = index3d_new();
     s->dirtyChunks = NULL;
     s->rtree = rtree_new(RTREE_NODE_MIN_CAPACITY, RTREE_NODE_MAX_CAPACITY);
+    s->editedChunks = NULL;
+    s->editsOffset = coords3_zero;
+    s->lightingBatch = NULL;
+    s->lightingWork = NULL;
 
     // vertex buffers will be created on demand during refresh
     s->firstVB_opaque = NULL;
@@ -312,6 +466,8 @@ Shape *shape_make_copy(Shape *const origin) {
 
     s->bbMin = origin->bbMin;
     s->bbMax = origin->bbMax;
+    s->nbChunks = origin->nbChunks;
+    s->nbBlocks = origin->nbBlocks;
 
     s->drawMode = origin->drawMode;
     s->renderingFlags = origin->renderingFlags;
@@ -333,13 +489,7 @@ Shape *shape_make_copy(Shape *const origin) {
         index3d_insert(s->chunks, chunkCopy, chunkCoords.x, chunkCoords.y, chunkCoords.z, NULL);
         chunk_move_in_neighborhood(s->chunks, chunkCopy, chunkCoords);
 
-        // partition new chunk in shape space
-        Box chunkBox = {{(float)chunkOrigin.x, (float)chunkOrigin.y, (float)chunkOrigin.z},
-                        {(float)(chunkOrigin.x + CHUNK_SIZE),
-                         (float)(chunkOrigin.y + CHUNK_SIZE),
-                         (float)(chunkOrigin.z + CHUNK_SIZE)}};
-        chunk_set_rtree_leaf(chunkCopy,
-                             rtree_create_and_insert(s->rtree, &chunkBox, 1, 1, chunkCopy));
+        // chunks r-tree is bulk loaded when first needed
 
         // enqueue new shape buffers
         _shape_chunk_enqueue_refresh(s, chunkCopy);
@@ -603,6 +753,15 @@ void shape_free(Shape *const shape) {
         fifo_list_free(shape->dirtyChunks, NULL);
     }
 
+    shape_enable_edit_tracking(shape, false);
+
+    _shape_lighting_work_free(shape);
+
+    if (shape->lightingBatch != NULL) {
+        index3d_flush(shape->lightingBatch, free);
+        index3d_free(shape->lightingBatch);
+    }
+
     rtree_free(shape->rtree);
 
     // free all vertex buffers
@@ -671,6 +830,7 @@ bool shape_add_block_as_transaction(Shape *const shape,
 
     if (shape->pendingTransaction == NULL) {
         shape->pendingTransaction = transaction_new();
+        transform_set_branch_dirty(shape->transform);
         if (shape->history != NULL) {
             history_discardTransactionsMoreRecentThanCursor(shape->history);
         }
@@ -703,6 +863,7 @@ bool shape_remove_block_as_transaction(Shape *const shape,
 
     if (shape->pendingTransaction == NULL) {
         shape->pendingTransaction = transaction_new();
+        transform_set_branch_dirty(shape->transform);
         if (shape->history != NULL) {
             history_discardTransactionsMoreRecentThanCursor(shape->history);
         }
@@ -740,6 +901,7 @@ bool shape_paint_block_as_transaction(Shape *const shape,
 
     if (shape->pendingTransaction == NULL) {
         shape->pendingTransaction = transaction_new();
+        transform_set_branch_dirty(shape->transform);
         if (shape->history != NULL) {
             history_discardTransactionsMoreRecentThanCursor(shape->history);
         }
@@ -791,6 +953,9 @@ bool shape_add_block(Shape *shape,
         return false;
     }
 
+    // lighting of previous changes must settle before blocks change again
+    _shape_lighting_work_settle(shape);
+
     // if caller wants to express colorIndex as a default color, we translate it here
     if (useDefaultColor) {
         color_palette_check_and_add_default_color_2021(shape->palette, colorIndex, &colorIndex);
@@ -817,6 +982,7 @@ bool shape_add_block(Shape *shape,
     if (blockAdded) {
         shape->nbBlocks++;
         _shape_chunk_enqueue_refresh(shape, chunk);
+        _shape_chunk_mark_edited(shape, chunk);
         _shape_chunk_check_neighbors_dirty(shape, chunk, block_coords);
 
         shape_expand_box(shape, (SHAPE_COORDS_INT3_T){x, y, z});
@@ -824,7 +990,11 @@ bool shape_add_block(Shape *shape,
         color_palette_increment_color(shape->palette, colorIndex, 1);
         ++shape->blocksCount[colorIndex];
 
-        if (_shape_get_rendering_flag(shape, SHAPE_RENDERING_FLAG_BAKED_LIGHTING)) {
+        if (shape->lightingBatch != NULL) {
+            _shape_lighting_batch_record(shape,
+                                         (SHAPE_COORDS_INT3_T){x, y, z},
+                                         SHAPE_COLOR_INDEX_AIR_BLOCK);
+        } else if (_shape_get_rendering_flag(shape, SHAPE_RENDERING_FLAG_BAKED_LIGHTING)) {
             shape_compute_baked_lighting_added_block(shape,
                                                      chunk,
                                                      (SHAPE_COORDS_INT3_T){x, y, z},
@@ -845,6 +1015,9 @@ bool shape_remove_block(Shape *shape,
         return false;
     }
 
+    // lighting of previous changes must settle before blocks change again
+    _shape_lighting_work_settle(shape);
+
     bool removed = false;
 
     Chunk *chunk;
@@ -864,10 +1037,13 @@ bool shape_remove_block(Shape *shape,
             shape->nbBlocks--;
             _shape_chunk_check_neighbors_dirty(shape, chunk, coords_in_chunk);
             _shape_chunk_enqueue_refresh(shape, chunk);
+            _shape_chunk_mark_edited(shape, chunk);
 
             // shape_reset_box(shape, x, y, z);
 
-            if (_shape_get_rendering_flag(shape, SHAPE_RENDERING_FLAG_BAKED_LIGHTING)) {
+            if (shape->lightingBatch != NULL) {
+                _shape_lighting_batch_record(shape, coords_in_shape, prevColor);
+            } else if (_shape_get_rendering_flag(shape, SHAPE_RENDERING_FLAG_BAKED_LIGHTING)) {
                 shape_compute_baked_lighting_removed_block(shape,
                                                            chunk,
                                                            coords_in_shape,
@@ -897,6 +1073,9 @@ bool shape_paint_block(Shape *shape,
         return false;
     }
 
+    // lighting of previous changes must settle before blocks change again
+    _shape_lighting_work_settle(shape);
+
     bool painted = false;
 
     Chunk *chunk;
@@ -920,8 +1099,11 @@ bool shape_paint_block(Shape *shape,
             ++shape->blocksCount[colorIndex];
 
             _shape_chunk_enqueue_refresh(shape, chunk);
+            _shape_chunk_mark_edited(shape, chunk);
 
-            if (_shape_get_rendering_flag(shape, SHAPE_RENDERING_FLAG_BAKED_LIGHTING)) {
+            if (shape->lightingBatch != NULL) {
+                _shape_lighting_batch_record(shape, coords_in_shape, prevColor);
+            } else if (_shape_get_rendering_flag(shape, SHAPE_RENDERING_FLAG_BAKED_LIGHTING)) {
                 shape_compute_baked_lighting_replaced_block(shape,
                                                             chunk,
                                                             coords_in_shape,
@@ -999,7 +1181,7 @@ void shape_remap_colors(Shape *s, const SHAPE_COLOR_INDEX_INT_T *remap) {
                                     continue;
                                 }
 
-                                block_set_color_index(b, newColor);
+                                chunk_paint_block(chunk, cx, cy, cz, newColor, NULL);
 
                                 color_palette_decrement_color(s->palette, prevColor, 1);
                                 color_palette_increment_color(s->palette, newColor, 1);
@@ -1707,6 +1889,38 @@ size_t shape_get_nb_chunks(const Shape *shape) {
     return shape->nbChunks;
 }
 
+static void _shape_edited_chunk_free(void *ptr) {
+    int3_free((int3 *)ptr);
+}
+
+void shape_enable_edit_tracking(Shape *shape, const bool enable) {
+    if (enable && shape->editedChunks == NULL) {
+        shape->editedChunks = index3d_new();
+    } else if (enable == false && shape->editedChunks != NULL) {
+        index3d_flush(shape->editedChunks, _shape_edited_chunk_free);
+        index3d_free(shape->editedChunks);
+        shape->editedChunks = NULL;
+    }
+}
+
+Index3D *shape_get_edited_chunks(const Shape *shape) {
+    return shape->editedChunks;
+}
+
+void shape_clear_edited_chunks(Shape *shape) {
+    if (shape->editedChunks != NULL) {
+        index3d_flush(shape->editedChunks, _shape_edited_chunk_free);
+    }
+}
+
+void shape_set_edits_offset(Shape *shape, const SHAPE_COORDS_INT3_T offset) {
+    shape->editsOffset = offset;
+}
+
+SHAPE_COORDS_INT3_T shape_get_edits_offset(const Shape *shape) {
+    return shape->editsOffset;
+}
+
 void shape_get_chunk_and_coordinates(const Shape *shape,
                                      const SHAPE_COORDS_INT3_T coords_in_shape,
                                      Chunk **chunk,
@@ -1770,6 +1984,10 @@ void shape_refresh_vertices(Shape *shape) {
         return;
     }
 
+    if (shape->lightingWork != NULL) {
+        _shape_lighting_work_process(shape, shape->lightingWork->budget, true);
+    }
+
     Chunk *c = shape->dirtyChunks != NULL ? fifo_list_pop(shape->dirtyChunks) : NULL;
     while (c != NULL) {
         // Note: chunk should never be NULL
@@ -1778,6 +1996,9 @@ void shape_refresh_vertices(Shape *shape) {
         // if the chunk has been emptied, we can remove it from shape index and destroy it
         // Note: this will create gaps in all the vb used for this chunk ie. make them fragmented
         if (chunk_get_nb_blocks(c) == 0) {
+            // pending lighting work may reference this chunk
+            shape_flush_lighting(shape);
+
             const SHAPE_COORDS_INT3_T chunkOrigin = chunk_get_origin(c);
             SHAPE_COORDS_INT3_T chunk_coords = chunk_utils_get_coords(chunkOrigin);
             index3d_remove(shape->chunks,
@@ -1785,7 +2006,9 @@ void shape_refresh_vertices(Shape *shape) {
                            (int)chunk_coords.y,
                            (int)chunk_coords.z,
                            NULL);
-            rtree_remove(shape->rtree, chunk_get_rtree_leaf(c), true);
+            if (chunk_get_rtree_leaf(c) != NULL) {
+                rtree_remove(shape->rtree, chunk_get_rtree_leaf(c), true);
+            }
             chunk_free(c, true);
             c = NULL;
 
@@ -1869,6 +2092,7 @@ VertexBuffer *shape_get_first_vertex_buffer(const Shape *shape, bool transparent
 
 Rtree *shape_get_rtree(const Shape *shape) {
     vx_assert(shape != NULL);
+    _shape_bulk_load_rtree(shape);
     return shape->rtree;
 }
 
@@ -1961,6 +2185,99 @@ void _chunk_entry_insert(DoublyLinkedList *chunks, Chunk *c, void *castData, flo
     }
 }
 
+typedef struct {
+    const Box *modelBox;
+    const float3 *modelVector;
+    const float3 *epsilon;
+    float3 *extraReplacement;
+    Block *block;
+    SHAPE_COORDS_INT3_T chunkOrigin;
+    SHAPE_COORDS_INT3_T blockCoords;
+    float3 normal;
+    float minSwept;
+    bool withReplacement;
+#if PHYSICS_EXTRA_REPLACEMENTS
+    bool blockedX, blockedY, blockedZ;
+    char pad[4];
+#else
+    char pad[7];
+#endif
+} _ShapeBoxCast;
+
+static void _shape_box_cast_block(void *element, uint16_t x, uint16_t y, uint16_t z, void *ptr) {
+    _ShapeBoxCast *bc = (_ShapeBoxCast *)ptr;
+
+    // block box in model space
+    const SHAPE_COORDS_INT3_T coords = {(SHAPE_COORDS_INT_T)(bc->chunkOrigin.x + x),
+                                        (SHAPE_COORDS_INT_T)(bc->chunkOrigin.y + y),
+                                        (SHAPE_COORDS_INT_T)(bc->chunkOrigin.z + z)};
+    const Box blockBox = {{(float)coords.x, (float)coords.y, (float)coords.z},
+                          {(float)coords.x + 1.0f, (float)coords.y + 1.0f, (float)coords.z + 1.0f}};
+
+    float3 tmpNormal, tmpReplacement;
+    const float swept = box_swept(bc->modelBox,
+                                  bc->modelVector,
+                                  &blockBox,
+                                  bc->epsilon,
+                                  bc->withReplacement,
+                                  &tmpNormal,
+                                  &tmpReplacement);
+    if (swept < bc->minSwept) {
+        bc->minSwept = swept;
+        bc->normal = tmpNormal;
+        bc->block = (Block *)element;
+        bc->blockCoords = coords;
+    }
+#if PHYSICS_EXTRA_REPLACEMENTS
+    if (bc->extraReplacement != NULL) {
+        if (tmpReplacement.x != 0.0f && bc->blockedX == false) {
+            // previous replacement is positive and new replacement is positive &
+            // bigger
+            if (bc->extraReplacement->x >= 0.0f &&
+                tmpReplacement.x > bc->extraReplacement->x) {
+                bc->extraReplacement->x = tmpReplacement.x;
+            }
+            // previous replacement is negative and new replacement is negative &
+            // bigger
+            else if (bc->extraReplacement->x <= 0.0f &&
+                     tmpReplacement.x < bc->extraReplacement->x) {
+                bc->extraReplacement->x = tmpReplacement.x;
+            }
+            // previous & new replacements are opposite... this axis is blocked,
+            // set to 0 to avoid stuttering and wait for another axis to replace
+            else if (bc->extraReplacement->x * tmpReplacement.x < 0.0f) {
+                bc->extraReplacement->x = 0.0f;
+                bc->blockedX = true;
+            }
+        }
+        if (tmpReplacement.y != 0.0f && bc->blockedY == false) {
+            if (bc->extraReplacement->y >= 0.0f &&
+                tmpReplacement.y > bc->extraReplacement->y) {
+                bc->extraReplacement->y = tmpReplacement.y;
+            } else if (bc->extraReplacement->y <= 0.0f &&
+                       tmpReplacement.y < bc->extraReplacement->y) {
+                bc->extraReplacement->y = tmpReplacement.y;
+            } else if (bc->extraReplacement->y * tmpReplacement.y < 0.0f) {
+                bc->extraReplacement->y = 0.0f;
+                bc->blockedX = true;
+            }
+        }
+        if (tmpReplacement.z != 0.0f && bc->blockedZ == false) {
+            if (bc->extraReplacement->z >= 0.0f &&
+                tmpReplacement.z > bc->extraReplacement->z) {
+                bc->extraReplacement->z = tmpReplacement.z;
+            } else if (bc->extraReplacement->z <= 0.0f &&
+                       tmpReplacement.z < bc->extraReplacement->z) {
+                bc->extraReplacement->z = tmpReplacement.z;
+            } else if (bc->extraReplacement->z * tmpReplacement.z < 0.0f) {
+                bc->extraReplacement->z = 0.0f;
+                bc->blockedX = true;
+            }
+        }
+    }
+#endif
+}
+
 float shape_box_cast(const Shape *s,
                      const Box *modelBox,
                      const float3 *modelVector,
@@ -1979,152 +2296,196 @@ float shape_box_cast(const Shape *s,
         float3_set_zero(extraReplacement);
     }
 
-    float minSwept = 1.0f;
-    const float maxDist = float3_length(modelVector);
-    const float3 unit = {modelVector->x / maxDist,
-                         modelVector->y / maxDist,
-                         modelVector->z / maxDist};
+    // chunks bounds, the r-tree root box is made of chunks boxes
+    Rtree *r = shape_get_rtree(s);
+    if (rtree_node_get_children_count(rtree_get_root(r)) == 0) {
+        return 1.0f;
+    }
+    const Box *bounds = rtree_node_get_aabb(rtree_get_root(r));
+
+    // blocks colliding w/ the broadphase box, same test as box_collide: a block at coordinate b
+    // collides along an axis if b + 1 > min + EPSILON_COLLISION && b < max - EPSILON_COLLISION
+    Box broadPhaseBox;
+    box_set_broadphase_box(modelBox, modelVector, &broadPhaseBox);
+    const float bpMin[3] = {broadPhaseBox.min.x, broadPhaseBox.min.y, broadPhaseBox.min.z};
+    const float bpMax[3] = {broadPhaseBox.max.x, broadPhaseBox.max.y, broadPhaseBox.max.z};
+    const float boundsMin[3] = {bounds->min.x, bounds->min.y, bounds->min.z};
+    const float boundsMax[3] = {bounds->max.x, bounds->max.y, bounds->max.z};
+    int32_t blockMin[3], blockMax[3];
+    for (int a = 0; a < 3; ++a) {
+        const float min = maximum(floorf(bpMin[a] + EPSILON_COLLISION), boundsMin[a]);
+        const float max = minimum(ceilf(bpMax[a] - EPSILON_COLLISION) - 1.0f,
+                                  boundsMax[a] - 1.0f);
+        if (min > max) {
+            return 1.0f;
+        }
+        blockMin[a] = (int32_t)min;
+        blockMax[a] = (int32_t)max;
+    }
+
+    // chunks overlapped by these blocks, walked in the direction of motion
+    const SHAPE_COORDS_INT3_T chunkMin = chunk_utils_get_coords(
+        (SHAPE_COORDS_INT3_T){(SHAPE_COORDS_INT_T)blockMin[0],
+                              (SHAPE_COORDS_INT_T)blockMin[1],
+                              (SHAPE_COORDS_INT_T)blockMin[2]});
+    const SHAPE_COORDS_INT3_T chunkMax = chunk_utils_get_coords(
+        (SHAPE_COORDS_INT3_T){(SHAPE_COORDS_INT_T)blockMax[0],
+                              (SHAPE_COORDS_INT_T)blockMax[1],
+                              (SHAPE_COORDS_INT_T)blockMax[2]});
+    const int32_t cFirst[3] = {modelVector->x < 0.0f ? chunkMax.x : chunkMin.x,
+                               modelVector->y < 0.0f ? chunkMax.y : chunkMin.y,
+                               modelVector->z < 0.0f ? chunkMax.z : chunkMin.z};
+    const int32_t cCount[3] = {chunkMax.x - chunkMin.x + 1,
+                               chunkMax.y - chunkMin.y + 1,
+                               chunkMax.z - chunkMin.z + 1};
+    const int32_t cStep[3] = {modelVector->x < 0.0f ? -1 : 1,
+                              modelVector->y < 0.0f ? -1 : 1,
+                              modelVector->z < 0.0f ? -1 : 1};
+
+    _ShapeBoxCast bc;
+    bc.modelBox = modelBox;
+    bc.modelVector = modelVector;
+    bc.epsilon = epsilon;
+    bc.extraReplacement = extraReplacement;
+    bc.block = NULL;
+    bc.minSwept = 1.0f;
+    bc.withReplacement = withReplacement;
 
-    // select overlapped chunks
-    DoublyLinkedList *chunksQuery = doubly_linked_list_new();
-    if (rtree_query_cast_all_box(s->rtree, modelBox, &unit, maxDist, 0, 1, NULL, chunksQuery) > 0) {
-        // sort query results by distance
-        doubly_linked_list_sort_ascending(chunksQuery, rtree_utils_result_sort_func);
+    Chunk *c;
+    uint16_t min[3], max[3];
+    for (int32_t i = 0; i < cCount[0]; ++i) {
+        for (int32_t j = 0; j < cCount[1]; ++j) {
+            for (int32_t k = 0; k < cCount[2]; ++k) {
+                c = (Chunk *)index3d_get(s->chunks,
+                                         cFirst[0] + i * cStep[0],
+                                         cFirst[1] + j * cStep[1],
+                                         cFirst[2] + k * cStep[2]);
+                if (c == NULL) {
+                    continue;
+                }
 
-        Box broadPhaseBox, tmpBox;
-        box_set_broadphase_box(modelBox, modelVector, &broadPhaseBox);
+                // blocks range in chunk coordinates
+                bc.chunkOrigin = chunk_get_origin(c);
+                const int32_t origin[3] = {bc.chunkOrigin.x, bc.chunkOrigin.y, bc.chunkOrigin.z};
+                for (int a = 0; a < 3; ++a) {
+                    min[a] = (uint16_t)maximum(blockMin[a] - origin[a], 0);
+                    max[a] = (uint16_t)minimum(blockMax[a] - origin[a], CHUNK_SIZE_MINUS_ONE);
+                }
+#if PHYSICS_EXTRA_REPLACEMENTS
+                bc.blockedX = false;
+                bc.blockedY = false;
+                bc.blockedZ = false;
+#endif
 
-        // examine query results in order, return first hit block
-        DoublyLinkedListNode *n = doubly_linked_list_first(chunksQuery);
-        RtreeCastResult *rtreeHit;
-        OctreeIterator *oi;
-        Chunk *c;
-        bool didHit = false, leaf;
-        float3 tmpNormal, tmpReplacement;
-        float swept = 1.0f, lastRtreeDist = FLT_MAX;
-        while (n != NULL) {
-            rtreeHit = (RtreeCastResult *)doubly_linked_list_node_pointer(n);
-            c = (Chunk *)rtree_node_get_leaf_ptr(rtreeHit->rtreeLeaf);
-
-            // make sure to examine all hits w/ similar distances before stopping
-            if (didHit &&
-                float_isEqual(rtreeHit->distance, lastRtreeDist, EPSILON_COLLISION) == false) {
-                break;
+                octree_foreach_in_range(chunk_get_octree(c),
+                                        min,
+                                        max,
+                                        _shape_box_cast_block,
+                                        &bc);
             }
-            lastRtreeDist = rtreeHit->distance;
+        }
+    }
 
-            const SHAPE_COORDS_INT3_T chunkOrigin = chunk_get_origin(c);
-            leaf = false;
-#if PHYSICS_EXTRA_REPLACEMENTS
-            float blockedX = false, blockedY = false, blockedZ = false;
-#endif
+    if (bc.block != NULL) {
+        if (normal != NULL) {
+            *normal = bc.normal;
+        }
+        if (block != NULL) {
+            *block = bc.block;
+        }
+        if (blockCoords != NULL) {
+            *blockCoords = bc.blockCoords;
+        }
+    }
 
-            oi = octree_iterator_new(chunk_get_octree(c));
-            while (octree_iterator_is_done(oi) == false) {
-                octree_iterator_get_node_box(oi, &tmpBox);
-
-                // chunk octree box in model space
-                tmpBox.min.x += chunkOrigin.x;
-                tmpBox.min.y += chunkOrigin.y;
-                tmpBox.min.z += chunkOrigin.z;
-                tmpBox.max.x += chunkOrigin.x;
-                tmpBox.max.y += chunkOrigin.y;
-                tmpBox.max.z += chunkOrigin.z;
-
-                const bool collides = box_collide(&tmpBox, &broadPhaseBox);
-                if (leaf && collides) {
-                    swept = box_swept(modelBox,
-                                      modelVector,
-                                      &tmpBox,
-                                      epsilon,
-                                      withReplacement,
-                                      &tmpNormal,
-                                      &tmpReplacement);
-                    if (swept < minSwept) {
-                        minSwept = swept;
-                        didHit = true;
-                        if (normal != NULL) {
-                            *normal = tmpNormal;
-                        }
-                        if (block != NULL) {
-                            *block = (Block *)octree_iterator_get_element(oi);
-                        }
-                        if (blockCoords != NULL) {
-                            uint16_t x, y, z;
-                            octree_iterator_get_current_position(oi, &x, &y, &z);
-                            blockCoords->x = (SHAPE_COORDS_INT_T)x;
-                            blockCoords->y = (SHAPE_COORDS_INT_T)y;
-                            blockCoords->z = (SHAPE_COORDS_INT_T)z;
-                        }
-                    }
-#if PHYSICS_EXTRA_REPLACEMENTS
-                    if (extraReplacement != NULL) {
-                        if (tmpReplacement.x != 0.0f && blockedX == false) {
-                            // previous replacement is positive and new replacement is positive &
-                            // bigger
-                            if (extraReplacement->x >= 0.0f &&
-                                tmpReplacement.x > extraReplacement->x) {
-                                extraReplacement->x = tmpReplacement.x;
-                            }
-                            // previous replacement is negative and new replacement is negative &
-                            // bigger
-                            else if (extraReplacement->x <= 0.0f &&
-                                     tmpReplacement.x < extraReplacement->x) {
-                                extraReplacement->x = tmpReplacement.x;
-                            }
-                            // previous & new replacements are opposite... this axis is blocked,
-                            // set to 0 to avoid stuttering and wait for another axis to replace
-                            else if (extraReplacement->x * tmpReplacement.x < 0.0f) {
-                                extraReplacement->x = 0.0f;
-                                blockedX = true;
-                            }
-                        }
-                        if (tmpReplacement.y != 0.0f && blockedY == false) {
-                            if (extraReplacement->y >= 0.0f &&
-                                tmpReplacement.y > extraReplacement->y) {
-                                extraReplacement->y = tmpReplacement.y;
-                            } else if (extraReplacement->y <= 0.0f &&
-                                       tmpReplacement.y < extraReplacement->y) {
-                                extraReplacement->y = tmpReplacement.y;
-                            } else if (extraReplacement->y * tmpReplacement.y < 0.0f) {
-                                extraReplacement->y = 0.0f;
-                                blockedX = true;
-                            }
-                        }
-                        if (tmpReplacement.z != 0.0f && blockedZ == false) {
-                            if (extraReplacement->z >= 0.0f &&
-                                tmpReplacement.z > extraReplacement->z) {
-                                extraReplacement->z = tmpReplacement.z;
-                            } else if (extraReplacement->z <= 0.0f &&
-                                       tmpReplacement.z < extraReplacement->z) {
-                                extraReplacement->z = tmpReplacement.z;
-                            } else if (extraReplacement->z * tmpReplacement.z < 0.0f) {
-                                extraReplacement->z = 0.0f;
-                                blockedX = true;
-                            }
-                        }
-                    }
-#endif
-                }
+    return bc.minSwept;
+}
 
-                octree_iterator_next(oi, collides == false && leaf == false, &leaf);
-            }
-            octree_iterator_free(oi);
+/// Looks for a block at given model coordinates, w/ the chunk of the previous call cached
+/// @param emptySize set to the size of the empty aligned area containing given coordinates, if
+/// there is no block there
+static Block *_shape_ray_cast_get_block(const Shape *s,
+                                        Chunk **chunk,
+                                        SHAPE_COORDS_INT3_T *chunkCoords,
+                                        const int32_t v[3],
+                                        uint16_t *emptySize) {
 
-            if (didHit && blockCoords != NULL) {
-                // chunk block coordinates in model space
-                blockCoords->x += chunkOrigin.x;
-                blockCoords->y += chunkOrigin.y;
-                blockCoords->z += chunkOrigin.z;
-            }
+    const SHAPE_COORDS_INT3_T coords = {(SHAPE_COORDS_INT_T)v[0],
+                                        (SHAPE_COORDS_INT_T)v[1],
+                                        (SHAPE_COORDS_INT_T)v[2]};
+    const SHAPE_COORDS_INT3_T cc = chunk_utils_get_coords(coords);
+    if (cc.x != chunkCoords->x || cc.y != chunkCoords->y || cc.z != chunkCoords->z) {
+        *chunk = (Chunk *)index3d_get(s->chunks, cc.x, cc.y, cc.z);
+        *chunkCoords = cc;
+    }
+    if (*chunk == NULL) {
+        *emptySize = CHUNK_SIZE;
+        return NULL;
+    }
 
-            n = doubly_linked_list_node_next(n);
-        }
+    const CHUNK_COORDS_INT3_T coordsInChunk = chunk_utils_get_coords_in_chunk(coords);
+    return (Block *)octree_get_element_or_empty_size(chunk_get_octree(*chunk),
+                                                     (size_t)coordsInChunk.x,
+                                                     (size_t)coordsInChunk.y,
+                                                     (size_t)coordsInChunk.z,
+                                                     emptySize);
+}
+
+/// Same distance to a plane as in ray_intersect_with_box, so that traversal & hit distances agree
+static float _shape_ray_cast_plane_distance(float plane, float origin, float invdir) {
+    const float diff = plane - origin;
+    // float_isEqual tolerance stays under 1 w/ shape coordinates, skip it for planes farther away
+    if (fabsf(diff) > 1.0f && fabsf(origin) < 65536.0f) {
+        return diff * invdir;
+    }
+    return float_isEqual(plane, origin, EPSILON_ZERO) ? 0.0f : diff * invdir;
+}
+
+/// Block coordinate along one axis where the ray is at given distance, within [min, max]
+/// @param before set to the previous block coordinate if the ray enters that block exactly at given
+/// distance, or to the same coordinate
+static int32_t _shape_ray_cast_axis_block(float origin,
+                                          float dir,
+                                          float invdir,
+                                          float t,
+                                          int32_t min,
+                                          int32_t max,
+                                          int32_t *before) {
+
+    const float p = origin + dir * t;
+    int32_t n = CLAMP((int32_t)floorf(p), min, max);
+
+    // far enough from blocks planes, no need to compare distances
+    const float fraction = p - floorf(p);
+    const float margin = 1e-3f + fabsf(p) * 1e-6f;
+    if (fraction > margin && fraction < 1.0f - margin) {
+        *before = n;
+        return n;
+    }
+
+    // plane through which the ray enters block n
+    const int32_t step = dir > 0.0f ? 1 : -1;
+    const int32_t first = dir > 0.0f ? min : max;
+    const int32_t last = dir > 0.0f ? max : min;
+    const int32_t enter = dir > 0.0f ? 0 : 1;
+    while (n != last && _shape_ray_cast_plane_distance((float)(n + step + enter),
+                                                       origin,
+                                                       invdir) <= t) {
+        n += step;
     }
-    doubly_linked_list_flush(chunksQuery, free);
-    doubly_linked_list_free(chunksQuery);
+    while (n != first && _shape_ray_cast_plane_distance((float)(n + enter), origin, invdir) > t) {
+        n -= step;
+    }
+    *before = n != first && _shape_ray_cast_plane_distance((float)(n + enter), origin, invdir) == t
+                  ? n - step
+                  : n;
+    return n;
+}
 
-    return minSwept;
+static bool _shape_ray_cast_block_distance(const Ray *modelRay, const int32_t v[3], float *d) {
+    const float3 min = {(float)v[0], (float)v[1], (float)v[2]};
+    const float3 max = {(float)(v[0] + 1), (float)(v[1] + 1), (float)(v[2] + 1)};
+    return ray_intersect_with_box(modelRay, &min, &max, d);
 }
 
 bool shape_ray_cast(const Shape *s,
@@ -2140,120 +2501,212 @@ bool shape_ray_cast(const Shape *s,
 
     // we want a ray in model space to intersect with block coordinates
     Transform *t = shape_get_pivot_transform(s);
-    Ray *modelRay = ray_world_to_local(worldRay, t);
-
-    // select traversed chunks
-    DoublyLinkedList *chunksQuery = doubly_linked_list_new();
-    if (rtree_query_cast_all_ray(s->rtree, modelRay, 0, 1, NULL, chunksQuery) > 0) {
-        // sort query results by distance
-        doubly_linked_list_sort_ascending(chunksQuery, rtree_utils_result_sort_func);
-
-        // examine query results in order, return first hit block
-        DoublyLinkedListNode *n = doubly_linked_list_first(chunksQuery);
-        RtreeCastResult *rtreeHit;
-        OctreeIterator *oi;
-        Chunk *c;
-        bool didHit = false, leaf;
-        Block *hitBlock = NULL;
-        float minDistance = FLT_MAX, lastRtreeDist = FLT_MAX;
-        uint16_t x = 0, y = 0, z = 0;
-        Box tmpBox;
-        float d;
-        while (n != NULL) {
-            rtreeHit = (RtreeCastResult *)doubly_linked_list_node_pointer(n);
-            c = (Chunk *)rtree_node_get_leaf_ptr(rtreeHit->rtreeLeaf);
+    Ray modelRay;
+    float3 modelRayStorage[3];
+    ray_init_world_to_local(&modelRay, modelRayStorage, worldRay, t);
 
-            // make sure to examine all hits w/ similar distances before stopping
-            if (didHit &&
-                float_isEqual(rtreeHit->distance, lastRtreeDist, EPSILON_COLLISION) == false) {
-                break;
-            }
-            lastRtreeDist = rtreeHit->distance;
+    // chunks bounds, the r-tree root box is made of chunks boxes
+    Rtree *r = shape_get_rtree(s);
+    if (rtree_node_get_children_count(rtree_get_root(r)) == 0) {
+        return false;
+    }
+    const Box *bounds = rtree_node_get_aabb(rtree_get_root(r));
+    float start;
+    if (ray_intersect_with_box(&modelRay, &bounds->min, &bounds->max, &start) == false) {
+        return false;
+    }
 
-            const SHAPE_COORDS_INT3_T chunkOrigin = chunk_get_origin(c);
-            leaf = false;
-
-            oi = octree_iterator_new(chunk_get_octree(c));
-            while (octree_iterator_is_done(oi) == false) {
-                octree_iterator_get_node_box(oi, &tmpBox);
-
-                // chunk octree box in model space
-                tmpBox.min.x += chunkOrigin.x;
-                tmpBox.min.y += chunkOrigin.y;
-                tmpBox.min.z += chunkOrigin.z;
-                tmpBox.max.x += chunkOrigin.x;
-                tmpBox.max.y += chunkOrigin.y;
-                tmpBox.max.z += chunkOrigin.z;
-
-                const bool collides = ray_intersect_with_box(modelRay,
-                                                             &tmpBox.min,
-                                                             &tmpBox.max,
-                                                             &d) &&
-                                      d < minDistance;
-                if (leaf && collides) {
-                    didHit = true;
-                    minDistance = d;
-                    hitBlock = (Block *)octree_iterator_get_element(oi);
-                    octree_iterator_get_current_position(oi, &x, &y, &z);
-                }
+    // 3D-DDA (Amanatides & Woo) through blocks, starting at the block containing ray origin, or
+    // where the ray enters chunks bounds. Empty aligned areas (missing chunks, empty octree nodes)
+    // are crossed in one step
+    float3 entry;
+    ray_impact_point(&modelRay, maximum(start, 0.0f), &entry);
+    const float origin[3] = {modelRay.origin->x, modelRay.origin->y, modelRay.origin->z};
+    const float dir[3] = {modelRay.dir->x, modelRay.dir->y, modelRay.dir->z};
+    const float invdir[3] = {modelRay.invdir->x, modelRay.invdir->y, modelRay.invdir->z};
+    const int32_t boundsMin[3] = {(int32_t)bounds->min.x,
+                                  (int32_t)bounds->min.y,
+                                  (int32_t)bounds->min.z};
+    const int32_t boundsMax[3] = {(int32_t)bounds->max.x,
+                                  (int32_t)bounds->max.y,
+                                  (int32_t)bounds->max.z};
+    int32_t v[3] = {(int32_t)floorf(entry.x), (int32_t)floorf(entry.y), (int32_t)floorf(entry.z)};
+    int32_t next[3], side[3], cellMin[3];
+    for (int a = 0; a < 3; ++a) {
+        v[a] = CLAMP(v[a], boundsMin[a], boundsMax[a] - 1);
+    }
+
+    // blocks touched when crossing several planes at once, w/ a bit set for each axis where the
+    // block is before the plane, starting w/ faces neighbors of next block
+    static const uint8_t sideMasks[6] = {1, 2, 4, 3, 5, 6};
 
-                octree_iterator_next(oi, collides == false && leaf == false, &leaf);
-            }
-            octree_iterator_free(oi);
+    Chunk *chunk = NULL;
+    SHAPE_COORDS_INT3_T chunkCoords = {INT16_MAX, INT16_MAX, INT16_MAX};
+    Block *hitBlock = NULL;
+    float minDistance = FLT_MAX, tAxis[3], tExit;
+    uint16_t size;
+    uint8_t tied, crossed;
+    int32_t x = 0, y = 0, z = 0;
+
+    // ray_intersect_with_box puts a plane close to ray origin at distance 0, blocks on both sides
+    // of it may be touched, at different distances
+    int32_t around[3];
+    bool nearPlane = false;
+    for (int a = 0; a < 3 && start <= 0.0f; ++a) {
+        if (float_isEqual((float)(v[a] + 1), origin[a], EPSILON_ZERO)) {
+            around[a] = v[a] + 1;
+        } else if (float_isEqual((float)v[a], origin[a], EPSILON_ZERO)) {
+            around[a] = v[a] - 1;
+        } else {
+            around[a] = v[a];
+        }
+        nearPlane = nearPlane || around[a] != v[a];
+    }
+    for (uint8_t m = 0; m < 8 && nearPlane; ++m) {
+        int32_t n[3];
+        bool valid = true;
+        for (int a = 0; a < 3; ++a) {
+            n[a] = m & (1 << a) ? around[a] : v[a];
+            valid = valid && (n[a] != v[a] || (m & (1 << a)) == 0) && n[a] >= boundsMin[a] &&
+                    n[a] < boundsMax[a];
+        }
+        float d;
+        Block *b = valid ? _shape_ray_cast_get_block(s, &chunk, &chunkCoords, n, &size) : NULL;
+        if (b != NULL && _shape_ray_cast_block_distance(&modelRay, n, &d) && d < minDistance) {
+            hitBlock = b;
+            minDistance = d;
+            x = n[0];
+            y = n[1];
+            z = n[2];
+        }
+    }
 
-            if (didHit) {
-                // chunk block coordinates in model space
-                x += chunkOrigin.x;
-                y += chunkOrigin.y;
-                z += chunkOrigin.z;
+    while (hitBlock == NULL) {
+        Block *b = _shape_ray_cast_get_block(s, &chunk, &chunkCoords, v, &size);
+        if (b != NULL) {
+            if (_shape_ray_cast_block_distance(&modelRay, v, &minDistance)) {
+                hitBlock = b;
+                x = v[0];
+                y = v[1];
+                z = v[2];
+                break;
             }
-
-            n = doubly_linked_list_node_next(n);
+            size = 1;
         }
 
-        if (hitBlock == NULL) {
-            ray_free(modelRay);
-            doubly_linked_list_flush(chunksQuery, free);
-            doubly_linked_list_free(chunksQuery);
-            return false;
+        // exit distance from current area, along each axis
+        tExit = FLT_MAX;
+        for (int a = 0; a < 3; ++a) {
+            cellMin[a] = v[a] & ~((int32_t)size - 1);
+            if (dir[a] > 0.0f) {
+                tAxis[a] = _shape_ray_cast_plane_distance((float)(cellMin[a] + size),
+                                                          origin[a],
+                                                          invdir[a]);
+            } else if (dir[a] < 0.0f) {
+                tAxis[a] = _shape_ray_cast_plane_distance((float)cellMin[a], origin[a], invdir[a]);
+            } else {
+                tAxis[a] = FLT_MAX;
+            }
+            tExit = minimum(tExit, tAxis[a]);
+        }
+        if (tExit == FLT_MAX) {
+            break;
         }
 
-        if (worldDistance != NULL || localImpact != NULL) {
-            float3 _localImpact;
-            ray_impact_point(modelRay, minDistance, &_localImpact);
-            if (localImpact != NULL) {
-                *localImpact = _localImpact;
+        // next block, crossing exited axes, w/ other coordinates kept within current area & never
+        // going back. Other coordinates are found w/ the same plane distances as in
+        // ray_intersect_with_box, and a block plane crossed exactly at exit distance is also noted
+        tied = 0;
+        crossed = 0;
+        for (int a = 0; a < 3; ++a) {
+            const int32_t cellMax = cellMin[a] + size - 1;
+            if (tAxis[a] == tExit) {
+                next[a] = dir[a] > 0.0f ? cellMax + 1 : cellMin[a] - 1;
+                side[a] = dir[a] > 0.0f ? cellMax : cellMin[a];
+                tied |= (uint8_t)(1 << a);
+            } else if (dir[a] == 0.0f || size == 1) {
+                next[a] = v[a];
+                side[a] = v[a];
+            } else {
+                next[a] = _shape_ray_cast_axis_block(origin[a],
+                                                     dir[a],
+                                                     invdir[a],
+                                                     tExit,
+                                                     dir[a] > 0.0f ? v[a] : cellMin[a],
+                                                     dir[a] > 0.0f ? cellMax : v[a],
+                                                     &side[a]);
+            }
+            if (side[a] != next[a]) {
+                crossed |= (uint8_t)(1 << a);
             }
+        }
 
-            if (worldDistance != NULL) {
-                float3 worldImpact;
-                transform_utils_position_ltw(t, &_localImpact, &worldImpact);
-                float3_op_substract(&worldImpact, worldRay->origin);
-                *worldDistance = float3_length(&worldImpact);
+        // several planes crossed at once, through an edge or a corner: blocks on the other side of
+        // some of them also touch the ray, unless within current area
+        if ((crossed & (crossed - 1)) != 0) {
+            for (int i = 0; i < 6 && hitBlock == NULL; ++i) {
+                if ((sideMasks[i] & crossed) != sideMasks[i] || (sideMasks[i] & tied) == tied) {
+                    continue;
+                }
+                int32_t n[3];
+                bool inBounds = true;
+                for (int a = 0; a < 3; ++a) {
+                    n[a] = sideMasks[i] & (1 << a) ? side[a] : next[a];
+                    inBounds = inBounds && n[a] >= boundsMin[a] && n[a] < boundsMax[a];
+                }
+                if (inBounds == false) {
+                    continue;
+                }
+                b = _shape_ray_cast_get_block(s, &chunk, &chunkCoords, n, &size);
+                if (b != NULL && _shape_ray_cast_block_distance(&modelRay, n, &minDistance)) {
+                    hitBlock = b;
+                    x = n[0];
+                    y = n[1];
+                    z = n[2];
+                }
             }
         }
 
-        if (block != NULL) {
-            *block = hitBlock;
+        bool inBounds = true;
+        for (int a = 0; a < 3; ++a) {
+            inBounds = inBounds && next[a] >= boundsMin[a] && next[a] < boundsMax[a];
+            v[a] = next[a];
+        }
+        if (inBounds == false) {
+            break;
+        }
+    }
+
+    if (hitBlock == NULL) {
+        return false;
+    }
+
+    if (worldDistance != NULL || localImpact != NULL) {
+        float3 _localImpact;
+        ray_impact_point(&modelRay, minDistance, &_localImpact);
+        if (localImpact != NULL) {
+            *localImpact = _localImpact;
         }
 
-        if (coords != NULL) {
-            coords->x = (SHAPE_COORDS_INT_T)x;
-            coords->y = (SHAPE_COORDS_INT_T)y;
-            coords->z = (SHAPE_COORDS_INT_T)z;
+        if (worldDistance != NULL) {
+            float3 worldImpact;
+            transform_utils_position_ltw(t, &_localImpact, &worldImpact);
+            float3_op_substract(&worldImpact, worldRay->origin);
+            *worldDistance = float3_length(&worldImpact);
         }
+    }
 
-        ray_free(modelRay);
-        doubly_linked_list_flush(chunksQuery, free);
-        doubly_linked_list_free(chunksQuery);
-        return true;
+    if (block != NULL) {
+        *block = hitBlock;
     }
 
-    ray_free(modelRay);
-    doubly_linked_list_flush(chunksQuery, free);
-    doubly_linked_list_free(chunksQuery);
+    if (coords != NULL) {
+        coords->x = (SHAPE_COORDS_INT_T)x;
+        coords->y = (SHAPE_COORDS_INT_T)y;
+        coords->z = (SHAPE_COORDS_INT_T)z;
+    }
 
-    return false;
+    return true;
 }
 
 bool shape_point_overlap(const Shape *s, const float3 *world) {
@@ -2285,53 +2738,71 @@ bool shape_box_overlap(const Shape *s, const Box *modelBox, Box *out) {
         return false;
     }
 
-    // select overlapped chunks
-    FifoList *chunksQuery = fifo_list_new();
-    bool didHit = false;
-    if (rtree_query_overlap_box(s->rtree, modelBox, 0, 1, NULL, chunksQuery, EPSILON_COLLISION) >
-        0) {
-
-        // examine query results, stop at first overlap
-        RtreeNode *hit = fifo_list_pop(chunksQuery);
-        OctreeIterator *oi;
-        bool leaf;
-        Chunk *c;
-        Box tmpBox;
-        while (hit != NULL && didHit == false) {
-            c = (Chunk *)rtree_node_get_leaf_ptr(hit);
-
-            const SHAPE_COORDS_INT3_T chunkOrigin = chunk_get_origin(c);
-            leaf = false;
-
-            oi = octree_iterator_new(chunk_get_octree(c));
-            while (octree_iterator_is_done(oi) == false) {
-                octree_iterator_get_node_box(oi, &tmpBox);
-
-                // chunk octree box in model space
-                tmpBox.min.x += chunkOrigin.x;
-                tmpBox.min.y += chunkOrigin.y;
-                tmpBox.min.z += chunkOrigin.z;
-                tmpBox.max.x += chunkOrigin.x;
-                tmpBox.max.y += chunkOrigin.y;
-                tmpBox.max.z += chunkOrigin.z;
-
-                const bool collides = box_collide(modelBox, &tmpBox);
-                if (leaf && collides) {
-                    didHit = true;
-                    if (out != NULL) {
-                        *out = tmpBox;
-                    }
-                    break;
+    // select overlapped chunks, kept on the stack unless there are too many
+    Rtree *r = shape_get_rtree(s);
+    RtreeNode *stackHits[PHYSICS_QUERY_STACK_RESULTS], **chunksQuery = stackHits;
+    size_t chunksCount = rtree_query_overlap_box_array(r,
+                                                       modelBox,
+                                                       0,
+                                                       1,
+                                                       NULL,
+                                                       stackHits,
+                                                       PHYSICS_QUERY_STACK_RESULTS,
+                                                       EPSILON_COLLISION);
+    if (chunksCount > PHYSICS_QUERY_STACK_RESULTS) {
+        chunksQuery = (RtreeNode **)malloc(chunksCount * sizeof(RtreeNode *));
+        if (chunksQuery == NULL) {
+            return false;
+        }
+        rtree_query_overlap_box_array(r,
+                                      modelBox,
+                                      0,
+                                      1,
+                                      NULL,
+                                      chunksQuery,
+                                      chunksCount,
+                                      EPSILON_COLLISION);
+    }
+
+    // examine query results, stop at first overlap
+    OctreeIterator oi;
+    bool didHit = false, leaf;
+    Chunk *c;
+    Box tmpBox;
+    for (size_t i = 0; i < chunksCount && didHit == false; ++i) {
+        c = (Chunk *)rtree_node_get_leaf_ptr(chunksQuery[i]);
+
+        const SHAPE_COORDS_INT3_T chunkOrigin = chunk_get_origin(c);
+        leaf = false;
+
+        octree_iterator_init(&oi, chunk_get_octree(c));
+        while (octree_iterator_is_done(&oi) == false) {
+            octree_iterator_get_node_box(&oi, &tmpBox);
+
+            // chunk octree box in model space
+            tmpBox.min.x += chunkOrigin.x;
+            tmpBox.min.y += chunkOrigin.y;
+            tmpBox.min.z += chunkOrigin.z;
+            tmpBox.max.x += chunkOrigin.x;
+            tmpBox.max.y += chunkOrigin.y;
+            tmpBox.max.z += chunkOrigin.z;
+
+            const bool collides = box_collide(modelBox, &tmpBox);
+            if (leaf && collides) {
+                didHit = true;
+                if (out != NULL) {
+                    *out = tmpBox;
                 }
-
-                octree_iterator_next(oi, collides == false && leaf == false, &leaf);
+                break;
             }
-            octree_iterator_free(oi);
 
-            hit = fifo_list_pop(chunksQuery);
+            octree_iterator_next(&oi, collides == false && leaf == false, &leaf);
         }
     }
-    fifo_list_free(chunksQuery, NULL);
+
+    if (chunksQuery != stackHits) {
+        free(chunksQuery);
+    }
 
     return didHit;
 }
@@ -2443,14 +2914,29 @@ void shape_remove_point(Shape *s, const char *key) {
 // MARK: - Baked lighting -
 
 void shape_compute_baked_lighting(Shape *s) {
+    ThreadPool *pool = s->nbChunks >= LIGHT_PARALLEL_MIN_CHUNKS ? thread_pool_get_shared() : NULL;
+    if (pool != NULL && thread_pool_get_nb_workers(pool) > 0) {
+        shape_compute_baked_lighting_parallel(s, pool);
+    } else {
+        shape_compute_baked_lighting_serial(s);
+    }
+}
+
+static void _shape_compute_baked_lighting_serial(Shape *s, const bool sunlightColumns) {
     _shape_toggle_rendering_flag(s, SHAPE_RENDERING_FLAG_BAKED_LIGHTING, true);
+    _shape_lighting_work_reset(s);
 
     LightNodeQueue *q = light_node_queue_new();
     SHAPE_COORDS_INT3_T min, max;
 
     _light_removal_all(s, &min, &max);
-    _light_enqueue_ambient_and_block_sources(s, q, min, max, false);
+    if (sunlightColumns && _light_sunlight_columns(s, q, min, max)) {
+        _light_enqueue_block_sources(s, q, min, max, false);
+    } else {
+        _light_enqueue_ambient_and_block_sources(s, q, min, max, false);
+    }
     _light_propagate(s, &min, &max, q, min.x - 1, max.y, min.z - 1, true);
+    _light_compact_all(s);
 
     light_node_queue_free(q);
 
@@ -2459,8 +2945,37 @@ void shape_compute_baked_lighting(Shape *s) {
 #endif
 }
 
+void shape_compute_baked_lighting_serial(Shape *s) {
+    _shape_compute_baked_lighting_serial(s, true);
+}
+
+void shape_compute_baked_lighting_flood_fill(Shape *s) {
+    _shape_compute_baked_lighting_serial(s, false);
+}
+
+void shape_compute_baked_lighting_parallel(Shape *s, ThreadPool *pool) {
+    _shape_lighting_work_reset(s);
+
+    SHAPE_COORDS_INT3_T min, max;
+    _light_removal_all(s, &min, &max);
+
+    if (_light_propagate_parallel(s, pool, min, max) == false) {
+        shape_compute_baked_lighting_serial(s);
+        return;
+    }
+    _light_compact_all(s);
+    _shape_toggle_rendering_flag(s, SHAPE_RENDERING_FLAG_BAKED_LIGHTING, true);
+
+#if SHAPE_LIGHTING_DEBUG
+    cclog_debug("Shape light computed (parallel)");
+#endif
+}
+
 void shape_toggle_baked_lighting(Shape *s, const bool toggle) {
     _shape_toggle_rendering_flag(s, SHAPE_RENDERING_FLAG_BAKED_LIGHTING, toggle);
+    if (toggle == false) {
+        _shape_lighting_work_reset(s);
+    }
 }
 
 bool shape_uses_baked_lighting(const Shape *s) {
@@ -2504,6 +3019,7 @@ void shape_set_lighting_data_from_blob(Shape *s,
                                        SHAPE_COORDS_INT3_T max) {
 
     _shape_toggle_rendering_flag(s, SHAPE_RENDERING_FLAG_BAKED_LIGHTING, true);
+    _shape_lighting_work_reset(s);
 
     Chunk *chunk;
     CHUNK_COORDS_INT3_T coords_in_chunk;
@@ -2541,6 +3057,7 @@ void shape_clear_baked_lighing(Shape *s) {
     index3d_iterator_free(it);
 
     _shape_toggle_rendering_flag(s, SHAPE_RENDERING_FLAG_BAKED_LIGHTING, false);
+    _shape_lighting_work_reset(s);
 }
 
 VERTEX_LIGHT_STRUCT_T shape_get_light_or_default(const Shape *s,
@@ -2858,6 +3375,98 @@ void shape_compute_baked_lighting_replaced_block(Shape *s,
     light_node_queue_free(lightQueue);
 }
 
+void shape_begin_lighting_batch(Shape *s) {
+    if (s == NULL || s->lightingBatch != NULL) {
+        return;
+    }
+    s->lightingBatch = index3d_new();
+}
+
+void shape_end_lighting_batch(Shape *s) {
+    if (s == NULL || s->lightingBatch == NULL) {
+        return;
+    }
+    if (s->lightingWork != NULL) {
+        // deferred lighting keeps the batch open, now closing it with deferred lighting
+        s->lightingWork->ownsBatch = true;
+        return;
+    }
+    Index3D *changes = s->lightingBatch;
+    s->lightingBatch = NULL;
+
+    if (_shape_get_rendering_flag(s, SHAPE_RENDERING_FLAG_BAKED_LIGHTING)) {
+        _light_apply_batch(s, changes);
+    }
+
+    index3d_flush(changes, free);
+    index3d_free(changes);
+}
+
+void shape_set_deferred_lighting_budget(Shape *s, uint32_t budget) {
+    if (s == NULL) {
+        return;
+    }
+    if (budget == 0) {
+        if (s->lightingWork != NULL) {
+            const bool ownsBatch = s->lightingWork->ownsBatch;
+            shape_flush_lighting(s);
+            _shape_lighting_work_free(s);
+
+            // a batch opened by the caller stays open (flushed) until shape_end_lighting_batch
+            if (ownsBatch) {
+                index3d_free(s->lightingBatch); // flushed
+                s->lightingBatch = NULL;
+            }
+        }
+        return;
+    }
+    if (s->lightingWork == NULL) {
+        _LightingWork *w = (_LightingWork *)malloc(sizeof(_LightingWork));
+        if (w == NULL) {
+            return;
+        }
+        w->changes = NULL;
+        w->lightQueue = light_node_queue_new();
+        w->lightRemovalQueue = light_removal_node_queue_new();
+        w->min = w->max = coords3_zero;
+        w->stage = LIGHTING_WORK_IDLE;
+        w->ownsBatch = s->lightingBatch == NULL;
+        s->lightingWork = w;
+
+        // changes are recorded in a batch that stays open, flushed by shape_process_lighting
+        shape_begin_lighting_batch(s);
+    }
+    s->lightingWork->budget = budget;
+}
+
+bool shape_process_lighting(Shape *s, uint32_t budget) {
+    if (s == NULL || s->lightingWork == NULL) {
+        return true;
+    }
+    return _shape_lighting_work_process(s, budget, true);
+}
+
+void shape_flush_lighting(Shape *s) {
+    shape_process_lighting(s, UINT32_MAX);
+}
+
+bool shape_has_pending_transaction(const Shape *s) {
+    return s->pendingTransaction != NULL;
+}
+
+bool shape_has_pending_vertices(const Shape *s) {
+    return (s->dirtyChunks != NULL && fifo_list_get_size(s->dirtyChunks) > 0) ||
+           shape_is_lighting_pending(s);
+}
+
+bool shape_is_lighting_pending(const Shape *s) {
+    if (s == NULL || s->lightingWork == NULL) {
+        return false;
+    }
+    return s->lightingWork->stage != LIGHTING_WORK_IDLE ||
+           index3d_is_empty(s->lightingBatch) == false;
+}
+
 uint64_t shape_get_baked_lighting_hash(const Shape *s) {
     if (s == NULL || s->palette == NULL) {
         return 0;
@@ -3059,35 +3668,209 @@ void _shape_chunk_enqueue_refresh(Shape *shape, Chunk *c) {
         }
         fifo_list_push(shape->dirtyChunks, c);
         chunk_set_dirty(c, true);
+        transform_set_branch_dirty(shape->transform);
     }
 }
 
-void _shape_chunk_check_neighbors_dirty(Shape *shape,
-                                        const Chunk *chunk,
-                                        CHUNK_COORDS_INT3_T block_pos) {
-    // Only neighbors sharing faces need to have their mesh set dirty
-    // Not refreshing diagonal chunks will only affect AO on that corner, not essential
-    // TODO: enable diagonal refresh once chunks slice refresh is implemented
-
-    if (block_pos.x == 0) {
-        _shape_chunk_enqueue_refresh(shape, chunk_get_neighbor(chunk, NX));
-    } else if (block_pos.x == CHUNK_SIZE_MINUS_ONE) {
-        _shape_chunk_enqueue_refresh(shape, chunk_get_neighbor(chunk, X));
+static void _shape_chunk_mark_edited(Shape *shape, const Chunk *c) {
+    if (shape->editedChunks == NULL) {
+        return;
     }
-
-    if (block_pos.y == 0) {
-        _shape_chunk_enqueue_refresh(shape, chunk_get_neighbor(chunk, NY));
-    } else if (block_pos.y == CHUNK_SIZE_MINUS_ONE) {
-        _shape_chunk_enqueue_refresh(shape, chunk_get_neighbor(chunk, Y));
+    const SHAPE_COORDS_INT3_T coords = chunk_utils_get_coords(chunk_get_origin(c));
+    if (index3d_get(shape->editedChunks, coords.x, coords.y, coords.z) == NULL) {
+        index3d_insert(shape->editedChunks,
+                       int3_new(coords.x, coords.y, coords.z),
+                       coords.x,
+                       coords.y,
+                       coords.z,
+                       NULL);
     }
+}
 
-    if (block_pos.z == 0) {
+/// only the first change of a block is recorded, to keep the block it had at batch start
+static void _shape_lighting_batch_record(Shape *shape,
+                                         SHAPE_COORDS_INT3_T coords,
+                                         SHAPE_COLOR_INDEX_INT_T before) {
+    if (_shape_get_rendering_flag(shape, SHAPE_RENDERING_FLAG_BAKED_LIGHTING) == false ||
+        index3d_get(shape->lightingBatch, coords.x, coords.y, coords.z) != NULL) {
+        return;
+    }
+    _LightingBatchChange *change = (_LightingBatchChange *)malloc(sizeof(_LightingBatchChange));
+    if (change == NULL) {
+        return;
+    }
+    change->coords = coords;
+    change->before = before;
+    change->kind = LIGHTING_BATCH_CHANGE_NONE;
+    index3d_insert(shape->lightingBatch, change, coords.x, coords.y, coords.z, NULL);
+    transform_set_branch_dirty(shape->transform);
+}
+
+static bool _shape_lighting_work_process(Shape *s, uint32_t budget, bool nextBatch) {
+    _LightingWork *w = s->lightingWork;
+    if (w == NULL) {
+        return true;
+    }
+    if (_shape_get_rendering_flag(s, SHAPE_RENDERING_FLAG_BAKED_LIGHTING) == false) {
+        _shape_lighting_work_reset(s);
+        return true;
+    }
+
+    while (budget > 0) {
+        if (w->stage == LIGHTING_WORK_IDLE) {
+            if (nextBatch == false || index3d_is_empty(s->lightingBatch)) {
+                break;
+            }
+            // changes made from now on go to next batch
+            w->changes = s->lightingBatch;
+            s->lightingBatch = index3d_new();
+
+            if (_light_batch_seed_removal(s,
+                                          w->changes,
+                                          w->lightRemovalQueue,
+                                          w->lightQueue,
+                                          &w->min,
+                                          &w->max)) {
+                w->stage = LIGHTING_WORK_REMOVAL;
+            } else {
+                index3d_flush(w->changes, free);
+                index3d_free(w->changes);
+                w->changes = NULL;
+                continue;
+            }
+        }
+
+        if (w->stage == LIGHTING_WORK_REMOVAL) {
+            budget -= _light_removal_budgeted(s,
+                                              &w->min,
+                                              &w->max,
+                                              w->lightRemovalQueue,
+                                              w->lightQueue,
+                                              budget);
+            if (light_removal_node_queue_count(w->lightRemovalQueue) > 0) {
+                break;
+            }
+            _light_batch_seed_propagation(s, w->changes, w->lightQueue);
+            index3d_flush(w->changes, free);
+            index3d_free(w->changes);
+            w->changes = NULL;
+            w->stage = LIGHTING_WORK_PROPAGATION;
+        }
+
+        budget -= _light_propagate_budgeted(s, &w->min, &w->max, w->lightQueue, false, budget);
+        if (light_node_queue_count(w->lightQueue) > 0) {
+            break;
+        }
+        // lighting settled, chunks can be remeshed
+        _lighting_postprocess_dirty(s, &w->min, &w->max);
+        w->stage = LIGHTING_WORK_IDLE;
+    }
+
+    return w->stage == LIGHTING_WORK_IDLE && index3d_is_empty(s->lightingBatch);
+}
+
+static void _shape_lighting_work_settle(Shape *s) {
+    if (s->lightingWork != NULL && s->lightingWork->stage != LIGHTING_WORK_IDLE) {
+        _shape_lighting_work_process(s, UINT32_MAX, false);
+    }
+}
+
+static void _shape_lighting_work_reset(Shape *s) {
+    _LightingWork *w = s->lightingWork;
+    if (w == NULL) {
+        return;
+    }
+    if (w->changes != NULL) {
+        index3d_flush(w->changes, free);
+        index3d_free(w->changes);
+        w->changes = NULL;
+    }
+    if (s->lightingBatch != NULL) {
+        index3d_flush(s->lightingBatch, free);
+    }
+    light_node_queue_clear(w->lightQueue);
+    LightRemovalNode rn;
+    while (light_removal_node_queue_pop(w->lightRemovalQueue, &rn)) {}
+    w->stage = LIGHTING_WORK_IDLE;
+}
+
+static void _shape_lighting_work_free(Shape *s) {
+    _LightingWork *w = s->lightingWork;
+    if (w == NULL) {
+        return;
+    }
+    _shape_lighting_work_reset(s);
+    light_node_queue_free(w->lightQueue);
+    light_removal_node_queue_free(w->lightRemovalQueue);
+    free(w);
+    s->lightingWork = NULL;
+}
+
+void _shape_chunk_check_neighbors_dirty(Shape *shape,
+                                        const Chunk *chunk,
+                                        CHUNK_COORDS_INT3_T block_pos) {
+    // Only neighbors sharing faces need to have their mesh set dirty
+    // Not refreshing diagonal chunks will only affect AO on that corner, not essential
+    // TODO: enable diagonal refresh once chunks slice refresh is implemented
+
+    if (block_pos.x == 0) {
+        _shape_chunk_enqueue_refresh(shape, chunk_get_neighbor(chunk, NX));
+    } else if (block_pos.x == CHUNK_SIZE_MINUS_ONE) {
+        _shape_chunk_enqueue_refresh(shape, chunk_get_neighbor(chunk, X));
+    }
+
+    if (block_pos.y == 0) {
+        _shape_chunk_enqueue_refresh(shape, chunk_get_neighbor(chunk, NY));
+    } else if (block_pos.y == CHUNK_SIZE_MINUS_ONE) {
+        _shape_chunk_enqueue_refresh(shape, chunk_get_neighbor(chunk, Y));
+    }
+
+    if (block_pos.z == 0) {
         _shape_chunk_enqueue_refresh(shape, chunk_get_neighbor(chunk, NZ));
     } else if (block_pos.z == CHUNK_SIZE_MINUS_ONE) {
         _shape_chunk_enqueue_refresh(shape, chunk_get_neighbor(chunk, Z));
     }
 }
 
+static void _shape_chunk_rtree_box(const Chunk *c, Box *box) {
+    const SHAPE_COORDS_INT3_T chunkOrigin = chunk_get_origin(c);
+    box->min = (float3){(float)chunkOrigin.x, (float)chunkOrigin.y, (float)chunkOrigin.z};
+    box->max = (float3){(float)(chunkOrigin.x + CHUNK_SIZE),
+                        (float)(chunkOrigin.y + CHUNK_SIZE),
+                        (float)(chunkOrigin.z + CHUNK_SIZE)};
+}
+
+static void _shape_bulk_load_rtree(const Shape *s) {
+    // r-tree is either empty w/ no chunk leaf, or has a leaf for each chunk
+    if (s->nbChunks == 0 || rtree_node_get_children_count(rtree_get_root(s->rtree)) > 0) {
+        return;
+    }
+
+    RtreeNode **leaves = (RtreeNode **)malloc(s->nbChunks * sizeof(RtreeNode *));
+    size_t count = 0;
+    Box chunkBox;
+
+    Index3DIterator *it = index3d_iterator_new(s->chunks);
+    Chunk *c;
+    while ((c = index3d_iterator_pointer(it)) != NULL) {
+        _shape_chunk_rtree_box(c, &chunkBox);
+        if (leaves != NULL) {
+            leaves[count] = rtree_create_leaf(s->rtree, &chunkBox, 1, 1, c);
+            chunk_set_rtree_leaf(c, leaves[count]);
+            ++count;
+        } else {
+            chunk_set_rtree_leaf(c, rtree_create_and_insert(s->rtree, &chunkBox, 1, 1, c));
+        }
+        index3d_iterator_next(it);
+    }
+    index3d_iterator_free(it);
+
+    if (leaves != NULL) {
+        rtree_bulk_load(s->rtree, leaves, count);
+        free(leaves);
+    }
+}
+
 bool _shape_add_block_in_chunks(Shape *shape,
                                 const Block block,
                                 const SHAPE_COORDS_INT_T x,
@@ -3113,11 +3896,13 @@ bool _shape_add_block_in_chunks(Shape *shape,
         index3d_insert(shape->chunks, chunk, chunk_coords.x, chunk_coords.y, chunk_coords.z, NULL);
         chunk_move_in_neighborhood(shape->chunks, chunk, chunk_coords);
 
-        Box chunkBox = {{(float)chunkOrigin.x, (float)chunkOrigin.y, (float)chunkOrigin.z},
-                        {(float)(chunkOrigin.x + CHUNK_SIZE),
-                         (float)(chunkOrigin.y + CHUNK_SIZE),
-                         (float)(chunkOrigin.z + CHUNK_SIZE)}};
-        chunk_set_rtree_leaf(chunk, rtree_create_and_insert(shape->rtree, &chunkBox, 1, 1, chunk));
+        // partition new chunk in shape space, unless chunks are yet to be bulk loaded
+        if (rtree_node_get_children_count(rtree_get_root(shape->rtree)) > 0) {
+            Box chunkBox;
+            _shape_chunk_rtree_box(chunk, &chunkBox);
+            chunk_set_rtree_leaf(chunk,
+                                 rtree_create_and_insert(shape->rtree, &chunkBox, 1, 1, chunk));
+        }
 
         *chunkAdded = true;
     } else {
@@ -3309,24 +4094,8 @@ void _light_set_and_enqueue_source(Shape *shape,
                                    LightNodeQueue *lightQueue,
                                    bool initEmpty) {
     VERTEX_LIGHT_STRUCT_T current = chunk_get_light_without_checking(c, coords_in_chunk);
-    const bool s = current.ambient < source.ambient;
-    const bool r = current.red < source.red;
-    const bool g = current.green < source.green;
-    const bool b = current.blue < source.blue;
-    if (s || r || g || b) {
-        // individually update light and emission value
-        if (s) {
-            current.ambient = source.ambient;
-        }
-        if (r) {
-            current.red = source.red;
-        }
-        if (g) {
-            current.green = source.green;
-        }
-        if (b) {
-            current.blue = source.blue;
-        }
+    // individually update light and emission value
+    if (_light_raise(&current, source)) {
         chunk_set_light(c, coords_in_chunk, current, initEmpty);
 
         // enqueue as a new light source if any value was higher
@@ -3351,7 +4120,16 @@ void _light_enqueue_ambient_and_block_sources(Shape *s,
         }
     }
 
+    _light_enqueue_block_sources(s, q, min, max, enqueueAir);
+}
+
+void _light_enqueue_block_sources(Shape *s,
+                                  LightNodeQueue *q,
+                                  SHAPE_COORDS_INT3_T min,
+                                  SHAPE_COORDS_INT3_T max,
+                                  bool enqueueAir) {
     // Block sources: enqueue all emissive blocks in the given area
+    SHAPE_COORDS_INT3_T coords_in_shape;
     const Block *b;
     SHAPE_COORDS_INT3_T chunkFrom = chunk_utils_get_coords(
         (SHAPE_COORDS_INT3_T){min.x - 1, min.y - 1, min.z - 1});
@@ -3400,6 +4178,68 @@ void _light_enqueue_ambient_and_block_sources(Shape *s,
     }
 }
 
+VERTEX_LIGHT_STRUCT_T _light_get_propagated(const Shape *s,
+                                            VERTEX_LIGHT_STRUCT_T current,
+                                            const Block *neighbor,
+                                            bool transparent,
+                                            uint8_t stepS,
+                                            uint8_t stepRGB) {
+    // if transparent, first reduce incoming light values
+    if (transparent) {
+        float a = (float)color_palette_get_color(s->palette, neighbor->colorIndex).a / 255.0f;
+#if TRANSPARENCY_ABSORPTION_FUNC == 1
+        a = easings_quadratic_in(a);
+#elif TRANSPARENCY_ABSORPTION_FUNC == 2
+        a = easings_cubic_in(a);
+#elif TRANSPARENCY_ABSORPTION_FUNC == 3
+        a = easings_exponential_in(a);
+#elif TRANSPARENCY_ABSORPTION_FUNC == 4
+        a = easings_circular_in(a);
+#endif
+
+#if TRANSPARENCY_ABSORPTION_MAX_STEP
+        float absorbRGB = 1.0f - fmaxf(a - (float)stepRGB / 15.0f, 0.0f);
+        float absorbS = 1.0f - fmaxf(a - (float)stepS / 15.0f, 0.0f);
+#else
+        float absorbRGB = 1.0f - a;
+        float absorbS = 1.0f - a;
+#endif
+        current.red = TO_UINT4((uint8_t)((float)current.red * absorbRGB));
+        current.green = TO_UINT4((uint8_t)((float)current.green * absorbRGB));
+        current.blue = TO_UINT4((uint8_t)((float)current.blue * absorbRGB));
+        current.ambient = TO_UINT4((uint8_t)((float)current.ambient * absorbS));
+    }
+
+    // individual values after propagation step, 0 if the step doesn't leave any light
+    VERTEX_LIGHT_STRUCT_T propagated;
+    propagated.ambient = TO_UINT4(current.ambient > stepS ? current.ambient - stepS : 0);
+    propagated.red = TO_UINT4(current.red > stepRGB ? current.red - stepRGB : 0);
+    propagated.green = TO_UINT4(current.green > stepRGB ? current.green - stepRGB : 0);
+    propagated.blue = TO_UINT4(current.blue > stepRGB ? current.blue - stepRGB : 0);
+    return propagated;
+}
+
+bool _light_raise(VERTEX_LIGHT_STRUCT_T *light, VERTEX_LIGHT_STRUCT_T source) {
+    bool raised = false;
+    if (light->ambient < source.ambient) {
+        light->ambient = source.ambient;
+        raised = true;
+    }
+    if (light->red < source.red) {
+        light->red = source.red;
+        raised = true;
+    }
+    if (light->green < source.green) {
+        light->green = source.green;
+        raised = true;
+    }
+    if (light->blue < source.blue) {
+        light->blue = source.blue;
+        raised = true;
+    }
+    return raised;
+}
+
 void _light_block_propagate(Shape *s,
                             Chunk *c,
                             SHAPE_COORDS_INT3_T *bbMin,
@@ -3418,50 +4258,14 @@ void _light_block_propagate(Shape *s,
     // if neighbor non-opaque, propagate sunlight and emission values individually & enqueue if
     // needed
     if (air || transparent) {
-        // if transparent, first reduce incoming light values
-        if (transparent) {
-            float a = (float)color_palette_get_color(s->palette, neighbor->colorIndex).a / 255.0f;
-#if TRANSPARENCY_ABSORPTION_FUNC == 1
-            a = easings_quadratic_in(a);
-#elif TRANSPARENCY_ABSORPTION_FUNC == 2
-            a = easings_cubic_in(a);
-#elif TRANSPARENCY_ABSORPTION_FUNC == 3
-            a = easings_exponential_in(a);
-#elif TRANSPARENCY_ABSORPTION_FUNC == 4
-            a = easings_circular_in(a);
-#endif
-
-#if TRANSPARENCY_ABSORPTION_MAX_STEP
-            float absorbRGB = 1.0f - fmaxf(a - (float)stepRGB / 15.0f, 0.0f);
-            float absorbS = 1.0f - fmaxf(a - (float)stepS / 15.0f, 0.0f);
-#else
-            float absorbRGB = 1.0f - a;
-            float absorbS = 1.0f - a;
-#endif
-            current.red = TO_UINT4((uint8_t)((float)current.red * absorbRGB));
-            current.green = TO_UINT4((uint8_t)((float)current.green * absorbRGB));
-            current.blue = TO_UINT4((uint8_t)((float)current.blue * absorbRGB));
-            current.ambient = TO_UINT4((uint8_t)((float)current.ambient * absorbS));
-        }
-
         VERTEX_LIGHT_STRUCT_T neighborLight = chunk_get_light_without_checking(c, coords_in_chunk);
-        const bool propagateS = neighborLight.ambient < current.ambient - stepS;
-        const bool propagateR = neighborLight.red < current.red - stepRGB;
-        const bool propagateG = neighborLight.green < current.green - stepRGB;
-        const bool propagateB = neighborLight.blue < current.blue - stepRGB;
-        if (propagateS || propagateR || propagateG || propagateB) {
-            if (propagateS) {
-                neighborLight.ambient = TO_UINT4(current.ambient - stepS);
-            }
-            if (propagateR) {
-                neighborLight.red = TO_UINT4(current.red - stepRGB);
-            }
-            if (propagateG) {
-                neighborLight.green = TO_UINT4(current.green - stepRGB);
-            }
-            if (propagateB) {
-                neighborLight.blue = TO_UINT4(current.blue - stepRGB);
-            }
+        const VERTEX_LIGHT_STRUCT_T propagated = _light_get_propagated(s,
+                                                                       current,
+                                                                       neighbor,
+                                                                       transparent,
+                                                                       stepS,
+                                                                       stepRGB);
+        if (_light_raise(&neighborLight, propagated)) {
             chunk_set_light(c, coords_in_chunk, neighborLight, initEmpty);
 
             light_node_queue_push(lightQueue, c, coords_in_shape);
@@ -3488,11 +4292,6 @@ void _light_propagate(Shape *s,
                       SHAPE_COORDS_INT_T srcZ,
                       bool initWithEmptyLight) {
 
-#if SHAPE_LIGHTING_DEBUG
-    cclog_debug("☀️ light propagation started...");
-    int iCount = 0;
-#endif
-
     // changed values bounding box
     SHAPE_COORDS_INT3_T min = *bbMin;
     SHAPE_COORDS_INT3_T max = *bbMax;
@@ -3500,6 +4299,23 @@ void _light_propagate(Shape *s,
     // set source block dirty
     _lighting_set_dirty(&min, &max, (SHAPE_COORDS_INT3_T){srcX, srcY, srcZ});
 
+    _light_propagate_budgeted(s, &min, &max, lightQueue, initWithEmptyLight, UINT32_MAX);
+
+    _lighting_postprocess_dirty(s, &min, &max);
+}
+
+uint32_t _light_propagate_budgeted(Shape *s,
+                                   SHAPE_COORDS_INT3_T *bbMin,
+                                   SHAPE_COORDS_INT3_T *bbMax,
+                                   LightNodeQueue *lightQueue,
+                                   bool initWithEmptyLight,
+                                   uint32_t maxNodes) {
+
+#if SHAPE_LIGHTING_DEBUG
+    cclog_debug("☀️ light propagation started...");
+    int iCount = 0;
+#endif
+
     Chunk *chunk, *insertChunk;
     CHUNK_COORDS_INT3_T coords_in_chunk, cc;
     SHAPE_COORDS_INT3_T coords_in_shape, cs;
@@ -3507,10 +4323,12 @@ void _light_propagate(Shape *s,
     const Block *neighbor = NULL;
     VERTEX_LIGHT_STRUCT_T currentLight;
     bool isCurrentAir, isCurrentOpen, isCurrentTransparent, isNeighborAir, isNeighborTransparent;
-    LightNode *n = light_node_queue_pop(lightQueue);
-    while (n != NULL) {
-        coords_in_shape = light_node_get_coords(n);
-        chunk = light_node_get_chunk(n);
+    uint32_t count = 0;
+    LightNode n;
+    while (count < maxNodes && light_node_queue_pop(lightQueue, &n)) {
+        ++count;
+        coords_in_shape = n.coords;
+        chunk = n.chunk;
 
         coords_in_chunk = chunk_utils_get_coords_in_chunk(coords_in_shape);
 
@@ -3557,8 +4375,8 @@ void _light_propagate(Shape *s,
                 // sunlight propagates infinitely vertically (step = 0)
                 _light_block_propagate(s,
                                        insertChunk,
-                                       &min,
-                                       &max,
+                                       bbMin,
+                                       bbMax,
                                        currentLight,
                                        cc,
                                        (SHAPE_COORDS_INT3_T){coords_in_shape.x,
@@ -3574,12 +4392,12 @@ void _light_propagate(Shape *s,
             }
         }
         // propagate sunlight top-down from above the volume, through empty chunks, and on the sides
-        else if (cs.y >= min.y && cs.y < max.y && cs.x >= min.x - 1 && cs.z >= min.z - 1 &&
-                 cs.x <= max.x && cs.z <= max.z) {
+        else if (cs.y >= bbMin->y && cs.y < bbMax->y && cs.x >= bbMin->x - 1 &&
+                 cs.z >= bbMin->z - 1 && cs.x <= bbMax->x && cs.z <= bbMax->z) {
 
             chunk_set_light(insertChunk, cc, currentLight, initWithEmptyLight);
             light_node_queue_push(lightQueue, insertChunk, cs);
-            _lighting_set_dirty(&min, &max, coords_in_shape);
+            _lighting_set_dirty(bbMin, bbMax, coords_in_shape);
         }
 
         // y + 1
@@ -3607,8 +4425,8 @@ void _light_propagate(Shape *s,
             if (isCurrentAir || isCurrentTransparent) {
                 _light_block_propagate(s,
                                        insertChunk,
-                                       &min,
-                                       &max,
+                                       bbMin,
+                                       bbMax,
                                        currentLight,
                                        cc,
                                        (SHAPE_COORDS_INT3_T){coords_in_shape.x,
@@ -3649,8 +4467,8 @@ void _light_propagate(Shape *s,
             if (isCurrentAir || isCurrentTransparent) {
                 _light_block_propagate(s,
                                        insertChunk,
-                                       &min,
-                                       &max,
+                                       bbMin,
+                                       bbMax,
                                        currentLight,
                                        cc,
                                        (SHAPE_COORDS_INT3_T){coords_in_shape.x + 1,
@@ -3691,8 +4509,8 @@ void _light_propagate(Shape *s,
             if (isCurrentAir || isCurrentTransparent) {
                 _light_block_propagate(s,
                                        insertChunk,
-                                       &min,
-                                       &max,
+                                       bbMin,
+                                       bbMax,
                                        currentLight,
                                        cc,
                                        (SHAPE_COORDS_INT3_T){coords_in_shape.x - 1,
@@ -3733,8 +4551,8 @@ void _light_propagate(Shape *s,
             if (isCurrentAir || isCurrentTransparent) {
                 _light_block_propagate(s,
                                        insertChunk,
-                                       &min,
-                                       &max,
+                                       bbMin,
+                                       bbMax,
                                        currentLight,
                                        cc,
                                        (SHAPE_COORDS_INT3_T){coords_in_shape.x,
@@ -3775,8 +4593,8 @@ void _light_propagate(Shape *s,
             if (isCurrentAir || isCurrentTransparent) {
                 _light_block_propagate(s,
                                        insertChunk,
-                                       &min,
-                                       &max,
+                                       bbMin,
+                                       bbMax,
                                        currentLight,
                                        cc,
                                        (SHAPE_COORDS_INT3_T){coords_in_shape.x,
@@ -3798,8 +4616,6 @@ void _light_propagate(Shape *s,
                                                                      current->colorIndex);
 
             if (currentLight.red == 0 && currentLight.green == 0 && currentLight.blue == 0) {
-                light_node_queue_recycle(n);
-                n = light_node_queue_pop(lightQueue);
                 continue;
             }
             // here: emissive block in need of (re)propagation
@@ -3842,16 +4658,13 @@ void _light_propagate(Shape *s,
 #if SHAPE_LIGHTING_DEBUG
         iCount++;
 #endif
-
-        light_node_queue_recycle(n);
-        n = light_node_queue_pop(lightQueue);
     }
 
-    _lighting_postprocess_dirty(s, &min, &max);
-
 #if SHAPE_LIGHTING_DEBUG
     cclog_debug("☀️ light propagation done with %d iterations", iCount);
 #endif
+
+    return count;
 }
 
 void _light_removal(Shape *s,
@@ -3859,6 +4672,15 @@ void _light_removal(Shape *s,
                     SHAPE_COORDS_INT3_T *bbMax,
                     LightRemovalNodeQueue *lightRemovalQueue,
                     LightNodeQueue *lightQueue) {
+    _light_removal_budgeted(s, bbMin, bbMax, lightRemovalQueue, lightQueue, UINT32_MAX);
+}
+
+uint32_t _light_removal_budgeted(Shape *s,
+                                 SHAPE_COORDS_INT3_T *bbMin,
+                                 SHAPE_COORDS_INT3_T *bbMax,
+                                 LightRemovalNodeQueue *lightRemovalQueue,
+                                 LightNodeQueue *lightQueue,
+                                 uint32_t maxNodes) {
 
 #if SHAPE_LIGHTING_DEBUG
     cclog_debug("☀️ light removal started...");
@@ -3872,13 +4694,15 @@ void _light_removal(Shape *s,
     Chunk *chunk, *insertChunk;
     SHAPE_COORDS_INT3_T coords_in_shape;
     CHUNK_COORDS_INT3_T coords_in_chunk, cc;
-    LightRemovalNode *rn = light_removal_node_queue_pop(lightRemovalQueue);
-    while (rn != NULL) {
-        coords_in_shape = light_removal_node_get_coords(rn);
-        light = light_removal_node_get_light(rn);
-        srgb = light_removal_node_get_srgb(rn);
-        blockID = light_removal_node_get_block_id(rn);
-        chunk = light_removal_node_get_chunk(rn);
+    uint32_t count = 0;
+    LightRemovalNode rn;
+    while (count < maxNodes && light_removal_node_queue_pop(lightRemovalQueue, &rn)) {
+        ++count;
+        coords_in_shape = rn.coords;
+        light = rn.light;
+        srgb = rn.srgb;
+        blockID = rn.blockID;
+        chunk = rn.chunk;
 
         // check that the current block is inside the shape bounds
         if (shape_is_within_bounding_box(s, coords_in_shape)) {
@@ -4092,14 +4916,13 @@ void _light_removal(Shape *s,
 #if SHAPE_LIGHTING_DEBUG
         iCount++;
 #endif
-
-        light_removal_node_queue_recycle(rn);
-        rn = light_removal_node_queue_pop(lightRemovalQueue);
     }
 
 #if SHAPE_LIGHTING_DEBUG
     cclog_debug("☀️ light removal done with %d iterations", iCount);
 #endif
+
+    return count;
 }
 
 void _light_removal_all(Shape *s, SHAPE_COORDS_INT3_T *min, SHAPE_COORDS_INT3_T *max) {
@@ -4135,6 +4958,1096 @@ void _light_removal_all(Shape *s, SHAPE_COORDS_INT3_T *min, SHAPE_COORDS_INT3_T
     }
 }
 
+void _light_compact_all(Shape *s) {
+    Index3DIterator *it = index3d_iterator_new(s->chunks);
+    while (index3d_iterator_pointer(it) != NULL) {
+        chunk_compact_lighting_data((Chunk *)index3d_iterator_pointer(it));
+        index3d_iterator_next(it);
+    }
+    index3d_iterator_free(it);
+}
+
+// direct neighbors, in the order they are processed during propagation
+static const SHAPE_COORDS_INT3_T _lightDirections[6] = {{0, -1, 0},
+                                                        {0, 1, 0},
+                                                        {1, 0, 0},
+                                                        {-1, 0, 0},
+                                                        {0, 0, 1},
+                                                        {0, 0, -1}};
+
+void _light_apply_batch(Shape *s, Index3D *changes) {
+    LightNodeQueue *lightQueue = light_node_queue_new();
+    LightRemovalNodeQueue *lightRemovalQueue = light_removal_node_queue_new();
+
+    // changed values bounding box need to include all changed blocks
+    SHAPE_COORDS_INT3_T min, max;
+
+    if (_light_batch_seed_removal(s, changes, lightRemovalQueue, lightQueue, &min, &max)) {
+        // one light removal pass for all changes
+        _light_removal(s, &min, &max, lightRemovalQueue, lightQueue);
+
+        _light_batch_seed_propagation(s, changes, lightQueue);
+
+        // one light propagation pass for all changes
+        _light_propagate(s, &min, &max, lightQueue, min.x, min.y, min.z, false);
+    }
+
+    light_removal_node_queue_free(lightRemovalQueue);
+    light_node_queue_free(lightQueue);
+}
+
+bool _light_batch_seed_removal(Shape *s,
+                               Index3D *changes,
+                               LightRemovalNodeQueue *lightRemovalQueue,
+                               LightNodeQueue *lightQueue,
+                               SHAPE_COORDS_INT3_T *bbMin,
+                               SHAPE_COORDS_INT3_T *bbMax) {
+    bool init = true;
+
+    _LightingBatchChange *change;
+    Chunk *c, *insertChunk;
+    CHUNK_COORDS_INT3_T coords_in_chunk;
+    SHAPE_COORDS_INT3_T coords_in_shape;
+    SHAPE_COLOR_INDEX_INT_T after;
+    VERTEX_LIGHT_STRUCT_T existingLight, newLight, light;
+    const Block *block;
+
+    // each block is seeded like in the matching shape_compute_baked_lighting_*_block function
+    Index3DIterator *it = index3d_iterator_new(changes);
+    while (index3d_iterator_pointer(it) != NULL) {
+        change = (_LightingBatchChange *)index3d_iterator_pointer(it);
+        index3d_iterator_next(it);
+
+        coords_in_shape = change->coords;
+        shape_get_chunk_and_coordinates(s, coords_in_shape, &c, NULL, &coords_in_chunk);
+        if (c == NULL) {
+            continue;
+        }
+        block = chunk_get_block(c, coords_in_chunk.x, coords_in_chunk.y, coords_in_chunk.z);
+        after = block != NULL ? block->colorIndex : SHAPE_COLOR_INDEX_AIR_BLOCK;
+
+        existingLight = chunk_get_light_without_checking(c, coords_in_chunk);
+        newLight = color_palette_get_emissive_color_as_light(s->palette, after);
+
+        if (change->before == SHAPE_COLOR_INDEX_AIR_BLOCK && after == SHAPE_COLOR_INDEX_AIR_BLOCK) {
+            // block added & removed during the batch may have shaded its surroundings meanwhile
+            change->kind = LIGHTING_BATCH_CHANGE_ADDED_AND_REMOVED;
+
+            light_removal_node_queue_push(lightRemovalQueue,
+                                          c,
+                                          coords_in_shape,
+                                          existingLight,
+                                          15,
+                                          255);
+        } else if (change->before == after) {
+            continue;
+        } else if (change->before == SHAPE_COLOR_INDEX_AIR_BLOCK) {
+            change->kind = LIGHTING_BATCH_CHANGE_ADDED;
+
+            if (newLight.red > 0 || newLight.green > 0 || newLight.blue > 0) {
+                light_node_queue_push(lightQueue, c, coords_in_shape);
+                chunk_set_light(c, coords_in_chunk, newLight, false);
+            }
+
+            light_removal_node_queue_push(lightRemovalQueue,
+                                          c,
+                                          coords_in_shape,
+                                          existingLight,
+                                          15,
+                                          255);
+
+            for (CHUNK_COORDS_INT_T xo = -1; xo <= 1; ++xo) {
+                for (CHUNK_COORDS_INT_T yo = -1; yo <= 1; ++yo) {
+                    for (CHUNK_COORDS_INT_T zo = -1; zo <= 1; ++zo) {
+                        if (xo == 0 && yo == 0 && zo == 0) {
+                            continue;
+                        }
+                        block = chunk_get_block_including_neighbors(c,
+                                                                    coords_in_chunk.x + xo,
+                                                                    coords_in_chunk.y + yo,
+                                                                    coords_in_chunk.z + zo,
+                                                                    &insertChunk,
+                                                                    NULL);
+                        if (block != NULL &&
+                            color_palette_is_emissive(s->palette, block->colorIndex)) {
+                            light = color_palette_get_emissive_color_as_light(s->palette,
+                                                                              block->colorIndex);
+                            light_removal_node_queue_push(
+                                lightRemovalQueue,
+                                insertChunk,
+                                (SHAPE_COORDS_INT3_T){
+                                    (SHAPE_COORDS_INT_T)(coords_in_shape.x + xo),
+                                    (SHAPE_COORDS_INT_T)(coords_in_shape.y + yo),
+                                    (SHAPE_COORDS_INT_T)(coords_in_shape.z + zo)},
+                                light,
+                                15,
+                                block->colorIndex);
+                        }
+                    }
+                }
+            }
+        } else {
+            if (after == SHAPE_COLOR_INDEX_AIR_BLOCK) {
+                change->kind = LIGHTING_BATCH_CHANGE_REMOVED;
+            } else if (existingLight.red != newLight.red || existingLight.green != newLight.green ||
+                       existingLight.blue != newLight.blue) {
+                change->kind = LIGHTING_BATCH_CHANGE_REPLACED;
+            } else {
+                continue;
+            }
+
+            if (existingLight.red > 0 || existingLight.green > 0 || existingLight.blue > 0) {
+                light_removal_node_queue_push(lightRemovalQueue,
+                                              c,
+                                              coords_in_shape,
+                                              existingLight,
+                                              15,
+                                              change->kind == LIGHTING_BATCH_CHANGE_REMOVED
+                                                  ? change->before
+                                                  : after);
+            }
+        }
+
+        if (init) {
+            *bbMin = *bbMax = coords_in_shape;
+            init = false;
+        } else {
+            _lighting_set_dirty(bbMin, bbMax, coords_in_shape);
+        }
+    }
+
+    index3d_iterator_free(it);
+
+    return init == false;
+}
+
+void _light_batch_seed_propagation(Shape *s, Index3D *changes, LightNodeQueue *lightQueue) {
+    _LightingBatchChange *change;
+    Chunk *c, *insertChunk;
+    CHUNK_COORDS_INT3_T coords_in_chunk;
+    SHAPE_COORDS_INT3_T coords_in_shape;
+    VERTEX_LIGHT_STRUCT_T newLight;
+    const Block *block;
+
+    // removed blocks' neighbors & replaced blocks' new emission
+    VERTEX_LIGHT_STRUCT_T zero;
+    ZERO_LIGHT(zero)
+    Index3DIterator *it = index3d_iterator_new(changes);
+    while (index3d_iterator_pointer(it) != NULL) {
+        change = (_LightingBatchChange *)index3d_iterator_pointer(it);
+        index3d_iterator_next(it);
+
+        if (change->kind == LIGHTING_BATCH_CHANGE_NONE ||
+            change->kind == LIGHTING_BATCH_CHANGE_ADDED) {
+            continue;
+        }
+        coords_in_shape = change->coords;
+        shape_get_chunk_and_coordinates(s, coords_in_shape, &c, NULL, &coords_in_chunk);
+
+        if (change->kind != LIGHTING_BATCH_CHANGE_REPLACED) {
+            for (int i = 0; i < 6; ++i) {
+                const SHAPE_COORDS_INT3_T insertCoords = {
+                    (SHAPE_COORDS_INT_T)(coords_in_shape.x + _lightDirections[i].x),
+                    (SHAPE_COORDS_INT_T)(coords_in_shape.y + _lightDirections[i].y),
+                    (SHAPE_COORDS_INT_T)(coords_in_shape.z + _lightDirections[i].z)};
+                shape_get_chunk_and_coordinates(s, insertCoords, &insertChunk, NULL, NULL);
+                light_node_queue_push(lightQueue, insertChunk, insertCoords);
+            }
+            chunk_set_light(c, coords_in_chunk, zero, false);
+        } else {
+            block = chunk_get_block(c, coords_in_chunk.x, coords_in_chunk.y, coords_in_chunk.z);
+            newLight = color_palette_get_emissive_color_as_light(s->palette, block->colorIndex);
+            if (newLight.red > 0 || newLight.green > 0 || newLight.blue > 0) {
+                light_node_queue_push(lightQueue, c, coords_in_shape);
+                chunk_set_light(c, coords_in_chunk, newLight, false);
+            } else {
+                chunk_set_light(c, coords_in_chunk, zero, false);
+            }
+        }
+    }
+    index3d_iterator_free(it);
+}
+
+// MARK: - Baked lighting, sunlight columns -
+//
+// Sunlight falls straight down through air w/o losing intensity, so blocks directly under the sky
+// are lit before propagation, one column of chunks at a time: its 16x16 (x, z) columns are a
+// 256-bit mask of those still sunlit, narrowed down plane by plane w/ 64-bit word operations.
+// Only sunlit blocks next to unlit ones then need to go through propagation.
+
+// one 16-bit row of z values per x, 4 rows per word (CHUNK_SIZE is 16)
+#define SUNLIGHT_MASK_WORDS 4
+#define SUNLIGHT_ROW_SHIFT(x) (((x) & 3) * CHUNK_SIZE)
+
+static uint16_t _light_sunlight_row(const uint64_t *mask, CHUNK_COORDS_INT_T x) {
+    return (uint16_t)(mask[x >> 2] >> SUNLIGHT_ROW_SHIFT(x));
+}
+
+static bool _light_sunlight_any(const uint64_t *mask) {
+    return (mask[0] | mask[1] | mask[2] | mask[3]) != 0;
+}
+
+static bool _light_sunlight_full(const uint64_t *mask) {
+    return (mask[0] & mask[1] & mask[2] & mask[3]) == UINT64_MAX;
+}
+
+size_t _light_sun_floor_index(SHAPE_COORDS_INT3_T min,
+                              SHAPE_COORDS_INT3_T max,
+                              SHAPE_COORDS_INT_T x,
+                              SHAPE_COORDS_INT_T z) {
+    return (size_t)(x - min.x + 1) * (size_t)(max.z - min.z + 2) + (size_t)(z - min.z + 1);
+}
+
+void _light_sunlight_chunk_column(Shape *s,
+                                  SHAPE_COORDS_INT3_T min,
+                                  SHAPE_COORDS_INT3_T max,
+                                  SHAPE_COORDS_INT_T chunkX,
+                                  SHAPE_COORDS_INT_T chunkZ,
+                                  SHAPE_COORDS_INT_T *sunFloors) {
+    const SHAPE_COORDS_INT_T originX = (SHAPE_COORDS_INT_T)(chunkX * CHUNK_SIZE);
+    const SHAPE_COORDS_INT_T originZ = (SHAPE_COORDS_INT_T)(chunkZ * CHUNK_SIZE);
+
+    // columns within lighting bounds, sunlit from the top until shadowed
+    uint16_t rowInBounds = 0;
+    for (CHUNK_COORDS_INT_T z = 0; z < CHUNK_SIZE; ++z) {
+        if (originZ + z >= min.z - 1 && originZ + z <= max.z) {
+            rowInBounds |= (uint16_t)(1 << z);
+        }
+    }
+    uint64_t sunlit[SUNLIGHT_MASK_WORDS] = {0, 0, 0, 0};
+    for (CHUNK_COORDS_INT_T x = 0; x < CHUNK_SIZE; ++x) {
+        if (originX + x >= min.x - 1 && originX + x <= max.x) {
+            sunlit[x >> 2] |= (uint64_t)rowInBounds << SUNLIGHT_ROW_SHIFT(x);
+        }
+    }
+
+    VERTEX_LIGHT_STRUCT_T sunlight;
+    DEFAULT_LIGHT(sunlight)
+
+    const SHAPE_COORDS_INT_T chunkMinY = chunk_utils_get_coords(min).y;
+    SHAPE_COORDS_INT_T chunkY = chunk_utils_get_coords(
+                                    (SHAPE_COORDS_INT3_T){originX,
+                                                          (SHAPE_COORDS_INT_T)(max.y - 1),
+                                                          originZ})
+                                    .y;
+    for (; chunkY >= chunkMinY && _light_sunlight_any(sunlit); --chunkY) {
+        Chunk *c = (Chunk *)index3d_get(s->chunks, chunkX, chunkY, chunkZ);
+        if (c == NULL) {
+            continue; // sunlight goes through missing chunks
+        }
+        if (chunk_get_nb_blocks(c) == 0 && _light_sunlight_full(sunlit)) {
+            chunk_reset_lighting_data(c, false);
+            continue;
+        }
+
+        // only blocks within chunk bounding box can shadow a column
+        CHUNK_COORDS_INT3_T bbMin, bbMax;
+        chunk_get_bounding_box_2(c, &bbMin, &bbMax);
+        uint16_t rowInBox = 0;
+        for (CHUNK_COORDS_INT_T z = bbMin.z; z < bbMax.z; ++z) {
+            rowInBox |= (uint16_t)(1 << z);
+        }
+
+        for (CHUNK_COORDS_INT_T y = CHUNK_SIZE_MINUS_ONE; y >= 0; --y) {
+            const SHAPE_COORDS_INT_T sy = (SHAPE_COORDS_INT_T)(chunkY * CHUNK_SIZE + y);
+
+            if (y >= bbMin.y && y < bbMax.y) {
+                for (CHUNK_COORDS_INT_T x = bbMin.x; x < bbMax.x; ++x) {
+                    const uint16_t row = _light_sunlight_row(sunlit, x) & rowInBox;
+                    if (row == 0) {
+                        continue;
+                    }
+                    uint16_t shadowed = 0;
+                    for (CHUNK_COORDS_INT_T z = bbMin.z; z < bbMax.z; ++z) {
+                        if ((row >> z & 1) == 0) {
+                            continue;
+                        }
+                        const Block *b = chunk_get_block(c, x, y, z);
+                        if (b->colorIndex != SHAPE_COLOR_INDEX_AIR_BLOCK) {
+                            shadowed |= (uint16_t)(1 << z);
+                            sunFloors[_light_sun_floor_index(
+                                min,
+                                max,
+                                (SHAPE_COORDS_INT_T)(originX + x),
+                                (SHAPE_COORDS_INT_T)(originZ + z))] = (SHAPE_COORDS_INT_T)(sy + 1);
+                        }
+                    }
+                    sunlit[x >> 2] &= ~((uint64_t)shadowed << SUNLIGHT_ROW_SHIFT(x));
+                }
+                if (_light_sunlight_any(sunlit) == false) {
+                    break;
+                }
+            }
+
+            for (CHUNK_COORDS_INT_T x = 0; x < CHUNK_SIZE; ++x) {
+                const uint16_t row = _light_sunlight_row(sunlit, x);
+                for (CHUNK_COORDS_INT_T z = 0; row != 0 && z < CHUNK_SIZE; ++z) {
+                    if (row >> z & 1) {
+                        chunk_set_light(c, (CHUNK_COORDS_INT3_T){x, y, z}, sunlight, true);
+                    }
+                }
+            }
+        }
+    }
+
+    // columns sunlit all the way down
+    for (CHUNK_COORDS_INT_T x = 0; x < CHUNK_SIZE; ++x) {
+        const uint16_t row = _light_sunlight_row(sunlit, x);
+        for (CHUNK_COORDS_INT_T z = 0; row != 0 && z < CHUNK_SIZE; ++z) {
+            if (row >> z & 1) {
+                sunFloors[_light_sun_floor_index(min,
+                                                 max,
+                                                 (SHAPE_COORDS_INT_T)(originX + x),
+                                                 (SHAPE_COORDS_INT_T)(originZ + z))] = min.y;
+            }
+        }
+    }
+}
+
+SHAPE_COORDS_INT_T _light_sunlight_seed_top(SHAPE_COORDS_INT3_T min,
+                                            SHAPE_COORDS_INT3_T max,
+                                            const SHAPE_COORDS_INT_T *sunFloors,
+                                            SHAPE_COORDS_INT_T x,
+                                            SHAPE_COORDS_INT_T z) {
+    // bottom sunlit block, and any block next to an unlit neighbor
+    SHAPE_COORDS_INT_T top = sunFloors[_light_sun_floor_index(min, max, x, z)];
+    for (int i = 2; i < 6; ++i) {
+        const SHAPE_COORDS_INT_T nx = (SHAPE_COORDS_INT_T)(x + _lightDirections[i].x);
+        const SHAPE_COORDS_INT_T nz = (SHAPE_COORDS_INT_T)(z + _lightDirections[i].z);
+        if (nx < min.x - 1 || nx > max.x || nz < min.z - 1 || nz > max.z) {
+            continue;
+        }
+        const SHAPE_COORDS_INT_T neighborFloor = sunFloors[
+            _light_sun_floor_index(min, max, nx, nz)];
+        top = maximum(top, (SHAPE_COORDS_INT_T)(neighborFloor - 1));
+    }
+    return top;
+}
+
+bool _light_sunlight_through_top(Shape *s,
+                                 SHAPE_COORDS_INT3_T max,
+                                 SHAPE_COORDS_INT_T x,
+                                 SHAPE_COORDS_INT_T z) {
+    Chunk *chunk;
+    CHUNK_COORDS_INT3_T cc;
+    shape_get_chunk_and_coordinates(s,
+                                    (SHAPE_COORDS_INT3_T){x, (SHAPE_COORDS_INT_T)(max.y - 1), z},
+                                    &chunk,
+                                    NULL,
+                                    &cc);
+    const Block *b = chunk_get_block_2(chunk, cc);
+    return b != NULL && color_palette_is_transparent(s->palette, b->colorIndex);
+}
+
+void _light_enqueue_sunlight_borders(Shape *s,
+                                     LightNodeQueue *q,
+                                     SHAPE_COORDS_INT3_T min,
+                                     SHAPE_COORDS_INT3_T max,
+                                     const SHAPE_COORDS_INT_T *sunFloors) {
+    Chunk *chunk = NULL;
+    SHAPE_COORDS_INT3_T cs;
+    for (SHAPE_COORDS_INT_T x = (SHAPE_COORDS_INT_T)(min.x - 1); x <= max.x; ++x) {
+        for (SHAPE_COORDS_INT_T z = (SHAPE_COORDS_INT_T)(min.z - 1); z <= max.z; ++z) {
+            const SHAPE_COORDS_INT_T sunFloor = sunFloors[_light_sun_floor_index(min, max, x, z)];
+            if (sunFloor >= max.y) {
+                if (_light_sunlight_through_top(s, max, x, z)) {
+                    light_node_queue_push(q, NULL, (SHAPE_COORDS_INT3_T){x, max.y, z});
+                }
+                continue;
+            }
+
+            // propagation goes down runs of missing chunks from their top block
+            bool inMissingRun = false;
+            const SHAPE_COORDS_INT_T top = _light_sunlight_seed_top(min, max, sunFloors, x, z);
+            for (SHAPE_COORDS_INT_T y = top; y >= sunFloor; --y) {
+                cs = (SHAPE_COORDS_INT3_T){x, y, z};
+                if (y == top || chunk_utils_get_coords_in_chunk(cs).y == CHUNK_SIZE_MINUS_ONE) {
+                    shape_get_chunk_and_coordinates(s, cs, &chunk, NULL, NULL);
+                }
+                if (chunk == NULL) {
+                    if (inMissingRun == false) {
+                        light_node_queue_push(q, NULL, cs);
+                        inMissingRun = true;
+                    }
+                } else {
+                    light_node_queue_push(q, chunk, cs);
+                    inMissingRun = false;
+                }
+            }
+        }
+    }
+}
+
+bool _light_sunlight_columns(Shape *s,
+                             LightNodeQueue *q,
+                             SHAPE_COORDS_INT3_T min,
+                             SHAPE_COORDS_INT3_T max) {
+    SHAPE_COORDS_INT_T *sunFloors = (SHAPE_COORDS_INT_T *)malloc(
+        (size_t)(max.x - min.x + 2) * (size_t)(max.z - min.z + 2) * sizeof(SHAPE_COORDS_INT_T));
+    if (sunFloors == NULL) {
+        return false;
+    }
+
+    const SHAPE_COORDS_INT3_T chunkMin = chunk_utils_get_coords(
+        (SHAPE_COORDS_INT3_T){(SHAPE_COORDS_INT_T)(min.x - 1),
+                              min.y,
+                              (SHAPE_COORDS_INT_T)(min.z - 1)});
+    const SHAPE_COORDS_INT3_T chunkMax = chunk_utils_get_coords(max);
+    for (SHAPE_COORDS_INT_T x = chunkMin.x; x <= chunkMax.x; ++x) {
+        for (SHAPE_COORDS_INT_T z = chunkMin.z; z <= chunkMax.z; ++z) {
+            _light_sunlight_chunk_column(s, min, max, x, z, sunFloors);
+        }
+    }
+    _light_enqueue_sunlight_borders(s, q, min, max, sunFloors);
+
+    free(sunFloors);
+    return true;
+}
+
+// MARK: - Baked lighting, parallel computation -
+//
+// Full shape lighting, computed in square regions of chunk columns (along x & z). A region is
+// processed by one job at a time, and only ever writes light values of its own blocks:
+// 1) sunlight columns: each region lights blocks directly under the sky, see above,
+// 2) propagation: each region floods light from its sources w/ its own node queue, light
+// reaching a block of another region is posted to that region & delivered on next pass, until
+// no region has anything left to process.
+// Light values can only be raised during propagation, so the result doesn't depend on processing
+// order and is identical to _light_propagate's.
+
+typedef struct _LightParallel _LightParallel;
+
+typedef struct {
+    Chunk *chunk;
+    SHAPE_COORDS_INT3_T coords;
+    VERTEX_LIGHT_STRUCT_T light;
+    bool overwrite; // emissive block storing its own emission, instead of raising values
+    char pad[5];
+} _LightRegionMessage;
+
+typedef struct {
+    _LightRegionMessage *messages;
+    size_t count;
+    size_t capacity;
+} _LightRegionOutbox;
+
+typedef struct {
+    _LightParallel *lp;
+
+    // nodes to process, chunk is NULL for cells outside of any chunk (sunlit)
+    LightNodeQueue *queue;
+
+    // messages for the 8 neighbor regions, index (dx + 1) * 3 + (dz + 1), double-buffered:
+    // written during a pass, read by neighbors during the next one
+    _LightRegionOutbox outboxes[2][9];
+
+    // one bit per (x, z, chunk y), set once a run of missing chunks has been lit from its top
+    uint8_t *sunlitRuns;
+
+    // region columns, inclusive, clamped to lighting bounds
+    SHAPE_COORDS_INT_T minX, minZ, maxX, maxZ;
+    // first column covered by the region, not clamped
+    SHAPE_COORDS_INT_T originX, originZ;
+
+    int rx, rz;
+} _LightRegion;
+
+struct _LightParallel {
+    Shape *shape;
+    _LightRegion *regions;
+    // lowest sunlit y of each (x, z) column, max.y if none
+    SHAPE_COORDS_INT_T *sunFloors;
+    // lighting bounds: blocks within [min, max[, sunlit columns within [min - 1, max] (x & z)
+    SHAPE_COORDS_INT3_T min, max;
+    int nbRegionsX, nbRegionsZ;
+    int chunkMinY, nbChunksY;
+    uint32_t pass; // outboxes[pass & 1] are written during current pass
+};
+
+static SHAPE_COORDS_INT_T *_light_parallel_sun_floor(_LightParallel *lp,
+                                                      SHAPE_COORDS_INT_T x,
+                                                      SHAPE_COORDS_INT_T z) {
+    return &lp->sunFloors[_light_sun_floor_index(lp->min, lp->max, x, z)];
+}
+
+static bool _light_region_owns(const _LightRegion *r, SHAPE_COORDS_INT3_T coords) {
+    return coords.x >= r->minX && coords.x <= r->maxX && coords.z >= r->minZ &&
+           coords.z <= r->maxZ;
+}
+
+static void _light_region_post(_LightRegion *r,
+                               Chunk *chunk,
+                               SHAPE_COORDS_INT3_T coords,
+                               VERTEX_LIGHT_STRUCT_T light,
+                               bool overwrite) {
+    const int dx = coords.x < r->minX ? 0 : (coords.x > r->maxX ? 2 : 1);
+    const int dz = coords.z < r->minZ ? 0 : (coords.z > r->maxZ ? 2 : 1);
+    _LightRegionOutbox *o = &r->outboxes[r->lp->pass & 1][dx * 3 + dz];
+
+    if (o->count == o->capacity) {
+        const size_t capacity = o->capacity > 0 ? o->capacity * 2 : 256;
+        _LightRegionMessage *messages = (_LightRegionMessage *)
+            realloc(o->messages, capacity * sizeof(_LightRegionMessage));
+        if (messages == NULL) {
+            cclog_error("🔥 can't post light to neighbor region");
+            return;
+        }
+        o->messages = messages;
+        o->capacity = capacity;
+    }
+    _LightRegionMessage *m = &o->messages[o->count++];
+    m->chunk = chunk;
+    m->coords = coords;
+    m->light = light;
+    m->overwrite = overwrite;
+}
+
+/// Raises light of a non-opaque block & enqueues it, or posts it to the region owning the block
+static void _light_region_raise(_LightRegion *r,
+                                Chunk *chunk,
+                                CHUNK_COORDS_INT3_T coords_in_chunk,
+                                SHAPE_COORDS_INT3_T coords_in_shape,
+                                VERTEX_LIGHT_STRUCT_T light) {
+    if (_light_region_owns(r, coords_in_shape) == false) {
+        _light_region_post(r, chunk, coords_in_shape, light, false);
+        return;
+    }
+    VERTEX_LIGHT_STRUCT_T current = chunk_get_light_without_checking(chunk, coords_in_chunk);
+    if (_light_raise(&current, light)) {
+        chunk_set_light(chunk, coords_in_chunk, current, true);
+        light_node_queue_push(r->queue, chunk, coords_in_shape);
+    }
+}
+
+/// Stores emission of an emissive block & enqueues it, or posts it to the region owning the block
+static void _light_region_overwrite(_LightRegion *r,
+                                    Chunk *chunk,
+                                    CHUNK_COORDS_INT3_T coords_in_chunk,
+                                    SHAPE_COORDS_INT3_T coords_in_shape,
+                                    VERTEX_LIGHT_STRUCT_T light) {
+    if (_light_region_owns(r, coords_in_shape) == false) {
+        _light_region_post(r, chunk, coords_in_shape, light, true);
+        return;
+    }
+    chunk_set_light(chunk, coords_in_chunk, light, true);
+    light_node_queue_push(r->queue, chunk, coords_in_shape);
+}
+
+/// Same as _light_block_propagate
+static void _light_region_propagate_to(_LightRegion *r,
+                                       VERTEX_LIGHT_STRUCT_T current,
+                                       const Block *neighbor,
+                                       Chunk *chunk,
+                                       CHUNK_COORDS_INT3_T coords_in_chunk,
+                                       SHAPE_COORDS_INT3_T coords_in_shape,
+                                       uint8_t stepS) {
+    const ColorPalette *palette = r->lp->shape->palette;
+    const bool air = neighbor->colorIndex == SHAPE_COLOR_INDEX_AIR_BLOCK;
+    const bool transparent = color_palette_is_transparent(palette, neighbor->colorIndex);
+    if (air || transparent) {
+        _light_region_raise(r,
+                            chunk,
+                            coords_in_chunk,
+                            coords_in_shape,
+                            _light_get_propagated(r->lp->shape,
+                                                  current,
+                                                  neighbor,
+                                                  transparent,
+                                                  stepS,
+                                                  EMISSION_PROPAGATION_STEP));
+    } else if (color_palette_is_emissive(palette, neighbor->colorIndex)) {
+        _light_region_overwrite(
+            r,
+            chunk,
+            coords_in_chunk,
+            coords_in_shape,
+            color_palette_get_emissive_color_as_light(palette, neighbor->colorIndex));
+    }
+}
+
+/// A cell outside of any chunk acts as a sunlight source for its neighbors in existing chunks
+static void _light_region_process_sunlit(_LightRegion *r, SHAPE_COORDS_INT3_T coords) {
+    VERTEX_LIGHT_STRUCT_T light;
+    DEFAULT_LIGHT(light)
+
+    const CHUNK_COORDS_INT3_T coords_in_chunk = chunk_utils_get_coords_in_chunk(coords);
+    Chunk *chunk;
+    CHUNK_COORDS_INT3_T cc;
+    SHAPE_COORDS_INT3_T cs;
+    for (int i = 0; i < 6; ++i) {
+        const SHAPE_COORDS_INT3_T d = _lightDirections[i];
+
+        // neighbor within the same (missing) chunk
+        if (coords_in_chunk.x + d.x >= 0 && coords_in_chunk.x + d.x < CHUNK_SIZE &&
+            coords_in_chunk.y + d.y >= 0 && coords_in_chunk.y + d.y < CHUNK_SIZE &&
+            coords_in_chunk.z + d.z >= 0 && coords_in_chunk.z + d.z < CHUNK_SIZE) {
+            continue;
+        }
+
+        cs = (SHAPE_COORDS_INT3_T){(SHAPE_COORDS_INT_T)(coords.x + d.x),
+                                   (SHAPE_COORDS_INT_T)(coords.y + d.y),
+                                   (SHAPE_COORDS_INT_T)(coords.z + d.z)};
+        shape_get_chunk_and_coordinates(r->lp->shape, cs, &chunk, NULL, &cc);
+        const Block *neighbor = chunk_get_block_2(chunk, cc);
+        if (neighbor != NULL) {
+            // sunlight propagates infinitely vertically (step = 0)
+            _light_region_propagate_to(r,
+                                       light,
+                                       neighbor,
+                                       chunk,
+                                       cc,
+                                       cs,
+                                       i == 0 ? 0 : SUNLIGHT_PROPAGATION_STEP);
+        }
+    }
+}
+
+/// A transparent block at the top of lighting bounds lets sunlight in from above, like ambient
+/// sources of _light_propagate
+static void _light_region_process_sunlit_top(_LightRegion *r,
+                                             SHAPE_COORDS_INT_T x,
+                                             SHAPE_COORDS_INT_T z) {
+    VERTEX_LIGHT_STRUCT_T light;
+    DEFAULT_LIGHT(light)
+
+    const SHAPE_COORDS_INT3_T cs = {x, (SHAPE_COORDS_INT_T)(r->lp->max.y - 1), z};
+    Chunk *chunk;
+    CHUNK_COORDS_INT3_T cc;
+    shape_get_chunk_and_coordinates(r->lp->shape, cs, &chunk, NULL, &cc);
+    const Block *b = chunk_get_block_2(chunk, cc);
+    if (b != NULL && color_palette_is_transparent(r->lp->shape->palette, b->colorIndex)) {
+        // sunlight propagates infinitely vertically (step = 0)
+        _light_region_propagate_to(r, light, b, chunk, cc, cs, 0);
+    }
+}
+
+/// Flags a run of missing chunks as lit, given its top cell, returns false if already lit
+static bool _light_region_mark_sunlit_run(_LightRegion *r, SHAPE_COORDS_INT3_T top) {
+    _LightParallel *lp = r->lp;
+    const int chunkY = chunk_utils_get_coords(top).y - lp->chunkMinY;
+    const size_t bit = ((size_t)(top.x - r->originX) * (size_t)(LIGHT_REGION_SIZE * CHUNK_SIZE) +
+                        (size_t)(top.z - r->originZ)) *
+                           (size_t)lp->nbChunksY +
+                       (size_t)chunkY;
+    const uint8_t mask = (uint8_t)(1 << (bit % 8));
+    if (r->sunlitRuns[bit / 8] & mask) {
+        return false;
+    }
+    r->sunlitRuns[bit / 8] |= mask;
+    return true;
+}
+
+/// Lights a run of missing chunks in one column, from top cell down to next existing chunk
+static void _light_region_light_missing_run(_LightRegion *r, SHAPE_COORDS_INT3_T top) {
+    _LightParallel *lp = r->lp;
+    if (top.y < lp->min.y || _light_region_mark_sunlit_run(r, top) == false) {
+        return;
+    }
+
+    SHAPE_COORDS_INT3_T cs = top;
+    while (cs.y >= lp->min.y) {
+        _light_region_process_sunlit(r, cs);
+
+        if (chunk_utils_get_coords_in_chunk(cs).y == 0) {
+            Chunk *below;
+            shape_get_chunk_and_coordinates(lp->shape,
+                                            (SHAPE_COORDS_INT3_T){cs.x,
+                                                                  (SHAPE_COORDS_INT_T)(cs.y - 1),
+                                                                  cs.z},
+                                            &below,
+                                            NULL,
+                                            NULL);
+            if (below != NULL) {
+                break;
+            }
+        }
+        cs.y--;
+    }
+}
+
+/// Same as _light_propagate's iteration, for a block in an existing chunk
+static void _light_region_process_block(_LightRegion *r,
+                                        Chunk *chunk,
+                                        SHAPE_COORDS_INT3_T coords_in_shape) {
+    const ColorPalette *palette = r->lp->shape->palette;
+    const CHUNK_COORDS_INT3_T coords_in_chunk = chunk_utils_get_coords_in_chunk(coords_in_shape);
+    const Block *current = chunk_get_block_2(chunk, coords_in_chunk);
+    if (current == NULL) {
+        return;
+    }
+
+    VERTEX_LIGHT_STRUCT_T currentLight = chunk_get_light_without_checking(chunk, coords_in_chunk);
+    const bool isCurrentAir = current->colorIndex == SHAPE_COLOR_INDEX_AIR_BLOCK;
+    const bool isCurrentTransparent = color_palette_is_transparent(palette, current->colorIndex);
+    bool isCurrentOpen = false;
+
+    Chunk *insertChunk;
+    CHUNK_COORDS_INT3_T cc;
+    SHAPE_COORDS_INT3_T cs;
+    for (int i = 0; i < 6; ++i) {
+        const SHAPE_COORDS_INT3_T d = _lightDirections[i];
+        cs = (SHAPE_COORDS_INT3_T){(SHAPE_COORDS_INT_T)(coords_in_shape.x + d.x),
+                                   (SHAPE_COORDS_INT_T)(coords_in_shape.y + d.y),
+                                   (SHAPE_COORDS_INT_T)(coords_in_shape.z + d.z)};
+        const Block *neighbor = chunk_get_block_including_neighbors(
+            chunk,
+            (CHUNK_COORDS_INT_T)(coords_in_chunk.x + d.x),
+            (CHUNK_COORDS_INT_T)(coords_in_chunk.y + d.y),
+            (CHUNK_COORDS_INT_T)(coords_in_chunk.z + d.z),
+            &insertChunk,
+            &cc);
+        if (neighbor == NULL) {
+            // sunlight comes through missing chunks below
+            if (i == 0) {
+                _light_region_light_missing_run(r, cs);
+            }
+            continue;
+        }
+
+        if (neighbor->colorIndex == SHAPE_COLOR_INDEX_AIR_BLOCK ||
+            color_palette_is_transparent(palette, neighbor->colorIndex)) {
+            isCurrentOpen = true;
+        }
+        if (isCurrentAir || isCurrentTransparent) {
+            _light_region_propagate_to(r,
+                                       currentLight,
+                                       neighbor,
+                                       insertChunk,
+                                       cc,
+                                       cs,
+                                       i == 0 ? 0 : SUNLIGHT_PROPAGATION_STEP);
+        }
+    }
+
+    // current node is a solid block with at least one face open, see _light_propagate
+    if (isCurrentAir == false && isCurrentOpen) {
+        currentLight = color_palette_get_emissive_color_as_light(palette, current->colorIndex);
+        if (currentLight.red == 0 && currentLight.green == 0 && currentLight.blue == 0) {
+            return;
+        }
+        for (CHUNK_COORDS_INT_T xo = -1; xo <= 1; xo++) {
+            for (CHUNK_COORDS_INT_T yo = -1; yo <= 1; yo++) {
+                for (CHUNK_COORDS_INT_T zo = -1; zo <= 1; zo++) {
+                    const Block *neighbor = chunk_get_block_including_neighbors(
+                        chunk,
+                        (CHUNK_COORDS_INT_T)(coords_in_chunk.x + xo),
+                        (CHUNK_COORDS_INT_T)(coords_in_chunk.y + yo),
+                        (CHUNK_COORDS_INT_T)(coords_in_chunk.z + zo),
+                        &insertChunk,
+                        &cc);
+                    if (neighbor != NULL && block_is_opaque(neighbor, palette) == false) {
+                        _light_region_raise(
+                            r,
+                            insertChunk,
+                            cc,
+                            (SHAPE_COORDS_INT3_T){(SHAPE_COORDS_INT_T)(coords_in_shape.x + xo),
+                                                  (SHAPE_COORDS_INT_T)(coords_in_shape.y + yo),
+                                                  (SHAPE_COORDS_INT_T)(coords_in_shape.z + zo)},
+                            currentLight);
+                    }
+                }
+            }
+        }
+    }
+}
+
+static void _light_region_flood(_LightRegion *r) {
+    LightNode n;
+    while (light_node_queue_pop(r->queue, &n)) {
+        if (n.chunk != NULL) {
+            _light_region_process_block(r, n.chunk, n.coords);
+        } else {
+            _light_region_process_sunlit(r, n.coords);
+        }
+    }
+}
+
+/// Job, 1st step: lights air blocks directly under the sky, one column of chunks at a time
+static void _light_region_sunlight_job(void *ptr) {
+    _LightRegion *r = (_LightRegion *)ptr;
+    _LightParallel *lp = r->lp;
+
+    const SHAPE_COORDS_INT3_T chunkMin = chunk_utils_get_coords(
+        (SHAPE_COORDS_INT3_T){r->minX, lp->min.y, r->minZ});
+    const SHAPE_COORDS_INT3_T chunkMax = chunk_utils_get_coords(
+        (SHAPE_COORDS_INT3_T){r->maxX, (SHAPE_COORDS_INT_T)(lp->max.y - 1), r->maxZ});
+    for (SHAPE_COORDS_INT_T cx = chunkMin.x; cx <= chunkMax.x; ++cx) {
+        for (SHAPE_COORDS_INT_T cz = chunkMin.z; cz <= chunkMax.z; ++cz) {
+            _light_sunlight_chunk_column(lp->shape, lp->min, lp->max, cx, cz, lp->sunFloors);
+
+            // sunlight goes through missing chunks, no need to light them again when
+            // propagating from the chunk above
+            const SHAPE_COORDS_INT_T originX = (SHAPE_COORDS_INT_T)(cx * CHUNK_SIZE);
+            const SHAPE_COORDS_INT_T originZ = (SHAPE_COORDS_INT_T)(cz * CHUNK_SIZE);
+            const SHAPE_COORDS_INT_T minX = maximum(r->minX, originX);
+            const SHAPE_COORDS_INT_T minZ = maximum(r->minZ, originZ);
+            const SHAPE_COORDS_INT_T maxX = minimum(r->maxX,
+                                                    (SHAPE_COORDS_INT_T)(originX +
+                                                                         CHUNK_SIZE_MINUS_ONE));
+            const SHAPE_COORDS_INT_T maxZ = minimum(r->maxZ,
+                                                    (SHAPE_COORDS_INT_T)(originZ +
+                                                                         CHUNK_SIZE_MINUS_ONE));
+            for (SHAPE_COORDS_INT_T cy = chunkMax.y; cy >= chunkMin.y; --cy) {
+                if (index3d_get(lp->shape->chunks, cx, cy, cz) != NULL) {
+                    continue;
+                }
+                const SHAPE_COORDS_INT_T top = (SHAPE_COORDS_INT_T)(cy * CHUNK_SIZE +
+                                                                    CHUNK_SIZE_MINUS_ONE);
+                for (SHAPE_COORDS_INT_T x = minX; x <= maxX; ++x) {
+                    for (SHAPE_COORDS_INT_T z = minZ; z <= maxZ; ++z) {
+                        if (*_light_parallel_sun_floor(lp, x, z) <= top) {
+                            _light_region_mark_sunlit_run(r, (SHAPE_COORDS_INT3_T){x, top, z});
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+/// Job, 2nd step: enqueues sunlit cells next to unlit ones & emissive blocks, then floods
+static void _light_region_seed_job(void *ptr) {
+    _LightRegion *r = (_LightRegion *)ptr;
+    _LightParallel *lp = r->lp;
+
+    // sunlit cells only need to propagate where neighbor columns aren't lit as well
+    Chunk *chunk = NULL;
+    SHAPE_COORDS_INT3_T cs;
+    for (SHAPE_COORDS_INT_T x = r->minX; x <= r->maxX; ++x) {
+        for (SHAPE_COORDS_INT_T z = r->minZ; z <= r->maxZ; ++z) {
+            const SHAPE_COORDS_INT_T sunFloor = *_light_parallel_sun_floor(lp, x, z);
+            if (sunFloor >= lp->max.y) {
+                _light_region_process_sunlit_top(r, x, z);
+                continue;
+            }
+
+            const SHAPE_COORDS_INT_T top = _light_sunlight_seed_top(lp->min,
+                                                                    lp->max,
+                                                                    lp->sunFloors,
+                                                                    x,
+                                                                    z);
+
+            for (SHAPE_COORDS_INT_T y = sunFloor; y <= top; ++y) {
+                cs = (SHAPE_COORDS_INT3_T){x, y, z};
+                if (y == sunFloor || chunk_utils_get_coords_in_chunk(cs).y == 0) {
+                    shape_get_chunk_and_coordinates(lp->shape, cs, &chunk, NULL, NULL);
+                }
+                light_node_queue_push(r->queue, chunk, cs);
+            }
+        }
+    }
+
+    // emissive blocks
+    const ColorPalette *palette = lp->shape->palette;
+    const SHAPE_COORDS_INT3_T chunkMin = chunk_utils_get_coords(
+        (SHAPE_COORDS_INT3_T){r->minX, lp->min.y, r->minZ});
+    const SHAPE_COORDS_INT3_T chunkMax = chunk_utils_get_coords(
+        (SHAPE_COORDS_INT3_T){r->maxX, (SHAPE_COORDS_INT_T)(lp->max.y - 1), r->maxZ});
+    for (SHAPE_COORDS_INT_T x = chunkMin.x; x <= chunkMax.x; ++x) {
+        for (SHAPE_COORDS_INT_T y = chunkMin.y; y <= chunkMax.y; ++y) {
+            for (SHAPE_COORDS_INT_T z = chunkMin.z; z <= chunkMax.z; ++z) {
+                chunk = (Chunk *)index3d_get(lp->shape->chunks, x, y, z);
+                if (chunk == NULL) {
+                    continue;
+                }
+                for (CHUNK_COORDS_INT_T cx = 0; cx < CHUNK_SIZE; ++cx) {
+                    for (CHUNK_COORDS_INT_T cy = 0; cy < CHUNK_SIZE; ++cy) {
+                        for (CHUNK_COORDS_INT_T cz = 0; cz < CHUNK_SIZE; ++cz) {
+                            const Block *b = chunk_get_block(chunk, cx, cy, cz);
+                            if (b != NULL && color_palette_is_emissive(palette, b->colorIndex)) {
+                                light_node_queue_push(
+                                    r->queue,
+                                    chunk,
+                                    (SHAPE_COORDS_INT3_T){
+                                        (SHAPE_COORDS_INT_T)(x * CHUNK_SIZE + cx),
+                                        (SHAPE_COORDS_INT_T)(y * CHUNK_SIZE + cy),
+                                        (SHAPE_COORDS_INT_T)(z * CHUNK_SIZE + cz)});
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    _light_region_flood(r);
+}
+
+static _LightRegion *_light_parallel_get_region(_LightParallel *lp, int rx, int rz) {
+    if (rx < 0 || rx >= lp->nbRegionsX || rz < 0 || rz >= lp->nbRegionsZ) {
+        return NULL;
+    }
+    return &lp->regions[rx * lp->nbRegionsZ + rz];
+}
+
+/// Neighbor's outbox containing messages for given region, posted during previous pass
+static _LightRegionOutbox *_light_region_get_inbox(_LightRegion *r, int dx, int dz) {
+    _LightRegion *n = _light_parallel_get_region(r->lp, r->rx + dx, r->rz + dz);
+    if (n == NULL) {
+        return NULL;
+    }
+    return &n->outboxes[(r->lp->pass - 1) & 1][(1 - dx) * 3 + (1 - dz)];
+}
+
+/// Job, 3rd step (repeated): applies light posted by neighbor regions, then floods
+static void _light_region_pass_job(void *ptr) {
+    _LightRegion *r = (_LightRegion *)ptr;
+
+    for (int dx = -1; dx <= 1; ++dx) {
+        for (int dz = -1; dz <= 1; ++dz) {
+            const _LightRegionOutbox *inbox = _light_region_get_inbox(r, dx, dz);
+            if ((dx == 0 && dz == 0) || inbox == NULL) {
+                continue;
+            }
+            for (size_t i = 0; i < inbox->count; ++i) {
+                const _LightRegionMessage *m = &inbox->messages[i];
+                const CHUNK_COORDS_INT3_T cc = chunk_utils_get_coords_in_chunk(m->coords);
+                if (m->overwrite) {
+                    _light_region_overwrite(r, m->chunk, cc, m->coords, m->light);
+                } else {
+                    _light_region_raise(r, m->chunk, cc, m->coords, m->light);
+                }
+            }
+        }
+    }
+
+    _light_region_flood(r);
+}
+
+/// Runs job for each region, or for scheduled ones only if not NULL
+static void _light_parallel_run(_LightParallel *lp,
+                                ThreadPool *pool,
+                                thread_pool_job_func job,
+                                const bool *scheduled) {
+    const int nbRegions = lp->nbRegionsX * lp->nbRegionsZ;
+    ThreadPoolBatch *b = thread_pool_batch_new(pool);
+    for (int i = 0; i < nbRegions; ++i) {
+        if (scheduled != NULL && scheduled[i] == false) {
+            continue;
+        }
+        if (b != NULL) {
+            thread_pool_batch_add_job(b, job, &lp->regions[i]);
+        } else {
+            job(&lp->regions[i]);
+        }
+    }
+    thread_pool_batch_wait_and_free(b);
+}
+
+bool _light_propagate_parallel(Shape *s,
+                               ThreadPool *pool,
+                               SHAPE_COORDS_INT3_T min,
+                               SHAPE_COORDS_INT3_T max) {
+    if (s->nbChunks == 0) {
+        return true;
+    }
+
+    _LightParallel lp;
+    lp.shape = s;
+    lp.min = min;
+    lp.max = max;
+    lp.pass = 0;
+
+    const SHAPE_COORDS_INT3_T chunkMin = chunk_utils_get_coords(
+        (SHAPE_COORDS_INT3_T){(SHAPE_COORDS_INT_T)(min.x - 1),
+                              min.y,
+                              (SHAPE_COORDS_INT_T)(min.z - 1)});
+    const SHAPE_COORDS_INT3_T chunkMax = chunk_utils_get_coords(max);
+    lp.chunkMinY = chunkMin.y;
+    lp.nbChunksY = (max.y - min.y) / CHUNK_SIZE;
+    lp.nbRegionsX = (chunkMax.x - chunkMin.x) / LIGHT_REGION_SIZE + 1;
+    lp.nbRegionsZ = (chunkMax.z - chunkMin.z) / LIGHT_REGION_SIZE + 1;
+
+    const int nbRegions = lp.nbRegionsX * lp.nbRegionsZ;
+    const size_t sunlitRunsSize = ((size_t)(LIGHT_REGION_SIZE * CHUNK_SIZE) *
+                                       (size_t)(LIGHT_REGION_SIZE * CHUNK_SIZE) *
+                                       (size_t)lp.nbChunksY +
+                                   7) /
+                                  8;
+
+    lp.sunFloors = (SHAPE_COORDS_INT_T *)malloc((size_t)(max.x - min.x + 2) *
+                                                 (size_t)(max.z - min.z + 2) *
+                                                 sizeof(SHAPE_COORDS_INT_T));
+    lp.regions = (_LightRegion *)calloc((size_t)nbRegions, sizeof(_LightRegion));
+    bool *scheduled = (bool *)malloc((size_t)nbRegions * sizeof(bool));
+    bool ok = lp.sunFloors != NULL && lp.regions != NULL && scheduled != NULL;
+
+    for (int i = 0; ok && i < nbRegions; ++i) {
+        _LightRegion *r = &lp.regions[i];
+        r->lp = &lp;
+        r->rx = i / lp.nbRegionsZ;
+        r->rz = i % lp.nbRegionsZ;
+        r->originX = (SHAPE_COORDS_INT_T)((chunkMin.x + r->rx * LIGHT_REGION_SIZE) * CHUNK_SIZE);
+        r->originZ = (SHAPE_COORDS_INT_T)((chunkMin.z + r->rz * LIGHT_REGION_SIZE) * CHUNK_SIZE);
+        r->minX = (SHAPE_COORDS_INT_T)maximum(r->originX, min.x - 1);
+        r->minZ = (SHAPE_COORDS_INT_T)maximum(r->originZ, min.z - 1);
+        r->maxX = (SHAPE_COORDS_INT_T)minimum(r->originX + LIGHT_REGION_SIZE * CHUNK_SIZE - 1,
+                                              max.x);
+        r->maxZ = (SHAPE_COORDS_INT_T)minimum(r->originZ + LIGHT_REGION_SIZE * CHUNK_SIZE - 1,
+                                              max.z);
+        r->queue = light_node_queue_new();
+        r->sunlitRuns = (uint8_t *)calloc(sunlitRunsSize, 1);
+        ok = r->queue != NULL && r->sunlitRuns != NULL;
+    }
+
+    if (ok) {
+        _light_parallel_run(&lp, pool, _light_region_sunlight_job, NULL);
+        _light_parallel_run(&lp, pool, _light_region_seed_job, NULL);
+
+        // deliver posted light until no region has anything left to process
+        while (true) {
+            lp.pass++;
+
+            bool any = false;
+            for (int i = 0; i < nbRegions; ++i) {
+                scheduled[i] = false;
+                for (int d = 0; d < 9 && scheduled[i] == false; ++d) {
+                    const _LightRegionOutbox *inbox = _light_region_get_inbox(&lp.regions[i],
+                                                                              d / 3 - 1,
+                                                                              d % 3 - 1);
+                    scheduled[i] = d != 4 && inbox != NULL && inbox->count > 0;
+                }
+                any = any || scheduled[i];
+            }
+            if (any == false) {
+                break;
+            }
+
+            _light_parallel_run(&lp, pool, _light_region_pass_job, scheduled);
+
+            // messages delivered during this pass
+            for (int i = 0; i < nbRegions; ++i) {
+                for (int d = 0; d < 9; ++d) {
+                    lp.regions[i].outboxes[(lp.pass - 1) & 1][d].count = 0;
+                }
+            }
+        }
+
+        SHAPE_COORDS_INT3_T dirtyMin = {(SHAPE_COORDS_INT_T)(min.x - 1),
+                                        min.y,
+                                        (SHAPE_COORDS_INT_T)(min.z - 1)};
+        _lighting_postprocess_dirty(s, &dirtyMin, &max);
+    } else {
+        cclog_error("🔥 can't allocate parallel lighting regions");
+    }
+
+    for (int i = 0; lp.regions != NULL && i < nbRegions; ++i) {
+        _LightRegion *r = &lp.regions[i];
+        light_node_queue_free(r->queue);
+        for (int b = 0; b < 2; ++b) {
+            for (int d = 0; d < 9; ++d) {
+                free(r->outboxes[b][d].messages);
+            }
+        }
+        free(r->sunlitRuns);
+    }
+    free(lp.regions);
+    free(lp.sunFloors);
+    free(scheduled);
+
+    return ok;
+}
+
 void _shape_check_all_vb_fragmented(Shape *s, VertexBuffer *first) {
     VertexBuffer *vb = first;
     while (vb != NULL) {
@@ -4204,6 +6117,9 @@ bool _shape_apply_transaction(Shape *const sh, Transaction *tr) {
     BlockChange *bc;
     const Block *b;
 
+    // lighting of all changes is updated at once
+    shape_begin_lighting_batch(sh);
+
     while (index3d_iterator_pointer(it) != NULL) {
         bc = (BlockChange *)index3d_iterator_pointer(it);
 
@@ -4243,6 +6159,8 @@ bool _shape_apply_transaction(Shape *const sh, Transaction *tr) {
         index3d_iterator_next(it);
     }
 
+    shape_end_lighting_batch(sh);
+
     if (resetBoxNeeded) {
         shape_reset_box(sh);
     }
@@ -4276,6 +6194,9 @@ bool _shape_undo_transaction(Shape *const sh, Transaction *tr) {
     BlockChange *bc;
     const Block *b;
 
+    // lighting of all changes is updated at once
+    shape_begin_lighting_batch(sh);
+
     while (index3d_iterator_pointer(it) != NULL) {
         bc = (BlockChange *)index3d_iterator_pointer(it);
 
@@ -4308,6 +6229,8 @@ bool _shape_undo_transaction(Shape *const sh, Transaction *tr) {
         index3d_iterator_next(it);
     }
 
+    shape_end_lighting_batch(sh);
+
     if (resetBoxNeeded == true) {
         shape_reset_box(sh);
     }
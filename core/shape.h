@@ -36,6 +36,7 @@ typedef struct _Transform Transform;
 typedef struct _VertexBuffer VertexBuffer;
 typedef struct _Chunk Chunk;
 typedef struct _Rtree Rtree;
+typedef struct _ThreadPool ThreadPool;
 
 typedef struct _LoadShapeSettings {
     bool lighting;
@@ -134,6 +135,7 @@ bool shape_paint_block_as_transaction(Shape *const shape,
 
 ///
 void shape_apply_current_transaction(Shape *const shape, bool keepPending);
+bool shape_has_pending_transaction(const Shape *s);
 
 /// @param useDefaultColor will translate a default color into shape palette
 bool shape_add_block(Shape *shape,
@@ -260,8 +262,20 @@ void shape_get_chunk_and_coordinates(const Shape *shape,
                                      Chunk **chunk,
                                      SHAPE_COORDS_INT3_T *chunk_coords,
                                      CHUNK_COORDS_INT3_T *coords_in_chunk);
+/// Edit tracking records which chunks have block changes (off by default), used for incremental
+/// saves. Chunks emptied since last clear remain listed, even though they're gone from the index.
+void shape_enable_edit_tracking(Shape *shape, const bool enable);
+/// Coordinates (int3, in chunks) of chunks edited since last clear, NULL if tracking is disabled
+Index3D *shape_get_edited_chunks(const Shape *shape);
+void shape_clear_edited_chunks(Shape *shape);
+/// Offset from shape coordinates to the coordinates its edits are saved in, see
+/// serialization_journal.h
+void shape_set_edits_offset(Shape *shape, const SHAPE_COORDS_INT3_T offset);
+SHAPE_COORDS_INT3_T shape_get_edits_offset(const Shape *shape);
 void shape_log_vertex_buffers(const Shape *shape, bool dirtyOnly, bool transparent);
 void shape_refresh_vertices(Shape *shape);
+/// Whether shape_refresh_vertices has chunks to refresh or lighting work left
+bool shape_has_pending_vertices(const Shape *s);
 void shape_refresh_all_vertices(Shape *s);
 VertexBuffer *shape_get_first_vertex_buffer(const Shape *shape, bool transparent);
 
@@ -351,6 +365,17 @@ void shape_remove_point(Shape *s, const char *key);
 /// baked lighting
 void shape_compute_baked_lighting(Shape *s);
 
+/// Single-threaded flood fill, used by shape_compute_baked_lighting for small shapes
+void shape_compute_baked_lighting_serial(Shape *s);
+
+/// Same result as shape_compute_baked_lighting_serial, w/o lighting sunlight columns first: all
+/// sunlight is propagated from the plane above the shape. Slower, used as reference
+void shape_compute_baked_lighting_flood_fill(Shape *s);
+
+/// Same result as shape_compute_baked_lighting_serial, the shape is split in regions of chunk
+/// columns lit by given thread pool's workers. Used by shape_compute_baked_lighting for big shapes
+void shape_compute_baked_lighting_parallel(Shape *s, ThreadPool *pool);
+
 void shape_toggle_baked_lighting(Shape *s, const bool toggle);
 bool shape_uses_baked_lighting(const Shape *s);
 VERTEX_LIGHT_STRUCT_T *shape_create_lighting_data_blob(const Shape *s, void **inout);
@@ -387,6 +412,24 @@ void shape_compute_baked_lighting_replaced_block(Shape *s,
                                                  CHUNK_COORDS_INT3_T coords_in_chunk,
                                                  SHAPE_COLOR_INDEX_INT_T blockID);
 
+/// Lighting batch: baked lighting updates of block changes are deferred until batch end, then
+/// computed in one light removal & propagation pass over all changed blocks, instead of one pass
+/// per block. Transactions are applied in a lighting batch. Batches can't be nested.
+void shape_begin_lighting_batch(Shape *s);
+void shape_end_lighting_batch(Shape *s);
+
+/// Deferred lighting: baked lighting updates of block changes are kept in a per-shape work queue
+/// and advanced by at most `budget` light nodes per frame (in shape_refresh_vertices), instead of
+/// running to completion on each change. Chunks are marked dirty for remesh once their lighting
+/// settles, final lighting is identical to synchronous updates. A budget of 0 disables deferred
+/// lighting, completing any pending work.
+void shape_set_deferred_lighting_budget(Shape *s, uint32_t budget);
+/// Advances pending lighting work by at most `budget` light nodes, returns true if settled
+bool shape_process_lighting(Shape *s, uint32_t budget);
+/// Completes all pending lighting work
+void shape_flush_lighting(Shape *s);
+bool shape_is_lighting_pending(const Shape *s);
+
 uint64_t shape_get_baked_lighting_hash(const Shape *s);
 
 // MARK: - History -
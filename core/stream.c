@@ -9,11 +9,21 @@
 #include <stdlib.h>
 #include <string.h>
 
+#if defined(__VX_PLATFORM_WINDOWS)
+// no mmap, file content is loaded in a heap buffer instead
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 enum STREAM_TYPE {
     STREAM_TYPE_FILE_READ = 1,
     STREAM_TYPE_FILE_WRITE = 2,
     STREAM_TYPE_BUFFER_READ = 3,
-    STREAM_TYPE_BUFFER_WRITE = 4
+    STREAM_TYPE_BUFFER_WRITE = 4,
+    STREAM_TYPE_MMAP_READ = 5
 };
 
 typedef struct {
@@ -32,6 +42,13 @@ typedef struct {
     FILE *file;
 } StreamData_FILE;
 
+// `view` must remain first member, mmap streams are read through StreamData_BUFFER_READ
+typedef struct {
+    StreamData_BUFFER_READ view;
+    void *mapping; // NULL for empty files
+    size_t mappingSize;
+} StreamData_MMAP_READ;
+
 struct _Stream {
     enum STREAM_TYPE type;
     void *data;
@@ -59,6 +76,18 @@ void stream_free(Stream *s) {
             data->file = NULL;
             break;
         }
+        case STREAM_TYPE_MMAP_READ: {
+            StreamData_MMAP_READ *data = (StreamData_MMAP_READ *)(s->data);
+            if (data->mapping != NULL) {
+#if defined(__VX_PLATFORM_WINDOWS)
+                free(data->mapping);
+#else
+                munmap(data->mapping, data->mappingSize);
+#endif
+                data->mapping = NULL;
+            }
+            break;
+        }
     }
 
     free(s->data);
@@ -127,6 +156,74 @@ Stream *stream_new_file_read(FILE *fd) {
     return s;
 }
 
+Stream *stream_new_mmap_read(const char *path) {
+    if (path == NULL) {
+        return NULL;
+    }
+
+    void *mapping = NULL;
+    size_t mappingSize = 0;
+
+#if defined(__VX_PLATFORM_WINDOWS)
+    FILE *fd = fopen(path, "rb");
+    if (fd == NULL) {
+        return NULL;
+    }
+    fseek(fd, 0, SEEK_END);
+    const long size = ftell(fd);
+    fseek(fd, 0, SEEK_SET);
+    if (size < 0) {
+        fclose(fd);
+        return NULL;
+    }
+    mappingSize = (size_t)size;
+    if (mappingSize > 0) {
+        mapping = malloc(mappingSize);
+        if (mapping == NULL || fread(mapping, mappingSize, 1, fd) != 1) {
+            free(mapping);
+            fclose(fd);
+            return NULL;
+        }
+    }
+    fclose(fd);
+#else
+    const int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return NULL;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < 0) {
+        close(fd);
+        return NULL;
+    }
+    mappingSize = (size_t)st.st_size;
+    // mmap doesn't accept 0 length, empty files are simply streams with nothing to read
+    if (mappingSize > 0) {
+        mapping = mmap(NULL, mappingSize, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapping == MAP_FAILED) {
+            close(fd);
+            return NULL;
+        }
+        // files are parsed front to back
+        madvise(mapping, mappingSize, MADV_SEQUENTIAL);
+    }
+    close(fd); // mapping remains valid
+#endif
+
+    Stream *s = (Stream *)malloc(sizeof(Stream));
+    s->type = STREAM_TYPE_MMAP_READ;
+
+    StreamData_MMAP_READ *data = malloc(sizeof(StreamData_MMAP_READ));
+    data->mapping = mapping;
+    data->mappingSize = mappingSize;
+    data->view.buffer = (const char *)mapping;
+    data->view.bufferSize = mappingSize;
+    data->view.cursor = data->view.buffer;
+
+    s->data = (void *)data;
+    return s;
+}
+
 bool stream_buffer_unload(Stream *s, char **buf, size_t *written, size_t *bufSize) {
     if (s->type != STREAM_TYPE_BUFFER_WRITE)
         return false;
@@ -150,7 +247,8 @@ bool stream_buffer_unload(Stream *s, char **buf, size_t *written, size_t *bufSiz
 
 bool stream_read(Stream *s, void *outValue, size_t itemSize, size_t nbItems) {
     switch (s->type) {
-        case STREAM_TYPE_BUFFER_READ: {
+        case STREAM_TYPE_BUFFER_READ:
+        case STREAM_TYPE_MMAP_READ: {
             size_t toRead = itemSize * nbItems;
             StreamData_BUFFER_READ *data = (StreamData_BUFFER_READ *)(s->data);
             if ((size_t)(data->cursor - data->buffer) + toRead > data->bufferSize) {
@@ -196,7 +294,8 @@ bool stream_read_string(Stream *s, size_t size, char *outValue) {
 
 bool stream_skip(Stream *s, size_t bytesToSkip) {
     switch (s->type) {
-        case STREAM_TYPE_BUFFER_READ: {
+        case STREAM_TYPE_BUFFER_READ:
+        case STREAM_TYPE_MMAP_READ: {
             StreamData_BUFFER_READ *data = (StreamData_BUFFER_READ *)(s->data);
             if ((size_t)(data->cursor - data->buffer) + bytesToSkip > data->bufferSize) {
                 return false;
@@ -217,9 +316,53 @@ bool stream_skip(Stream *s, size_t bytesToSkip) {
     return false;
 }
 
+const void *stream_borrow(Stream *s, size_t size) {
+    switch (s->type) {
+        case STREAM_TYPE_BUFFER_READ:
+        case STREAM_TYPE_MMAP_READ: {
+            StreamData_BUFFER_READ *data = (StreamData_BUFFER_READ *)(s->data);
+            if ((size_t)(data->cursor - data->buffer) + size > data->bufferSize) {
+                return NULL;
+            }
+            const void *borrowed = (const void *)data->cursor;
+            data->cursor += size;
+            return borrowed;
+        }
+        default:
+            break;
+    }
+    return NULL;
+}
+
+bool stream_is_memory_backed(const Stream *s) {
+    return s->type == STREAM_TYPE_BUFFER_READ || s->type == STREAM_TYPE_MMAP_READ;
+}
+
+size_t stream_get_size(Stream *s) {
+    switch (s->type) {
+        case STREAM_TYPE_BUFFER_READ:
+        case STREAM_TYPE_MMAP_READ: {
+            StreamData_BUFFER_READ *data = (StreamData_BUFFER_READ *)(s->data);
+            return data->bufferSize;
+        }
+        case STREAM_TYPE_FILE_READ: {
+            StreamData_FILE *data = (StreamData_FILE *)(s->data);
+            const long pos = ftell(data->file);
+            fseek(data->file, 0, SEEK_END);
+            const long size = ftell(data->file);
+            fseek(data->file, pos, SEEK_SET);
+            return size > 0 ? (size_t)size : 0;
+        }
+        default:
+            break;
+    }
+    return 0;
+}
+
 size_t stream_get_cursor_position(Stream *s) {
     switch (s->type) {
-        case STREAM_TYPE_BUFFER_READ: {
+        case STREAM_TYPE_BUFFER_READ:
+        case STREAM_TYPE_MMAP_READ: {
             StreamData_BUFFER_READ *data = (StreamData_BUFFER_READ *)(s->data);
             return (size_t)(data->cursor - data->buffer);
         }
@@ -235,7 +378,8 @@ size_t stream_get_cursor_position(Stream *s) {
 
 void stream_set_cursor_position(Stream *s, size_t pos) {
     switch (s->type) {
-        case STREAM_TYPE_BUFFER_READ: {
+        case STREAM_TYPE_BUFFER_READ:
+        case STREAM_TYPE_MMAP_READ: {
             StreamData_BUFFER_READ *data = (StreamData_BUFFER_READ *)(s->data);
             data->cursor = data->buffer + pos;
             break;
@@ -252,7 +396,8 @@ void stream_set_cursor_position(Stream *s, size_t pos) {
 
 bool stream_reached_the_end(Stream *s) {
     switch (s->type) {
-        case STREAM_TYPE_BUFFER_READ: {
+        case STREAM_TYPE_BUFFER_READ:
+        case STREAM_TYPE_MMAP_READ: {
             StreamData_BUFFER_READ *data = (StreamData_BUFFER_READ *)(s->data);
             return (size_t)(data->cursor - data->buffer) == data->bufferSize;
         }
@@ -40,6 +40,11 @@ Stream *stream_new_file_write(FILE *fd);
 // Expecting a file opened with "rb" flag
 Stream *stream_new_file_read(FILE *fd);
 
+// Maps file at given path in memory (read-only), returns NULL if it can't be opened.
+// Reads are plain memcpys from the mapping, and stream_borrow can be used for zero-copy access.
+// Mapping is released in stream_free.
+Stream *stream_new_mmap_read(const char *path);
+
 // READ
 
 bool stream_read(Stream *s, void *outValue, size_t itemSize, size_t nbItems);
@@ -50,6 +55,17 @@ bool stream_read_float32(Stream *s, float *outValue);
 bool stream_read_string(Stream *s, size_t size, char *outValue);
 bool stream_skip(Stream *s, size_t bytesToSkip);
 
+// Returns a pointer to the next `size` bytes and moves the cursor past them, without copying.
+// Only memory-backed streams (buffer & mmap reads) support it, returns NULL otherwise or if
+// there aren't enough bytes left. Pointer remains valid until the Stream is freed.
+const void *stream_borrow(Stream *s, size_t size);
+
+// Returns true if stream_borrow is supported by this Stream
+bool stream_is_memory_backed(const Stream *s);
+
+// Total size of readable content (0 for write streams)
+size_t stream_get_size(Stream *s);
+
 size_t stream_get_cursor_position(Stream *s);
 void stream_set_cursor_position(Stream *s, size_t pos);
 
@@ -0,0 +1,61 @@
+// -------------------------------------------------------------
+//  Cubzh Core Unit Tests
+//  lighting_map.h
+// -------------------------------------------------------------
+
+#pragma once
+
+#include "color_atlas.h"
+#include "color_palette.h"
+#include "shape.h"
+
+// Baked lighting fixture, shared by unit tests & cli lighting benchmark
+
+/// Terrain w/ overhangs, glass & lamps, and a floating island above missing chunks, partly under a
+/// glass roof at the top of the bounds. Same content for a given size (side, in blocks)
+static inline Shape *lighting_map_make(ColorAtlas *atlas, const SHAPE_COORDS_INT_T size) {
+    Shape *s = shape_make();
+    ColorPalette *p = color_palette_new(atlas);
+    shape_set_palette(s, p, false);
+
+    const RGBAColor groundColor = {90, 140, 60, 255};
+    const RGBAColor glassColor = {200, 220, 255, 120};
+    const RGBAColor lampColor = {255, 160, 40, 255};
+    SHAPE_COLOR_INDEX_INT_T ground, glass, lamp;
+    color_palette_check_and_add_color(p, groundColor, &ground, false);
+    color_palette_check_and_add_color(p, glassColor, &glass, false);
+    color_palette_check_and_add_color(p, lampColor, &lamp, false);
+    color_palette_set_emissive(p, lamp, true);
+
+    uint32_t seed = 42;
+    for (SHAPE_COORDS_INT_T x = 0; x < size; ++x) {
+        for (SHAPE_COORDS_INT_T z = 0; z < size; ++z) {
+            seed = seed * 1103515245 + 12345;
+            const SHAPE_COORDS_INT_T h = (SHAPE_COORDS_INT_T)(4 + (x / 7 + z / 5) % 10 +
+                                                              (int)((seed >> 16) % 3));
+            for (SHAPE_COORDS_INT_T y = 0; y < h; ++y) {
+                if (y > 1 && y < h - 2 && (x / 3 + z / 4 + y) % 6 == 0) {
+                    continue; // cave
+                }
+                shape_add_block(s, ground, x, y, z, false);
+            }
+            if ((x + 2 * z) % 11 == 0) {
+                shape_add_block(s, glass, x, h, z, false);
+            }
+            if ((seed >> 20) % 37 == 0) {
+                shape_add_block(s, lamp, x, (SHAPE_COORDS_INT_T)(h - 3), z, false);
+            }
+            if (x > size * 2 / 7 && x < size * 5 / 7 && z > size * 3 / 7 && z < size * 6 / 7) {
+                shape_add_block(s, ground, x, 40, z, false);
+                if ((x + z) % 9 == 0) {
+                    shape_add_block(s, lamp, x, 39, z, false);
+                }
+            }
+            if (x >= size * 12 / 35 && x < size * 17 / 35 && z >= size * 4 / 7 &&
+                z < size * 5 / 7) {
+                shape_add_block(s, glass, x, 47, z, false); // roof at the top of the bounds
+            }
+        }
+    }
+    return s;
+}
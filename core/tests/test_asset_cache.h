@@ -0,0 +1,225 @@
+// -------------------------------------------------------------
+//  Cubzh Core Unit Tests
+//  test_asset_cache.h
+// -------------------------------------------------------------
+
+#pragma once
+
+#include "asset_cache.h"
+#include "serialization.h"
+#include "transform.h"
+
+static Shape *_test_asset_cache_make_shape(ColorAtlas *atlas, SHAPE_COORDS_INT_T size) {
+    Shape *s = shape_make();
+    shape_set_palette(s, color_palette_new(atlas), false);
+    SHAPE_COLOR_INDEX_INT_T idx;
+    color_palette_check_and_add_color(shape_get_palette(s),
+                                      (RGBAColor){10, 20, 30, 255},
+                                      &idx,
+                                      false);
+    for (SHAPE_COORDS_INT_T x = 0; x < size; ++x) {
+        for (SHAPE_COORDS_INT_T z = 0; z < size; ++z) {
+            shape_add_block(s, idx, x, 0, z, false);
+        }
+    }
+    return s;
+}
+
+static Shape *_test_asset_cache_load(AssetCache *c,
+                                     void *buf,
+                                     uint32_t bufSize,
+                                     ColorAtlas *atlas,
+                                     const LoadShapeSettings *settings) {
+    Stream *s = stream_new_buffer_read((const char *)buf, bufSize);
+    return asset_cache_load_shape(c, s, "", atlas, settings, false);
+}
+
+static bool _test_asset_cache_child_shares_palette(const Shape *s) {
+    DoublyLinkedListNode *n = shape_get_transform_children_iterator(s);
+    Shape *child = n != NULL ? transform_utils_get_shape(
+                                   (Transform *)doubly_linked_list_node_pointer(n))
+                             : NULL;
+    return child != NULL && shape_get_palette(child) == shape_get_palette(s);
+}
+
+// check that loads of the same content are served from cache, as independent copies
+void test_asset_cache_load_shape(void) {
+    ColorAtlas *atlas = color_atlas_new();
+    const LoadShapeSettings settings = {.lighting = false, .isMutable = false};
+
+    Shape *src = _test_asset_cache_make_shape(atlas, 20);
+    Shape *child = _test_asset_cache_make_shape(atlas, 2);
+    shape_set_parent(child, shape_get_root_transform(src), false);
+    shape_release(child);
+
+    void *buf = NULL;
+    uint32_t bufSize = 0;
+    TEST_ASSERT(serialization_save_shape_as_buffer(src, NULL, NULL, 0, &buf, &bufSize));
+
+    AssetCache *c = asset_cache_new(ASSET_CACHE_DEFAULT_MEMORY_BUDGET);
+    Shape *a = _test_asset_cache_load(c, buf, bufSize, atlas, &settings);
+    Shape *b = _test_asset_cache_load(c, buf, bufSize, atlas, &settings);
+    TEST_ASSERT(a != NULL && b != NULL);
+    TEST_CHECK(a != b);
+    TEST_CHECK(shape_get_nb_blocks(a) == 400 && shape_get_nb_blocks(b) == 400);
+    TEST_CHECK(shape_count_shape_descendants(a) == 1 && shape_count_shape_descendants(b) == 1);
+
+    // copies are independent
+    shape_remove_block(a, 0, 0, 0);
+    TEST_CHECK(block_is_solid(shape_get_block(b, 0, 0, 0)));
+
+    // different settings, different entry
+    const LoadShapeSettings mutableSettings = {.lighting = false, .isMutable = true};
+    Shape *m = _test_asset_cache_load(c, buf, bufSize, atlas, &mutableSettings);
+    TEST_ASSERT(m != NULL);
+
+    AssetCacheStats stats = asset_cache_get_stats(c);
+    TEST_CHECK(stats.hits == 1);
+    TEST_CHECK(stats.misses == 2);
+    TEST_CHECK(stats.nbEntries == 2);
+    TEST_CHECK(stats.memory > 0);
+
+    // budget
+    asset_cache_set_memory_budget(c, 0);
+    stats = asset_cache_get_stats(c);
+    TEST_CHECK(stats.nbEntries == 0 && stats.memory == 0 && stats.evictions == 2);
+    Shape *d = _test_asset_cache_load(c, buf, bufSize, atlas, &settings);
+    TEST_ASSERT(d != NULL);
+    TEST_CHECK(shape_get_nb_blocks(d) == 400);
+    stats = asset_cache_get_stats(c);
+    TEST_CHECK(stats.bypasses == 1 && stats.nbEntries == 0);
+
+    shape_release(a);
+    shape_release(b);
+    shape_release(m);
+    shape_release(d);
+    asset_cache_free(c);
+    free(buf);
+    shape_release(src);
+    color_atlas_free(atlas);
+}
+
+static Octree *_test_asset_cache_get_octree(const Shape *s) {
+    Chunk *chunk = NULL;
+    shape_get_chunk_and_coordinates(s, (SHAPE_COORDS_INT3_T){0, 0, 0}, &chunk, NULL, NULL);
+    return chunk != NULL ? chunk_get_octree(chunk) : NULL;
+}
+
+// check that items w/ the same content share a template regardless of fullname, and that copies
+// share blocks until written
+void test_asset_cache_shared_by_fullnames(void) {
+    ColorAtlas *atlas = color_atlas_new();
+    const LoadShapeSettings settings = {.lighting = false, .isMutable = false};
+
+    Shape *src = _test_asset_cache_make_shape(atlas, 10);
+    void *buf = NULL;
+    uint32_t bufSize = 0;
+    TEST_ASSERT(serialization_save_shape_as_buffer(src, NULL, NULL, 0, &buf, &bufSize));
+
+    AssetCache *c = asset_cache_get_shared();
+    const AssetCacheStats before = asset_cache_get_stats(c);
+    Shape *a = asset_cache_load_shape(c,
+                                      stream_new_buffer_read((const char *)buf, bufSize),
+                                      "user.a",
+                                      atlas,
+                                      &settings,
+                                      false);
+    Shape *b = asset_cache_load_shape(c,
+                                      stream_new_buffer_read((const char *)buf, bufSize),
+                                      "user.b",
+                                      atlas,
+                                      &settings,
+                                      false);
+    TEST_ASSERT(a != NULL && b != NULL);
+    const AssetCacheStats after = asset_cache_get_stats(c);
+    TEST_CHECK(after.misses == before.misses + 1);
+    TEST_CHECK(after.hits == before.hits + 1);
+    TEST_CHECK(strcmp(shape_get_fullname(a), "user.a") == 0);
+    TEST_CHECK(strcmp(shape_get_fullname(b), "user.b") == 0);
+
+    // copy-on-write
+    TEST_CHECK(_test_asset_cache_get_octree(a) == _test_asset_cache_get_octree(b));
+    shape_paint_block(a, 0, 0, 0, 0);
+    TEST_CHECK(_test_asset_cache_get_octree(a) != _test_asset_cache_get_octree(b));
+    TEST_CHECK(shape_get_nb_blocks(a) == 100 && shape_get_nb_blocks(b) == 100);
+
+    shape_release(a);
+    shape_release(b);
+    asset_cache_flush(c);
+    free(buf);
+    shape_release(src);
+    color_atlas_free(atlas);
+}
+
+// check that templates of a freed atlas are dropped, not matched by a new atlas
+void test_asset_cache_freed_atlas(void) {
+    const LoadShapeSettings settings = {.lighting = false, .isMutable = false};
+    AssetCache *c = asset_cache_new(ASSET_CACHE_DEFAULT_MEMORY_BUDGET);
+
+    ColorAtlas *atlas = color_atlas_new();
+    Shape *src = _test_asset_cache_make_shape(atlas, 10);
+    void *buf = NULL;
+    uint32_t bufSize = 0;
+    TEST_ASSERT(serialization_save_shape_as_buffer(src, NULL, NULL, 0, &buf, &bufSize));
+    shape_release(src);
+
+    Shape *s = _test_asset_cache_load(c, buf, bufSize, atlas, &settings);
+    TEST_ASSERT(s != NULL);
+    shape_release(s);
+    color_atlas_free(atlas);
+
+    atlas = color_atlas_new();
+    s = _test_asset_cache_load(c, buf, bufSize, atlas, &settings);
+    TEST_ASSERT(s != NULL);
+    TEST_CHECK(color_palette_get_atlas(shape_get_palette(s)) == atlas);
+
+    const AssetCacheStats stats = asset_cache_get_stats(c);
+    TEST_CHECK(stats.misses == 2 && stats.hits == 0);
+    TEST_CHECK(stats.nbEntries == 1 && stats.evictions == 1);
+
+    shape_release(s);
+    asset_cache_free(c);
+    free(buf);
+    color_atlas_free(atlas);
+}
+
+// check that children sharing the root palette still do in copies, as in uncached loads
+void test_asset_cache_shared_palette(void) {
+    ColorAtlas *atlas = color_atlas_new();
+    const LoadShapeSettings settings = {.lighting = false, .isMutable = false};
+
+    Shape *src = _test_asset_cache_make_shape(atlas, 4);
+    Shape *child = shape_make();
+    shape_set_palette(child, shape_get_palette(src), true);
+    shape_add_block(child, 0, 0, 0, 0, false);
+    shape_set_parent(child, shape_get_root_transform(src), false);
+    shape_release(child);
+
+    void *buf = NULL;
+    uint32_t bufSize = 0;
+    TEST_ASSERT(serialization_save_shape_as_buffer(src, NULL, NULL, 0, &buf, &bufSize));
+
+    Shape *loaded = serialization_load_shape(stream_new_buffer_read((const char *)buf, bufSize),
+                                             "",
+                                             atlas,
+                                             (LoadShapeSettings *)&settings,
+                                             false);
+    TEST_ASSERT(loaded != NULL);
+    TEST_CHECK(_test_asset_cache_child_shares_palette(loaded));
+
+    AssetCache *c = asset_cache_new(ASSET_CACHE_DEFAULT_MEMORY_BUDGET);
+    Shape *miss = _test_asset_cache_load(c, buf, bufSize, atlas, &settings);
+    Shape *hit = _test_asset_cache_load(c, buf, bufSize, atlas, &settings);
+    TEST_ASSERT(miss != NULL && hit != NULL);
+    TEST_CHECK(_test_asset_cache_child_shares_palette(miss));
+    TEST_CHECK(_test_asset_cache_child_shares_palette(hit));
+    TEST_CHECK(shape_get_palette(miss) != shape_get_palette(hit));
+
+    shape_release(loaded);
+    shape_release(miss);
+    shape_release(hit);
+    asset_cache_free(c);
+    free(buf);
+    shape_release(src);
+    color_atlas_free(atlas);
+}
@@ -0,0 +1,110 @@
+// -------------------------------------------------------------
+//  Cubzh Core Unit Tests
+//  test_box_lanes.h
+// -------------------------------------------------------------
+
+#pragma once
+
+#include <math.h>
+
+#include "box_lanes.h"
+
+// pseudo-random value in [0, 16[, snapped to integers half of the time to hit equal bounds
+static float _test_box_lanes_random(uint32_t *seed) {
+    *seed = *seed * 1103515245 + 12345;
+    const float v = (float)((*seed >> 8) & 0xffff) / 4096.0f;
+    return (*seed >> 30) & 1 ? floorf(v) : v;
+}
+
+static void _test_box_lanes_fill(BoxLanes *bl, uint32_t *seed) {
+    for (uint8_t i = 0; i < BOX_LANES_COUNT; ++i) {
+        float3 a = {_test_box_lanes_random(seed),
+                    _test_box_lanes_random(seed),
+                    _test_box_lanes_random(seed)};
+        float3 b = {_test_box_lanes_random(seed),
+                    _test_box_lanes_random(seed),
+                    _test_box_lanes_random(seed)};
+        const Box box = {{minimum(a.x, b.x), minimum(a.y, b.y), minimum(a.z, b.z)},
+                         {maximum(a.x, b.x), maximum(a.y, b.y), maximum(a.z, b.z)}};
+        box_lanes_set(bl, i, &box);
+    }
+}
+
+// check that box tests give the same masks as box_collide_epsilon, for all counts
+void test_box_lanes_collide_epsilon(void) {
+    BoxLanes bl;
+    uint32_t seed = 3;
+
+    for (int n = 0; n < 200; ++n) {
+        _test_box_lanes_fill(&bl, &seed);
+        const float3 a = {_test_box_lanes_random(&seed),
+                          _test_box_lanes_random(&seed),
+                          _test_box_lanes_random(&seed)};
+        const Box b = {a, {a.x + 4.0f, a.y + 4.0f, a.z + 4.0f}};
+
+        for (uint8_t count = 0; count <= BOX_LANES_COUNT; ++count) {
+            uint8_t expected = 0;
+            Box lane;
+            for (uint8_t i = 0; i < count; ++i) {
+                box_lanes_get(&bl, i, &lane);
+                if (box_collide_epsilon(&lane, &b, EPSILON_COLLISION)) {
+                    expected |= (uint8_t)(1u << i);
+                }
+            }
+            TEST_CHECK(box_lanes_collide_epsilon(&bl, count, &b, EPSILON_COLLISION) == expected);
+            TEST_CHECK(box_lanes_collide_epsilon_scalar(&bl, count, &b, EPSILON_COLLISION) ==
+                       expected);
+        }
+    }
+}
+
+// check that ray tests give the same masks & distances as ray_intersect_with_box, including rays
+// along world axes & origins on boxes bounds
+void test_box_lanes_intersect_ray(void) {
+    BoxLanes bl;
+    uint32_t seed = 5;
+    float distances[BOX_LANES_COUNT], expectedDistances[BOX_LANES_COUNT];
+
+    for (int n = 0; n < 300; ++n) {
+        _test_box_lanes_fill(&bl, &seed);
+        const float3 origin = {_test_box_lanes_random(&seed),
+                               _test_box_lanes_random(&seed),
+                               _test_box_lanes_random(&seed)};
+        float3 dir;
+        switch (n % 3) {
+            case 0:
+                dir = (float3){0.0f, n % 2 == 0 ? -1.0f : 1.0f, 0.0f};
+                break;
+            case 1:
+                dir = (float3){1.0f, 0.0f, -1.0f};
+                break;
+            default:
+                dir = (float3){_test_box_lanes_random(&seed) - 8.0f,
+                               _test_box_lanes_random(&seed) - 8.0f,
+                               _test_box_lanes_random(&seed) - 8.0f};
+                break;
+        }
+        Ray *ray = ray_new(&origin, &dir);
+
+        const uint8_t count = (uint8_t)(n % (BOX_LANES_COUNT + 1));
+        uint8_t expected = 0;
+        Box lane;
+        for (uint8_t i = 0; i < count; ++i) {
+            box_lanes_get(&bl, i, &lane);
+            if (ray_intersect_with_box(ray, &lane.min, &lane.max, &expectedDistances[i])) {
+                expected |= (uint8_t)(1u << i);
+            }
+        }
+
+        const uint8_t mask = box_lanes_intersect_ray(&bl, count, ray, distances);
+        TEST_CHECK(mask == expected);
+        for (uint8_t i = 0; i < count; ++i) {
+            if (mask & expected & (1u << i)) {
+                TEST_CHECK(distances[i] == expectedDistances[i]);
+            }
+        }
+        TEST_CHECK(box_lanes_intersect_ray_scalar(&bl, count, ray, distances) == expected);
+
+        ray_free(ray);
+    }
+}
@@ -0,0 +1,154 @@
+// -------------------------------------------------------------
+//  Cubzh Core Unit Tests
+//  test_broadphase.h
+// -------------------------------------------------------------
+
+#pragma once
+
+#include "broadphase.h"
+
+#define TEST_BROADPHASE_LEAVES 400
+
+static Box _test_broadphase_random_box(uint32_t *seed, float size) {
+    float v[6];
+    for (int i = 0; i < 6; ++i) {
+        *seed = *seed * 1103515245 + 12345;
+        v[i] = (float)((*seed >> 8) & 0xffff) / 65536.0f;
+    }
+    // spread around the origin, over several grid cells
+    const Box b = {{v[0] * 200.0f - 100.0f, v[1] * 50.0f - 25.0f, v[2] * 200.0f - 100.0f},
+                   {v[0] * 200.0f - 100.0f + 0.5f + v[3] * size,
+                    v[1] * 50.0f - 25.0f + 0.5f + v[4] * size,
+                    v[2] * 200.0f - 100.0f + 0.5f + v[5] * size}};
+    return b;
+}
+
+static size_t _test_broadphase_overlap_expected(RtreeNode **leaves,
+                                                const Box *query,
+                                                float epsilon) {
+    size_t expected = 0;
+    for (int i = 0; i < TEST_BROADPHASE_LEAVES; ++i) {
+        if (leaves[i] != NULL &&
+            box_collide_epsilon(rtree_node_get_aabb(leaves[i]), query, epsilon)) {
+            expected++;
+        }
+    }
+    return expected;
+}
+
+// check that overlap queries find the same leaves as a brute-force test, while leaves are moved &
+// removed, w/ both broadphases
+void test_broadphase_query_overlap_box(void) {
+    const BroadphaseType types[2] = {BroadphaseType_HashGrid, BroadphaseType_SweepAndPrune};
+    FifoList *results = fifo_list_new();
+
+    for (int type = 0; type < 2; ++type) {
+        Rtree *r = rtree_new(2, 4);
+        Broadphase *b = broadphase_new(types[type]);
+        RtreeNode *leaves[TEST_BROADPHASE_LEAVES];
+        uint32_t seed = 13;
+        for (uintptr_t i = 0; i < TEST_BROADPHASE_LEAVES; ++i) {
+            // a few leaves overlap too many cells to be in the grid cells
+            Box box = _test_broadphase_random_box(&seed, i % 50 == 0 ? 120.0f : 8.0f);
+            leaves[i] = rtree_create_leaf(r, &box, 1, 1, (void *)(i + 1));
+            broadphase_insert(b, leaves[i]);
+        }
+        TEST_CHECK(broadphase_get_count(b) == TEST_BROADPHASE_LEAVES);
+
+        for (int pass = 0; pass < 3; ++pass) {
+            for (int q = 0; q < 100; ++q) {
+                // last queries cover more cells than there are in the grid
+                const Box query = _test_broadphase_random_box(&seed, q < 90 ? 30.0f : 400.0f);
+                const float epsilon = q % 2 == 0 ? EPSILON_COLLISION : -EPSILON_COLLISION;
+
+                const size_t hits =
+                    broadphase_query_overlap_box(b, &query, 1, 1, NULL, results, epsilon);
+                TEST_CHECK(hits == _test_broadphase_overlap_expected(leaves, &query, epsilon));
+
+                RtreeNode *hit = (RtreeNode *)fifo_list_pop(results);
+                while (hit != NULL) {
+                    TEST_CHECK(box_collide_epsilon(rtree_node_get_aabb(hit), &query, epsilon));
+                    hit = (RtreeNode *)fifo_list_pop(results);
+                }
+                TEST_CHECK(broadphase_query_overlap_box(b, &query, 2, 2, NULL, NULL, epsilon) == 0);
+            }
+
+            // move leaves a little, some of them across cells, then remove every 4th leaf
+            for (int i = 0; i < TEST_BROADPHASE_LEAVES; ++i) {
+                if (leaves[i] == NULL) {
+                    continue;
+                }
+                if (pass == 0 && i % 4 == 0) {
+                    broadphase_remove(b, leaves[i]);
+                    rtree_free_leaf(r, leaves[i]);
+                    leaves[i] = NULL;
+                    continue;
+                }
+                Box box = *rtree_node_get_aabb(leaves[i]);
+                const float3 move = {(float)(i % 7) - 3.0f, (float)(i % 3) - 1.0f, 2.5f};
+                float3_op_add(&box.min, &move);
+                float3_op_add(&box.max, &move);
+                broadphase_update(b, leaves[i], &box);
+            }
+        }
+        TEST_CHECK(broadphase_get_count(b) == TEST_BROADPHASE_LEAVES * 3 / 4);
+
+        // flushed leaves are each given back once
+        broadphase_flush(b, results);
+        TEST_CHECK(fifo_list_get_size(results) == TEST_BROADPHASE_LEAVES * 3 / 4);
+        TEST_CHECK(broadphase_get_count(b) == 0);
+        while (fifo_list_pop(results) != NULL) {}
+
+        broadphase_free(b);
+        rtree_free(r);
+    }
+
+    fifo_list_free(results, NULL);
+}
+
+// check that ray casts find the same leaves & distances as ray_intersect_with_box
+void test_broadphase_query_cast_all_ray(void) {
+    const BroadphaseType types[2] = {BroadphaseType_HashGrid, BroadphaseType_SweepAndPrune};
+    DoublyLinkedList *results = doubly_linked_list_new();
+
+    for (int type = 0; type < 2; ++type) {
+        Rtree *r = rtree_new(2, 4);
+        Broadphase *b = broadphase_new(types[type]);
+        Box boxes[TEST_BROADPHASE_LEAVES];
+        uint32_t seed = 17;
+        for (uintptr_t i = 0; i < TEST_BROADPHASE_LEAVES; ++i) {
+            boxes[i] = _test_broadphase_random_box(&seed, i % 50 == 0 ? 120.0f : 8.0f);
+            broadphase_insert(b, rtree_create_leaf(r, &boxes[i], 1, 1, (void *)(i + 1)));
+        }
+
+        for (int q = 0; q < 50; ++q) {
+            const Box o = _test_broadphase_random_box(&seed, 1.0f);
+            const float3 origin = {o.min.x, o.min.y, -150.0f};
+            const float3 dir = {o.max.x - o.min.x - 0.5f, 0.1f, 1.0f};
+            Ray *ray = ray_new(&origin, &dir);
+            size_t expected = 0;
+            float distance;
+            for (int i = 0; i < TEST_BROADPHASE_LEAVES; ++i) {
+                if (ray_intersect_with_box(ray, &boxes[i].min, &boxes[i].max, &distance)) {
+                    expected++;
+                }
+            }
+
+            TEST_CHECK(broadphase_query_cast_all_ray(b, ray, 1, 1, NULL, results) == expected);
+            RtreeCastResult *result = (RtreeCastResult *)doubly_linked_list_pop_first(results);
+            while (result != NULL) {
+                const Box *aabb = rtree_node_get_aabb(result->rtreeLeaf);
+                TEST_CHECK(ray_intersect_with_box(ray, &aabb->min, &aabb->max, &distance));
+                TEST_CHECK(distance == result->distance);
+                free(result);
+                result = (RtreeCastResult *)doubly_linked_list_pop_first(results);
+            }
+            ray_free(ray);
+        }
+
+        broadphase_free(b);
+        rtree_free(r);
+    }
+
+    doubly_linked_list_free(results);
+}
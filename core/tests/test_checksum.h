@@ -0,0 +1,51 @@
+// -------------------------------------------------------------
+//  Cubzh Core Unit Tests
+//  test_checksum.h
+// -------------------------------------------------------------
+
+#pragma once
+
+#include "checksum.h"
+#include "zlib.h"
+
+// check that CRC-32 matches zlib's, for all sizes & alignments around the 8-byte stride
+void test_checksum_crc32(void) {
+    uint8_t data[1024];
+    uint32_t seed = 12345;
+    for (size_t i = 0; i < sizeof(data); ++i) {
+        seed = seed * 1103515245 + 12345;
+        data[i] = (uint8_t)(seed >> 16);
+    }
+
+    TEST_CHECK(checksum_crc32(0, data, 0) == 0);
+
+    for (size_t offset = 0; offset < 8; ++offset) {
+        for (size_t size = 0; size < 70; ++size) {
+            const uint32_t expected = (uint32_t)crc32(0L, data + offset, (uInt)size);
+            TEST_CHECK(checksum_crc32(0, data + offset, size) == expected);
+        }
+    }
+
+    // running crc
+    uint32_t crc = checksum_crc32(0, data, 100);
+    crc = checksum_crc32(crc, data + 100, sizeof(data) - 100);
+    TEST_CHECK(crc == (uint32_t)crc32(0L, data, (uInt)sizeof(data)));
+}
+
+// check that combining CRC-32 of two parts gives the CRC-32 of the whole
+void test_checksum_crc32_combine(void) {
+    uint8_t data[5000];
+    for (size_t i = 0; i < sizeof(data); ++i) {
+        data[i] = (uint8_t)(i * 7 + i / 13);
+    }
+    const uint32_t whole = checksum_crc32(0, data, sizeof(data));
+
+    const size_t splits[] = {0, 1, 7, 64, 1000, 4999, 5000};
+    for (size_t i = 0; i < sizeof(splits) / sizeof(splits[0]); ++i) {
+        const size_t split = splits[i];
+        const uint32_t crc1 = checksum_crc32(0, data, split);
+        const uint32_t crc2 = checksum_crc32(0, data + split, sizeof(data) - split);
+        TEST_CHECK(checksum_crc32_combine(crc1, crc2, sizeof(data) - split) == whole);
+        TEST_MSG("split at %zu", split);
+    }
+}
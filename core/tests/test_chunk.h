@@ -144,3 +144,101 @@ void test_chunk_needs_display(void) {
 
     chunk_free(chunk, false);
 }
+
+// Reset a chunk's lighting, check that it is stored as a single value until a different value is
+// written, and collapsed back once uniform again
+void test_chunk_uniform_lighting(void) {
+    Chunk *chunk = chunk_new((SHAPE_COORDS_INT3_T){0, 0, 0});
+    VERTEX_LIGHT_STRUCT_T light, check;
+
+    TEST_CHECK(chunk_get_uniform_light(chunk, NULL) == false);
+
+    chunk_reset_lighting_data(chunk, false);
+    TEST_CHECK(chunk_get_uniform_light(chunk, &check));
+    TEST_CHECK(check.ambient == 15 && check.red == 0 && check.green == 0 && check.blue == 0);
+    TEST_CHECK(chunk_get_lighting_data(chunk) == NULL);
+
+    // same value, still uniform
+    DEFAULT_LIGHT(light)
+    chunk_set_light(chunk, (CHUNK_COORDS_INT3_T){3, 4, 5}, light, false);
+    TEST_CHECK(chunk_get_uniform_light(chunk, NULL));
+
+    // first non-uniform value
+    light.red = 8;
+    chunk_set_light(chunk, (CHUNK_COORDS_INT3_T){3, 4, 5}, light, false);
+    TEST_CHECK(chunk_get_uniform_light(chunk, NULL) == false);
+    TEST_CHECK(chunk_get_lighting_data(chunk) != NULL);
+    check = chunk_get_light_without_checking(chunk, (CHUNK_COORDS_INT3_T){3, 4, 5});
+    TEST_CHECK(check.ambient == 15 && check.red == 8);
+    check = chunk_get_light_without_checking(chunk, (CHUNK_COORDS_INT3_T){0, 0, 0});
+    TEST_CHECK(check.ambient == 15 && check.red == 0);
+
+    // not uniform, can't be collapsed
+    chunk_compact_lighting_data(chunk);
+    TEST_CHECK(chunk_get_uniform_light(chunk, NULL) == false);
+
+    light.red = 0;
+    chunk_set_light(chunk, (CHUNK_COORDS_INT3_T){3, 4, 5}, light, false);
+    chunk_compact_lighting_data(chunk);
+    TEST_CHECK(chunk_get_uniform_light(chunk, &check));
+    TEST_CHECK(check.ambient == 15 && check.red == 0);
+
+    // copies keep uniform lighting
+    Chunk *copy = chunk_new_copy(chunk);
+    TEST_CHECK(chunk_get_uniform_light(copy, &check));
+    TEST_CHECK(check.ambient == 15);
+
+    // written in full
+    VERTEX_LIGHT_STRUCT_T *data = (VERTEX_LIGHT_STRUCT_T *)malloc(
+        CHUNK_SIZE_CUBE * sizeof(VERTEX_LIGHT_STRUCT_T));
+    chunk_write_lighting_data(copy, data);
+    TEST_CHECK(data[0].ambient == 15 && data[CHUNK_SIZE_CUBE - 1].ambient == 15);
+
+    // uniform data given to a chunk is collapsed
+    chunk_reset_lighting_data(copy, true);
+    TEST_CHECK(chunk_get_uniform_light(copy, &check));
+    TEST_CHECK(check.ambient == 0);
+    chunk_set_lighting_data(copy, data);
+    TEST_CHECK(chunk_get_uniform_light(copy, &check));
+    TEST_CHECK(check.ambient == 15);
+
+    chunk_clear_lighting_data(copy);
+    TEST_CHECK(chunk_get_uniform_light(copy, NULL) == false);
+
+    chunk_free(copy, false);
+    chunk_free(chunk, false);
+}
+
+// Copy a chunk, check that blocks are shared until one of the chunks is written, each chunk then
+// only seeing its own writes
+void test_chunk_copy_on_write(void) {
+    Chunk *chunk = chunk_new((SHAPE_COORDS_INT3_T){0, 0, 0});
+    Block *block = block_new_with_color(3);
+    TEST_CHECK(chunk_add_block(chunk, *block, 1, 1, 1));
+    TEST_CHECK(chunk_add_block(chunk, *block, 2, 2, 2));
+
+    Chunk *copy = chunk_new_copy(chunk);
+    TEST_CHECK(chunk_get_octree(copy) == chunk_get_octree(chunk));
+    TEST_CHECK(octree_is_shared(chunk_get_octree(chunk)));
+
+    // painting the copy gives it its own blocks
+    TEST_CHECK(chunk_paint_block(copy, 1, 1, 1, 7, NULL));
+    TEST_CHECK(chunk_get_octree(copy) != chunk_get_octree(chunk));
+    TEST_CHECK(octree_is_shared(chunk_get_octree(chunk)) == false);
+    TEST_CHECK(block_get_color_index(chunk_get_block(copy, 1, 1, 1)) == 7);
+    TEST_CHECK(block_get_color_index(chunk_get_block(chunk, 1, 1, 1)) == 3);
+
+    // removing from a chunk sharing its blocks
+    Chunk *copy2 = chunk_new_copy(chunk);
+    TEST_CHECK(chunk_remove_block(chunk, 2, 2, 2, NULL));
+    TEST_CHECK(block_is_solid(chunk_get_block(chunk, 2, 2, 2)) == false);
+    TEST_CHECK(block_is_solid(chunk_get_block(copy2, 2, 2, 2)));
+    TEST_CHECK(chunk_get_nb_blocks(chunk) == 1 && chunk_get_nb_blocks(copy2) == 2);
+
+    // released in any order
+    chunk_free(chunk, false);
+    TEST_CHECK(block_get_color_index(chunk_get_block(copy2, 1, 1, 1)) == 3);
+    chunk_free(copy2, false);
+    chunk_free(copy, false);
+    block_free(block);
+}
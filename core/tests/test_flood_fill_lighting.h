@@ -10,18 +10,16 @@
 #include "int3.h"
 
 // Function that are not tested :
-// light_node_queue_recycle
 // light_node_queue_free
 // light_removal_node_queue_free
-// light_removal_node_queue_recycle
-// light_removal_node_get_light
 
 // Create a new queue and check if the created queue is empty.
 void test_light_node_queue_new(void) {
     LightNodeQueue *const q = light_node_queue_new();
 
-    LightNode *const check = light_node_queue_pop(q);
-    TEST_CHECK(check == NULL);
+    LightNode check;
+    TEST_CHECK(light_node_queue_pop(q, &check) == false);
+    TEST_CHECK(light_node_queue_count(q) == 0);
 
     light_node_queue_free(q);
 }
@@ -32,26 +30,20 @@ void test_light_node_get_coords(void) {
     const SHAPE_COORDS_INT3_T coords1 = {-10, 0, 10};
     const SHAPE_COORDS_INT3_T coords2 = {185, 516, -1684};
     SHAPE_COORDS_INT3_T coordsCheck = {0, 0, 0};
-    LightNode *check = NULL;
+    LightNode check;
 
     LightNodeQueue *const q = light_node_queue_new();
 
     light_node_queue_push(q, NULL, coords1);
-    check = light_node_queue_pop(q);
-    coordsCheck = light_node_get_coords(check);
-
-    light_node_free(check);
-    check = NULL;
+    TEST_CHECK(light_node_queue_pop(q, &check));
+    coordsCheck = check.coords;
     TEST_CHECK(coordsCheck.x == coords1.x);
     TEST_CHECK(coordsCheck.y == coords1.y);
     TEST_CHECK(coordsCheck.z == coords1.z);
 
     light_node_queue_push(q, NULL, coords2);
-    check = light_node_queue_pop(q);
-    coordsCheck = light_node_get_coords(check);
-
-    light_node_free(check);
-    check = NULL;
+    TEST_CHECK(light_node_queue_pop(q, &check));
+    coordsCheck = check.coords;
     TEST_CHECK(coordsCheck.x == coords2.x);
     TEST_CHECK(coordsCheck.y == coords2.y);
     TEST_CHECK(coordsCheck.z == coords2.z);
@@ -67,11 +59,9 @@ void test_light_node_queue_push(void) {
     LightNodeQueue *q = light_node_queue_new();
     light_node_queue_push(q, NULL, coords);
 
-    LightNode *check = light_node_queue_pop(q);
-    coordsCheck = light_node_get_coords(check);
-
-    light_node_free(check);
-    check = NULL;
+    LightNode check;
+    TEST_CHECK(light_node_queue_pop(q, &check));
+    coordsCheck = check.coords;
     TEST_CHECK(coordsCheck.x == coords.x);
     TEST_CHECK(coordsCheck.y == coords.y);
     TEST_CHECK(coordsCheck.z == coords.z);
@@ -80,49 +70,75 @@ void test_light_node_queue_push(void) {
 }
 
 // Create a queue and insert in it 3 different nodes. To check if the pop is done correctly, we pop
-// the nodes one by one and check if they are popped in the right order. We also check if their
-// values are correct.
+// the nodes one by one and check if they are popped in the right order (first in, first out). We
+// also check if their values are correct.
 void test_light_node_queue_pop(void) {
     const SHAPE_COORDS_INT3_T coordsA = {-10, 0, 10};
     const SHAPE_COORDS_INT3_T coordsB = {-3565, 17368, 20724};
     const SHAPE_COORDS_INT3_T coordsC = {984, -27863, 1563};
     SHAPE_COORDS_INT3_T coordsCheck = {0, 0, 0};
-    LightNode *check = NULL;
+    LightNode check;
 
     LightNodeQueue *q = light_node_queue_new();
     light_node_queue_push(q, NULL, coordsA); // [coordsA]
-    light_node_queue_push(q, NULL, coordsB); // [coordsB, coordsA]
-    light_node_queue_push(q, NULL, coordsC); // [coordsC, coordsB, coordsA]
-
-    check = light_node_queue_pop(q); // [coordsB, coordsA]
-    coordsCheck = light_node_get_coords(check);
-
-    light_node_free(check);
-    check = NULL;
-    TEST_CHECK(coordsCheck.x == coordsC.x);
-    TEST_CHECK(coordsCheck.y == coordsC.y);
-    TEST_CHECK(coordsCheck.z == coordsC.z);
+    light_node_queue_push(q, NULL, coordsB); // [coordsA, coordsB]
+    light_node_queue_push(q, NULL, coordsC); // [coordsA, coordsB, coordsC]
+    TEST_CHECK(light_node_queue_count(q) == 3);
 
-    check = light_node_queue_pop(q); // [coordsA]
-    coordsCheck = light_node_get_coords(check);
+    TEST_CHECK(light_node_queue_pop(q, &check)); // [coordsB, coordsC]
+    coordsCheck = check.coords;
+    TEST_CHECK(coordsCheck.x == coordsA.x);
+    TEST_CHECK(coordsCheck.y == coordsA.y);
+    TEST_CHECK(coordsCheck.z == coordsA.z);
 
-    light_node_free(check);
-    check = NULL;
+    TEST_CHECK(light_node_queue_pop(q, &check)); // [coordsC]
+    coordsCheck = check.coords;
     TEST_CHECK(coordsCheck.x == coordsB.x);
     TEST_CHECK(coordsCheck.y == coordsB.y);
     TEST_CHECK(coordsCheck.z == coordsB.z);
 
-    check = light_node_queue_pop(q); // []
-    coordsCheck = light_node_get_coords(check);
+    TEST_CHECK(light_node_queue_pop(q, &check)); // []
+    coordsCheck = check.coords;
+    TEST_CHECK(coordsCheck.x == coordsC.x);
+    TEST_CHECK(coordsCheck.y == coordsC.y);
+    TEST_CHECK(coordsCheck.z == coordsC.z);
 
-    light_node_free(check);
-    check = NULL;
-    TEST_CHECK(coordsCheck.x == coordsA.x);
-    TEST_CHECK(coordsCheck.y == coordsA.y);
-    TEST_CHECK(coordsCheck.z == coordsA.z);
+    TEST_CHECK(light_node_queue_pop(q, &check) == false);
 
-    check = light_node_queue_pop(q);
-    TEST_CHECK(check == NULL);
+    light_node_queue_free(q);
+}
+
+// Push & pop many nodes, interleaved so that the ring buffer wraps around while it grows. Nodes
+// must come out in the order they've been pushed.
+void test_light_node_queue_wrap_around(void) {
+    LightNodeQueue *q = light_node_queue_new();
+    LightNode check;
+    int16_t pushed = 0, popped = 0;
+    bool ordered = true;
+
+    for (int i = 0; i < 50; ++i) {
+        for (int j = 0; j < 3 * i; ++j) {
+            light_node_queue_push(q, NULL, (SHAPE_COORDS_INT3_T){pushed, 0, 0});
+            pushed++;
+        }
+        for (int j = 0; j < 2 * i; ++j) {
+            TEST_CHECK(light_node_queue_pop(q, &check));
+            ordered = ordered && check.coords.x == popped;
+            popped++;
+        }
+    }
+    TEST_CHECK(light_node_queue_count(q) == (size_t)(pushed - popped));
+    while (light_node_queue_pop(q, &check)) {
+        ordered = ordered && check.coords.x == popped;
+        popped++;
+    }
+    TEST_CHECK(ordered);
+    TEST_CHECK(popped == pushed);
+
+    // cleared queue can be reused
+    light_node_queue_push(q, NULL, (SHAPE_COORDS_INT3_T){1, 2, 3});
+    light_node_queue_clear(q);
+    TEST_CHECK(light_node_queue_pop(q, &check) == false);
 
     light_node_queue_free(q);
 }
@@ -133,8 +149,9 @@ void test_light_node_queue_pop(void) {
 void test_light_removal_node_queue_new(void) {
     LightRemovalNodeQueue *q = light_removal_node_queue_new();
 
-    LightRemovalNode *check = light_removal_node_queue_pop(q);
-    TEST_CHECK(check == NULL);
+    LightRemovalNode check;
+    TEST_CHECK(light_removal_node_queue_pop(q, &check) == false);
+    TEST_CHECK(light_removal_node_queue_count(q) == 0);
 
     light_removal_node_queue_free(q);
 }
@@ -142,7 +159,7 @@ void test_light_removal_node_queue_new(void) {
 // Create a new removal queue and insert a node in it. We now check if the queue isn't empty anymore
 void test_light_removal_node_queue_push(void) {
     const SHAPE_COORDS_INT3_T coords = {-10, 0, 10};
-    LightRemovalNode *check = NULL;
+    LightRemovalNode check;
 
     LightRemovalNodeQueue *q = light_removal_node_queue_new();
     VERTEX_LIGHT_STRUCT_T light;
@@ -151,11 +168,8 @@ void test_light_removal_node_queue_push(void) {
     SHAPE_COLOR_INDEX_INT_T blockID = 100;
     light_removal_node_queue_push(q, NULL, coords, light, srgb, blockID);
 
-    check = light_removal_node_queue_pop(q);
-    TEST_CHECK(check != NULL);
-
-    light_removal_node_free(check);
-    check = NULL;
+    TEST_CHECK(light_removal_node_queue_count(q) == 1);
+    TEST_CHECK(light_removal_node_queue_pop(q, &check));
 
     light_removal_node_queue_free(q);
 }
@@ -164,8 +178,7 @@ void test_light_removal_node_queue_push(void) {
 // is now empty and if the values of the popped value are correct.
 void test_light_removal_node_queue_pop(void) {
     const SHAPE_COORDS_INT3_T coords = {-10, 0, 10};
-    LightRemovalNode *check = NULL;
-    SHAPE_COORDS_INT3_T coordsCheck = {0, 0, 0};
+    LightRemovalNode check;
 
     LightRemovalNodeQueue *q = light_removal_node_queue_new();
     VERTEX_LIGHT_STRUCT_T light;
@@ -174,15 +187,15 @@ void test_light_removal_node_queue_pop(void) {
     SHAPE_COLOR_INDEX_INT_T blockID = 100;
     light_removal_node_queue_push(q, NULL, coords, light, srgb, blockID);
 
-    check = light_removal_node_queue_pop(q);
-    TEST_CHECK(check != NULL);
-    coordsCheck = light_removal_node_get_coords(check);
-
-    light_removal_node_free(check);
-    check = NULL;
-    TEST_CHECK(coordsCheck.x == coords.x);
-    TEST_CHECK(coordsCheck.y == coords.y);
-    TEST_CHECK(coordsCheck.z == coords.z);
+    TEST_CHECK(light_removal_node_queue_pop(q, &check));
+    TEST_CHECK(light_removal_node_queue_pop(q, &check) == false);
+    TEST_CHECK(check.coords.x == coords.x);
+    TEST_CHECK(check.coords.y == coords.y);
+    TEST_CHECK(check.coords.z == coords.z);
+    TEST_CHECK(check.light.ambient == light.ambient);
+    TEST_CHECK(check.light.red == light.red);
+    TEST_CHECK(check.light.green == light.green);
+    TEST_CHECK(check.light.blue == light.blue);
 
     light_removal_node_queue_free(q);
 }
@@ -192,8 +205,7 @@ void test_light_removal_node_queue_pop(void) {
 void test_light_removal_node_get_coords(void) {
     const SHAPE_COORDS_INT3_T coordsA = {-10, 0, 10};
     const SHAPE_COORDS_INT3_T coordsB = {29684, -45, -14556};
-    LightRemovalNode *check = NULL;
-    SHAPE_COORDS_INT3_T coordsCheck = {0, 0, 0};
+    LightRemovalNode check;
 
     LightRemovalNodeQueue *q = light_removal_node_queue_new();
 
@@ -211,25 +223,17 @@ void test_light_removal_node_get_coords(void) {
     SHAPE_COLOR_INDEX_INT_T blockIDB = 255;
     light_removal_node_queue_push(q, NULL, coordsB, lightB, srgbB, blockIDB);
 
-    // Check for Node B
-    check = light_removal_node_queue_pop(q);
-    coordsCheck = light_removal_node_get_coords(check);
-
-    light_removal_node_free(check);
-    check = NULL;
-    TEST_CHECK(coordsCheck.x == coordsB.x);
-    TEST_CHECK(coordsCheck.y == coordsB.y);
-    TEST_CHECK(coordsCheck.z == coordsB.z);
-
     // Check for Node A
-    check = light_removal_node_queue_pop(q);
-    coordsCheck = light_removal_node_get_coords(check);
+    TEST_CHECK(light_removal_node_queue_pop(q, &check));
+    TEST_CHECK(check.coords.x == coordsA.x);
+    TEST_CHECK(check.coords.y == coordsA.y);
+    TEST_CHECK(check.coords.z == coordsA.z);
 
-    light_removal_node_free(check);
-    check = NULL;
-    TEST_CHECK(coordsCheck.x == coordsA.x);
-    TEST_CHECK(coordsCheck.y == coordsA.y);
-    TEST_CHECK(coordsCheck.z == coordsA.z);
+    // Check for Node B
+    TEST_CHECK(light_removal_node_queue_pop(q, &check));
+    TEST_CHECK(check.coords.x == coordsB.x);
+    TEST_CHECK(check.coords.y == coordsB.y);
+    TEST_CHECK(check.coords.z == coordsB.z);
 
     light_removal_node_queue_free(q);
 }
@@ -239,8 +243,7 @@ void test_light_removal_node_get_coords(void) {
 void test_light_removal_node_get_srgb(void) {
     const SHAPE_COORDS_INT3_T coordsA = {-10, 0, 10};
     const SHAPE_COORDS_INT3_T coordsB = {29684, -45, -14556};
-    LightRemovalNode *check = NULL;
-    uint8_t checkSrgb = 0;
+    LightRemovalNode check;
 
     LightRemovalNodeQueue *q = light_removal_node_queue_new();
 
@@ -258,32 +261,23 @@ void test_light_removal_node_get_srgb(void) {
     SHAPE_COLOR_INDEX_INT_T blockIDB = 255;
     light_removal_node_queue_push(q, NULL, coordsB, lightB, srgbB, blockIDB);
 
-    // Check for Node B
-    check = light_removal_node_queue_pop(q);
-    checkSrgb = light_removal_node_get_srgb(check);
-
-    light_removal_node_free(check);
-    check = NULL;
-    TEST_CHECK(checkSrgb == srgbB);
-
     // Check for Node A
-    check = light_removal_node_queue_pop(q);
-    checkSrgb = light_removal_node_get_srgb(check);
+    TEST_CHECK(light_removal_node_queue_pop(q, &check));
+    TEST_CHECK(check.srgb == srgbA);
 
-    light_removal_node_free(check);
-    check = NULL;
-    TEST_CHECK(checkSrgb == srgbA);
+    // Check for Node B
+    TEST_CHECK(light_removal_node_queue_pop(q, &check));
+    TEST_CHECK(check.srgb == srgbB);
 
     light_removal_node_queue_free(q);
 }
 
 // Create a new removal queue and insert 2 different nodes in it. Then we pop them one by one from
-// the queue and check if the coords of the popped node is correct.
+// the queue and check if the block ID of the popped node is correct.
 void test_light_removal_node_get_block_id(void) {
     const SHAPE_COORDS_INT3_T coordsA = {-10, 0, 10};
     const SHAPE_COORDS_INT3_T coordsB = {29684, -45, -14556};
-    LightRemovalNode *check = NULL;
-    SHAPE_COLOR_INDEX_INT_T checkBlockID = 0;
+    LightRemovalNode check;
 
     LightRemovalNodeQueue *q = light_removal_node_queue_new();
 
@@ -301,21 +295,13 @@ void test_light_removal_node_get_block_id(void) {
     SHAPE_COLOR_INDEX_INT_T blockIDB = 255;
     light_removal_node_queue_push(q, NULL, coordsB, lightB, srgbB, blockIDB);
 
-    // Check for Node B
-    check = light_removal_node_queue_pop(q);
-    checkBlockID = light_removal_node_get_block_id(check);
-
-    light_removal_node_free(check);
-    check = NULL;
-    TEST_CHECK(checkBlockID == blockIDB);
-
     // Check for Node A
-    check = light_removal_node_queue_pop(q);
-    checkBlockID = light_removal_node_get_block_id(check);
+    TEST_CHECK(light_removal_node_queue_pop(q, &check));
+    TEST_CHECK(check.blockID == blockIDA);
 
-    light_removal_node_free(check);
-    check = NULL;
-    TEST_CHECK(checkBlockID == blockIDA);
+    // Check for Node B
+    TEST_CHECK(light_removal_node_queue_pop(q, &check));
+    TEST_CHECK(check.blockID == blockIDB);
 
     light_removal_node_queue_free(q);
 }
@@ -12,9 +12,28 @@
 #pragma clang diagnostic pop // ignored "-Wsign-conversion"
 #pragma clang diagnostic pop // ignored "-Wconversion"
 
+// malloc calls made by the current thread, to check that some functions don't allocate. Only
+// counted w/ glibc, where the executable can interpose malloc
+#if defined(__GLIBC__)
+#define TEST_ALLOC_COUNTING 1
+extern void *__libc_malloc(size_t size);
+static __thread size_t test_alloc_count = 0;
+void *malloc(size_t size) {
+    test_alloc_count++;
+    return __libc_malloc(size);
+}
+#else
+#define TEST_ALLOC_COUNTING 0
+static size_t test_alloc_count = 0;
+#endif
+
+#include "test_asset_cache.h"
 #include "test_block.h"
 #include "test_blockChange.h"
 #include "test_box.h"
+#include "test_box_lanes.h"
+#include "test_broadphase.h"
+#include "test_checksum.h"
 #include "test_chunk.h"
 #include "test_config.h"
 #include "test_doubly_linked_list.h"
@@ -35,8 +54,12 @@
 #include "test_matrix4x4.h"
 #include "test_quaternion.h"
 #include "test_rtree.h"
+#include "test_scene.h"
+#include "test_serialization_journal.h"
+#include "test_serialization_v6.h"
 #include "test_shape.h"
 #include "test_stream.h"
+#include "test_thread_pool.h"
 #include "test_transaction.h"
 #include "test_transform.h"
 #include "test_utils.h"
@@ -45,6 +68,12 @@
 
 TEST_LIST = {
 
+    // asset_cache
+    {"asset_cache_load_shape", test_asset_cache_load_shape},
+    {"asset_cache_shared_by_fullnames", test_asset_cache_shared_by_fullnames},
+    {"asset_cache_freed_atlas", test_asset_cache_freed_atlas},
+    {"asset_cache_shared_palette", test_asset_cache_shared_palette},
+
     // block
     {"test_block_new", test_block_new},
     {"test_block_new_air", test_block_new_air},
@@ -81,10 +110,24 @@ TEST_LIST = {
     {"test_box_to_aabox_no_rot", test_box_to_aabox_no_rot},
     {"test_box_to_aabox2", test_box_to_aabox2},
 
+    // box lanes
+    {"box_lanes_collide_epsilon", test_box_lanes_collide_epsilon},
+    {"box_lanes_intersect_ray", test_box_lanes_intersect_ray},
+
+    // broadphase
+    {"broadphase_query_overlap_box", test_broadphase_query_overlap_box},
+    {"broadphase_query_cast_all_ray", test_broadphase_query_cast_all_ray},
+
+    // checksum
+    {"checksum_crc32", test_checksum_crc32},
+    {"checksum_crc32_combine", test_checksum_crc32_combine},
+
     // chunk
     {"test_chunk_new", test_chunk_new},
     {"test_chunk_Block", test_chunk_Block},
     {"test_chunk_needs_display", test_chunk_needs_display},
+    {"test_chunk_uniform_lighting", test_chunk_uniform_lighting},
+    {"test_chunk_copy_on_write", test_chunk_copy_on_write},
 
     // config
     {"test_upper_power_of_two", test_upper_power_of_two},
@@ -219,6 +262,7 @@ TEST_LIST = {
     {"light_node_get_coords", test_light_node_get_coords},
     {"light_node_queue_push", test_light_node_queue_push},
     {"light_node_queue_pop", test_light_node_queue_pop},
+    {"light_node_queue_wrap_around", test_light_node_queue_wrap_around},
     {"light_removal_node_queue_new", test_light_removal_node_queue_new},
     {"light_removal_node_queue_push", test_light_removal_node_queue_push},
     {"light_removal_node_queue_pop", test_light_removal_node_queue_pop},
@@ -296,6 +340,32 @@ TEST_LIST = {
     {"rtree_node_get_groups", test_rtree_node_get_groups},
     {"rtree_node_get_collides_with", test_rtree_node_get_collides_with},
     {"rtree_create_and_insert", test_rtree_create_and_insert},
+    {"rtree_query_overlap_box", test_rtree_query_overlap_box},
+    {"rtree_query_cast_all_ray", test_rtree_query_cast_all_ray},
+    {"rtree_query_array", test_rtree_query_array},
+    {"rtree_query_order", test_rtree_query_order},
+    {"rtree_bulk_load", test_rtree_bulk_load},
+    {"rtree_refresh_collision_masks", test_rtree_refresh_collision_masks},
+
+    // scene
+    {"scene_cast_rays", test_scene_cast_rays},
+    {"scene_register_collision_couple", test_scene_register_collision_couple},
+    {"scene_refresh_islands", test_scene_refresh_islands},
+    {"scene_skip_clean_branches", test_scene_skip_clean_branches},
+
+    // serialization_journal
+    {"serialization_journal_save", test_serialization_journal_save},
+    {"serialization_journal_invalid_record", test_serialization_journal_invalid_record},
+
+    // serialization_v6
+    {"serialization_v6_shape_round_trip", test_serialization_v6_shape_round_trip},
+    {"serialization_v6_children_round_trip", test_serialization_v6_children_round_trip},
+    {"serialization_v6_shape_palette_after_blocks",
+     test_serialization_v6_shape_palette_after_blocks},
+    {"serialization_utils_compress_parallel", test_serialization_utils_compress_parallel},
+    {"serialization_save_shape_async", test_serialization_save_shape_async},
+    {"serialization_save_shape_async_batch_wait",
+     test_serialization_save_shape_async_batch_wait},
 
     // shape
     {"shape_make", test_shape_make},
@@ -312,6 +382,17 @@ TEST_LIST = {
     {"test_shape_addblock_1", test_shape_addblock_1},
     // {"test_shape_addblock_2", test_shape_addblock_2},
     {"test_shape_addblock_3", test_shape_addblock_3},
+    {"shape_compute_baked_lighting_parallel", test_shape_compute_baked_lighting_parallel},
+    {"shape_compute_baked_lighting_sunlight_columns",
+     test_shape_compute_baked_lighting_sunlight_columns},
+    {"shape_lighting_batch", test_shape_lighting_batch},
+    {"shape_lighting_deferred", test_shape_lighting_deferred},
+    {"shape_lighting_deferred_caller_batch", test_shape_lighting_deferred_caller_batch},
+    {"shape_baked_lighting_hash", test_shape_baked_lighting_hash},
+    {"shape_box_overlap_chunks", test_shape_box_overlap_chunks},
+    {"shape_ray_cast", test_shape_ray_cast},
+    {"shape_ray_cast_any_direction", test_shape_ray_cast_any_direction},
+    {"shape_box_cast", test_shape_box_cast},
 
     // stream
     {"stream_new_buffer_read", test_stream_new_buffer_read},
@@ -323,9 +404,17 @@ TEST_LIST = {
     {"stream_read_float32", test_stream_read_float32},
     {"stream_read_string", test_stream_read_string},
     {"stream_skip", test_stream_skip},
+    {"stream_get_size", test_stream_get_size},
     {"stream_get_cursor_position", test_stream_get_cursor_position},
     {"stream_set_cursor_position", test_stream_set_cursor_position},
     {"stream_reached_the_end", test_stream_reached_the_end},
+    {"stream_new_mmap_read", test_stream_new_mmap_read},
+    {"stream_borrow", test_stream_borrow},
+
+    // thread_pool
+    {"thread_pool_add_job", test_thread_pool_add_job},
+    {"thread_pool_batch", test_thread_pool_batch},
+    {"thread_pool_batch_wait_own_jobs", test_thread_pool_batch_wait_own_jobs},
 
     // transaction
     {"transaction_new", test_transaction_new},
@@ -6,6 +6,7 @@
 
 #pragma once
 
+#include "ray.h"
 #include "rtree.h"
 #include "transform.h"
 
@@ -13,19 +14,16 @@
 // rtree_get_height
 // rtree_get_root
 // rtree_node_get_children_count
-// rtree_node_get_children_iterator
+// rtree_node_get_child
 // rtree_node_get_leaf_ptr
 // rtree_node_is_leaf
 // rtree_node_set_collision_masks
 // rtree_recurse
 // rtree_insert
-// rtree_remove
 // rtree_find_and_remove
 // rtree_refresh_collision_masks
 // rtree_query_overlap_func
-// rtree_query_overlap_box
 // rtree_query_cast_all_func
-// rtree_query_cast_all_ray
 // rtree_query_cast_all_box_step_func
 // rtree_query_cast_all_box
 // rtree_utils_broadphase_steps
@@ -104,3 +102,335 @@ void test_rtree_create_and_insert(void) {
     rtree_free(r);
     transform_release(t);
 }
+
+// pseudo-random boxes, deterministic
+static Box _test_rtree_random_box(uint32_t *seed, float size) {
+    float v[6];
+    for (int i = 0; i < 6; ++i) {
+        *seed = *seed * 1103515245 + 12345;
+        v[i] = (float)((*seed >> 8) & 0xffff) / 65536.0f;
+    }
+    const Box b = {{v[0] * 100.0f, v[1] * 100.0f, v[2] * 100.0f},
+                   {v[0] * 100.0f + 0.5f + v[3] * size,
+                    v[1] * 100.0f + 0.5f + v[4] * size,
+                    v[2] * 100.0f + 0.5f + v[5] * size}};
+    return b;
+}
+
+// queries must find the same leaves as a brute-force test against all inserted boxes,
+// after insertions w/ many splits & after removals w/ condensing
+void test_rtree_query_overlap_box(void) {
+    Rtree *r = rtree_new(2, 4);
+    Box boxes[500];
+    RtreeNode *leaves[500];
+    uint32_t seed = 7;
+    for (uintptr_t i = 0; i < 500; ++i) {
+        boxes[i] = _test_rtree_random_box(&seed, 4.0f);
+        leaves[i] = rtree_create_and_insert(r, &boxes[i], 1, 1, (void *)(i + 1));
+    }
+    FifoList *results = fifo_list_new();
+
+    for (int pass = 0; pass < 2; ++pass) {
+        for (int q = 0; q < 50; ++q) {
+            const Box query = _test_rtree_random_box(&seed, 20.0f);
+            size_t expected = 0;
+            for (int i = 0; i < 500; ++i) {
+                if (leaves[i] != NULL && box_collide_epsilon(&boxes[i], &query, EPSILON_ZERO)) {
+                    expected++;
+                }
+            }
+            const size_t hits =
+                rtree_query_overlap_box(r, &query, 1, 1, NULL, results, EPSILON_ZERO);
+            TEST_CHECK(hits == expected);
+            while (fifo_list_pop(results) != NULL) {}
+        }
+
+        // remove every other leaf before second pass
+        if (pass == 0) {
+            for (int i = 0; i < 500; i += 2) {
+                rtree_remove(r, leaves[i], true);
+                leaves[i] = NULL;
+            }
+        }
+    }
+
+    fifo_list_free(results, NULL);
+    rtree_free(r);
+}
+
+void test_rtree_query_cast_all_ray(void) {
+    Rtree *r = rtree_new(2, 4);
+    Box boxes[500];
+    uint32_t seed = 11;
+    for (uintptr_t i = 0; i < 500; ++i) {
+        boxes[i] = _test_rtree_random_box(&seed, 4.0f);
+        rtree_create_and_insert(r, &boxes[i], 1, 1, (void *)(i + 1));
+    }
+    DoublyLinkedList *results = doubly_linked_list_new();
+
+    for (int q = 0; q < 50; ++q) {
+        const Box b = _test_rtree_random_box(&seed, 1.0f);
+        const float3 origin = {b.min.x, b.min.y, 0.0f};
+        const float3 dir = {b.max.x - b.min.x - 0.5f, 0.1f, 1.0f};
+        Ray *ray = ray_new(&origin, &dir);
+        size_t expected = 0;
+        float distance;
+        for (int i = 0; i < 500; ++i) {
+            if (ray_intersect_with_box(ray, &boxes[i].min, &boxes[i].max, &distance)) {
+                expected++;
+            }
+        }
+        const size_t hits = rtree_query_cast_all_ray(r, ray, 1, 1, NULL, results);
+        TEST_CHECK(hits == expected);
+        doubly_linked_list_flush(results, free);
+        ray_free(ray);
+    }
+
+    doubly_linked_list_free(results);
+    rtree_free(r);
+}
+
+// check that array queries find the same leaves as list queries, up to capacity, w/o allocation
+void test_rtree_query_array(void) {
+    Rtree *r = rtree_new(2, 4);
+    Box boxes[500];
+    uint32_t seed = 13;
+    for (uintptr_t i = 0; i < 500; ++i) {
+        boxes[i] = _test_rtree_random_box(&seed, 4.0f);
+        rtree_create_and_insert(r, &boxes[i], 1, 1, (void *)(i + 1));
+    }
+    FifoList *overlapList = fifo_list_new();
+    DoublyLinkedList *castList = doubly_linked_list_new();
+    RtreeNode *overlapArray[500];
+    RtreeCastResult castArray[500];
+
+    for (int q = 0; q < 50; ++q) {
+        const Box query = _test_rtree_random_box(&seed, 20.0f);
+        const float3 origin = {query.min.x, query.min.y, 0.0f};
+        const float3 dir = {query.max.x - query.min.x - 0.5f, 0.1f, 1.0f};
+        Ray *ray = ray_new(&origin, &dir);
+
+        const size_t overlaps =
+            rtree_query_overlap_box(r, &query, 1, 1, NULL, overlapList, EPSILON_ZERO);
+        const size_t casts = rtree_query_cast_all_ray(r, ray, 1, 1, NULL, castList);
+
+        const size_t allocs = test_alloc_count;
+        const size_t capacity = (size_t)q % 10;
+        TEST_CHECK(rtree_query_overlap_box_array(r,
+                                                 &query,
+                                                 1,
+                                                 1,
+                                                 NULL,
+                                                 overlapArray,
+                                                 capacity,
+                                                 EPSILON_ZERO) == overlaps);
+        TEST_CHECK(rtree_query_overlap_box_array(r,
+                                                 &query,
+                                                 1,
+                                                 1,
+                                                 NULL,
+                                                 overlapArray,
+                                                 500,
+                                                 EPSILON_ZERO) == overlaps);
+        TEST_CHECK(rtree_query_cast_all_ray_array(r, ray, 1, 1, NULL, castArray, 500) == casts);
+        rtree_utils_sort_results(castArray, casts);
+        TEST_CHECK(TEST_ALLOC_COUNTING == 0 || test_alloc_count == allocs);
+
+        for (size_t i = 0; i < overlaps; ++i) {
+            TEST_CHECK(box_collide_epsilon(rtree_node_get_aabb(overlapArray[i]),
+                                           &query,
+                                           EPSILON_ZERO));
+            TEST_CHECK(fifo_list_pop(overlapList) != NULL);
+        }
+        for (size_t i = 0; i < casts; ++i) {
+            TEST_CHECK(i == 0 || castArray[i - 1].distance <= castArray[i].distance);
+        }
+        doubly_linked_list_flush(castList, free);
+        ray_free(ray);
+    }
+
+    fifo_list_free(overlapList, NULL);
+    doubly_linked_list_free(castList);
+    rtree_free(r);
+}
+
+// queries list leaves breadth-first, including when more nodes are pending than the query queue
+// keeps on the stack
+void test_rtree_query_order(void) {
+    Rtree *r = rtree_new(2, 4);
+    Box boxes[3000];
+    uint32_t seed = 17;
+    for (uintptr_t i = 0; i < 3000; ++i) {
+        boxes[i] = _test_rtree_random_box(&seed, 4.0f);
+        rtree_create_and_insert(r, &boxes[i], 1, 1, (void *)(i + 1));
+    }
+
+    // reference breadth-first traversal
+    RtreeNode **expected = (RtreeNode **)malloc(3000 * sizeof(RtreeNode *));
+    size_t nbExpected = 0;
+    FifoList *toExamine = fifo_list_new();
+    RtreeNode *rn = rtree_get_root(r);
+    while (rn != NULL) {
+        for (uint8_t i = 0; i < rtree_node_get_children_count(rn); ++i) {
+            RtreeNode *child = rtree_node_get_child(rn, i);
+            if (rtree_node_is_leaf(child)) {
+                expected[nbExpected++] = child;
+            } else {
+                fifo_list_push(toExamine, child);
+            }
+        }
+        rn = (RtreeNode *)fifo_list_pop(toExamine);
+    }
+    fifo_list_free(toExamine, NULL);
+    TEST_ASSERT(nbExpected == 3000);
+
+    const Box all = {{-1.0f, -1.0f, -1.0f}, {200.0f, 200.0f, 200.0f}};
+    FifoList *results = fifo_list_new();
+    TEST_CHECK(rtree_query_overlap_box(r, &all, 1, 1, NULL, results, EPSILON_ZERO) == 3000);
+    bool sameOrder = true;
+    for (size_t i = 0; i < nbExpected; ++i) {
+        sameOrder = sameOrder && fifo_list_pop(results) == expected[i];
+    }
+    TEST_CHECK(sameOrder);
+
+    RtreeNode **resultsArray = (RtreeNode **)malloc(3000 * sizeof(RtreeNode *));
+    TEST_CHECK(rtree_query_overlap_box_array(r,
+                                             &all,
+                                             1,
+                                             1,
+                                             NULL,
+                                             resultsArray,
+                                             3000,
+                                             EPSILON_ZERO) == 3000);
+    TEST_CHECK(memcmp(resultsArray, expected, 3000 * sizeof(RtreeNode *)) == 0);
+
+    free(resultsArray);
+    fifo_list_free(results, NULL);
+    free(expected);
+    rtree_free(r);
+}
+
+// checks that all leaves are at given depth & that nodes other than the root are within capacity
+static bool _test_rtree_check_node(const RtreeNode *rn, uint16_t depth, uint16_t h, bool isRoot) {
+    const uint8_t count = rtree_node_get_children_count(rn);
+    if (rtree_node_get_leaf_ptr(rn) != NULL) {
+        return depth == h + 1 && count == 0;
+    }
+    if (isRoot == false && (count < 2 || count > 4)) {
+        return false;
+    }
+    for (uint8_t i = 0; i < count; ++i) {
+        if (_test_rtree_check_node(rtree_node_get_child(rn, i), depth + 1, h, false) == false) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// bulk-loaded tree must be valid & find the same leaves as a brute-force test, then remain valid
+// w/ successive updates
+void test_rtree_bulk_load(void) {
+    Box boxes[500];
+    RtreeNode *leaves[500], *bulk[500];
+    uint32_t seed = 13;
+
+    for (size_t count = 1; count <= 500; count += 499) {
+        Rtree *r = rtree_new(2, 4);
+        for (uintptr_t i = 0; i < count; ++i) {
+            boxes[i] = _test_rtree_random_box(&seed, 4.0f);
+            leaves[i] = rtree_create_leaf(r, &boxes[i], 1, 1, (void *)(i + 1));
+            bulk[i] = leaves[i];
+        }
+        rtree_bulk_load(r, bulk, count);
+        TEST_CHECK(_test_rtree_check_node(rtree_get_root(r), 1, rtree_get_height(r), true));
+
+        FifoList *results = fifo_list_new();
+        for (int pass = 0; pass < 2; ++pass) {
+            for (int q = 0; q < 50; ++q) {
+                const Box query = _test_rtree_random_box(&seed, 20.0f);
+                size_t expected = 0;
+                for (size_t i = 0; i < count; ++i) {
+                    if (leaves[i] != NULL &&
+                        box_collide_epsilon(&boxes[i], &query, EPSILON_ZERO)) {
+                        expected++;
+                    }
+                }
+                const size_t hits =
+                    rtree_query_overlap_box(r, &query, 1, 1, NULL, results, EPSILON_ZERO);
+                TEST_CHECK(hits == expected);
+                while (fifo_list_pop(results) != NULL) {}
+            }
+
+            // remove a third of the leaves & insert some more before second pass
+            if (pass == 0) {
+                for (size_t i = 0; i < count; i += 3) {
+                    rtree_remove(r, leaves[i], true);
+                    leaves[i] = NULL;
+                }
+                for (size_t i = 1; i < count; i += 3) {
+                    boxes[i] = _test_rtree_random_box(&seed, 4.0f);
+                    rtree_update(r, leaves[i], &boxes[i]);
+                }
+                TEST_CHECK(
+                    _test_rtree_check_node(rtree_get_root(r), 1, rtree_get_height(r), true));
+            }
+        }
+
+        fifo_list_free(results, NULL);
+        rtree_free(r);
+    }
+}
+
+// internal nodes collision masks include those of their children, removed leaves masks may remain
+static bool _test_rtree_check_masks(RtreeNode *rn) {
+    if (rtree_node_is_leaf(rn)) {
+        return true;
+    }
+    uint16_t groups = 0, collidesWith = 0;
+    for (uint8_t i = 0; i < rtree_node_get_children_count(rn); ++i) {
+        RtreeNode *child = rtree_node_get_child(rn, i);
+        if (_test_rtree_check_masks(child) == false) {
+            return false;
+        }
+        groups |= rtree_node_get_groups(child);
+        collidesWith |= rtree_node_get_collides_with(child);
+    }
+    return (groups & ~rtree_node_get_groups(rn)) == 0 &&
+           (collidesWith & ~rtree_node_get_collides_with(rn)) == 0;
+}
+
+// check that refreshing collision masks after some leaves changed or moved, gives ancestors masks
+// including those of all their leaves
+void test_rtree_refresh_collision_masks(void) {
+    RtreeNode *leaves[300];
+    uint32_t seed = 21;
+
+    Rtree *r = rtree_new(2, 4);
+    for (uintptr_t i = 0; i < 300; ++i) {
+        Box box = _test_rtree_random_box(&seed, 4.0f);
+        leaves[i] = rtree_create_and_insert(r, &box, 1, 1, (void *)(i + 1));
+    }
+    rtree_refresh_collision_masks(r);
+    TEST_CHECK(_test_rtree_check_masks(rtree_get_root(r)));
+    TEST_CHECK(rtree_node_get_groups(rtree_get_root(r)) == 1);
+
+    for (int pass = 0; pass < 3; ++pass) {
+        for (size_t i = (size_t)pass; i < 300; i += 7) {
+            rtree_node_set_collision_masks(leaves[i], (uint16_t)(2 << pass), 1);
+        }
+        for (size_t i = (size_t)pass + 1; i < 300; i += 11) {
+            Box box = _test_rtree_random_box(&seed, 4.0f);
+            rtree_update(r, leaves[i], &box);
+        }
+        if (pass == 1) {
+            for (size_t i = 0; i < 300; i += 2) {
+                rtree_node_set_collision_masks(leaves[i], 1, 8);
+            }
+        }
+        rtree_refresh_collision_masks(r);
+        TEST_CHECK(_test_rtree_check_masks(rtree_get_root(r)));
+    }
+    TEST_CHECK(rtree_node_get_collides_with(rtree_get_root(r)) == (1 | 8));
+
+    rtree_free(r);
+}
@@ -0,0 +1,479 @@
+// -------------------------------------------------------------
+//  Cubzh Core Unit Tests
+//  test_scene.h
+// -------------------------------------------------------------
+
+#pragma once
+
+#include "color_atlas.h"
+#include "color_palette.h"
+#include "rigidBody.h"
+#include "scene.h"
+#include "shape.h"
+#include "thread_pool.h"
+#include "transform.h"
+
+#define TEST_SCENE_TRANSFORMS 300
+#define TEST_SCENE_RAYS 500
+#define TEST_SCENE_COUPLES 200
+#define TEST_SCENE_BODIES 150
+#define TEST_SCENE_STEPS 60
+#define TEST_SCENE_GROUPS 8
+#define TEST_SCENE_GROUP_CHILDREN 10
+
+static float _test_scene_random(uint32_t *seed) {
+    *seed = *seed * 1103515245 + 12345;
+    return (float)((*seed >> 8) & 0xffff) / 65536.0f;
+}
+
+// check that batched ray casts give the same results as single ray casts, w/ static, rotated &
+// dynamic colliders, a per-block shape, groups & filters
+void test_scene_cast_rays(void) {
+    Scene *sc = scene_new(NULL);
+    Transform *transforms[TEST_SCENE_TRANSFORMS];
+    uint32_t seed = 3;
+
+    for (int i = 0; i < TEST_SCENE_TRANSFORMS; ++i) {
+        Transform *t = transform_make(PointTransform);
+        RigidBody *rb;
+        const uint16_t groups = i % 3 == 0 ? 2 : 1;
+        transform_ensure_rigidbody(t,
+                                   i % 4 == 0 ? RigidbodyMode_Dynamic : RigidbodyMode_Static,
+                                   groups,
+                                   groups,
+                                   &rb);
+        const Box collider = {{0.0f, 0.0f, 0.0f}, {4.0f, 4.0f, 4.0f}};
+        rigidbody_set_collider(rb, &collider, true);
+        transform_set_position(t,
+                               _test_scene_random(&seed) * 100.0f,
+                               _test_scene_random(&seed) * 20.0f,
+                               _test_scene_random(&seed) * 100.0f);
+        if (i % 5 == 0) {
+            transform_set_rotation_euler(t, 0.0f, _test_scene_random(&seed) * 3.0f, 0.4f);
+        }
+        transform_set_parent(t, scene_get_root(sc), false);
+        transforms[i] = t;
+    }
+
+    // terrain w/ holes, per-block collisions
+    ColorAtlas *atlas = color_atlas_new();
+    ColorPalette *p = color_palette_new(atlas);
+    SHAPE_COLOR_INDEX_INT_T color;
+    color_palette_check_and_add_color(p, (RGBAColor){90, 140, 60, 255}, &color, false);
+    Shape *s = shape_make();
+    shape_set_palette(s, p, false);
+    for (SHAPE_COORDS_INT_T x = 0; x < 40; ++x) {
+        for (SHAPE_COORDS_INT_T z = 0; z < 40; ++z) {
+            const SHAPE_COORDS_INT_T h = (SHAPE_COORDS_INT_T)(1 + (x / 4 + z / 3) % 5);
+            for (SHAPE_COORDS_INT_T y = 0; y < h; ++y) {
+                if ((x * 7 + z * 3 + y) % 5 != 0) {
+                    shape_add_block(s, color, x, y, z, false);
+                }
+            }
+        }
+    }
+    RigidBody *shapeRb;
+    shape_ensure_rigidbody(s, 1, 1, &shapeRb);
+    rigidbody_set_simulation_mode(shapeRb, RigidbodyMode_StaticPerBlock);
+    shape_fit_collider_to_bounding_box(s);
+    transform_set_position(shape_get_root_transform(s), 20.0f, -5.0f, 30.0f);
+    transform_set_rotation_euler(shape_get_root_transform(s), 0.0f, 0.3f, 0.0f);
+    transform_set_parent(shape_get_root_transform(s), scene_get_root(sc), false);
+
+    scene_refresh(sc, 1.0 / 60.0, NULL);
+    scene_end_of_frame_refresh(sc, NULL);
+
+    DoublyLinkedList *filter = doubly_linked_list_new();
+    doubly_linked_list_push_last(filter, transforms[1]);
+    doubly_linked_list_push_last(filter, shape_get_root_transform(s));
+
+    Ray *rays[TEST_SCENE_RAYS];
+    CastRayQuery queries[TEST_SCENE_RAYS];
+    CastResult results[TEST_SCENE_RAYS];
+    for (int i = 0; i < TEST_SCENE_RAYS; ++i) {
+        const float3 origin = {_test_scene_random(&seed) * 100.0f,
+                               30.0f,
+                               _test_scene_random(&seed) * 100.0f};
+        const float3 dir = {_test_scene_random(&seed) - 0.5f,
+                            -_test_scene_random(&seed),
+                            _test_scene_random(&seed) - 0.5f};
+        rays[i] = ray_new(&origin, &dir);
+        queries[i].worldRay = rays[i];
+        queries[i].groups = i % 2 == 0 ? 1 : 3;
+        queries[i].filterOutTransforms = i % 7 == 0 ? filter : NULL;
+    }
+
+    // single job, then several jobs
+    for (size_t count = 20; count <= TEST_SCENE_RAYS; count += TEST_SCENE_RAYS - 20) {
+        const size_t hits = scene_cast_rays(sc, queries, count, results);
+
+        size_t expectedHits = 0, blockHits = 0;
+        CastResult expected;
+        for (size_t i = 0; i < count; ++i) {
+            const HitType type = scene_cast_ray(sc,
+                                                queries[i].worldRay,
+                                                queries[i].groups,
+                                                queries[i].filterOutTransforms,
+                                                &expected);
+            if (type != Hit_None) {
+                expectedHits++;
+            }
+            if (type == Hit_Block) {
+                blockHits++;
+            }
+            TEST_CHECK(results[i].type == type);
+            TEST_CHECK(results[i].hitTr == expected.hitTr);
+            TEST_CHECK(results[i].block == expected.block);
+            TEST_CHECK(results[i].distance == expected.distance);
+            TEST_CHECK(results[i].faceTouched == expected.faceTouched);
+            TEST_CHECK(results[i].blockCoords.x == expected.blockCoords.x &&
+                       results[i].blockCoords.y == expected.blockCoords.y &&
+                       results[i].blockCoords.z == expected.blockCoords.z);
+        }
+        TEST_CHECK(hits == expectedHits);
+        TEST_CHECK(blockHits > 0 && blockHits < expectedHits);
+    }
+
+    for (int i = 0; i < TEST_SCENE_RAYS; ++i) {
+        ray_free(rays[i]);
+    }
+    doubly_linked_list_free(filter);
+    for (int i = 0; i < TEST_SCENE_TRANSFORMS; ++i) {
+        transform_release(transforms[i]);
+    }
+    scene_free(sc);
+    shape_release(s);
+    color_atlas_free(atlas);
+}
+
+static void _test_scene_collision_end_func(CollisionCallbackType type,
+                                           Transform *self,
+                                           RigidBody *selfRb,
+                                           Transform *other,
+                                           RigidBody *otherRb,
+                                           float3 wNormal,
+                                           void *callbackData) {
+    if (type == CollisionCallbackType_End) {
+        (*(int *)callbackData)++;
+    }
+}
+
+static Transform *_test_scene_make_couple_transform(void) {
+    Transform *t = transform_make(PointTransform);
+    RigidBody *rb;
+    transform_ensure_rigidbody(t, RigidbodyMode_Static, 1, 1, &rb);
+    rigidbody_toggle_collision_callback(rb, CollisionCallbackType_End, true);
+    return t;
+}
+
+// check couples status over several frames, end-of-contact callbacks for couples no longer
+// registered, couples of removed transforms & recycled transform IDs
+void test_scene_register_collision_couple(void) {
+    Scene *sc = scene_new(NULL);
+    Transform *transforms[TEST_SCENE_COUPLES + 1];
+    for (int i = 0; i <= TEST_SCENE_COUPLES; ++i) {
+        transforms[i] = _test_scene_make_couple_transform();
+    }
+    rigidbody_set_collision_callback(_test_scene_collision_end_func);
+    int ends = 0;
+
+    // new couples begin, then are discarded for the rest of the frame, in any order
+    for (int i = 0; i < TEST_SCENE_COUPLES; ++i) {
+        float3 normal = {(float)i, 0.0f, 0.0f};
+        TEST_CHECK(scene_register_collision_couple(sc, transforms[i], transforms[i + 1], &normal) ==
+                   CollisionCoupleStatus_Begin);
+    }
+    for (int i = 0; i < TEST_SCENE_COUPLES; ++i) {
+        float3 normal = float3_zero;
+        TEST_CHECK(scene_register_collision_couple(sc, transforms[i + 1], transforms[i], &normal) ==
+                   CollisionCoupleStatus_Discard);
+        TEST_CHECK(normal.x == (float)i);
+    }
+    scene_end_of_frame_refresh(sc, &ends);
+    TEST_CHECK(ends == 0);
+
+    // existing couples tick w/o allocation, others end
+    const size_t allocs = test_alloc_count;
+    for (int i = 0; i < TEST_SCENE_COUPLES; i += 2) {
+        float3 normal = float3_zero;
+        TEST_CHECK(scene_register_collision_couple(sc, transforms[i], transforms[i + 1], &normal) ==
+                   CollisionCoupleStatus_Tick);
+        TEST_CHECK(normal.x == (float)i);
+        TEST_CHECK(scene_register_collision_couple(sc, transforms[i], transforms[i + 1], &normal) ==
+                   CollisionCoupleStatus_Discard);
+    }
+    TEST_CHECK(TEST_ALLOC_COUNTING == 0 || test_alloc_count == allocs);
+    scene_end_of_frame_refresh(sc, &ends);
+    TEST_CHECK(ends == TEST_SCENE_COUPLES); // 2 callbacks for each of half the couples
+
+    // ended couples begin again
+    float3 normal = float3_zero;
+    TEST_CHECK(scene_register_collision_couple(sc, transforms[1], transforms[2], &normal) ==
+               CollisionCoupleStatus_Begin);
+    TEST_CHECK(scene_register_collision_couple(sc, transforms[0], transforms[1], &normal) ==
+               CollisionCoupleStatus_Tick);
+
+    // a removed transform ends its couple w/o callback, its ID is given to a new transform
+    const uint16_t id = transform_get_id(transforms[0]);
+    transform_release(transforms[0]);
+    transforms[0] = _test_scene_make_couple_transform();
+    TEST_CHECK(transform_get_id(transforms[0]) == id);
+    TEST_CHECK(scene_register_collision_couple(sc, transforms[0], transforms[1], &normal) ==
+               CollisionCoupleStatus_Begin);
+    ends = 0;
+    scene_end_of_frame_refresh(sc, &ends);
+    TEST_CHECK(ends == TEST_SCENE_COUPLES - 2);
+    ends = 0;
+    scene_end_of_frame_refresh(sc, &ends);
+    TEST_CHECK(ends == 4);
+
+    rigidbody_set_collision_callback(NULL);
+    for (int i = 0; i <= TEST_SCENE_COUPLES; ++i) {
+        transform_release(transforms[i]);
+    }
+    scene_free(sc);
+}
+
+static void _test_scene_collision_count_func(CollisionCallbackType type,
+                                             Transform *self,
+                                             RigidBody *selfRb,
+                                             Transform *other,
+                                             RigidBody *otherRb,
+                                             float3 wNormal,
+                                             void *callbackData) {
+    (*(int *)callbackData)++;
+}
+
+// dynamic rigidbodies thrown over a bumpy per-block terrain, crowded ones push each other
+static Scene *_test_scene_make_bodies(ColorAtlas *atlas,
+                                      bool crowded,
+                                      Transform **bodies,
+                                      Shape **terrain) {
+    Scene *sc = scene_new(NULL);
+    const float gravity = -200.0f;
+    scene_set_constant_acceleration(sc, NULL, &gravity, NULL);
+
+    ColorPalette *p = color_palette_new(atlas);
+    SHAPE_COLOR_INDEX_INT_T color;
+    color_palette_check_and_add_color(p, (RGBAColor){90, 140, 60, 255}, &color, false);
+    Shape *s = shape_make();
+    shape_set_palette(s, p, false);
+    for (SHAPE_COORDS_INT_T x = 0; x < 48; ++x) {
+        for (SHAPE_COORDS_INT_T z = 0; z < 48; ++z) {
+            const SHAPE_COORDS_INT_T h = (SHAPE_COORDS_INT_T)(1 + (x / 3 + z / 5) % 4);
+            for (SHAPE_COORDS_INT_T y = 0; y < h; ++y) {
+                shape_add_block(s, color, x, y, z, false);
+            }
+        }
+    }
+    RigidBody *rb;
+    shape_ensure_rigidbody(s, 1, 1, &rb);
+    rigidbody_set_simulation_mode(rb, RigidbodyMode_StaticPerBlock);
+    shape_fit_collider_to_bounding_box(s);
+    transform_set_parent(shape_get_root_transform(s), scene_get_root(sc), false);
+    *terrain = s;
+
+    uint32_t seed = 7;
+    const float spacing = crowded ? 1.5f : 4.0f;
+    const Box collider = {{-0.5f, 0.0f, -0.5f}, {0.5f, 1.0f, 0.5f}};
+    for (int i = 0; i < TEST_SCENE_BODIES; ++i) {
+        Transform *t = transform_make(PointTransform);
+        transform_ensure_rigidbody(t, RigidbodyMode_Dynamic, 1, 1, &rb);
+        rigidbody_set_collider(rb, &collider, true);
+        if (i % 3 == 0) {
+            rigidbody_toggle_collision_callback(rb, CollisionCallbackType_Begin, true);
+        }
+        const float speed = crowded ? 20.0f : 2.0f;
+        const float3 v = {(_test_scene_random(&seed) - 0.5f) * speed,
+                          0.0f,
+                          (_test_scene_random(&seed) - 0.5f) * speed};
+        rigidbody_set_velocity(rb, &v);
+        transform_set_position(t,
+                               4.0f + (float)(i % 10) * spacing,
+                               8.0f + (float)(i / 50) * 2.0f,
+                               4.0f + (float)(i / 10 % 5) * spacing);
+        transform_set_parent(t, scene_get_root(sc), false);
+        bodies[i] = t;
+    }
+    return sc;
+}
+
+// check that islands solved in parallel give the same results w/ any number of workers, and the
+// same results as solving rigidbodies one by one if they don't touch each other
+void test_scene_refresh_islands(void) {
+    ColorAtlas *atlas = color_atlas_new();
+    ThreadPool *pools[2] = {thread_pool_new(1), thread_pool_new(4)};
+    rigidbody_set_collision_callback(_test_scene_collision_count_func);
+
+    for (int crowded = 0; crowded < 2; ++crowded) {
+        Scene *scenes[3];
+        Shape *terrains[3];
+        Transform *bodies[3][TEST_SCENE_BODIES];
+        int collisions[3] = {0, 0, 0};
+        for (int k = 0; k < 3; ++k) {
+            scenes[k] = _test_scene_make_bodies(atlas, crowded, bodies[k], &terrains[k]);
+            scene_set_physics_thread_pool(scenes[k], k > 0 ? pools[k - 1] : NULL);
+        }
+
+        for (int step = 0; step < TEST_SCENE_STEPS; ++step) {
+            for (int k = 0; k < 3; ++k) {
+                scene_refresh(scenes[k], 1.0 / 60.0, &collisions[k]);
+                scene_end_of_frame_refresh(scenes[k], &collisions[k]);
+            }
+        }
+
+        int landed = 0, sameAsSerial = 0;
+        for (int i = 0; i < TEST_SCENE_BODIES; ++i) {
+            const float3 *pos = transform_get_position(bodies[0][i]);
+            const float3 *pos1 = transform_get_position(bodies[1][i]);
+            const float3 *pos2 = transform_get_position(bodies[2][i]);
+            TEST_CHECK(pos1->x == pos2->x && pos1->y == pos2->y && pos1->z == pos2->z);
+            if (pos->x == pos1->x && pos->y == pos1->y && pos->z == pos1->z) {
+                sameAsSerial++;
+            }
+            if (rigidbody_has_contact(transform_get_rigidbody(bodies[1][i]), AxesMaskNY)) {
+                landed++;
+            }
+        }
+        TEST_CHECK(collisions[1] == collisions[2]);
+        TEST_CHECK(landed > TEST_SCENE_BODIES / 2);
+        if (crowded == 0) {
+            TEST_CHECK(sameAsSerial == TEST_SCENE_BODIES);
+            TEST_CHECK(collisions[0] == collisions[1]);
+        }
+        TEST_CHECK(collisions[1] > 0);
+
+        for (int k = 0; k < 3; ++k) {
+            for (int i = 0; i < TEST_SCENE_BODIES; ++i) {
+                transform_release(bodies[k][i]);
+            }
+            scene_free(scenes[k]);
+            shape_release(terrains[k]);
+        }
+    }
+
+    rigidbody_set_collision_callback(NULL);
+    thread_pool_free(pools[0]);
+    thread_pool_free(pools[1]);
+    color_atlas_free(atlas);
+}
+
+static void _test_scene_step(Scene *sc) {
+    scene_refresh(sc, 1.0 / 60.0, NULL);
+    scene_end_of_frame_refresh(sc, NULL);
+}
+
+static bool _test_scene_is_branch_dirty(Transform *t) {
+    return transform_is_branch_dirty(t, false) || transform_is_branch_dirty(t, true);
+}
+
+// check that refresh passes skip clean branches, while branches changed since their last visit are
+// refreshed: moved & re-parented transforms, rigidbodies changes, shapes transactions
+void test_scene_skip_clean_branches(void) {
+    Scene *sc = scene_new(NULL);
+    Transform *groups[TEST_SCENE_GROUPS];
+    Transform *children[TEST_SCENE_GROUPS][TEST_SCENE_GROUP_CHILDREN];
+    const Box collider = {{0.0f, 0.0f, 0.0f}, {1.0f, 1.0f, 1.0f}};
+    RigidBody *rb;
+
+    for (int i = 0; i < TEST_SCENE_GROUPS; ++i) {
+        groups[i] = transform_make(PointTransform);
+        transform_set_position(groups[i], (float)i * 10.0f, 0.0f, 0.0f);
+        transform_set_parent(groups[i], scene_get_root(sc), false);
+        for (int j = 0; j < TEST_SCENE_GROUP_CHILDREN; ++j) {
+            Transform *t = transform_make(PointTransform);
+            transform_ensure_rigidbody(t, RigidbodyMode_Static, 1, 1, &rb);
+            rigidbody_set_collider(rb, &collider, true);
+            transform_set_local_position(t, 0.0f, 0.0f, (float)j * 2.0f);
+            transform_set_parent(t, groups[i], false);
+            children[i][j] = t;
+        }
+    }
+
+    ColorAtlas *atlas = color_atlas_new();
+    ColorPalette *p = color_palette_new(atlas);
+    SHAPE_COLOR_INDEX_INT_T color;
+    color_palette_check_and_add_color(p, (RGBAColor){90, 140, 60, 255}, &color, false);
+    Shape *s = shape_make();
+    shape_set_palette(s, p, false);
+    shape_add_block(s, color, 0, 0, 0, false);
+    shape_ensure_rigidbody(s, 1, 1, &rb);
+    shape_fit_collider_to_bounding_box(s);
+    transform_set_parent(shape_get_root_transform(s), groups[1], false);
+
+    // new transforms are refreshed, then all branches are clean
+    _test_scene_step(sc);
+    TEST_CHECK(_test_scene_is_branch_dirty(scene_get_root(sc)) == false);
+    TEST_CHECK(rtree_node_get_aabb(rigidbody_get_rtree_leaf(
+                                       transform_get_rigidbody(children[2][3])))
+                   ->min.z == 6.0f);
+
+    // moved transform flags its ancestors only
+    transform_set_position(children[2][3], 20.0f, 5.0f, 6.0f);
+    TEST_CHECK(_test_scene_is_branch_dirty(children[2][3]));
+    TEST_CHECK(_test_scene_is_branch_dirty(groups[2]));
+    TEST_CHECK(_test_scene_is_branch_dirty(scene_get_root(sc)));
+    TEST_CHECK(_test_scene_is_branch_dirty(groups[3]) == false);
+    TEST_CHECK(_test_scene_is_branch_dirty(children[2][4]) == false);
+    _test_scene_step(sc);
+    TEST_CHECK(_test_scene_is_branch_dirty(scene_get_root(sc)) == false);
+    RtreeNode *leaf = rigidbody_get_rtree_leaf(transform_get_rigidbody(children[2][3]));
+    TEST_CHECK(rtree_node_get_aabb(leaf)->min.y == 5.0f);
+
+    // moved group refreshes its whole branch
+    transform_set_position(groups[3], 30.0f, 0.0f, 50.0f);
+    _test_scene_step(sc);
+    leaf = rigidbody_get_rtree_leaf(transform_get_rigidbody(children[3][4]));
+    TEST_CHECK(rtree_node_get_aabb(leaf)->min.z == 58.0f);
+
+    // re-parented branch is refreshed under its new parent
+    transform_set_parent(children[4][1], groups[3], false);
+    _test_scene_step(sc);
+    leaf = rigidbody_get_rtree_leaf(transform_get_rigidbody(children[4][1]));
+    TEST_CHECK(rtree_node_get_aabb(leaf)->min.x == 30.0f);
+    TEST_CHECK(rtree_node_get_aabb(leaf)->min.z == 52.0f);
+
+    // rigidbodies changes
+    rigidbody_set_collider(transform_get_rigidbody(children[5][0]), &box_zero, true);
+    rigidbody_set_groups(transform_get_rigidbody(children[5][1]), 2);
+    rigidbody_set_simulation_mode(transform_get_rigidbody(children[5][2]),
+                                  RigidbodyMode_Disabled);
+    _test_scene_step(sc);
+    TEST_CHECK(rigidbody_get_rtree_leaf(transform_get_rigidbody(children[5][0])) == NULL);
+    leaf = rigidbody_get_rtree_leaf(transform_get_rigidbody(children[5][1]));
+    TEST_CHECK(rtree_node_get_groups(leaf) == 2);
+    TEST_CHECK(rigidbody_get_rtree_leaf(transform_get_rigidbody(children[5][2])) == NULL);
+    TEST_CHECK(_test_scene_is_branch_dirty(scene_get_root(sc)) == false);
+
+    // dynamic rigidbody keeps its branch visited by the physics refresh
+    rb = transform_get_rigidbody(children[6][0]);
+    rigidbody_set_simulation_mode(rb, RigidbodyMode_Dynamic);
+    const float3 v = {0.0f, 60.0f, 0.0f};
+    for (int i = 0; i < 3; ++i) {
+        rigidbody_set_velocity(rb, &v);
+        _test_scene_step(sc);
+        TEST_CHECK(transform_is_branch_dirty(groups[6], false));
+        TEST_CHECK(transform_is_branch_dirty(groups[7], false) == false);
+    }
+    TEST_CHECK(transform_get_position(children[6][0])->y > 1.0f);
+    leaf = rigidbody_get_rtree_leaf(rb);
+    TEST_CHECK(rtree_node_get_aabb(leaf)->min.y == transform_get_position(children[6][0])->y);
+
+    // shape transaction is applied at end-of-frame
+    TEST_CHECK(shape_add_block_as_transaction(s, sc, color, 1, 0, 0));
+    TEST_CHECK(transform_is_branch_dirty(groups[1], true));
+    _test_scene_step(sc);
+    TEST_CHECK(shape_has_pending_transaction(s) == false);
+    TEST_CHECK(shape_get_nb_blocks(s) == 2);
+    TEST_CHECK(transform_is_branch_dirty(groups[1], true) == false);
+
+    for (int i = 0; i < TEST_SCENE_GROUPS; ++i) {
+        for (int j = 0; j < TEST_SCENE_GROUP_CHILDREN; ++j) {
+            transform_release(children[i][j]);
+        }
+        transform_release(groups[i]);
+    }
+    scene_free(sc);
+    shape_release(s);
+    color_atlas_free(atlas);
+}
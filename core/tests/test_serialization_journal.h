@@ -0,0 +1,226 @@
+// -------------------------------------------------------------
+//  Cubzh Core Unit Tests
+//  test_serialization_journal.h
+// -------------------------------------------------------------
+
+#pragma once
+
+#include "serialization_journal.h"
+#include "zlib.h"
+
+// functions that are NOT tested:
+// serialization_journal_save_full (called through serialization_journal_save)
+
+#define TEST_JOURNAL_MIN 3
+#define TEST_JOURNAL_MAX 51
+
+static bool _test_journal_file_size(const char *filepath, uint32_t *size) {
+    FILE *fd = fopen(filepath, "rb");
+    if (fd == NULL) {
+        return false;
+    }
+    fseek(fd, 0, SEEK_END);
+    *size = (uint32_t)ftell(fd);
+    fclose(fd);
+    return true;
+}
+
+static uint32_t _test_journal_file_crc(const char *filepath) {
+    FILE *fd = fopen(filepath, "rb");
+    if (fd == NULL) {
+        return 0;
+    }
+    uint8_t buf[4096];
+    uLong crc = crc32(0L, Z_NULL, 0);
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), fd)) > 0) {
+        crc = crc32(crc, buf, (uInt)n);
+    }
+    fclose(fd);
+    return (uint32_t)crc;
+}
+
+static bool _test_journal_has_color(Shape *s,
+                                    SHAPE_COORDS_INT_T x,
+                                    SHAPE_COORDS_INT_T y,
+                                    SHAPE_COORDS_INT_T z,
+                                    RGBAColor color) {
+    const Block *b = shape_get_block(s, x, y, z);
+    if (block_is_solid(b) == false) {
+        return false;
+    }
+    const RGBAColor c = color_palette_get_color(shape_get_palette(s), block_get_color_index(b));
+    return c.r == color.r && c.g == color.g && c.b == color.b && c.a == color.a;
+}
+
+// check that incremental saves are replayed on load, w/ base file offset at model AABB min
+void test_serialization_journal_save(void) {
+    ColorAtlas *atlas = color_atlas_new();
+    const LoadShapeSettings settings = {.lighting = false, .isMutable = false};
+    const char *file_name = "journal.3zh";
+    const char *journal_name = "journal.3zh" SERIALIZATION_JOURNAL_EXTENSION;
+    const RGBAColor red = {255, 0, 0, 255};
+    const RGBAColor green = {0, 255, 0, 255};
+    const RGBAColor blue = {0, 0, 255, 255};
+
+    Shape *src = shape_make();
+    shape_set_palette(src, color_palette_new(atlas), false);
+    SHAPE_COLOR_INDEX_INT_T redIdx, blueIdx, greenIdx;
+    color_palette_check_and_add_color(shape_get_palette(src), red, &redIdx, false);
+    color_palette_check_and_add_color(shape_get_palette(src), green, &greenIdx, false);
+    // red line along X at min y/z, noise elsewhere so that base isn't smaller than edits
+    uint32_t seed = 3;
+    for (SHAPE_COORDS_INT_T x = TEST_JOURNAL_MIN; x < TEST_JOURNAL_MAX; ++x) {
+        for (SHAPE_COORDS_INT_T y = TEST_JOURNAL_MIN; y < TEST_JOURNAL_MAX; ++y) {
+            for (SHAPE_COORDS_INT_T z = TEST_JOURNAL_MIN; z < TEST_JOURNAL_MAX; ++z) {
+                seed = seed * 1103515245 + 12345;
+                const bool line = y == TEST_JOURNAL_MIN && z == TEST_JOURNAL_MIN;
+                shape_add_block(src, line || (seed >> 16) % 2 ? redIdx : greenIdx, x, y, z, false);
+            }
+        }
+    }
+
+    // shape doesn't track edits yet: full save
+    TEST_ASSERT(serialization_journal_save(src, NULL, 0, file_name));
+    TEST_CHECK(shape_get_edited_chunks(src) != NULL);
+    uint32_t baseSize = 0, journalSize = 0;
+    TEST_CHECK(_test_journal_file_size(file_name, &baseSize) && baseSize > 0);
+    TEST_CHECK(_test_journal_file_size(journal_name, &journalSize));
+    const uint32_t headerSize = journalSize;
+
+    // nothing edited: nothing written
+    TEST_CHECK(serialization_journal_save(src, NULL, 0, file_name));
+    TEST_CHECK(_test_journal_file_size(journal_name, &journalSize) && journalSize == headerSize);
+
+    // edits, w/ a new color & a new chunk
+    color_palette_check_and_add_color(shape_get_palette(src), blue, &blueIdx, false);
+    shape_remove_block(src, TEST_JOURNAL_MIN, TEST_JOURNAL_MIN, TEST_JOURNAL_MIN);
+    shape_paint_block(src, blueIdx, 10, 10, 10);
+    shape_add_block(src, blueIdx, TEST_JOURNAL_MAX + 20, TEST_JOURNAL_MIN, TEST_JOURNAL_MIN, false);
+    TEST_CHECK(serialization_journal_save(src, NULL, 0, file_name));
+    TEST_CHECK(_test_journal_file_size(journal_name, &journalSize) && journalSize > headerSize);
+    TEST_CHECK(index3d_is_empty(shape_get_edited_chunks(src)));
+
+    // base file & journal untouched, loaded shape is in base coordinates
+    uint32_t size = 0;
+    TEST_CHECK(_test_journal_file_size(file_name, &size) && size == baseSize);
+    const uint32_t journalCRC = _test_journal_file_crc(journal_name);
+    Shape *loaded = serialization_journal_load_shape(file_name, atlas, (LoadShapeSettings *)&settings);
+    TEST_ASSERT(loaded != NULL);
+    TEST_CHECK(_test_journal_file_crc(journal_name) == journalCRC);
+    const SHAPE_COORDS_INT_T o = TEST_JOURNAL_MIN;
+    TEST_CHECK(block_is_solid(shape_get_block(loaded, 0, 0, 0)) == false);
+    TEST_CHECK(_test_journal_has_color(loaded, 1, 0, 0, red));
+    TEST_CHECK(_test_journal_has_color(loaded, 10 - o, 10 - o, 10 - o, blue));
+    TEST_CHECK(_test_journal_has_color(loaded, TEST_JOURNAL_MAX + 20 - o, 0, 0, blue));
+    TEST_CHECK(shape_get_edited_chunks(loaded) != NULL);
+
+    // edits from loaded shape are journaled as well
+    shape_remove_block(loaded, 1, 0, 0);
+    TEST_CHECK(serialization_journal_save(loaded, NULL, 0, file_name));
+    shape_release(loaded);
+
+    loaded = serialization_journal_load_shape(file_name, atlas, (LoadShapeSettings *)&settings);
+    TEST_ASSERT(loaded != NULL);
+    TEST_CHECK(block_is_solid(shape_get_block(loaded, 0, 0, 0)) == false);
+    TEST_CHECK(block_is_solid(shape_get_block(loaded, 1, 0, 0)) == false);
+    TEST_CHECK(_test_journal_has_color(loaded, 2, 0, 0, red));
+    TEST_CHECK(_test_journal_has_color(loaded, TEST_JOURNAL_MAX + 20 - o, 0, 0, blue));
+
+    // journal is compacted into a new base once bigger than it
+    bool compacted = false;
+    for (SHAPE_COORDS_INT_T y = 1; y < TEST_JOURNAL_MAX - o && compacted == false; ++y) {
+        for (SHAPE_COORDS_INT_T x = 0; x < TEST_JOURNAL_MAX - o; x += 4) {
+            for (SHAPE_COORDS_INT_T z = 0; z < TEST_JOURNAL_MAX - o; z += 4) {
+                shape_remove_block(loaded, x, y, z);
+            }
+        }
+        TEST_CHECK(serialization_journal_save(loaded, NULL, 0, file_name));
+        compacted = _test_journal_file_size(journal_name, &journalSize) &&
+                    journalSize == headerSize;
+    }
+    TEST_CHECK(compacted);
+    Shape *reloaded = serialization_journal_load_shape(file_name,
+                                                       atlas,
+                                                       (LoadShapeSettings *)&settings);
+    TEST_ASSERT(reloaded != NULL);
+    TEST_CHECK(block_is_solid(shape_get_block(reloaded, 0, 1, 0)) == false);
+    TEST_CHECK(_test_journal_has_color(reloaded, 2, 0, 0, red));
+    shape_release(reloaded);
+
+    remove(file_name);
+    remove(journal_name);
+    shape_release(loaded);
+    shape_release(src);
+    color_atlas_free(atlas);
+}
+
+// check that a malformed record is entirely discarded on load, even if its first chunks are valid
+void test_serialization_journal_invalid_record(void) {
+    ColorAtlas *atlas = color_atlas_new();
+    const LoadShapeSettings settings = {.lighting = false, .isMutable = false};
+    const char *file_name = "journal_invalid.3zh";
+    const char *journal_name = "journal_invalid.3zh" SERIALIZATION_JOURNAL_EXTENSION;
+    const RGBAColor red = {255, 0, 0, 255};
+
+    Shape *src = shape_make();
+    shape_set_palette(src, color_palette_new(atlas), false);
+    SHAPE_COLOR_INDEX_INT_T redIdx;
+    color_palette_check_and_add_color(shape_get_palette(src), red, &redIdx, false);
+    for (SHAPE_COORDS_INT_T x = 0; x < 2 * CHUNK_SIZE; ++x) {
+        shape_add_block(src, redIdx, x, 0, 0, false);
+    }
+    TEST_ASSERT(serialization_journal_save_full(src, NULL, 0, file_name));
+
+    // 1 color, 1st chunk empties blocks, 2nd chunk refers to a missing color
+    const uint32_t chunkSize = 3 * sizeof(int16_t) + CHUNK_SIZE_CUBE;
+    const uint32_t recordSize = sizeof(uint8_t) + sizeof(RGBAColor) + sizeof(uint8_t) +
+                                sizeof(uint32_t) + 2 * chunkSize;
+    uint8_t *record = (uint8_t *)malloc(recordSize);
+    TEST_ASSERT(record != NULL);
+    uint32_t cursor = 0;
+    record[cursor++] = 1;
+    memcpy(record + cursor, &red, sizeof(RGBAColor));
+    cursor += sizeof(RGBAColor);
+    record[cursor++] = 0;
+    const uint32_t chunkCount = 2;
+    memcpy(record + cursor, &chunkCount, sizeof(uint32_t));
+    cursor += sizeof(uint32_t);
+    for (int16_t c = 0; c < 2; ++c) {
+        const int16_t origin[3] = {(int16_t)(c * CHUNK_SIZE), 0, 0};
+        memcpy(record + cursor, origin, sizeof(origin));
+        cursor += sizeof(origin);
+        memset(record + cursor, c == 0 ? SHAPE_COLOR_INDEX_AIR_BLOCK : 5, CHUNK_SIZE_CUBE);
+        cursor += CHUNK_SIZE_CUBE;
+    }
+    TEST_ASSERT(cursor == recordSize);
+
+    uLong compressedSize = compressBound(recordSize);
+    void *compressed = malloc(compressedSize);
+    TEST_ASSERT(compressed != NULL);
+    TEST_ASSERT(compress(compressed, &compressedSize, record, recordSize) == Z_OK);
+    const uint32_t sizes[2] = {(uint32_t)compressedSize, recordSize};
+    FILE *fd = fopen(journal_name, "ab");
+    TEST_ASSERT(fd != NULL);
+    TEST_CHECK(fwrite(sizes, sizeof(uint32_t), 2, fd) == 2);
+    TEST_CHECK(fwrite(compressed, compressedSize, 1, fd) == 1);
+    fclose(fd);
+    free(compressed);
+    free(record);
+
+    // blocks of the valid chunk are still there, next save will be a full one
+    Shape *loaded = serialization_journal_load_shape(file_name,
+                                                     atlas,
+                                                     (LoadShapeSettings *)&settings);
+    TEST_ASSERT(loaded != NULL);
+    TEST_CHECK(_test_journal_has_color(loaded, 0, 0, 0, red));
+    TEST_CHECK(_test_journal_has_color(loaded, CHUNK_SIZE - 1, 0, 0, red));
+    TEST_CHECK(_test_journal_has_color(loaded, CHUNK_SIZE, 0, 0, red));
+    TEST_CHECK(shape_get_edited_chunks(loaded) == NULL);
+
+    remove(file_name);
+    remove(journal_name);
+    shape_release(loaded);
+    shape_release(src);
+    color_atlas_free(atlas);
+}
@@ -0,0 +1,432 @@
+// -------------------------------------------------------------
+//  Cubzh Core Unit Tests
+//  test_serialization_v6.h
+// -------------------------------------------------------------
+
+#pragma once
+
+#include "serialization.h"
+#include "serialization_v6.h"
+#include "test_thread_pool.h"
+#include "thread_pool.h"
+#include "transform.h"
+#include "zlib.h"
+
+// functions that are NOT tested:
+// serialization_v6_save_shape
+// serialization_v6_get_preview_data
+
+#define TEST_SERIALIZATION_V6_W 40
+#define TEST_SERIALIZATION_V6_H 20
+#define TEST_SERIALIZATION_V6_D 40
+
+static Shape *_test_serialization_v6_make_shape(ColorAtlas *atlas) {
+    Shape *s = shape_make();
+    shape_set_palette(s, color_palette_new(atlas), false);
+
+    const RGBAColor colors[4] = {{255, 0, 0, 255},
+                                 {0, 255, 0, 255},
+                                 {0, 0, 255, 255},
+                                 {255, 255, 0, 255}};
+    SHAPE_COLOR_INDEX_INT_T indexes[4];
+    for (int i = 0; i < 4; ++i) {
+        color_palette_check_and_add_color(shape_get_palette(s), colors[i], &indexes[i], false);
+    }
+
+    // pseudo-random colors, so that compressed data spans several read windows
+    uint32_t seed = 42;
+    for (SHAPE_COORDS_INT_T x = 0; x < TEST_SERIALIZATION_V6_W; ++x) {
+        for (SHAPE_COORDS_INT_T y = 0; y < TEST_SERIALIZATION_V6_H; ++y) {
+            for (SHAPE_COORDS_INT_T z = 0; z < TEST_SERIALIZATION_V6_D; ++z) {
+                seed = seed * 1103515245 + 12345;
+                shape_add_block(s, indexes[(seed >> 16) % 4], x, y, z, false);
+            }
+        }
+    }
+    return s;
+}
+
+static void _test_serialization_v6_check_same_blocks(Shape *a, Shape *b) {
+    int3 sizeA, sizeB;
+    shape_get_bounding_box_size(a, &sizeA);
+    shape_get_bounding_box_size(b, &sizeB);
+    TEST_CHECK(sizeA.x == sizeB.x && sizeA.y == sizeB.y && sizeA.z == sizeB.z);
+
+    bool same = true;
+    for (SHAPE_COORDS_INT_T x = 0; x < TEST_SERIALIZATION_V6_W && same; ++x) {
+        for (SHAPE_COORDS_INT_T y = 0; y < TEST_SERIALIZATION_V6_H && same; ++y) {
+            for (SHAPE_COORDS_INT_T z = 0; z < TEST_SERIALIZATION_V6_D && same; ++z) {
+                const Block *ba = shape_get_block(a, x, y, z);
+                const Block *bb = shape_get_block(b, x, y, z);
+                if (block_is_solid(ba) != block_is_solid(bb)) {
+                    same = false;
+                } else if (block_is_solid(ba)) {
+                    const RGBAColor ca = color_palette_get_color(shape_get_palette(a),
+                                                                 block_get_color_index(ba));
+                    const RGBAColor cb = color_palette_get_color(shape_get_palette(b),
+                                                                 block_get_color_index(bb));
+                    same = ca.r == cb.r && ca.g == cb.g && ca.b == cb.b && ca.a == cb.a;
+                }
+            }
+        }
+    }
+    TEST_CHECK(same);
+}
+
+// check that a shape is identical after a save/load round trip, from memory & file streams
+void test_serialization_v6_shape_round_trip(void) {
+    ColorAtlas *atlas = color_atlas_new();
+    Shape *src = _test_serialization_v6_make_shape(atlas);
+    const LoadShapeSettings settings = {.lighting = false, .isMutable = false};
+
+    void *buf = NULL;
+    uint32_t bufSize = 0;
+    TEST_ASSERT(serialization_save_shape_as_buffer(src, NULL, NULL, 0, &buf, &bufSize));
+
+    // memory-backed stream (compressed data is inflated in place)
+    Shape *fromBuffer = serialization_load_shape(stream_new_buffer_read(buf, bufSize),
+                                                 "",
+                                                 atlas,
+                                                 (LoadShapeSettings *)&settings,
+                                                 false);
+    TEST_ASSERT(fromBuffer != NULL);
+    _test_serialization_v6_check_same_blocks(src, fromBuffer);
+
+    // FILE stream (compressed data read through a window)
+    const char *file_name = "round_trip.3zh";
+    FILE *f = fopen(file_name, "wb");
+    TEST_ASSERT(f != NULL);
+    TEST_ASSERT(fwrite(buf, bufSize, 1, f) == 1);
+    fclose(f);
+
+    Shape *fromFile = serialization_load_shape(stream_new_file_read(fopen(file_name, "rb")),
+                                               "",
+                                               atlas,
+                                               (LoadShapeSettings *)&settings,
+                                               false);
+    TEST_ASSERT(fromFile != NULL);
+    _test_serialization_v6_check_same_blocks(src, fromFile);
+
+    remove(file_name);
+    free(buf);
+    shape_release(fromBuffer);
+    shape_release(fromFile);
+    shape_release(src);
+    color_atlas_free(atlas);
+}
+
+// check that children are identical after a round trip from a file stream, w/ shared & own palettes
+void test_serialization_v6_children_round_trip(void) {
+    ColorAtlas *atlas = color_atlas_new();
+    Shape *src = _test_serialization_v6_make_shape(atlas);
+    Shape *shared = _test_serialization_v6_make_shape(atlas);
+    shape_set_palette(shared, shape_get_palette(src), true);
+    shape_set_parent(shared, shape_get_root_transform(src), false);
+    Shape *own = _test_serialization_v6_make_shape(atlas);
+    shape_set_parent(own, shape_get_root_transform(src), false);
+    const LoadShapeSettings settings = {.lighting = false, .isMutable = false};
+
+    void *buf = NULL;
+    uint32_t bufSize = 0;
+    TEST_ASSERT(serialization_save_shape_as_buffer(src, NULL, NULL, 0, &buf, &bufSize));
+
+    // FILE stream (blocks are decoded while compressed data is read through a window)
+    const char *file_name = "children_round_trip.3zh";
+    FILE *f = fopen(file_name, "wb");
+    TEST_ASSERT(f != NULL);
+    TEST_ASSERT(fwrite(buf, bufSize, 1, f) == 1);
+    fclose(f);
+
+    Shape *loaded = serialization_load_shape(stream_new_file_read(fopen(file_name, "rb")),
+                                             "",
+                                             atlas,
+                                             (LoadShapeSettings *)&settings,
+                                             false);
+    TEST_ASSERT(loaded != NULL);
+    _test_serialization_v6_check_same_blocks(src, loaded);
+
+    DoublyLinkedListNode *n = shape_get_transform_children_iterator(loaded);
+    TEST_ASSERT(n != NULL && doubly_linked_list_node_next(n) != NULL);
+    Shape *loadedShared = transform_utils_get_shape(
+        (Transform *)doubly_linked_list_node_pointer(n));
+    Shape *loadedOwn = transform_utils_get_shape(
+        (Transform *)doubly_linked_list_node_pointer(doubly_linked_list_node_next(n)));
+    TEST_ASSERT(loadedShared != NULL && loadedOwn != NULL);
+    TEST_CHECK(shape_get_palette(loadedShared) == shape_get_palette(loaded));
+    TEST_CHECK(shape_get_palette(loadedOwn) != shape_get_palette(loaded));
+    _test_serialization_v6_check_same_blocks(shared, loadedShared);
+    _test_serialization_v6_check_same_blocks(own, loadedOwn);
+
+    remove(file_name);
+    free(buf);
+    shape_release(loaded);
+    shape_release(shared);
+    shape_release(own);
+    shape_release(src);
+    color_atlas_free(atlas);
+}
+
+// shape chunk & sub-chunks IDs, see serialization_v6.c
+#define TEST_SERIALIZATION_V6_CHUNK_SHAPE 3
+#define TEST_SERIALIZATION_V6_CHUNK_SHAPE_NAME 18
+#define TEST_SERIALIZATION_V6_CHUNK_SHAPE_PALETTE 22
+#define TEST_SERIALIZATION_V6_CHUNK_HEADER_SIZE 10
+
+// rewrites a saved buffer w/ its shape chunks uncompressed & their palette sub-chunk moved last
+static uint8_t *_test_serialization_v6_move_palette_last(const uint8_t *buf,
+                                                         uint32_t size,
+                                                         uint32_t *outSize) {
+    const uint32_t headerSize = MAGIC_BYTES_SIZE + SERIALIZATION_FILE_FORMAT_VERSION_SIZE +
+                                SERIALIZATION_COMPRESSION_ALGO_SIZE +
+                                SERIALIZATION_TOTAL_SIZE_SIZE;
+    uint32_t chunkSize, uncompressedSize;
+
+    // chunks are at most as large as their uncompressed payload
+    uint32_t capacity = headerSize;
+    for (uint32_t cursor = headerSize; cursor < size;) {
+        memcpy(&chunkSize, buf + cursor + 1, sizeof(uint32_t));
+        memcpy(&uncompressedSize, buf + cursor + 6, sizeof(uint32_t));
+        capacity += TEST_SERIALIZATION_V6_CHUNK_HEADER_SIZE + maximum(chunkSize, uncompressedSize);
+        cursor += TEST_SERIALIZATION_V6_CHUNK_HEADER_SIZE + chunkSize;
+    }
+    uint8_t *out = (uint8_t *)malloc(capacity);
+    memcpy(out, buf, headerSize);
+    uint32_t outCursor = headerSize;
+
+    for (uint32_t cursor = headerSize; cursor < size;) {
+        const uint8_t id = buf[cursor];
+        memcpy(&chunkSize, buf + cursor + 1, sizeof(uint32_t));
+        memcpy(&uncompressedSize, buf + cursor + 6, sizeof(uint32_t));
+        if (id != TEST_SERIALIZATION_V6_CHUNK_SHAPE) {
+            const uint32_t fullSize = TEST_SERIALIZATION_V6_CHUNK_HEADER_SIZE + chunkSize;
+            memcpy(out + outCursor, buf + cursor, fullSize);
+            outCursor += fullSize;
+            cursor += fullSize;
+            continue;
+        }
+
+        uLong payloadSize = uncompressedSize;
+        uint8_t *payload = (uint8_t *)malloc(uncompressedSize);
+        TEST_CHECK(uncompress(payload,
+                              &payloadSize,
+                              buf + cursor + TEST_SERIALIZATION_V6_CHUNK_HEADER_SIZE,
+                              chunkSize) == Z_OK);
+
+        const uint8_t isCompressed = 0;
+        out[outCursor] = id;
+        memcpy(out + outCursor + 1, &uncompressedSize, sizeof(uint32_t));
+        memcpy(out + outCursor + 5, &isCompressed, sizeof(uint8_t));
+        memcpy(out + outCursor + 6, &uncompressedSize, sizeof(uint32_t));
+        outCursor += TEST_SERIALIZATION_V6_CHUNK_HEADER_SIZE;
+
+        uint32_t paletteStart = 0, paletteSize = 0;
+        for (uint32_t p = 0; p < uncompressedSize;) {
+            uint32_t subChunkSize;
+            if (payload[p] == TEST_SERIALIZATION_V6_CHUNK_SHAPE_NAME) {
+                subChunkSize = 2 + payload[p + 1];
+            } else {
+                memcpy(&subChunkSize, payload + p + 1, sizeof(uint32_t));
+                subChunkSize += 5;
+            }
+            if (payload[p] == TEST_SERIALIZATION_V6_CHUNK_SHAPE_PALETTE) {
+                paletteStart = p;
+                paletteSize = subChunkSize;
+            } else {
+                memcpy(out + outCursor, payload + p, subChunkSize);
+                outCursor += subChunkSize;
+            }
+            p += subChunkSize;
+        }
+        TEST_CHECK(paletteSize > 0);
+        memcpy(out + outCursor, payload + paletteStart, paletteSize);
+        outCursor += paletteSize;
+
+        free(payload);
+        cursor += TEST_SERIALIZATION_V6_CHUNK_HEADER_SIZE + chunkSize;
+    }
+
+    const uint32_t totalSize = outCursor - headerSize;
+    memcpy(out + headerSize - SERIALIZATION_TOTAL_SIZE_SIZE, &totalSize, sizeof(uint32_t));
+    *outSize = outCursor;
+    return out;
+}
+
+// check that shape blocks are decoded w/ the shape palette, even if it comes after them
+void test_serialization_v6_shape_palette_after_blocks(void) {
+    ColorAtlas *atlas = color_atlas_new();
+    Shape *src = _test_serialization_v6_make_shape(atlas);
+    const LoadShapeSettings settings = {.lighting = false, .isMutable = false};
+
+    void *buf = NULL;
+    uint32_t bufSize = 0;
+    TEST_ASSERT(serialization_save_shape_as_buffer(src, NULL, NULL, 0, &buf, &bufSize));
+    uint32_t reorderedSize = 0;
+    uint8_t *reordered = _test_serialization_v6_move_palette_last((const uint8_t *)buf,
+                                                                  bufSize,
+                                                                  &reorderedSize);
+
+    // memory-backed stream (blocks are borrowed)
+    Shape *fromBuffer = serialization_load_shape(stream_new_buffer_read((const char *)reordered,
+                                                                        reorderedSize),
+                                                 "",
+                                                 atlas,
+                                                 (LoadShapeSettings *)&settings,
+                                                 false);
+    TEST_ASSERT(fromBuffer != NULL);
+    _test_serialization_v6_check_same_blocks(src, fromBuffer);
+
+    // FILE stream (blocks are buffered)
+    const char *file_name = "palette_after_blocks.3zh";
+    FILE *f = fopen(file_name, "wb");
+    TEST_ASSERT(f != NULL);
+    TEST_ASSERT(fwrite(reordered, reorderedSize, 1, f) == 1);
+    fclose(f);
+
+    Shape *fromFile = serialization_load_shape(stream_new_file_read(fopen(file_name, "rb")),
+                                               "",
+                                               atlas,
+                                               (LoadShapeSettings *)&settings,
+                                               false);
+    TEST_ASSERT(fromFile != NULL);
+    _test_serialization_v6_check_same_blocks(src, fromFile);
+
+    remove(file_name);
+    free(reordered);
+    free(buf);
+    shape_release(fromBuffer);
+    shape_release(fromFile);
+    shape_release(src);
+    color_atlas_free(atlas);
+}
+
+// check that parallel compression outputs regular zlib streams, whatever the number of slices
+void test_serialization_utils_compress_parallel(void) {
+    const uint32_t sizes[3] = {1000, 300000, 0};
+    SerializationCompressionTask tasks[3];
+    uint8_t *srcs[3];
+
+    uint32_t seed = 7;
+    for (int i = 0; i < 3; ++i) {
+        srcs[i] = (uint8_t *)malloc(sizes[i] + 1);
+        TEST_ASSERT(srcs[i] != NULL);
+        for (uint32_t j = 0; j < sizes[i]; ++j) {
+            // compressible but not trivial data, repeating across slice boundaries
+            seed = seed * 1103515245 + 12345;
+            srcs[i][j] = (j / 64) % 3 == 0 ? (uint8_t)(seed >> 16) : (uint8_t)(j % 251);
+        }
+        tasks[i].src = srcs[i];
+        tasks[i].srcSize = sizes[i];
+    }
+
+    TEST_ASSERT(serialization_utils_compress_parallel(tasks, 3));
+
+    for (int i = 0; i < 3; ++i) {
+        TEST_CHECK(tasks[i].dst != NULL);
+
+        uLong uncompressedSize = sizes[i];
+        uint8_t *uncompressed = (uint8_t *)malloc(sizes[i] + 1);
+        TEST_CHECK(uncompress(uncompressed, &uncompressedSize, tasks[i].dst, tasks[i].dstSize) ==
+                   Z_OK);
+        TEST_CHECK(uncompressedSize == sizes[i]);
+        TEST_CHECK(memcmp(uncompressed, srcs[i], sizes[i]) == 0);
+        free(uncompressed);
+    }
+
+    // single slice: same output as zlib's compress
+    uLong compressedSize = compressBound(sizes[0]);
+    uint8_t *compressed = (uint8_t *)malloc(compressedSize);
+    TEST_ASSERT(compress(compressed, &compressedSize, srcs[0], sizes[0]) == Z_OK);
+    TEST_CHECK(compressedSize == tasks[0].dstSize);
+    TEST_CHECK(memcmp(compressed, tasks[0].dst, compressedSize) == 0);
+    free(compressed);
+
+    for (int i = 0; i < 3; ++i) {
+        free(tasks[i].dst);
+        free(srcs[i]);
+    }
+}
+
+static void _test_serialization_v6_save_done(bool success, void *userdata) {
+    *(int *)userdata = success ? 1 : -1;
+}
+
+// check that edits made right after an asynchronous save don't end up in the file
+void test_serialization_save_shape_async(void) {
+    ColorAtlas *atlas = color_atlas_new();
+    Shape *reference = _test_serialization_v6_make_shape(atlas);
+    Shape *edited = _test_serialization_v6_make_shape(atlas);
+    const LoadShapeSettings settings = {.lighting = false, .isMutable = false};
+
+    const char *file_name = "async_save.3zh";
+    int done = 0;
+    TEST_ASSERT(serialization_save_shape_async(edited,
+                                               NULL,
+                                               0,
+                                               fopen(file_name, "wb"),
+                                               _test_serialization_v6_save_done,
+                                               &done));
+
+    for (SHAPE_COORDS_INT_T x = 0; x < TEST_SERIALIZATION_V6_W; ++x) {
+        shape_remove_block(edited, x, 0, 0);
+    }
+
+    thread_pool_wait(thread_pool_get_shared());
+    TEST_CHECK(done == 1);
+
+    Shape *loaded = serialization_load_shape(stream_new_file_read(fopen(file_name, "rb")),
+                                             "",
+                                             atlas,
+                                             (LoadShapeSettings *)&settings,
+                                             false);
+    TEST_ASSERT(loaded != NULL);
+    _test_serialization_v6_check_same_blocks(reference, loaded);
+
+    remove(file_name);
+    shape_release(loaded);
+    shape_release(edited);
+    shape_release(reference);
+    color_atlas_free(atlas);
+}
+
+// check that waiting for a batch of the shared pool doesn't run a queued asynchronous save on the
+// waiting thread
+void test_serialization_save_shape_async_batch_wait(void) {
+    ThreadPool *pool = thread_pool_get_shared();
+    const uint32_t nbWorkers = thread_pool_get_nb_workers(pool);
+    TEST_ASSERT(nbWorkers > 0); // gate jobs would never return otherwise
+
+    // all workers busy, save stays queued
+    _TestThreadPoolGate gate = {mutex_new(), 0, false, {0}};
+    for (uint32_t i = 0; i < nbWorkers; ++i) {
+        thread_pool_add_job(pool, _test_thread_pool_gate_job, &gate);
+    }
+    while (_test_thread_pool_gate_started(&gate) < nbWorkers) {}
+
+    ColorAtlas *atlas = color_atlas_new();
+    Shape *shape = _test_serialization_v6_make_shape(atlas);
+    const char *file_name = "async_save_batch_wait.3zh";
+    int done = 0;
+    TEST_ASSERT(serialization_save_shape_async(shape,
+                                               NULL,
+                                               0,
+                                               fopen(file_name, "wb"),
+                                               _test_serialization_v6_save_done,
+                                               &done));
+
+    _TestThreadPoolJob job = {pool, 0, {0}};
+    ThreadPoolBatch *b = thread_pool_batch_new(pool);
+    TEST_ASSERT(b != NULL);
+    thread_pool_batch_add_job(b, _test_thread_pool_increment, &job);
+    thread_pool_batch_wait_and_free(b);
+    TEST_CHECK(job.value == 1);
+    TEST_CHECK(done == 0);
+
+    _test_thread_pool_gate_release(&gate);
+    thread_pool_wait(pool);
+    TEST_CHECK(done == 1);
+
+    remove(file_name);
+    mutex_free(gate.mutex);
+    shape_release(shape);
+    color_atlas_free(atlas);
+}
@@ -7,11 +7,16 @@
 
 #pragma once
 
+#include <float.h>
+
 #include "acutest.h"
 
+#include "lighting_map.h"
 #include "scene.h"
 #include "shape.h"
+#include "thread_pool.h"
 #include "transform.h"
+#include "zlib.h"
 
 // functions that are NOT tested:
 // shape_add_buffer
@@ -94,9 +99,7 @@
 // shape_set_physics_simulation_mode
 // shape_set_physics_properties
 // shape_box_cast
-// shape_ray_cast
 // shape_point_overlap
-// shape_box_overlap
 // shape_is_hidden
 // shape_set_draw_mode
 // shape_get_draw_mode
@@ -551,3 +554,593 @@ void test_shape_addblock_3(void) {
     shape_free((Shape *const)sh);
     scene_free(sc);
 }
+
+static Shape *_test_shape_make_lighting_map(ColorAtlas *atlas) {
+    return lighting_map_make(atlas, 70);
+}
+
+// check that parallel baked lighting gives the same result as the single-threaded flood fill
+void test_shape_compute_baked_lighting_parallel(void) {
+    ColorAtlas *atlas = color_atlas_new();
+    Shape *serial = _test_shape_make_lighting_map(atlas);
+    Shape *parallel = _test_shape_make_lighting_map(atlas);
+    Shape *oneWorker = _test_shape_make_lighting_map(atlas);
+
+    ThreadPool *pool = thread_pool_new(3);
+    ThreadPool *pool1 = thread_pool_new(1);
+    shape_compute_baked_lighting_serial(serial);
+    shape_compute_baked_lighting_parallel(parallel, pool);
+    shape_compute_baked_lighting_parallel(oneWorker, pool1);
+    TEST_CHECK(shape_uses_baked_lighting(parallel));
+
+    size_t differences = 0, lit = 0;
+    for (SHAPE_COORDS_INT_T x = -2; x < 82; ++x) {
+        for (SHAPE_COORDS_INT_T y = -2; y < 50; ++y) {
+            for (SHAPE_COORDS_INT_T z = -2; z < 82; ++z) {
+                const VERTEX_LIGHT_STRUCT_T a = shape_get_light_or_default(serial, x, y, z);
+                const VERTEX_LIGHT_STRUCT_T b = shape_get_light_or_default(parallel, x, y, z);
+                const VERTEX_LIGHT_STRUCT_T c = shape_get_light_or_default(oneWorker, x, y, z);
+                if (a.ambient != b.ambient || a.red != b.red || a.green != b.green ||
+                    a.blue != b.blue || memcmp(&b, &c, sizeof(VERTEX_LIGHT_STRUCT_T)) != 0) {
+                    differences++;
+                }
+                if (a.red > 0 && a.ambient < 15) {
+                    lit++;
+                }
+            }
+        }
+    }
+    TEST_CHECK(differences == 0);
+    TEST_MSG("%zu differences", differences);
+    TEST_CHECK(lit > 0); // emission in shaded areas
+
+    thread_pool_free(pool);
+    thread_pool_free(pool1);
+    shape_free(serial);
+    shape_free(parallel);
+    shape_free(oneWorker);
+    color_atlas_free(atlas);
+}
+
+/// adds, removes & paints blocks, lamps included, in overlapping areas of existing chunks
+static void _test_shape_edit_lighting_map(Shape *s, const bool openHole) {
+    SHAPE_COLOR_INDEX_INT_T ground, lamp;
+    color_palette_check_and_add_color(shape_get_palette(s),
+                                      (RGBAColor){90, 140, 60, 255},
+                                      &ground,
+                                      false);
+    color_palette_check_and_add_color(shape_get_palette(s),
+                                      (RGBAColor){255, 160, 40, 255},
+                                      &lamp,
+                                      false);
+
+    for (SHAPE_COORDS_INT_T x = 10; x < 30; ++x) {
+        for (SHAPE_COORDS_INT_T z = 10; z < 30; ++z) {
+            // crossing walls w/ lamps, partly sunlit
+            if (z == 12) {
+                for (SHAPE_COORDS_INT_T y = 2; y < 14; ++y) {
+                    shape_add_block(s, (x + y) % 4 == 0 ? lamp : ground, x, y, z, false);
+                }
+            }
+            if (x == 12) {
+                for (SHAPE_COORDS_INT_T y = 1; y < 8; ++y) {
+                    shape_add_block(s, (z + y) % 3 == 0 ? lamp : ground, x, y, z, false);
+                }
+            }
+            // dig a trench, through lamps & caves
+            if (x > 15 && x < 25) {
+                for (SHAPE_COORDS_INT_T y = 2; y < 10; ++y) {
+                    shape_remove_block(s, x, y, z + 20);
+                }
+            }
+            // swap lamps & ground under the floating island
+            for (SHAPE_COORDS_INT_T y = 0; y < 16; ++y) {
+                const Block *b = shape_get_block_immediate(s, x + 20, y, z + 30);
+                if (b != NULL && (x + y + z) % 5 == 0) {
+                    shape_paint_block(s, b->colorIndex == lamp ? ground : lamp, x + 20, y, z + 30);
+                }
+            }
+        }
+    }
+    // open a hole in the first wall
+    for (SHAPE_COORDS_INT_T x = 14; openHole && x < 20; ++x) {
+        for (SHAPE_COORDS_INT_T y = 4; y < 10; ++y) {
+            shape_remove_block(s, x, y, 12);
+        }
+    }
+}
+
+static size_t _test_shape_count_light_differences(const Shape *a, const Shape *b) {
+    size_t differences = 0;
+    for (SHAPE_COORDS_INT_T x = -2; x < 82; ++x) {
+        for (SHAPE_COORDS_INT_T y = -2; y < 50; ++y) {
+            for (SHAPE_COORDS_INT_T z = -2; z < 82; ++z) {
+                const VERTEX_LIGHT_STRUCT_T la = shape_get_light_or_default(a, x, y, z);
+                const VERTEX_LIGHT_STRUCT_T lb = shape_get_light_or_default(b, x, y, z);
+                if (la.ambient != lb.ambient || la.red != lb.red || la.green != lb.green ||
+                    la.blue != lb.blue) {
+                    differences++;
+                }
+            }
+        }
+    }
+    return differences;
+}
+
+// check that lighting sunlight columns before propagation gives the same result as propagating all
+// sunlight from the plane above the shape, w/ overhangs, glass & missing chunks under the sky
+void test_shape_compute_baked_lighting_sunlight_columns(void) {
+    ColorAtlas *atlas = color_atlas_new();
+
+    for (int edited = 0; edited < 2; ++edited) {
+        Shape *columns = _test_shape_make_lighting_map(atlas);
+        Shape *floodFill = _test_shape_make_lighting_map(atlas);
+        if (edited) {
+            _test_shape_edit_lighting_map(columns, true);
+            _test_shape_edit_lighting_map(floodFill, true);
+        }
+
+        shape_compute_baked_lighting_serial(columns);
+        shape_compute_baked_lighting_flood_fill(floodFill);
+
+        const size_t differences = _test_shape_count_light_differences(columns, floodFill);
+        TEST_CHECK(differences == 0);
+        TEST_MSG("%zu differences (edited: %d)", differences, edited);
+
+        // shaded air right under the floating island, sunlit air right above it
+        TEST_CHECK(shape_get_light_or_default(columns, 35, 38, 45).ambient < 15);
+        TEST_CHECK(shape_get_light_or_default(columns, 35, 42, 45).ambient == 15);
+
+        shape_free(columns);
+        shape_free(floodFill);
+    }
+
+    color_atlas_free(atlas);
+}
+
+// check that lighting updated once for a batch of changes is the same as lighting updated after
+// each block change, and the same as lighting computed from scratch
+void test_shape_lighting_batch(void) {
+    ColorAtlas *atlas = color_atlas_new();
+    Shape *perBlock = _test_shape_make_lighting_map(atlas);
+    Shape *batched = _test_shape_make_lighting_map(atlas);
+    shape_compute_baked_lighting(perBlock);
+    shape_compute_baked_lighting(batched);
+
+    _test_shape_edit_lighting_map(perBlock, false);
+
+    shape_begin_lighting_batch(batched);
+    _test_shape_edit_lighting_map(batched, false);
+    shape_end_lighting_batch(batched);
+
+    size_t differences = _test_shape_count_light_differences(perBlock, batched);
+    TEST_CHECK(differences == 0);
+    TEST_MSG("%zu differences w/ per-block lighting", differences);
+
+    // blocks added & removed within a batch
+    Shape *full = _test_shape_make_lighting_map(atlas);
+    _test_shape_edit_lighting_map(full, true);
+    shape_compute_baked_lighting(full);
+
+    shape_free(batched);
+    batched = _test_shape_make_lighting_map(atlas);
+    shape_compute_baked_lighting(batched);
+
+    shape_begin_lighting_batch(batched);
+    _test_shape_edit_lighting_map(batched, true);
+    shape_end_lighting_batch(batched);
+
+    differences = _test_shape_count_light_differences(full, batched);
+    TEST_CHECK(differences == 0);
+    TEST_MSG("%zu differences w/ full lighting", differences);
+
+    shape_free(perBlock);
+    shape_free(batched);
+    shape_free(full);
+    color_atlas_free(atlas);
+}
+
+// check that lighting advanced under a budget over several calls is the same as lighting updated
+// synchronously, including when blocks change while lighting is pending
+void test_shape_lighting_deferred(void) {
+    ColorAtlas *atlas = color_atlas_new();
+    Shape *sync = _test_shape_make_lighting_map(atlas);
+    Shape *deferred = _test_shape_make_lighting_map(atlas);
+    shape_compute_baked_lighting(sync);
+    shape_compute_baked_lighting(deferred);
+
+    shape_begin_lighting_batch(sync);
+    _test_shape_edit_lighting_map(sync, false);
+    shape_end_lighting_batch(sync);
+    shape_begin_lighting_batch(sync);
+    _test_shape_edit_lighting_map(sync, true);
+    shape_end_lighting_batch(sync);
+
+    shape_set_deferred_lighting_budget(deferred, 100);
+    TEST_CHECK(shape_is_lighting_pending(deferred) == false);
+
+    _test_shape_edit_lighting_map(deferred, false);
+    TEST_CHECK(shape_is_lighting_pending(deferred));
+    TEST_CHECK(shape_process_lighting(deferred, 100) == false);
+    TEST_CHECK(shape_process_lighting(deferred, 100) == false);
+    TEST_CHECK(shape_is_lighting_pending(deferred));
+
+    // blocks changed while lighting is pending
+    _test_shape_edit_lighting_map(deferred, true);
+
+    int calls = 1;
+    while (shape_process_lighting(deferred, 100) == false) {
+        calls++;
+    }
+    TEST_CHECK(calls > 1);
+    TEST_CHECK(shape_is_lighting_pending(deferred) == false);
+
+    size_t differences = _test_shape_count_light_differences(sync, deferred);
+    TEST_CHECK(differences == 0);
+    TEST_MSG("%zu differences w/ synchronous lighting", differences);
+
+    // disabling deferred lighting completes pending work
+    shape_begin_lighting_batch(sync);
+    _test_shape_edit_lighting_map(sync, false);
+    shape_end_lighting_batch(sync);
+    _test_shape_edit_lighting_map(deferred, false);
+    shape_set_deferred_lighting_budget(deferred, 0);
+    TEST_CHECK(shape_is_lighting_pending(deferred) == false);
+
+    differences = _test_shape_count_light_differences(sync, deferred);
+    TEST_CHECK(differences == 0);
+    TEST_MSG("%zu differences after disabling deferred lighting", differences);
+
+    shape_free(sync);
+    shape_free(deferred);
+    color_atlas_free(atlas);
+}
+
+// check that disabling deferred lighting keeps a lighting batch opened by the caller, its changes
+// being lit when the caller ends it
+void test_shape_lighting_deferred_caller_batch(void) {
+    ColorAtlas *atlas = color_atlas_new();
+    Shape *sync = _test_shape_make_lighting_map(atlas);
+    Shape *deferred = _test_shape_make_lighting_map(atlas);
+    shape_compute_baked_lighting(sync);
+    shape_compute_baked_lighting(deferred);
+
+    shape_begin_lighting_batch(sync);
+    _test_shape_edit_lighting_map(sync, false);
+    shape_end_lighting_batch(sync);
+
+    shape_begin_lighting_batch(deferred);
+    shape_set_deferred_lighting_budget(deferred, 100);
+    _test_shape_edit_lighting_map(deferred, false);
+    shape_set_deferred_lighting_budget(deferred, 0);
+    TEST_CHECK(shape_is_lighting_pending(deferred) == false);
+
+    size_t differences = _test_shape_count_light_differences(sync, deferred);
+    TEST_CHECK(differences == 0);
+    TEST_MSG("%zu differences after disabling deferred lighting", differences);
+
+    // still batching until the caller ends the batch
+    shape_begin_lighting_batch(sync);
+    _test_shape_edit_lighting_map(sync, true);
+    shape_end_lighting_batch(sync);
+    _test_shape_edit_lighting_map(deferred, true);
+    TEST_CHECK(_test_shape_count_light_differences(sync, deferred) > 0);
+
+    shape_end_lighting_batch(deferred);
+    differences = _test_shape_count_light_differences(sync, deferred);
+    TEST_CHECK(differences == 0);
+    TEST_MSG("%zu differences after ending the batch", differences);
+
+    shape_free(sync);
+    shape_free(deferred);
+    color_atlas_free(atlas);
+}
+
+// same as shape_get_baked_lighting_hash before chunks cached their blocks hash
+static uint64_t _test_shape_reference_lighting_hash(const Shape *s) {
+    uLong hash = (uLong)color_palette_get_lighting_hash(shape_get_palette(s));
+    Index3DIterator *it = index3d_iterator_new(shape_get_chunks(s));
+    while (index3d_iterator_pointer(it) != NULL) {
+        Chunk *c = (Chunk *)index3d_iterator_pointer(it);
+        const SHAPE_COORDS_INT3_T origin = chunk_get_origin(c);
+        const Octree *o = chunk_get_octree(c);
+        hash = crc32(hash, (const Bytef *)&origin, (uInt)sizeof(SHAPE_COORDS_INT3_T));
+        hash = crc32(hash, octree_get_elements(o), (uInt)octree_get_elements_size(o));
+        index3d_iterator_next(it);
+    }
+    index3d_iterator_free(it);
+    return (uint64_t)hash;
+}
+
+// check that baked lighting hash is unchanged by chunks caching their hash, and follows edits
+void test_shape_baked_lighting_hash(void) {
+    ColorAtlas *atlas = color_atlas_new();
+    Shape *s = _test_shape_make_lighting_map(atlas);
+
+    const uint64_t hash = shape_get_baked_lighting_hash(s);
+    TEST_CHECK(hash == _test_shape_reference_lighting_hash(s));
+    TEST_CHECK(shape_get_baked_lighting_hash(s) == hash);
+
+    const Block *b = shape_get_block_immediate(s, 20, 0, 20);
+    TEST_ASSERT(b != NULL);
+    const SHAPE_COLOR_INDEX_INT_T color = b->colorIndex;
+
+    TEST_CHECK(shape_remove_block(s, 20, 0, 20));
+    TEST_CHECK(shape_get_baked_lighting_hash(s) != hash);
+    TEST_CHECK(shape_get_baked_lighting_hash(s) == _test_shape_reference_lighting_hash(s));
+
+    TEST_CHECK(shape_add_block(s, color, 20, 0, 20, false));
+    TEST_CHECK(shape_get_baked_lighting_hash(s) == hash);
+
+    SHAPE_COLOR_INDEX_INT_T other;
+    color_palette_check_and_add_color(shape_get_palette(s),
+                                      (RGBAColor){1, 2, 3, 255},
+                                      &other,
+                                      false);
+    TEST_CHECK(shape_paint_block(s, other, 20, 0, 20));
+    TEST_CHECK(shape_get_baked_lighting_hash(s) == _test_shape_reference_lighting_hash(s));
+
+    // copies share cached hashes
+    Shape *copy = shape_make_copy(s);
+    TEST_CHECK(shape_get_baked_lighting_hash(copy) == shape_get_baked_lighting_hash(s));
+
+    shape_free(copy);
+    shape_free(s);
+    color_atlas_free(atlas);
+}
+
+static bool _test_shape_cell_overlap(const Shape *s, SHAPE_COORDS_INT3_T coords) {
+    const Box cell = {{(float)coords.x + 0.25f, (float)coords.y + 0.25f, (float)coords.z + 0.25f},
+                      {(float)coords.x + 0.75f, (float)coords.y + 0.75f, (float)coords.z + 0.75f}};
+    return shape_box_overlap(s, &cell, NULL);
+}
+
+// check that chunks partitioning in bulk, then one by one, finds the same blocks as a lookup
+void test_shape_box_overlap_chunks(void) {
+    ColorAtlas *atlas = color_atlas_new();
+    Shape *s = _test_shape_make_lighting_map(atlas);
+
+    // far block in a new chunk, partitioned incrementally
+    TEST_CHECK(_test_shape_cell_overlap(s, (SHAPE_COORDS_INT3_T){100, 40, 100}) == false);
+    TEST_CHECK(shape_add_block(s, 1, 100, 40, 100, false));
+    TEST_CHECK(_test_shape_cell_overlap(s, (SHAPE_COORDS_INT3_T){100, 40, 100}));
+    TEST_CHECK(shape_remove_block(s, 100, 40, 100));
+    TEST_CHECK(_test_shape_cell_overlap(s, (SHAPE_COORDS_INT3_T){100, 40, 100}) == false);
+
+    Shape *copy = shape_make_copy(s);
+    uint32_t seed = 7;
+    for (int i = 0; i < 2000; ++i) {
+        seed = seed * 1103515245 + 12345;
+        const SHAPE_COORDS_INT3_T coords = {(SHAPE_COORDS_INT_T)((seed >> 8) % 72),
+                                            (SHAPE_COORDS_INT_T)((seed >> 16) % 20),
+                                            (SHAPE_COORDS_INT_T)((seed >> 20) % 72)};
+        const Block *b = shape_get_block_immediate(s, coords.x, coords.y, coords.z);
+        const bool solid = b != NULL && block_is_solid(b);
+        TEST_CHECK(_test_shape_cell_overlap(s, coords) == solid);
+        TEST_CHECK(_test_shape_cell_overlap(copy, coords) == solid);
+    }
+
+    shape_free(copy);
+    shape_free(s);
+    color_atlas_free(atlas);
+}
+
+// check that vertical rays hit the top block of each column, w/o allocation once chunks are
+// partitioned
+void test_shape_ray_cast(void) {
+    ColorAtlas *atlas = color_atlas_new();
+    Shape *s = _test_shape_make_lighting_map(atlas);
+    shape_set_pivot(s, 0.0f, 0.0f, 0.0f);
+
+    const float3 dir = {0.0f, -1.0f, 0.0f};
+    const float3 first = {0.5f, 100.0f, 0.5f};
+    Ray *ray = ray_new(&first, &dir);
+    Block *block = NULL;
+    SHAPE_COORDS_INT3_T coords;
+    TEST_CHECK(shape_ray_cast(s, ray, NULL, NULL, &block, &coords));
+
+    for (SHAPE_COORDS_INT_T x = 0; x < 72; x += 3) {
+        for (SHAPE_COORDS_INT_T z = 0; z < 72; z += 5) {
+            SHAPE_COORDS_INT_T top = 50;
+            const Block *b = NULL;
+            while (top >= 0 && (b == NULL || block_is_solid(b) == false)) {
+                b = shape_get_block_immediate(s, x, --top, z);
+            }
+
+            const float3 origin = {(float)x + 0.5f, 100.0f, (float)z + 0.5f};
+            float3_copy(ray->origin, &origin);
+            float distance = 0.0f;
+
+            const size_t allocs = test_alloc_count;
+            const bool hit = shape_ray_cast(s, ray, &distance, NULL, &block, &coords);
+            TEST_CHECK(shape_box_overlap(s, &(Box){{0.0f, 0.0f, 0.0f}, {1.0f, 1.0f, 1.0f}}, NULL));
+            TEST_CHECK(TEST_ALLOC_COUNTING == 0 || test_alloc_count == allocs);
+
+            TEST_CHECK(hit == (top >= 0));
+            if (hit) {
+                TEST_CHECK(coords.x == x && coords.y == top && coords.z == z);
+                TEST_CHECK(float_isEqual(distance, 100.0f - (float)(top + 1), EPSILON_ZERO));
+            }
+        }
+    }
+
+    ray_free(ray);
+    shape_free(s);
+    color_atlas_free(atlas);
+}
+
+// check that rays in any direction, from outside or inside the shape, hit the closest block found
+// by testing all blocks, at the same distance
+void test_shape_ray_cast_any_direction(void) {
+    ColorAtlas *atlas = color_atlas_new();
+    Shape *s = _test_shape_make_lighting_map(atlas);
+    shape_set_pivot(s, 0.0f, 0.0f, 0.0f);
+
+    uint32_t seed = 7;
+    float v[6];
+    for (int n = 0; n < 60; ++n) {
+        for (int i = 0; i < 6; ++i) {
+            seed = seed * 1103515245 + 12345;
+            v[i] = (float)((seed >> 8) & 0xffff) / 65536.0f;
+        }
+        float3 origin, dir;
+        switch (n % 4) {
+            case 0: // from above, far from the shape
+                origin = (float3){v[0] * 200.0f - 60.0f, 80.0f, v[1] * 200.0f - 60.0f};
+                dir = (float3){v[2] - 0.5f, -v[3], v[4] - 0.5f};
+                break;
+            case 1: // from inside the shape
+                origin = (float3){v[0] * 70.0f, v[1] * 10.0f, v[2] * 70.0f};
+                dir = (float3){v[3] - 0.5f, v[4] - 0.5f, v[5] - 0.5f};
+                break;
+            case 2: // along an axis, on blocks faces
+                origin = (float3){-10.0f, (float)(n % 12), (float)(n % 70)};
+                dir = (float3){1.0f, 0.0f, 0.0f};
+                break;
+            default: // through blocks edges
+                origin = (float3){(float)(n % 70), 40.0f, 0.0f};
+                dir = (float3){1.0f, -1.0f, 1.0f};
+                break;
+        }
+        Ray *ray = ray_new(&origin, &dir);
+        Ray *modelRay = ray_world_to_local(ray, shape_get_pivot_transform(s));
+
+        bool expectedHit = false;
+        float expected = FLT_MAX, d;
+        for (SHAPE_COORDS_INT_T x = 0; x < 72; ++x) {
+            for (SHAPE_COORDS_INT_T y = 0; y < 50; ++y) {
+                for (SHAPE_COORDS_INT_T z = 0; z < 72; ++z) {
+                    const Block *b = shape_get_block_immediate(s, x, y, z);
+                    const float3 min = {(float)x, (float)y, (float)z};
+                    const float3 max = {(float)(x + 1), (float)(y + 1), (float)(z + 1)};
+                    if (b != NULL && block_is_solid(b) &&
+                        ray_intersect_with_box(modelRay, &min, &max, &d) && d < expected) {
+                        expected = d;
+                        expectedHit = true;
+                    }
+                }
+            }
+        }
+
+        Block *block = NULL;
+        SHAPE_COORDS_INT3_T coords;
+        float3 impact, expectedImpact;
+        TEST_CHECK(shape_ray_cast(s, ray, NULL, &impact, &block, &coords) == expectedHit);
+        if (expectedHit) {
+            // another block may be touched at the same distance
+            const float3 min = {(float)coords.x, (float)coords.y, (float)coords.z};
+            const float3 max = {(float)(coords.x + 1),
+                                (float)(coords.y + 1),
+                                (float)(coords.z + 1)};
+            TEST_CHECK(block == shape_get_block_immediate(s, coords.x, coords.y, coords.z));
+            TEST_CHECK(ray_intersect_with_box(modelRay, &min, &max, &d) && d == expected);
+            ray_impact_point(modelRay, expected, &expectedImpact);
+            TEST_CHECK(impact.x == expectedImpact.x && impact.y == expectedImpact.y &&
+                       impact.z == expectedImpact.z);
+        }
+
+        ray_free(modelRay);
+        ray_free(ray);
+    }
+
+    shape_free(s);
+    color_atlas_free(atlas);
+}
+
+// check that swept boxes stop at the earliest block found by testing all blocks overlapped by the
+// broadphase box, w/ the same normal, w/o allocation
+void test_shape_box_cast(void) {
+    ColorAtlas *atlas = color_atlas_new();
+    Shape *s = _test_shape_make_lighting_map(atlas);
+    shape_get_rtree(s); // chunks are partitioned on first use
+
+    uint32_t seed = 11;
+    float v[6];
+    for (int n = 0; n < 200; ++n) {
+        for (int i = 0; i < 6; ++i) {
+            seed = seed * 1103515245 + 12345;
+            v[i] = (float)((seed >> 8) & 0xffff) / 65536.0f;
+        }
+        float3 min, vector;
+        switch (n % 4) {
+            case 0: // falling, from above the terrain
+                min = (float3){v[0] * 74.0f - 3.0f, 16.0f + v[1] * 4.0f, v[2] * 74.0f - 3.0f};
+                vector = (float3){v[3] - 0.5f, -20.0f * v[4], v[5] - 0.5f};
+                break;
+            case 1: // walking, on blocks faces
+                min = (float3){floorf(v[0] * 70.0f), 4.0f + floorf(v[1] * 10.0f), v[2] * 70.0f};
+                vector = (float3){v[3] * 4.0f - 2.0f, 0.0f, v[4] * 4.0f - 2.0f};
+                break;
+            case 2: // across several chunks, under the floating island
+                min = (float3){v[0] * 70.0f, 20.0f + v[1] * 15.0f, v[2] * 70.0f};
+                vector = (float3){v[3] * 40.0f - 20.0f, v[4] * 20.0f, v[5] * 40.0f - 20.0f};
+                break;
+            default: // entering the shape from outside its bounds
+                min = (float3){-8.0f + v[0] * 4.0f, 6.0f + v[1] * 10.0f, v[2] * 70.0f};
+                vector = (float3){10.0f + v[3] * 10.0f, -v[4] * 4.0f, v[5] - 0.5f};
+                break;
+        }
+        const Box box = {min, {min.x + 0.8f, min.y + 1.8f, min.z + 0.8f}};
+
+        Box broadPhaseBox;
+        box_set_broadphase_box(&box, &vector, &broadPhaseBox);
+        float expected = 1.0f;
+        for (SHAPE_COORDS_INT_T x = 0; x < 72; ++x) {
+            for (SHAPE_COORDS_INT_T y = 0; y < 50; ++y) {
+                for (SHAPE_COORDS_INT_T z = 0; z < 72; ++z) {
+                    const Block *b = shape_get_block_immediate(s, x, y, z);
+                    const Box blockBox = {{(float)x, (float)y, (float)z},
+                                          {(float)(x + 1), (float)(y + 1), (float)(z + 1)}};
+                    if (b == NULL || block_is_solid(b) == false ||
+                        box_collide(&blockBox, &broadPhaseBox) == false) {
+                        continue;
+                    }
+                    const float swept = box_swept(&box,
+                                                  &vector,
+                                                  &blockBox,
+                                                  &float3_epsilon_collision,
+                                                  true,
+                                                  NULL,
+                                                  NULL);
+                    expected = minimum(expected, swept);
+                }
+            }
+        }
+
+        float3 normal, expectedNormal;
+        Block *block = NULL;
+        SHAPE_COORDS_INT3_T coords;
+        const size_t allocs = test_alloc_count;
+        const float swept = shape_box_cast(s,
+                                           &box,
+                                           &vector,
+                                           &float3_epsilon_collision,
+                                           true,
+                                           &normal,
+                                           NULL,
+                                           &block,
+                                           &coords);
+        TEST_CHECK(TEST_ALLOC_COUNTING == 0 || test_alloc_count == allocs);
+        TEST_CHECK(swept == expected);
+        if (expected < 1.0f) {
+            // another block may be touched at the same time
+            const Box blockBox = {{(float)coords.x, (float)coords.y, (float)coords.z},
+                                  {(float)(coords.x + 1),
+                                   (float)(coords.y + 1),
+                                   (float)(coords.z + 1)}};
+            TEST_CHECK(block == shape_get_block_immediate(s, coords.x, coords.y, coords.z));
+            TEST_CHECK(box_swept(&box,
+                                 &vector,
+                                 &blockBox,
+                                 &float3_epsilon_collision,
+                                 true,
+                                 &expectedNormal,
+                                 NULL) == expected);
+            TEST_CHECK(normal.x == expectedNormal.x && normal.y == expectedNormal.y &&
+                       normal.z == expectedNormal.z);
+        }
+    }
+
+    shape_free(s);
+    color_atlas_free(atlas);
+}
@@ -181,6 +181,28 @@ void test_stream_skip(void) {
     free(content);
 }
 
+// check that size doesn't depend on cursor position, for buffer & file streams
+void test_stream_get_size(void) {
+    const char content[5] = {1, 2, 3, 4, 5};
+    Stream *s = stream_new_buffer_read(content, 5);
+    stream_skip(s, 2);
+    TEST_CHECK(stream_get_size(s) == 5);
+    stream_free(s);
+
+    const char *file_name = "stream_size.bin";
+    FILE *f = fopen(file_name, "wb");
+    TEST_ASSERT(f != NULL);
+    fwrite(content, 1, 5, f);
+    fclose(f);
+
+    s = stream_new_file_read(fopen(file_name, "rb"));
+    stream_skip(s, 3);
+    TEST_CHECK(stream_get_size(s) == 5);
+    TEST_CHECK(stream_get_cursor_position(s) == 3);
+    stream_free(s);
+    remove(file_name);
+}
+
 // check that skipping increases the cursor position
 void test_stream_get_cursor_position(void) {
     const size_t len = 2;
@@ -238,3 +260,61 @@ void test_stream_reached_the_end(void) {
     stream_free(s);
     free(content);
 }
+
+// check that a mapped file is read correctly and released on free
+void test_stream_new_mmap_read(void) {
+    const char *file_name = "hi_mmap.txt";
+    const char *content = "Hello";
+    char buf[6];
+    FILE *f = fopen(file_name, "wb");
+    TEST_ASSERT(f != NULL);
+    TEST_ASSERT(fputs(content, f) != EOF);
+    fclose(f);
+
+    Stream *s = stream_new_mmap_read(file_name);
+    TEST_ASSERT(s != NULL);
+    TEST_CHECK(stream_is_memory_backed(s));
+    TEST_CHECK(stream_read_string(s, 5, buf));
+    buf[5] = '\0';
+    TEST_CHECK(strcmp(buf, content) == 0);
+    TEST_CHECK(stream_reached_the_end(s));
+    // cannot read beyond the mapping
+    TEST_CHECK(stream_read(s, buf, 1, 1) == false);
+
+    stream_free(s);
+    remove(file_name);
+
+    // missing files can't be mapped
+    TEST_CHECK(stream_new_mmap_read("missing_file.txt") == NULL);
+}
+
+// check that borrowed bytes point to the stream memory and move the cursor
+void test_stream_borrow(void) {
+    const size_t len = 4;
+    const char content[4] = {1, 2, 3, 4};
+    Stream *s = stream_new_buffer_read(content, len);
+
+    const char *borrowed = (const char *)stream_borrow(s, 3);
+    TEST_CHECK(borrowed == content);
+    TEST_CHECK(stream_get_cursor_position(s) == 3);
+    // not enough bytes left
+    TEST_CHECK(stream_borrow(s, 2) == NULL);
+    TEST_CHECK(stream_get_cursor_position(s) == 3);
+    borrowed = (const char *)stream_borrow(s, 1);
+    TEST_CHECK(borrowed != NULL && *borrowed == 4);
+
+    stream_free(s);
+
+    // FILE streams can't lend memory
+    const char *file_name = "hi_borrow.txt";
+    FILE *f = fopen(file_name, "wb");
+    TEST_ASSERT(f != NULL);
+    fputs("Hello", f);
+    fclose(f);
+    f = fopen(file_name, "rb");
+    s = stream_new_file_read(f);
+    TEST_CHECK(stream_is_memory_backed(s) == false);
+    TEST_CHECK(stream_borrow(s, 1) == NULL);
+    stream_free(s);
+    remove(file_name);
+}
@@ -0,0 +1,155 @@
+// -------------------------------------------------------------
+//  Cubzh Core Unit Tests
+//  test_thread_pool.h
+// -------------------------------------------------------------
+
+#pragma once
+
+#include "mutex.h"
+#include "thread_pool.h"
+
+// functions that are NOT tested:
+// thread_pool_get_nb_cores
+
+typedef struct {
+    ThreadPool *pool;
+    uint32_t value;
+    char pad[4];
+} _TestThreadPoolJob;
+
+static void _test_thread_pool_increment(void *userdata) {
+    _TestThreadPoolJob *job = (_TestThreadPoolJob *)userdata;
+    job->value += 1;
+}
+
+// keeps a worker busy until released
+typedef struct {
+    Mutex *mutex;
+    uint32_t started;
+    bool released;
+    char pad[3];
+} _TestThreadPoolGate;
+
+static void _test_thread_pool_gate_job(void *userdata) {
+    _TestThreadPoolGate *gate = (_TestThreadPoolGate *)userdata;
+    mutex_lock(gate->mutex);
+    gate->started++;
+    mutex_unlock(gate->mutex);
+
+    bool released = false;
+    while (released == false) {
+        mutex_lock(gate->mutex);
+        released = gate->released;
+        mutex_unlock(gate->mutex);
+    }
+}
+
+static uint32_t _test_thread_pool_gate_started(_TestThreadPoolGate *gate) {
+    mutex_lock(gate->mutex);
+    const uint32_t started = gate->started;
+    mutex_unlock(gate->mutex);
+    return started;
+}
+
+static void _test_thread_pool_gate_release(_TestThreadPoolGate *gate) {
+    mutex_lock(gate->mutex);
+    gate->released = true;
+    mutex_unlock(gate->mutex);
+}
+
+// waits for a nested batch from within a job
+static void _test_thread_pool_nested(void *userdata) {
+    _TestThreadPoolJob *job = (_TestThreadPoolJob *)userdata;
+    _TestThreadPoolJob children[8];
+    ThreadPoolBatch *b = thread_pool_batch_new(job->pool);
+    for (int i = 0; i < 8; ++i) {
+        children[i].value = 0;
+        thread_pool_batch_add_job(b, _test_thread_pool_increment, &children[i]);
+    }
+    thread_pool_batch_wait_and_free(b);
+    for (int i = 0; i < 8; ++i) {
+        job->value += children[i].value;
+    }
+}
+
+// check that all jobs run once, w/ and w/o workers
+void test_thread_pool_add_job(void) {
+    const uint32_t nbWorkers[2] = {3, 0};
+    for (int p = 0; p < 2; ++p) {
+        ThreadPool *pool = thread_pool_new(nbWorkers[p]);
+        TEST_ASSERT(pool != NULL);
+        TEST_CHECK(thread_pool_get_nb_workers(pool) > 0);
+
+        _TestThreadPoolJob jobs[100];
+        for (int i = 0; i < 100; ++i) {
+            jobs[i].value = 0;
+            thread_pool_add_job(pool, _test_thread_pool_increment, &jobs[i]);
+        }
+        thread_pool_wait(pool);
+
+        bool allDone = true;
+        for (int i = 0; i < 100; ++i) {
+            allDone = allDone && jobs[i].value == 1;
+        }
+        TEST_CHECK(allDone);
+
+        thread_pool_free(pool);
+    }
+}
+
+// check that batches can be waited for from within jobs
+void test_thread_pool_batch(void) {
+    ThreadPool *pool = thread_pool_new(2);
+    TEST_ASSERT(pool != NULL);
+
+    _TestThreadPoolJob jobs[16];
+    ThreadPoolBatch *b = thread_pool_batch_new(pool);
+    TEST_ASSERT(b != NULL);
+    for (int i = 0; i < 16; ++i) {
+        jobs[i].pool = pool;
+        jobs[i].value = 0;
+        thread_pool_batch_add_job(b, _test_thread_pool_nested, &jobs[i]);
+    }
+    thread_pool_batch_wait_and_free(b);
+
+    bool allDone = true;
+    for (int i = 0; i < 16; ++i) {
+        allDone = allDone && jobs[i].value == 8;
+    }
+    TEST_CHECK(allDone);
+
+    TEST_CHECK(thread_pool_get_shared() != NULL);
+    TEST_CHECK(thread_pool_get_shared() == thread_pool_get_shared());
+
+    thread_pool_free(pool);
+}
+
+// check that waiting for a batch only runs jobs of that batch, other queued jobs are left to
+// workers
+void test_thread_pool_batch_wait_own_jobs(void) {
+    ThreadPool *pool = thread_pool_new(1);
+    TEST_ASSERT(pool != NULL);
+    TEST_ASSERT(thread_pool_get_nb_workers(pool) == 1); // gate job would never return otherwise
+
+    _TestThreadPoolGate gate = {mutex_new(), 0, false, {0}};
+    thread_pool_add_job(pool, _test_thread_pool_gate_job, &gate);
+    while (_test_thread_pool_gate_started(&gate) == 0) {}
+
+    _TestThreadPoolJob unrelated = {pool, 0, {0}};
+    _TestThreadPoolJob own = {pool, 0, {0}};
+    thread_pool_add_job(pool, _test_thread_pool_increment, &unrelated);
+    ThreadPoolBatch *b = thread_pool_batch_new(pool);
+    TEST_ASSERT(b != NULL);
+    thread_pool_batch_add_job(b, _test_thread_pool_increment, &own);
+    thread_pool_batch_wait_and_free(b);
+
+    TEST_CHECK(own.value == 1);
+    TEST_CHECK(unrelated.value == 0);
+
+    _test_thread_pool_gate_release(&gate);
+    thread_pool_wait(pool);
+    TEST_CHECK(unrelated.value == 1);
+
+    thread_pool_free(pool);
+    mutex_free(gate.mutex);
+}
@@ -0,0 +1,357 @@
+// -------------------------------------------------------------
+//  Cubzh Core
+//  thread_pool.c
+// -------------------------------------------------------------
+
+#include "thread_pool.h"
+
+// C
+#include <stdlib.h>
+
+// Core
+#include "cclog.h"
+
+#if defined(__VX_PLATFORM_WINDOWS)
+
+#include <windows.h>
+
+typedef HANDLE _Thread;
+typedef SRWLOCK _Lock;
+typedef CONDITION_VARIABLE _Cond;
+
+#define _lock_init(l) InitializeSRWLock(l)
+#define _lock_destroy(l)
+#define _lock(l) AcquireSRWLockExclusive(l)
+#define _unlock(l) ReleaseSRWLockExclusive(l)
+#define _cond_init(c) InitializeConditionVariable(c)
+#define _cond_destroy(c)
+#define _cond_wait(c, l) SleepConditionVariableSRW(c, l, INFINITE, 0)
+#define _cond_signal(c) WakeConditionVariable(c)
+#define _cond_broadcast(c) WakeAllConditionVariable(c)
+
+#else // non-Windows platforms
+
+#include <pthread.h>
+#include <unistd.h>
+
+typedef pthread_t _Thread;
+typedef pthread_mutex_t _Lock;
+typedef pthread_cond_t _Cond;
+
+#define _lock_init(l) pthread_mutex_init(l, NULL)
+#define _lock_destroy(l) pthread_mutex_destroy(l)
+#define _lock(l) pthread_mutex_lock(l)
+#define _unlock(l) pthread_mutex_unlock(l)
+#define _cond_init(c) pthread_cond_init(c, NULL)
+#define _cond_destroy(c) pthread_cond_destroy(c)
+#define _cond_wait(c, l) pthread_cond_wait(c, l)
+#define _cond_signal(c) pthread_cond_signal(c)
+#define _cond_broadcast(c) pthread_cond_broadcast(c)
+
+#endif // defined(__VX_PLATFORM_WINDOWS)
+
+typedef struct _ThreadPoolJob ThreadPoolJob;
+
+struct _ThreadPoolJob {
+    thread_pool_job_func func;
+    void *userdata;
+    ThreadPoolBatch *batch; // NULL if not part of a batch
+    ThreadPoolJob *next;
+};
+
+struct _ThreadPoolBatch {
+    ThreadPool *pool;
+    uint32_t pending; // jobs added & not done yet, protected by pool lock
+    char pad[4];
+};
+
+struct _ThreadPool {
+    _Thread *workers;
+    ThreadPoolJob *first;
+    ThreadPoolJob *last;
+    _Lock lock;
+    _Cond jobAdded; // signaled when a job is queued or pool is stopping
+    _Cond jobDone;  // broadcast when a job is done
+    uint32_t nbWorkers;
+    uint32_t pending; // queued + running jobs
+    bool stopping;
+    char pad[7];
+};
+
+// MARK: - Private -
+
+// pops next job, lock must be held
+static ThreadPoolJob *_thread_pool_pop(ThreadPool *p) {
+    ThreadPoolJob *job = p->first;
+    if (job != NULL) {
+        p->first = job->next;
+        if (p->first == NULL) {
+            p->last = NULL;
+        }
+    }
+    return job;
+}
+
+// pops next job of given batch, lock must be held
+static ThreadPoolJob *_thread_pool_pop_batch(ThreadPool *p, const ThreadPoolBatch *batch) {
+    ThreadPoolJob *prev = NULL;
+    ThreadPoolJob *job = p->first;
+    while (job != NULL && job->batch != batch) {
+        prev = job;
+        job = job->next;
+    }
+    if (job != NULL) {
+        if (prev != NULL) {
+            prev->next = job->next;
+        } else {
+            p->first = job->next;
+        }
+        if (p->last == job) {
+            p->last = prev;
+        }
+    }
+    return job;
+}
+
+// runs job without holding the lock, lock must be held when calling
+static void _thread_pool_run(ThreadPool *p, ThreadPoolJob *job) {
+    _unlock(&p->lock);
+    job->func(job->userdata);
+    _lock(&p->lock);
+
+    if (job->batch != NULL) {
+        job->batch->pending--;
+    }
+    p->pending--;
+    free(job);
+    _cond_broadcast(&p->jobDone);
+}
+
+#if defined(__VX_PLATFORM_WINDOWS)
+static DWORD WINAPI _thread_pool_worker(LPVOID arg) {
+#else
+static void *_thread_pool_worker(void *arg) {
+#endif
+    ThreadPool *p = (ThreadPool *)arg;
+
+    _lock(&p->lock);
+    while (true) {
+        ThreadPoolJob *job = _thread_pool_pop(p);
+        if (job != NULL) {
+            _thread_pool_run(p, job);
+        } else if (p->stopping) {
+            break;
+        } else {
+            _cond_wait(&p->jobAdded, &p->lock);
+        }
+    }
+    _unlock(&p->lock);
+
+#if defined(__VX_PLATFORM_WINDOWS)
+    return 0;
+#else
+    return NULL;
+#endif
+}
+
+static void _thread_pool_push(ThreadPool *p,
+                              thread_pool_job_func func,
+                              void *userdata,
+                              ThreadPoolBatch *batch) {
+
+    // no workers, job runs right away
+    if (p->nbWorkers == 0) {
+        func(userdata);
+        return;
+    }
+
+    ThreadPoolJob *job = (ThreadPoolJob *)malloc(sizeof(ThreadPoolJob));
+    if (job == NULL) {
+        cclog_error("thread pool: failed to allocate job, running it synchronously");
+        func(userdata);
+        return;
+    }
+    job->func = func;
+    job->userdata = userdata;
+    job->batch = batch;
+    job->next = NULL;
+
+    _lock(&p->lock);
+    if (p->last != NULL) {
+        p->last->next = job;
+    } else {
+        p->first = job;
+    }
+    p->last = job;
+    p->pending++;
+    if (batch != NULL) {
+        batch->pending++;
+    }
+    _cond_signal(&p->jobAdded);
+    _unlock(&p->lock);
+}
+
+// waits for pending counter to reach 0, running queued jobs of given batch meanwhile (any job if
+// batch is NULL), unrelated jobs are left to workers
+static void _thread_pool_wait_for(ThreadPool *p,
+                                  const uint32_t *pending,
+                                  const ThreadPoolBatch *batch) {
+    _lock(&p->lock);
+    while (*pending > 0) {
+        ThreadPoolJob *job = batch != NULL ? _thread_pool_pop_batch(p, batch)
+                                           : _thread_pool_pop(p);
+        if (job != NULL) {
+            _thread_pool_run(p, job);
+        } else {
+            _cond_wait(&p->jobDone, &p->lock);
+        }
+    }
+    _unlock(&p->lock);
+}
+
+// MARK: - Exposed functions -
+
+uint32_t thread_pool_get_nb_cores(void) {
+#if defined(__VX_PLATFORM_WINDOWS)
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    const long n = (long)info.dwNumberOfProcessors;
+#else
+    const long n = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+    return n > 0 ? (uint32_t)n : 1;
+}
+
+ThreadPool *thread_pool_new(uint32_t nbWorkers) {
+    ThreadPool *p = (ThreadPool *)malloc(sizeof(ThreadPool));
+    if (p == NULL) {
+        return NULL;
+    }
+
+    if (nbWorkers == 0) {
+        const uint32_t nbCores = thread_pool_get_nb_cores();
+        nbWorkers = nbCores > 1 ? nbCores - 1 : 1;
+    }
+
+    p->first = NULL;
+    p->last = NULL;
+    p->pending = 0;
+    p->stopping = false;
+    _lock_init(&p->lock);
+    _cond_init(&p->jobAdded);
+    _cond_init(&p->jobDone);
+
+    p->workers = (_Thread *)malloc(sizeof(_Thread) * nbWorkers);
+    p->nbWorkers = 0;
+    if (p->workers == NULL) {
+        return p;
+    }
+
+    for (uint32_t i = 0; i < nbWorkers; ++i) {
+#if defined(__VX_PLATFORM_WINDOWS)
+        p->workers[i] = CreateThread(NULL, 0, _thread_pool_worker, p, 0, NULL);
+        const bool ok = p->workers[i] != NULL;
+#else
+        const bool ok = pthread_create(&p->workers[i], NULL, _thread_pool_worker, p) == 0;
+#endif
+        if (ok == false) {
+            // keep workers created so far (possibly none, jobs then run synchronously)
+            cclog_warning("thread pool: could only create %u/%u workers", i, nbWorkers);
+            break;
+        }
+        p->nbWorkers++;
+    }
+
+    return p;
+}
+
+void thread_pool_free(ThreadPool *p) {
+    if (p == NULL) {
+        return;
+    }
+
+    thread_pool_wait(p);
+
+    _lock(&p->lock);
+    p->stopping = true;
+    _cond_broadcast(&p->jobAdded);
+    _unlock(&p->lock);
+
+    for (uint32_t i = 0; i < p->nbWorkers; ++i) {
+#if defined(__VX_PLATFORM_WINDOWS)
+        WaitForSingleObject(p->workers[i], INFINITE);
+        CloseHandle(p->workers[i]);
+#else
+        pthread_join(p->workers[i], NULL);
+#endif
+    }
+    free(p->workers);
+
+    _cond_destroy(&p->jobAdded);
+    _cond_destroy(&p->jobDone);
+    _lock_destroy(&p->lock);
+    free(p);
+}
+
+#if defined(__VX_PLATFORM_WINDOWS)
+static INIT_ONCE _sharedPoolOnce = INIT_ONCE_STATIC_INIT;
+#else
+static pthread_once_t _sharedPoolOnce = PTHREAD_ONCE_INIT;
+#endif
+static ThreadPool *_sharedPool = NULL;
+
+#if defined(__VX_PLATFORM_WINDOWS)
+static BOOL CALLBACK _thread_pool_create_shared(PINIT_ONCE once, PVOID param, PVOID *ctx) {
+    _sharedPool = thread_pool_new(0);
+    return TRUE;
+}
+#else
+static void _thread_pool_create_shared(void) {
+    _sharedPool = thread_pool_new(0);
+}
+#endif
+
+ThreadPool *thread_pool_get_shared(void) {
+#if defined(__VX_PLATFORM_WINDOWS)
+    InitOnceExecuteOnce(&_sharedPoolOnce, _thread_pool_create_shared, NULL, NULL);
+#else
+    pthread_once(&_sharedPoolOnce, _thread_pool_create_shared);
+#endif
+    return _sharedPool;
+}
+
+uint32_t thread_pool_get_nb_workers(const ThreadPool *p) {
+    return p->nbWorkers;
+}
+
+void thread_pool_add_job(ThreadPool *p, thread_pool_job_func func, void *userdata) {
+    _thread_pool_push(p, func, userdata, NULL);
+}
+
+void thread_pool_wait(ThreadPool *p) {
+    _thread_pool_wait_for(p, &p->pending, NULL);
+}
+
+// MARK: - Batches -
+
+ThreadPoolBatch *thread_pool_batch_new(ThreadPool *p) {
+    ThreadPoolBatch *b = (ThreadPoolBatch *)malloc(sizeof(ThreadPoolBatch));
+    if (b == NULL) {
+        return NULL;
+    }
+    b->pool = p;
+    b->pending = 0;
+    return b;
+}
+
+void thread_pool_batch_add_job(ThreadPoolBatch *b, thread_pool_job_func func, void *userdata) {
+    _thread_pool_push(b->pool, func, userdata, b);
+}
+
+void thread_pool_batch_wait_and_free(ThreadPoolBatch *b) {
+    if (b == NULL) {
+        return;
+    }
+    _thread_pool_wait_for(b->pool, &b->pending, b);
+    free(b);
+}
@@ -0,0 +1,60 @@
+// -------------------------------------------------------------
+//  Cubzh Core
+//  thread_pool.h
+// -------------------------------------------------------------
+
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// A fixed set of worker threads consuming jobs in FIFO order.
+// On platforms where threads can't be created, pools have no workers
+// and jobs run synchronously on the calling thread.
+
+typedef struct _ThreadPool ThreadPool;
+
+// Jobs added through a batch can be waited for together.
+typedef struct _ThreadPoolBatch ThreadPoolBatch;
+
+typedef void (*thread_pool_job_func)(void *userdata);
+
+/// Number of cores available to the process (at least 1)
+uint32_t thread_pool_get_nb_cores(void);
+
+/// Creates a pool with given number of workers,
+/// 0 means one worker per available core, minus one for the calling thread.
+ThreadPool *thread_pool_new(uint32_t nbWorkers);
+
+/// Waits for all pending jobs, then stops and frees workers
+void thread_pool_free(ThreadPool *p);
+
+/// Process-wide pool, created on first call (thread safe)
+ThreadPool *thread_pool_get_shared(void);
+
+uint32_t thread_pool_get_nb_workers(const ThreadPool *p);
+
+/// Adds a job that nobody will wait for (userdata ownership goes to the job)
+void thread_pool_add_job(ThreadPool *p, thread_pool_job_func func, void *userdata);
+
+/// Blocks until all jobs added so far are done, the waiting thread runs queued jobs meanwhile
+void thread_pool_wait(ThreadPool *p);
+
+// MARK: - Batches -
+
+ThreadPoolBatch *thread_pool_batch_new(ThreadPool *p);
+
+void thread_pool_batch_add_job(ThreadPoolBatch *b, thread_pool_job_func func, void *userdata);
+
+/// Blocks until all jobs of the batch are done, then frees the batch.
+/// The waiting thread runs queued jobs of that batch meanwhile (never other jobs), it's fine to
+/// wait for a batch from a job.
+void thread_pool_batch_wait_and_free(ThreadPoolBatch *b);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
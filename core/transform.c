@@ -44,6 +44,12 @@
 #define TRANSFORM_FLAG_ANIMATIONS 8
 // helper to debug a specific transform
 #define TRANSFORM_FLAG_DEBUG 16
+// branch has to be visited by the scene physics or end-of-frame refresh, these flags are set along
+// ancestors, see transform_set_branch_dirty
+#define TRANSFORM_FLAG_BRANCH_REFRESH 32
+#define TRANSFORM_FLAG_BRANCH_END_OF_FRAME 64
+#define TRANSFORM_FLAG_BRANCH_ALL                                                                  \
+    (TRANSFORM_FLAG_BRANCH_REFRESH | TRANSFORM_FLAG_BRANCH_END_OF_FRAME)
 
 #if DEBUG_TRANSFORM
 static int debug_transform_refresh_calls = 0;
@@ -184,7 +190,7 @@ Transform *transform_make(TransformType type) {
     t->childrenCount = 0;
     t->children = doubly_linked_list_new();
     t->dirty = TRANSFORM_DIRTY_NONE;
-    t->flags = TRANSFORM_FLAG_ANIMATIONS;
+    t->flags = TRANSFORM_FLAG_ANIMATIONS | TRANSFORM_FLAG_BRANCH_ALL;
     t->ptr = NULL;
     t->ptr_free = NULL;
     t->wptr = NULL;
@@ -299,6 +305,30 @@ void transform_refresh_children_done(Transform *t) {
     _transform_reset_dirty(t, TRANSFORM_DIRTY_CHILDREN);
 }
 
+void transform_set_branch_dirty(Transform *t) {
+    // self is always flagged, in case its branch was just moved under a new parent
+    t->flags |= TRANSFORM_FLAG_BRANCH_ALL;
+
+    // ancestors of a flagged transform are flagged as well
+    Transform *it = t->parent;
+    while (it != NULL && (it->flags & TRANSFORM_FLAG_BRANCH_ALL) != TRANSFORM_FLAG_BRANCH_ALL) {
+        it->flags |= TRANSFORM_FLAG_BRANCH_ALL;
+        it = it->parent;
+    }
+}
+
+bool transform_is_branch_dirty(const Transform *t, bool endOfFrame) {
+    return (t->flags & (endOfFrame ? TRANSFORM_FLAG_BRANCH_END_OF_FRAME
+                                   : TRANSFORM_FLAG_BRANCH_REFRESH)) != 0;
+}
+
+void transform_toggle_branch_dirty(Transform *t, bool endOfFrame, bool toggle) {
+    _transform_toggle_flag(t,
+                           endOfFrame ? TRANSFORM_FLAG_BRANCH_END_OF_FRAME
+                                      : TRANSFORM_FLAG_BRANCH_REFRESH,
+                           toggle);
+}
+
 void transform_reset_any_dirty(Transform *t) {
     _transform_reset_dirty(t, TRANSFORM_DIRTY_CACHE);
 }
@@ -334,6 +364,7 @@ bool transform_ensure_rigidbody(Transform *t,
     bool isNew = false;
     if (t->rigidBody == NULL) {
         t->rigidBody = rigidbody_new(mode, groups, collidesWith);
+        rigidbody_set_transform(t->rigidBody, t);
         isNew = true;
     } else {
         rigidbody_set_simulation_mode(t->rigidBody, mode);
@@ -353,6 +384,7 @@ bool transform_ensure_rigidbody_copy(Transform *t, const Transform *other) {
 
     if (t->rigidBody == NULL) {
         t->rigidBody = rigidbody_new_copy(other->rigidBody);
+        rigidbody_set_transform(t->rigidBody, t);
     } else {
         rigidbody_set_collider(t->rigidBody, rigidbody_get_collider(other->rigidBody), false);
         rigidbody_set_constant_acceleration(t->rigidBody,
@@ -466,6 +498,7 @@ bool transform_set_parent(Transform *t, Transform *parent, bool keepWorld) {
     t->parent = parent;
     doubly_linked_list_push_last(parent->children, t);
     parent->childrenCount++;
+    transform_set_branch_dirty(t);
     return true;
 }
 
@@ -1164,6 +1197,11 @@ static void _transform_set_dirty(Transform *const t, const uint8_t flag, bool ke
     } else {
         t->dirty |= (flag | TRANSFORM_DIRTY_CACHE);
     }
+
+    // any change of transformations sets mtx dirty, other flags are set while refreshing
+    if ((flag & TRANSFORM_DIRTY_MTX) != 0) {
+        transform_set_branch_dirty(t);
+    }
 }
 
 static void _transform_reset_dirty(Transform *const t, const uint8_t flag) {
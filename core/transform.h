@@ -95,6 +95,13 @@ Weakptr *transform_get_and_retain_weakptr(Transform *t);
 bool transform_is_hierarchy_dirty(Transform *t);
 void transform_refresh(Transform *t, bool hierarchyDirty, bool refreshParents);
 void transform_refresh_children_done(Transform *t);
+/// Flags this transform & its ancestors, for the scene refresh passes to visit this branch. Done on
+/// any change of transformations or hierarchy, and by rigidbodies & shapes having work to do
+void transform_set_branch_dirty(Transform *t);
+/// @param endOfFrame flag of the end-of-frame refresh, or of the physics refresh
+bool transform_is_branch_dirty(const Transform *t, bool endOfFrame);
+/// Toggles this transform flag only, used by the scene while visiting the branch
+void transform_toggle_branch_dirty(Transform *t, bool endOfFrame, bool toggle);
 void transform_reset_any_dirty(Transform *t);
 /// set, but not reset by transform, can be used internally by higher types as custom flag
 bool transform_is_any_dirty(Transform *t);